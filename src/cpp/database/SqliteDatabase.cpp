@@ -16,7 +16,8 @@ SETUP_NLOG("DataBase");
 
 using namespace std;
 
-SqliteDatabase::SqliteDatabase(const char* host) : Database(host,"",""), mWalQ(NULL), walRunning(false)
+SqliteDatabase::SqliteDatabase(const char* host, bool readOnly) : Database(host,"",""),
+	mReadOnly(readOnly), mWalQ(NULL), walRunning(false)
 {
 	mConnection		= NULL;
 	mCurrentStmt	= NULL;
@@ -24,7 +25,9 @@ SqliteDatabase::SqliteDatabase(const char* host) : Database(host,"",""), mWalQ(N
 
 void SqliteDatabase::connect()
 {
-	int rc = sqlite3_open(mHost.c_str(), &mConnection);
+	int rc = mReadOnly
+		? sqlite3_open_v2(mHost.c_str(), &mConnection, SQLITE_OPEN_READONLY, NULL)
+		: sqlite3_open(mHost.c_str(), &mConnection);
 	if (rc)
 	{
 		cLog(lsFATAL) << "Can't open " << mHost << " " << rc;
@@ -35,10 +38,29 @@ void SqliteDatabase::connect()
 
 void SqliteDatabase::disconnect()
 {
+	typedef std::pair<const std::string, SqliteStatement*> stmt_t;
+	BOOST_FOREACH(stmt_t& it, mStatements)
+		delete it.second;
+	mStatements.clear();
+
 	sqlite3_finalize(mCurrentStmt);
+	mCurrentStmt = NULL;
 	sqlite3_close(mConnection);
 }
 
+SqliteStatement& SqliteDatabase::getStatement(const char* sql)
+{
+	std::map<std::string, SqliteStatement*>::iterator it = mStatements.find(sql);
+	if (it == mStatements.end())
+		it = mStatements.insert(std::make_pair(std::string(sql), new SqliteStatement(this, sql))).first;
+	else
+	{
+		it->second->reset();
+		it->second->clearBindings();
+	}
+	return *it->second;
+}
+
 // returns true if the query went ok
 bool SqliteDatabase::executeSQL(const char* sql, bool fail_ok)
 {
@@ -298,6 +320,11 @@ int SqliteStatement::bind(int position, uint32 value)
 	return sqlite3_bind_int64(statement, position, static_cast<sqlite3_int64>(value));
 }
 
+int SqliteStatement::bind(int position, uint64 value)
+{
+	return sqlite3_bind_int64(statement, position, static_cast<sqlite3_int64>(value));
+}
+
 int SqliteStatement::bind(int position, const std::string& value)
 {
 	return sqlite3_bind_text(statement, position, value.data(), value.size(), SQLITE_TRANSIENT);
@@ -313,6 +340,11 @@ int SqliteStatement::bind(int position)
 	return sqlite3_bind_null(statement, position);
 }
 
+int SqliteStatement::clearBindings()
+{
+	return sqlite3_clear_bindings(statement);
+}
+
 int SqliteStatement::size(int column)
 {
 	return sqlite3_column_bytes(statement, column);
@@ -346,11 +378,21 @@ uint32 SqliteStatement::getUInt32(int column)
 	return static_cast<uint32>(sqlite3_column_int64(statement, column));
 }
 
+uint64 SqliteStatement::getUInt64(int column)
+{
+	return static_cast<uint64>(sqlite3_column_int64(statement, column));
+}
+
 int64 SqliteStatement::getInt64(int column)
 {
 	return sqlite3_column_int64(statement, column);
 }
 
+bool SqliteStatement::isNull(int column)
+{
+	return sqlite3_column_type(statement, column) == SQLITE_NULL;
+}
+
 int SqliteStatement::step()
 {
 	return sqlite3_step(statement);
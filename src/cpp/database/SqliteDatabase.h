@@ -2,18 +2,24 @@
 
 #include <string>
 #include <set>
+#include <map>
 
 #include <boost/thread/mutex.hpp>
 
 struct sqlite3;
 struct sqlite3_stmt;
 
+class SqliteStatement;
 
 class SqliteDatabase : public Database
 {
 	sqlite3* mConnection;
 	sqlite3_stmt* mCurrentStmt;
 	bool mMoreRows;
+	bool mReadOnly;
+
+	// Prepared statements owned by this connection, keyed by SQL text
+	std::map<std::string, SqliteStatement*>	mStatements;
 
 	boost::mutex			walMutex;
 	JobQueue*				mWalQ;
@@ -21,7 +27,7 @@ class SqliteDatabase : public Database
 	bool					walRunning;
 
 public:
-	SqliteDatabase(const char* host);
+	SqliteDatabase(const char* host, bool readOnly = false);
 
 	void connect();
 	void disconnect();
@@ -52,6 +58,12 @@ public:
 	uint64 getBigInt(int colIndex);
 
 	sqlite3* peekConnection() { return mConnection; }
+	bool isReadOnly() const { return mReadOnly; }
+
+	// Returns a reset statement from this connection's cache, preparing it on first use.
+	// The caller must serialize use of the connection, as with executeSQL.
+	SqliteStatement& getStatement(const char* sql);
+
 	virtual bool setupCheckpointing(JobQueue*);
 	virtual SqliteDatabase* getSqliteDB() { return this; }
 
@@ -85,8 +97,11 @@ public:
 	int bindStatic(int position, const std::string& value);
 
 	int bind(int position, uint32 value);
+	int bind(int position, uint64 value);
 	int bind(int position);
 
+	int clearBindings();
+
 	// columns start at 0
 	int size(int column);
 
@@ -96,7 +111,9 @@ public:
 	std::string getString(int column);
 	const char* peekString(int column);
 	uint32 getUInt32(int column);
+	uint64 getUInt64(int column);
 	int64 getInt64(int column);
+	bool isNull(int column);
 
 	int step();
 	int reset();
@@ -7,7 +7,7 @@
 
 SETUP_LOG();
 
-AccountItem::AccountItem(SerializedLedgerEntry::ref ledger) : mLedgerEntry(ledger)
+AccountItem::AccountItem(SerializedLedgerView::ref ledger) : mLedgerEntry(ledger)
 {
 
 }
@@ -24,18 +24,16 @@ void AccountItems::fillItems(const uint160& accountID, Ledger::ref ledger)
 	uint256 rootIndex		= Ledger::getOwnerDirIndex(accountID);
 	uint256 currentIndex	= rootIndex;
 
-	LedgerStateParms	lspNode		= lepNONE;
-
 	while (1)
 	{
-		SLE::pointer ownerDir	= ledger->getDirNode(lspNode, currentIndex);
+		SLEView::pointer ownerDir	= ledger->getSLEView(currentIndex, ltDIR_NODE);
 		if (!ownerDir) return;
 
 		STVector256 svOwnerNodes	= ownerDir->getFieldV256(sfIndexes);
 
 		BOOST_FOREACH(uint256& uNode, svOwnerNodes.peekValue())
 		{
-			SLE::pointer sleCur	= ledger->getSLE(uNode);
+			SLEView::pointer sleCur	= ledger->getSLEView(uNode);
 
 			AccountItem::pointer item=mOfType->makeItem(accountID, sleCur);
 			if(item)
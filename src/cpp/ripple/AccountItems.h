@@ -10,19 +10,18 @@
 class AccountItem
 {
 protected:
-	SerializedLedgerEntry::pointer	mLedgerEntry;
+	SerializedLedgerView::pointer	mLedgerEntry;
 public:
 	typedef boost::shared_ptr<AccountItem> pointer;
 	typedef const pointer& ref;
 
 	AccountItem(){ }
-	AccountItem(SerializedLedgerEntry::ref ledger);
-	virtual AccountItem::pointer makeItem(const uint160& accountID, SerializedLedgerEntry::ref ledgerEntry)=0;
+	AccountItem(SerializedLedgerView::ref ledger);
+	virtual AccountItem::pointer makeItem(const uint160& accountID, SerializedLedgerView::ref ledgerEntry)=0;
 	virtual LedgerEntryType getType()=0;
 
-	SerializedLedgerEntry::pointer getSLE() { return mLedgerEntry; }
-	const SerializedLedgerEntry& peekSLE() const { return *mLedgerEntry; }
-	SerializedLedgerEntry& peekSLE() { return *mLedgerEntry; }
+	SerializedLedgerEntry::pointer getSLE() { return mLedgerEntry->getSLE(); }
+	const SerializedLedgerView& peekSLE() const { return *mLedgerEntry; }
 
 	std::vector<unsigned char> getRaw() const;
 };
@@ -27,6 +27,44 @@ static const uint64 tenTo17 = tenTo14 * 1000;
 #include "BigNum64.h"
 #endif
 
+// Compute (a * b) / c, truncating. Callers guarantee the quotient fits in 64 bits.
+static uint64 muldivBN(uint64 a, uint64 b, uint64 c)
+{
+	CBigNum v;
+	if ((BN_add_word64(&v, a) != 1) ||
+		(BN_mul_word64(&v, b) != 1) ||
+		(BN_div_word64(&v, c) == ((uint64) -1)))
+	{
+		throw std::runtime_error("internal bn error");
+	}
+
+	assert(BN_num_bytes(&v) <= 64);
+
+	return v.getuint64();
+}
+
+#ifdef __SIZEOF_INT128__
+
+// Same as muldivBN but on a native 128-bit intermediate, so the offer and path loops don't allocate a BIGNUM
+// for every IOU multiply and divide.
+static inline uint64 muldiv(uint64 a, uint64 b, uint64 c)
+{
+	unsigned __int128 v = static_cast<unsigned __int128>(a) * b / c;
+
+	assert((v >> 64) == 0);
+
+	return static_cast<uint64>(v);
+}
+
+#else
+
+static inline uint64 muldiv(uint64 a, uint64 b, uint64 c)
+{
+	return muldivBN(a, b, c);
+}
+
+#endif
+
 bool STAmount::issuerFromString(uint160& uDstIssuer, const std::string& sIssuer)
 {
 	bool	bSuccess	= true;
@@ -918,18 +956,8 @@ STAmount STAmount::divide(const STAmount& num, const STAmount& den, const uint16
 		}
 
 	// Compute (numerator * 10^17) / denominator
-	CBigNum v;
-	if ((BN_add_word64(&v, numVal) != 1) ||
-		(BN_mul_word64(&v, tenTo17) != 1) ||
-		(BN_div_word64(&v, denVal) == ((uint64) -1)))
-	{
-		throw std::runtime_error("internal bn error");
-	}
-
 	// 10^16 <= quotient <= 10^18
-	assert(BN_num_bytes(&v) <= 64);
-
-	return STAmount(uCurrencyID, uIssuerID, v.getuint64() + 5,
+	return STAmount(uCurrencyID, uIssuerID, muldiv(numVal, tenTo17, denVal) + 5,
 		numOffset - denOffset - 17, num.mIsNegative != den.mIsNegative);
 }
 
@@ -971,19 +999,8 @@ STAmount STAmount::multiply(const STAmount& v1, const STAmount& v2, const uint16
 	}
 
 	// Compute (numerator * denominator) / 10^14 with rounding
-	// 10^16 <= result <= 10^18
-	CBigNum v;
-	if ((BN_add_word64(&v, value1) != 1) ||
-		(BN_mul_word64(&v, value2) != 1) ||
-		(BN_div_word64(&v, tenTo14) == ((uint64) -1)))
-	{
-		throw std::runtime_error("internal bn error");
-	}
-
 	// 10^16 <= product <= 10^18
-	assert(BN_num_bytes(&v) <= 64);
-
-	return STAmount(uCurrencyID, uIssuerID, v.getuint64() + 7, offset1 + offset2 + 14,
+	return STAmount(uCurrencyID, uIssuerID, muldiv(value1, value2, tenTo14) + 7, offset1 + offset2 + 14,
 		v1.mIsNegative != v2.mIsNegative);
 }
 
@@ -1587,6 +1604,72 @@ BOOST_AUTO_TEST_CASE( CurrencyMulDivTests )
 			mulTest(rand() % 10000000, rand() % 10000000);
 }
 
+static uint64 randMantissa()
+{ // a random value in [cMinValue, cMaxValue]
+	uint64 r = rand();
+	r <<= 31;
+	r |= rand();
+	r <<= 31;
+	r |= rand();
+	return STAmount::cMinValue + (r % (STAmount::cMaxValue - STAmount::cMinValue + 1));
+}
+
+static void muldivTest(uint64 a, uint64 b, uint64 c)
+{
+	if (muldiv(a, b, c) != muldivBN(a, b, c))
+	{
+		cLog(lsWARNING) << "muldiv(" << a << ", " << b << ", " << c << ") = " << muldiv(a, b, c)
+			<< " not " << muldivBN(a, b, c);
+		BOOST_FAIL("Native muldiv differs from BIGNUM");
+	}
+}
+
+BOOST_AUTO_TEST_CASE( NativeMulDivTests )
+{
+	// Every mantissa multiply and divide lands in the ranges below, so compare the native kernel against the
+	// BIGNUM one over all pairs of edge values and a large random sample of each operation.
+	const uint64 edges[] = {
+		STAmount::cMinValue, STAmount::cMinValue + 1, STAmount::cMinValue * 2 - 1, STAmount::cMinValue * 3,
+		tenTo14 * 99 + 1, tenTo14 * 999 / 7, STAmount::cMaxValue - 1, STAmount::cMaxValue
+	};
+	const int iEdges = sizeof(edges) / sizeof(edges[0]);
+
+	for (int i = 0; i != iEdges; ++i)
+		for (int j = 0; j != iEdges; ++j)
+		{
+			muldivTest(edges[i], edges[j], tenTo14);
+			muldivTest(edges[i], tenTo17, edges[j]);
+		}
+
+	for (int i = 0; i != 1000000; ++i)
+	{
+		uint64 a = randMantissa(), b = randMantissa();
+		muldivTest(a, b, tenTo14);
+		muldivTest(a, tenTo17, b);
+	}
+
+	// The amount level paths should agree too
+	for (int i = 0; i != 10000; ++i)
+	{
+		STAmount a(CURRENCY_ONE, ACCOUNT_ONE, randMantissa(), (rand() % 40) - 20);
+		STAmount b(CURRENCY_ONE, ACCOUNT_ONE, randMantissa(), (rand() % 40) - 20);
+
+		STAmount prod(CURRENCY_ONE, ACCOUNT_ONE, muldivBN(a.getMantissa(), b.getMantissa(), tenTo14) + 7,
+			a.getExponent() + b.getExponent() + 14, false);
+		if (STAmount::multiply(a, b, CURRENCY_ONE, ACCOUNT_ONE) != prod)
+			BOOST_FAIL("STAmount multiply differs from BIGNUM");
+
+		STAmount quot(CURRENCY_ONE, ACCOUNT_ONE, muldivBN(a.getMantissa(), tenTo17, b.getMantissa()) + 5,
+			a.getExponent() - b.getExponent() - 17, false);
+		if (STAmount::divide(a, b, CURRENCY_ONE, ACCOUNT_ONE) != quot)
+			BOOST_FAIL("STAmount divide differs from BIGNUM");
+
+		if (!quot.isZero() && (STAmount::getRate(b, a) != ((static_cast<uint64>(quot.getExponent() + 100) << (64 - 8))
+			| quot.getMantissa())))
+			BOOST_FAIL("STAmount getRate differs from BIGNUM");
+	}
+}
+
 BOOST_AUTO_TEST_CASE( UnderFlowTests )
 {
 	STAmount bigNative(STAmount::cMaxNative / 2);
@@ -3,10 +3,12 @@
 #include "Config.h"
 #include "PeerDoor.h"
 #include "RPCDoor.h"
+#include "MetricsDoor.h"
 #include "BitcoinUtil.h"
 #include "key.h"
 #include "utils.h"
 #include "TaggedCache.h"
+#include "SlabPool.h"
 #include "Log.h"
 
 #include "../database/SqliteDatabase.h"
@@ -14,6 +16,7 @@
 #include <iostream>
 
 #include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
@@ -23,11 +26,13 @@ LogPartition TaggedCachePartition("TaggedCache");
 LogPartition AutoSocketPartition("AutoSocket");
 Application* theApp = NULL;
 
-DatabaseCon::DatabaseCon(const std::string& strName, const char *initStrings[], int initCount)
+DatabaseCon::DatabaseCon(const std::string& strName, const char *initStrings[], int initCount) :
+	mReaderCount(0), mReaderLimit(0)
 {
 	boost::filesystem::path	pPath	= theConfig.RUN_STANDALONE ? "" : theConfig.DATA_DIR / strName;
 
-	mDatabase = new SqliteDatabase(pPath.string().c_str());
+	mPath = pPath.string();
+	mDatabase = new SqliteDatabase(mPath.c_str());
 	mDatabase->connect();
 	for(int i = 0; i < initCount; ++i)
 		mDatabase->executeSQL(initStrings[i], true);
@@ -35,16 +40,92 @@ DatabaseCon::DatabaseCon(const std::string& strName, const char *initStrings[],
 
 DatabaseCon::~DatabaseCon()
 {
+	BOOST_FOREACH(Database* reader, mIdleReaders)
+	{
+		reader->disconnect();
+		delete reader;
+	}
+	mIdleReaders.clear();
+
 	mDatabase->disconnect();
 	delete mDatabase;
 }
 
+void DatabaseCon::setReaderLimit(int limit)
+{ // An unnamed database is private to its connection, so it cannot have readers
+	boost::mutex::scoped_lock sl(mReaderLock);
+	mReaderLimit = mPath.empty() ? 0 : limit;
+}
+
+Database* DatabaseCon::acquireReader()
+{
+	boost::mutex::scoped_lock sl(mReaderLock);
+	if (mReaderLimit <= 0)
+		return NULL;
+
+	while (mIdleReaders.empty())
+	{
+		if (mReaderCount < mReaderLimit)
+		{ // open connections lazily, only as concurrency requires them
+			++mReaderCount;
+			sl.unlock();
+			Database* reader = new SqliteDatabase(mPath.c_str(), true);
+			reader->connect();
+			cLog(lsDEBUG) << "Opened reader for " << mPath;
+			return reader;
+		}
+		mReaderCondition.wait(sl);
+	}
+
+	Database* reader = mIdleReaders.back();
+	mIdleReaders.pop_back();
+	return reader;
+}
+
+void DatabaseCon::releaseReader(Database* reader)
+{
+	boost::mutex::scoped_lock sl(mReaderLock);
+	mIdleReaders.push_back(reader);
+	mReaderCondition.notify_one();
+}
+
+DatabaseReader::DatabaseReader(DatabaseCon* con) : mCon(con), mLock(con->getDBLock(), boost::defer_lock)
+{
+	mDatabase = mCon->acquireReader();
+	if (!mDatabase)
+	{
+		mLock.lock();
+		mDatabase = mCon->getDB();
+	}
+}
+
+DatabaseReader::~DatabaseReader()
+{
+	BOOST_FOREACH(SqliteStatement* statement, mStatements)
+		statement->reset();
+
+	if (mLock.owns_lock())
+		mLock.unlock();
+	else
+	{
+		mDatabase->getSqliteDB()->endIterRows();
+		mCon->releaseReader(mDatabase);
+	}
+}
+
+SqliteStatement& DatabaseReader::getStatement(const char* sql)
+{
+	SqliteStatement& statement = mDatabase->getSqliteDB()->getStatement(sql);
+	mStatements.push_back(&statement);
+	return statement;
+}
+
 Application::Application() :
 	mIOWork(mIOService), mAuxWork(mAuxService), mUNL(mIOService), mNetOps(mIOService, &mLedgerMaster),
 	mTempNodeCache("NodeCache", 16384, 90), mHashedObjectStore(16384, 300),
 	mSNTPClient(mAuxService), mRPCHandler(&mNetOps), mFeeTrack(),
 	mRpcDB(NULL), mTxnDB(NULL), mLedgerDB(NULL), mWalletDB(NULL), mHashNodeDB(NULL), mNetNodeDB(NULL),
-	mConnectionPool(mIOService), mPeerDoor(NULL), mRPCDoor(NULL), mWSPublicDoor(NULL), mWSPrivateDoor(NULL),
+	mConnectionPool(mIOService), mPeerDoor(NULL), mRPCDoor(NULL), mMetricsDoor(NULL), mWSPublicDoor(NULL), mWSPrivateDoor(NULL),
 	mSweepTimer(mAuxService)
 {
 	getRand(mNonce256.begin(), mNonce256.size());
@@ -59,7 +140,7 @@ void Application::stop()
 {
 	cLog(lsINFO) << "Received shutdown request";
 	mIOService.stop();
-	mHashedObjectStore.bulkWrite();
+	mHashedObjectStore.stopWrite();
 	mValidations.flush();
 	mAuxService.stop();
 	mJobQueue.shutdown();
@@ -128,6 +209,10 @@ void Application::setup()
 	mLedgerDB->getDB()->setupCheckpointing(&mJobQueue);
 	mHashNodeDB->getDB()->setupCheckpointing(&mJobQueue);
 
+	mTxnDB->setReaderLimit(theConfig.getSize(siDBReaders));
+	mLedgerDB->setReaderLimit(theConfig.getSize(siDBReaders));
+	mHashNodeDB->setReaderLimit(theConfig.getSize(siDBReaders));
+
 	if (theConfig.START_UP == Config::FRESH)
 	{
 		cLog(lsINFO) << "Starting new Ledger";
@@ -163,8 +248,12 @@ void Application::setup()
 	if (!theConfig.RUN_STANDALONE)
 		getUNL().nodeBootstrap();
 
+	InstanceType::setTelemetry(theConfig.INSTANCE_TELEMETRY);
+
 	mValidations.tune(theConfig.getSize(siValidationsSize), theConfig.getSize(siValidationsAge));
 	mHashedObjectStore.tune(theConfig.getSize(siNodeCacheSize), theConfig.getSize(siNodeCacheAge));
+	mHashedObjectStore.tuneWrites(theConfig.NODE_WRITE_BATCH, theConfig.NODE_WRITE_LATENCY,
+		static_cast<uint64>(theConfig.NODE_WRITE_BUDGET) * 1024 * 1024);
 	mLedgerMaster.tune(theConfig.getSize(siLedgerSize), theConfig.getSize(siLedgerAge));
 
 	//
@@ -211,6 +300,24 @@ void Application::setup()
 		cLog(lsINFO) << "RPC interface: disabled";
 	}
 
+	//
+	// Allow Prometheus to scrape the latency histograms.
+	//
+	if (!theConfig.METRICS_IP.empty() && theConfig.METRICS_PORT)
+	{
+		try
+		{
+			mMetricsDoor = new MetricsDoor(mIOService);
+		}
+		catch (const std::exception& e)
+		{
+			// Must run as directed or exit.
+			cLog(lsFATAL) << boost::str(boost::format("Can not open metrics service: %s") % e.what());
+
+			exit(3);
+		}
+	}
+
 	//
 	// Allow private WS connections.
 	//
@@ -301,6 +408,7 @@ void Application::sweep()
 	mTempNodeCache.sweep();
 	mValidations.sweep();
 	getMasterLedgerAcquire().sweep();
+	SlabPool::releaseAll();			// after the caches, which hold most of the nodes
 	mSweepTimer.expires_from_now(boost::posix_time::seconds(theConfig.getSize(siSweepInterval)));
 	mSweepTimer.async_wait(boost::bind(&Application::sweep, this));
 }
@@ -2,6 +2,7 @@
 #define __APPLICATION__
 
 #include <boost/asio.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 #include "../database/database.h"
 
@@ -27,20 +28,58 @@
 #include "OrderBookDB.h"
 
 class RPCDoor;
+class MetricsDoor;
 class PeerDoor;
 typedef TaggedCache< uint256, std::vector<unsigned char> > NodeCache;
 
+class SqliteStatement;
+
 class DatabaseCon
 {
 protected:
 	Database*				mDatabase;
 	boost::recursive_mutex	mLock;
 
+	// Read-only connections, so queries can run in parallel with the writer under WAL
+	std::string					mPath;
+	boost::mutex				mReaderLock;
+	boost::condition_variable	mReaderCondition;
+	std::vector<Database*>		mIdleReaders;
+	int							mReaderCount;
+	int							mReaderLimit;
+
 public:
 	DatabaseCon(const std::string& name, const char *initString[], int countInit);
 	~DatabaseCon();
 	Database* getDB() { return mDatabase; }
 	boost::recursive_mutex& getDBLock() { return mLock; }
+
+	void setReaderLimit(int limit);
+	Database* acquireReader();			// NULL if this database has no read pool
+	void releaseReader(Database* reader);
+};
+
+// Holds a read-only connection for the lifetime of the object.
+// Falls back to the shared connection, under its lock, when there is no read pool.
+// Statements handed out are reset on release, as one left mid-query holds its read transaction open.
+class DatabaseReader
+{
+protected:
+	DatabaseCon*					mCon;
+	Database*						mDatabase;
+	ScopedLock						mLock;
+	std::vector<SqliteStatement*>	mStatements;
+
+public:
+	DatabaseReader(DatabaseCon* con);
+	~DatabaseReader();
+
+	Database* getDB()			{ return mDatabase; }
+	SqliteStatement& getStatement(const char* sql);
+
+private:
+	DatabaseReader(const DatabaseReader&);				// no implementation
+	DatabaseReader& operator=(const DatabaseReader&);	// no implementation
 };
 
 class Application
@@ -74,6 +113,7 @@ class Application
 	ConnectionPool			mConnectionPool;
 	PeerDoor*				mPeerDoor;
 	RPCDoor*				mRPCDoor;
+	MetricsDoor*			mMetricsDoor;
 	WSDoor*					mWSPublicDoor;
 	WSDoor*					mWSPrivateDoor;
 
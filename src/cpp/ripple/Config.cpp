@@ -23,11 +23,18 @@
 #define SECTION_FEE_OPERATION			"fee_operation"
 #define SECTION_FEE_ACCOUNT_RESERVE		"fee_account_reserve"
 #define SECTION_FEE_OWNER_RESERVE		"fee_owner_reserve"
+#define SECTION_LEDGER_APPLY_THREADS	"ledger_apply_threads"
 #define SECTION_LEDGER_HISTORY			"ledger_history"
+#define SECTION_METRICS_IP				"metrics_ip"
+#define SECTION_METRICS_PORT			"metrics_port"
+#define SECTION_INSTANCE_TELEMETRY		"instance_telemetry"
 #define SECTION_IPS						"ips"
 #define SECTION_NETWORK_QUORUM			"network_quorum"
 #define SECTION_NODE_SEED				"node_seed"
 #define SECTION_NODE_SIZE				"node_size"
+#define SECTION_NODE_WRITE_BATCH		"node_write_batch"
+#define SECTION_NODE_WRITE_BUDGET		"node_write_budget"
+#define SECTION_NODE_WRITE_LATENCY		"node_write_latency"
 #define SECTION_PATH_SEARCH_SIZE		"path_search_size"
 #define SECTION_PEER_CONNECT_LOW_WATER	"peer_connect_low_water"
 #define SECTION_PEER_IP					"peer_ip"
@@ -185,6 +192,7 @@ Config::Config()
 
 	PEER_PORT				= SYSTEM_PEER_PORT;
 	RPC_PORT				= 5001;
+	METRICS_PORT			= 0;
 	WEBSOCKET_PORT			= SYSTEM_WEBSOCKET_PORT;
 	WEBSOCKET_PUBLIC_PORT	= SYSTEM_WEBSOCKET_PUBLIC_PORT;
 	WEBSOCKET_PUBLIC_SECURE	= 1;
@@ -220,6 +228,14 @@ Config::Config()
 
 	LEDGER_HISTORY			= 256;
 
+	NODE_WRITE_BATCH		= 1024;
+	NODE_WRITE_LATENCY		= 100;
+	NODE_WRITE_BUDGET		= 64;
+
+	LEDGER_APPLY_THREADS	= 0;
+
+	INSTANCE_TELEMETRY		= false;
+
 	PATH_SEARCH_SIZE		= DEFAULT_PATH_SEARCH_SIZE;
 	ACCOUNT_PROBE_MAX		= 10;
 
@@ -333,6 +349,11 @@ void Config::load()
 			if (sectionSingleB(secConfig, SECTION_RPC_PORT, strTemp))
 				RPC_PORT = boost::lexical_cast<int>(strTemp);
 
+			(void) sectionSingleB(secConfig, SECTION_METRICS_IP, METRICS_IP);
+
+			if (sectionSingleB(secConfig, SECTION_METRICS_PORT, strTemp))
+				METRICS_PORT = boost::lexical_cast<int>(strTemp);
+
 			if (sectionSingleB(secConfig, "ledger_creator" , strTemp))
 				LEDGER_CREATOR = boost::lexical_cast<bool>(strTemp);
 
@@ -361,6 +382,21 @@ void Config::load()
 				}
 			}
 
+			if (sectionSingleB(secConfig, SECTION_NODE_WRITE_BATCH, strTemp))
+				NODE_WRITE_BATCH	= std::max(1, boost::lexical_cast<int>(strTemp));
+
+			if (sectionSingleB(secConfig, SECTION_NODE_WRITE_LATENCY, strTemp))
+				NODE_WRITE_LATENCY	= std::max(0, boost::lexical_cast<int>(strTemp));
+
+			if (sectionSingleB(secConfig, SECTION_NODE_WRITE_BUDGET, strTemp))
+				NODE_WRITE_BUDGET	= std::max(0, boost::lexical_cast<int>(strTemp));
+
+			if (sectionSingleB(secConfig, SECTION_LEDGER_APPLY_THREADS, strTemp))
+				LEDGER_APPLY_THREADS	= std::max(0, boost::lexical_cast<int>(strTemp));
+
+			if (sectionSingleB(secConfig, SECTION_INSTANCE_TELEMETRY, strTemp))
+				INSTANCE_TELEMETRY	= boost::lexical_cast<bool>(strTemp);
+
 			(void) sectionSingleB(secConfig, SECTION_WEBSOCKET_IP, WEBSOCKET_IP);
 
 			if (sectionSingleB(secConfig, SECTION_WEBSOCKET_PORT, strTemp))
@@ -473,6 +509,7 @@ int Config::getSize(SizedItemName item)
 		{ siNodeCacheAge,		{	30,		60,		90,		300,		600		} },
 		{ siLedgerSize,			{	32,		64,		128,	1024,		0		} },
 		{ siLedgerAge,			{	30,		60,		120,	300,		600		} },
+		{ siDBReaders,			{	1,		2,		4,		6,			8		} },
 			};
 
 	for (int i = 0; i < (sizeof(sizeTable) / sizeof(SizedItem)); ++i)
@@ -63,6 +63,7 @@ enum SizedItemName
 	siLedgerSize,
 	siLedgerAge,
 	siLedgerFetch,
+	siDBReaders,
 };
 
 struct SizedItem
@@ -145,6 +146,10 @@ public:
 	bool						RPC_ALLOW_REMOTE;
 	Json::Value					RPC_STARTUP;
 
+	// Prometheus endpoint for the latency histograms
+	std::string					METRICS_IP;
+	int							METRICS_PORT;
+
 	// Path searching
 	int							PATH_SEARCH_SIZE;
 
@@ -166,6 +171,15 @@ public:
 	// Node storage configuration
 	uint32						LEDGER_HISTORY;
 	int							NODE_SIZE;
+	int							NODE_WRITE_BATCH;		// Most nodes written per database transaction.
+	int							NODE_WRITE_LATENCY;		// Milliseconds to wait for a full batch.
+	int							NODE_WRITE_BUDGET;		// Megabytes of unwritten nodes before stores block.
+
+	// Ledger close
+	int							LEDGER_APPLY_THREADS;	// Threads speculating a consensus set, 0 for one per core.
+
+	// Diagnostics
+	bool						INSTANCE_TELEMETRY;		// True to count object creations for get_counts.
 
 	// Client behavior
 	int							ACCOUNT_PROBE_MAX;		// How far to scan for accounts.
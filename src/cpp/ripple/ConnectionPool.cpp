@@ -208,6 +208,7 @@ void ConnectionPool::policyEnforce()
 
 	// Enforce policies.
 	policyLowWater();
+	policySquelch();
 
 	// Schedule next enforcement.
 	mPolicyTimer.expires_at(boost::posix_time::second_clock::universal_time()+boost::posix_time::seconds(POLICY_INTERVAL_SECONDS));
@@ -235,11 +236,10 @@ void ConnectionPool::policyHandler(const boost::system::error_code& ecResult)
 int ConnectionPool::relayMessage(Peer* fromPeer, const PackedMessage::pointer& msg)
 {
 	int sentTo = 0;
-	boost::mutex::scoped_lock sl(mPeerLock);
+	PeerSnapshot peers = getPeerSnapshot();
 
-	BOOST_FOREACH(const vtConMap& pair, mConnectedMap)
+	BOOST_FOREACH(Peer::ref peer, *peers)
 	{
-		Peer::ref peer	= pair.second;
 		if (!peer)
 			std::cerr << "CP::RM null peer in list" << std::endl;
 		else if ((!fromPeer || !(peer.get() == fromPeer)) && peer->isConnected())
@@ -254,26 +254,64 @@ int ConnectionPool::relayMessage(Peer* fromPeer, const PackedMessage::pointer& m
 
 void ConnectionPool::relayMessageBut(const std::set<uint64>& fromPeers, const PackedMessage::pointer& msg)
 { // Relay message to all but the specified peers
-	boost::mutex::scoped_lock sl(mPeerLock);
+	PeerSnapshot peers = getPeerSnapshot();
 
-	BOOST_FOREACH(const vtConMap& pair, mConnectedMap)
+	BOOST_FOREACH(Peer::ref peer, *peers)
 	{
-		Peer::ref peer	= pair.second;
 		if (peer->isConnected() && (fromPeers.count(peer->getPeerId()) == 0))
 			peer->sendPacket(msg);
 	}
 
 }
 
+void ConnectionPool::relayValidatorMessage(const std::set<uint64>& fromPeers, const PackedMessage::pointer& msg,
+	const std::string& validator)
+{
+	PeerSnapshot peers = getPeerSnapshot();
+
+	BOOST_FOREACH(Peer::ref peer, *peers)
+	{
+		if (peer->isConnected() && (fromPeers.count(peer->getPeerId()) == 0))
+		{
+			if (peer->isSquelched(validator))
+				++mSquelchAvoided;
+			else
+				peer->sendPacket(msg);
+		}
+	}
+}
+
+void ConnectionPool::policySquelch()
+{ // Choose the peers that relay each validator to us, and tell the rest to stop or resume
+	std::vector<SquelchTable::Action> actions;
+
+	mSquelch.evaluate(upTime(), actions);
+
+	BOOST_FOREACH(const SquelchTable::Action& action, actions)
+	{
+		Peer::pointer peer = getPeerById(action.peer);
+		if (peer)
+			peer->sendSquelch(action.validator, action.duration);
+	}
+}
+
+Json::Value ConnectionPool::getSquelchJson()
+{
+	Json::Value ret = mSquelch.getJson();
+
+	ret["avoided"] = boost::lexical_cast<std::string>(mSquelchAvoided.load());
+
+	return ret;
+}
+
 void ConnectionPool::relayMessageTo(const std::set<uint64>& fromPeers, const PackedMessage::pointer& msg)
 { // Relay message to the specified peers
-	boost::mutex::scoped_lock sl(mPeerLock);
+	PeerSnapshot peers = getPeerSnapshot();
 
-	BOOST_FOREACH(const uint64& peerID, fromPeers)
+	BOOST_FOREACH(Peer::ref peer, *peers)
 	{
-		const boost::unordered_map<uint64, Peer::pointer>::iterator& it = mPeerIdMap.find(peerID);
-	    if ((it != mPeerIdMap.end()) && it->second->isConnected())
-			it->second->sendPacket(msg);
+		if (peer->isConnected() && (fromPeers.count(peer->getPeerId()) != 0))
+			peer->sendPacket(msg);
 	}
 
 }
@@ -359,26 +397,27 @@ Json::Value ConnectionPool::getPeersJson()
 
 int ConnectionPool::getPeerCount()
 {
-	boost::mutex::scoped_lock sl(mPeerLock);
-
-	return mConnectedMap.size();
+	return getPeerSnapshot()->size();
 }
 
 std::vector<Peer::pointer> ConnectionPool::getPeerVector()
 {
-	std::vector<Peer::pointer> ret;
+	return *getPeerSnapshot();
+}
 
-	boost::mutex::scoped_lock sl(mPeerLock);
+void ConnectionPool::updateSnapshot()
+{ // must hold mPeerLock
+	boost::shared_ptr<PeerVector> peers = boost::make_shared<PeerVector>();
 
-	ret.reserve(mConnectedMap.size());
+	peers->reserve(mConnectedMap.size());
 
 	BOOST_FOREACH(const vtConMap& pair, mConnectedMap)
 	{
 		assert(!!pair.second);
-		ret.push_back(pair.second);
+		peers->push_back(pair.second);
     }
 
-    return ret;
+	boost::atomic_store(&mPeerSnapshot, PeerSnapshot(peers));
 }
 
 uint64 ConnectionPool::assignPeerId()
@@ -412,6 +451,7 @@ bool ConnectionPool::peerConnected(Peer::ref peer, const RippleAddress& naPeer,
 
 			mConnectedMap[naPeer]	= peer;
 			bNew					= true;
+			updateSnapshot();
 
 			assert(peer->getPeerId() != 0);
 			mPeerIdMap.insert(std::make_pair(peer->getPeerId(), peer));
@@ -475,6 +515,7 @@ void ConnectionPool::peerDisconnected(Peer::ref peer, const RippleAddress& naPee
 		{
 			// Found it. Delete it.
 			mConnectedMap.erase(itCm);
+			updateSnapshot();
 
 			//cLog(lsINFO) << "Pool: disconnected: " << naPeer.humanNodePublic() << " " << peer->getIP() << " " << peer->getPort();
 		}
@@ -5,9 +5,12 @@
 
 #include <boost/asio/ssl.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
 
 #include "Peer.h"
 #include "PackedMessage.h"
+#include "Squelch.h"
 #include "types.h"
 
 //
@@ -38,6 +41,14 @@ private:
     // Connections with have a 64-bit identifier
     boost::unordered_map<uint64, Peer::pointer>			mPeerIdMap;
 
+	// The peers in mConnectedMap. Replaced, never changed, whenever the map changes,
+	// so relays can walk it without taking mPeerLock.
+	typedef std::vector<Peer::pointer>					PeerVector;
+	typedef boost::shared_ptr<const PeerVector>			PeerSnapshot;
+	PeerSnapshot										mPeerSnapshot;
+
+	void			updateSnapshot();
+
 	Peer::pointer										mScanning;
 	boost::asio::deadline_timer							mScanTimer;
 	std::string											mScanIp;
@@ -47,6 +58,9 @@ private:
 
 	boost::asio::deadline_timer							mPolicyTimer;
 
+	SquelchTable										mSquelch;
+	boost::atomic<uint64>								mSquelchAvoided;	// relays not sent to squelching peers
+
 	void			policyHandler(const boost::system::error_code& ecResult);
 
 	// Peers we are establishing a connection with as a client.
@@ -59,7 +73,8 @@ private:
 
 public:
 	ConnectionPool(boost::asio::io_service& io_service) :
-		mLastPeer(0), mScanTimer(io_service), mPolicyTimer(io_service)
+		mLastPeer(0), mPeerSnapshot(boost::make_shared<PeerVector>()), mScanTimer(io_service), mPolicyTimer(io_service),
+		mSquelchAvoided(0)
 	{ ; }
 
 	// Begin enforcing connection policy.
@@ -70,6 +85,13 @@ public:
 	void relayMessageTo(const std::set<uint64>& fromPeers, const PackedMessage::pointer& msg);
 	void relayMessageBut(const std::set<uint64>& fromPeers, const PackedMessage::pointer& msg);
 
+	// Relay a validator's proposal or validation to all but the specified peers and those that squelched it.
+	void relayValidatorMessage(const std::set<uint64>& fromPeers, const PackedMessage::pointer& msg,
+		const std::string& validator);
+
+	SquelchTable& getSquelch()	{ return mSquelch; }
+	Json::Value getSquelchJson();
+
 	// Manual connection request.
 	// Queue for immediate scanning.
 	void connectTo(const std::string& strIp, int iPort);
@@ -96,6 +118,7 @@ public:
 	int getPeerCount();
 	Json::Value getPeersJson();
 	std::vector<Peer::pointer> getPeerVector();
+	PeerSnapshot getPeerSnapshot()	{ return boost::atomic_load(&mPeerSnapshot); }
 
 	// Peer 64-bit ID function
 	uint64 assignPeerId();
@@ -112,6 +135,7 @@ public:
 	// Connection policy
 	//
 	void policyLowWater();
+	void policySquelch();
 	void policyEnforce();
 
 };
@@ -12,6 +12,7 @@
 // These must stay at the top of this file
 std::map<int, SField::ptr> SField::codeToField;
 boost::mutex SField::mapMutex;
+int SField::num = 0;
 
 SField sfInvalid(-1), sfGeneric(0);
 SField sfLedgerEntry(STI_LEDGERENTRY, 1, "LedgerEntry");
@@ -47,6 +48,7 @@ SField::SField(SerializedTypeID tid, int fv) : fieldCode(FIELD_CODE(tid, fv)), f
 { // call with the map mutex
 	fieldName = lexical_cast_i(tid) + "/" + lexical_cast_i(fv);
 	codeToField[fieldCode] = this;
+	fieldNum = ++num;
 	assert((fv != 1) || ((tid != STI_ARRAY) && (tid!=STI_OBJECT)));
 }
 
@@ -51,6 +51,7 @@ public:
 protected:
 	static std::map<int, ptr>	codeToField;
 	static boost::mutex			mapMutex;
+	static int					num;
 
 	SField(SerializedTypeID id, int val);
 
@@ -62,12 +63,14 @@ public:
 	std::string				fieldName;
 	int						fieldMeta;
 	bool					signingField;
+	int						fieldNum;		// Dense local number, for template lookups
 
 	SField(int fc, SerializedTypeID tid, int fv, const char* fn) : 
 		fieldCode(fc), fieldType(tid), fieldValue(fv), fieldName(fn), fieldMeta(sMD_Default), signingField(true)
 	{
 		boost::mutex::scoped_lock sl(mapMutex);
 		codeToField[fieldCode] = this;
+		fieldNum = ++num;
 	}
 
 	SField(SerializedTypeID tid, int fv, const char *fn) :
@@ -76,9 +79,14 @@ public:
 	{
 		boost::mutex::scoped_lock sl(mapMutex);
 		codeToField[fieldCode] = this;
+		fieldNum = ++num;
 	}
 
-	SField(int fc) : fieldCode(fc), fieldType(STI_UNKNOWN), fieldValue(0), fieldMeta(sMD_Never) { ; }
+	SField(int fc) : fieldCode(fc), fieldType(STI_UNKNOWN), fieldValue(0), fieldMeta(sMD_Never)
+	{
+		boost::mutex::scoped_lock sl(mapMutex);
+		fieldNum = ++num;
+	}
 
 	~SField();
 
@@ -89,6 +97,7 @@ public:
 
 	std::string getName() const;
 	bool hasName() const		{ return !fieldName.empty(); }
+	int getNum() const			{ return fieldNum; }
 
 	bool isGeneric() const		{ return fieldCode == 0; }
 	bool isInvalid() const		{ return fieldCode == -1; }
@@ -1,8 +1,12 @@
 
 #include "HashedObject.h"
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
 
 #include "../database/SqliteDatabase.h"
 
@@ -10,14 +14,25 @@
 #include "Application.h"
 #include "Log.h"
 
+// Batched fetches that can wait on the database at once, the rest are refused and the caller drops them
+#define HASHED_FETCH_JOBS_MAX	64
+
 SETUP_LOG();
-DECLARE_INSTANCE(HashedObject);
+DECLARE_SIZED_INSTANCE(HashedObject, HashedObject);
 
 HashedObjectStore::HashedObjectStore(int cacheSize, int cacheAge) :
 	mCache("HashedObjectStore", cacheSize, cacheAge), mNegativeCache("HashedObjectNegativeCache", 0, 120),
-	mWriteGeneration(0), mWritePending(false)
+	mWriteBytes(0), mWriteQueued(0), mWriteDone(0), mWriteThread(false), mWriteFlush(false), mWriteStop(false),
+	mWriteBatch(1024), mWriteLatency(100), mWriteBudget(64 * 1024 * 1024),
+	mFetchLatency(Metrics::get("node_store_fetch")), mFetchJobs(0)
 {
 	mWriteSet.reserve(128);
+	mWriteLoad.setHistogram(Metrics::get("node_store_write"));
+}
+
+HashedObjectStore::~HashedObjectStore()
+{
+	stopWrite();
 }
 
 void HashedObjectStore::tune(int size, int age)
@@ -26,6 +41,15 @@ void HashedObjectStore::tune(int size, int age)
 	mCache.setTargetAge(age);
 }
 
+void HashedObjectStore::tuneWrites(int batch, int latencyMS, uint64 budgetBytes)
+{
+	boost::mutex::scoped_lock sl(mWriteMutex);
+	mWriteBatch		= std::max(1, batch);
+	mWriteLatency	= std::max(0, latencyMS);
+	mWriteBudget	= budgetBytes;
+	mWriteCondition.notify_all();
+	mWrittenCondition.notify_all();
+}
 
 bool HashedObjectStore::store(HashedObjectType type, uint32 index,
 	const std::vector<unsigned char>& data, const uint256& hash)
@@ -47,12 +71,25 @@ bool HashedObjectStore::store(HashedObjectType type, uint32 index,
 	{
 //		cLog(lsTRACE) << "Queuing write for " << hash;
 		boost::mutex::scoped_lock sl(mWriteMutex);
+
+		while (mWriteThread && (mWriteBudget > 0) && (mWriteBytes > mWriteBudget))
+		{ // the writer is behind, apply backpressure
+			mWriteFlush = true;
+			mWriteCondition.notify_one();
+			mWrittenCondition.wait(sl);
+		}
+
 		mWriteSet.push_back(object);
-		if (!mWritePending)
+		mWriteBytes += data.size();
+		++mWriteQueued;
+
+		if (!mWriteThread && !mWriteStop)
 		{
-			mWritePending = true;
-			theApp->getJobQueue().addJob(jtWRITE, boost::bind(&HashedObjectStore::bulkWrite, this));
+			mWriteThread = true;
+			mWriter = boost::thread(boost::bind(&HashedObjectStore::writeThread, this));
 		}
+		else if (mWriteSet.size() >= mWriteBatch)
+			mWriteCondition.notify_one();
 	}
 //	else
 //		cLog(lsTRACE) << "HOS: already had " << hash;
@@ -61,40 +98,89 @@ bool HashedObjectStore::store(HashedObjectType type, uint32 index,
 }
 
 void HashedObjectStore::waitWrite()
-{
+{ // wait until everything queued so far is committed
 	boost::mutex::scoped_lock sl(mWriteMutex);
-	int gen = mWriteGeneration;
-	while (mWritePending && (mWriteGeneration == gen))
-		mWriteCondition.wait(sl);
+	uint64 target = mWriteQueued;
+	while (mWriteThread && (mWriteDone < target))
+	{
+		mWriteFlush = true;
+		mWriteCondition.notify_one();
+		mWrittenCondition.wait(sl);
+	}
 }
 
-void HashedObjectStore::bulkWrite()
+void HashedObjectStore::stopWrite()
 {
-	while (1)
 	{
-		std::vector< boost::shared_ptr<HashedObject> > set;
-		set.reserve(128);
+		boost::mutex::scoped_lock sl(mWriteMutex);
+		mWriteStop = true;
+		mWriteCondition.notify_all();
+	}
 
+	if (mWriter.joinable())
+		mWriter.join();
+}
+
+void HashedObjectStore::writeThread()
+{
+	std::vector< boost::shared_ptr<HashedObject> > set;
+	set.reserve(128);
+
+	while (1)
+	{
 		{
 			boost::mutex::scoped_lock sl(mWriteMutex);
-			mWriteSet.swap(set);
-			assert(mWriteSet.empty());
-			++mWriteGeneration;
-			mWriteCondition.notify_all();
-			if (set.empty())
-			{
-				mWritePending = false;
+
+			while (mWriteSet.empty() && !mWriteStop)
+				mWriteCondition.wait(sl);
+
+			if (mWriteSet.empty())
+			{ // stopping, and everything is written
+				mWriteThread = false;
+				mWrittenCondition.notify_all();
 				return;
 			}
+
+			if (!mWriteFlush && !mWriteStop && (mWriteSet.size() < mWriteBatch) && (mWriteLatency > 0))
+			{ // give producers until the latency target to fill a batch
+				mWriteCondition.timed_wait(sl, boost::posix_time::milliseconds(mWriteLatency));
+			}
+			mWriteFlush = false;
+
+			if (mWriteSet.size() <= mWriteBatch)
+				mWriteSet.swap(set);
+			else
+			{
+				set.assign(mWriteSet.begin(), mWriteSet.begin() + mWriteBatch);
+				mWriteSet.erase(mWriteSet.begin(), mWriteSet.begin() + mWriteBatch);
+			}
 		}
-//		cLog(lsTRACE) << "HOS: writing " << set.size();
+
+		LoadEvent event(mWriteLoad, true, set.size());
+		writeBatch(set);
+		event.stop();
+
+		{
+			boost::mutex::scoped_lock sl(mWriteMutex);
+			BOOST_FOREACH(const boost::shared_ptr<HashedObject>& it, set)
+				mWriteBytes -= it->getData().size();
+			mWriteDone += set.size();
+			mWrittenCondition.notify_all();
+		}
+		set.clear();
+	}
+}
+
+void HashedObjectStore::writeBatch(const std::vector< boost::shared_ptr<HashedObject> >& set)
+{
+//	cLog(lsTRACE) << "HOS: writing " << set.size();
 
 #ifndef NO_SQLITE3_PREPARE
 
 	{
 		Database* db = theApp->getHashNodeDB()->getDB();
 		ScopedLock sl(theApp->getHashNodeDB()->getDBLock());
-		static SqliteStatement pSt(db->getSqliteDB(),
+		SqliteStatement& pSt = db->getSqliteDB()->getStatement(
 			"INSERT OR IGNORE INTO CommittedObjects "
 				"(Hash,ObjType,LedgerIndex,Object) VALUES (?, ?, ?, ?);");
 
@@ -114,6 +200,7 @@ void HashedObjectStore::bulkWrite()
 			}
 
 			pSt.reset();
+			pSt.clearBindings();
 			pSt.bind(1, it->getHash().GetHex());
 			pSt.bind(2, type);
 			pSt.bind(3, it->getIndex());
@@ -131,41 +218,59 @@ void HashedObjectStore::bulkWrite()
 
 #else
 
-		static boost::format
-			fAdd("INSERT OR IGNORE INTO CommittedObjects "
-				"(Hash,ObjType,LedgerIndex,Object) VALUES ('%s','%c','%u',%s);");
+	static boost::format
+		fAdd("INSERT OR IGNORE INTO CommittedObjects "
+			"(Hash,ObjType,LedgerIndex,Object) VALUES ('%s','%c','%u',%s);");
 
-		Database* db = theApp->getHashNodeDB()->getDB();
-		{
-			ScopedLock sl(theApp->getHashNodeDB()->getDBLock());
+	Database* db = theApp->getHashNodeDB()->getDB();
+	{
+		ScopedLock sl(theApp->getHashNodeDB()->getDBLock());
 
-			db->executeSQL("BEGIN TRANSACTION;");
+		db->executeSQL("BEGIN TRANSACTION;");
 
-			BOOST_FOREACH(const boost::shared_ptr<HashedObject>& it, set)
-			{
-				char type;
+		BOOST_FOREACH(const boost::shared_ptr<HashedObject>& it, set)
+		{
+			char type;
 
-				switch (it->getType())
-				{
-					case hotLEDGER:				type = 'L'; break;
-					case hotTRANSACTION:		type = 'T'; break;
-					case hotACCOUNT_NODE:		type = 'A'; break;
-					case hotTRANSACTION_NODE:	type = 'N'; break;
-					default:					type = 'U';
-				}
-				db->executeSQL(boost::str(fAdd % it->getHash().GetHex() % type % it->getIndex() % sqlEscape(it->getData())));
+			switch (it->getType())
+			{
+				case hotLEDGER:				type = 'L'; break;
+				case hotTRANSACTION:		type = 'T'; break;
+				case hotACCOUNT_NODE:		type = 'A'; break;
+				case hotTRANSACTION_NODE:	type = 'N'; break;
+				default:					type = 'U';
 			}
-
-			db->executeSQL("END TRANSACTION;");
+			db->executeSQL(boost::str(fAdd % it->getHash().GetHex() % type % it->getIndex() % sqlEscape(it->getData())));
 		}
+
+		db->executeSQL("END TRANSACTION;");
+	}
+
 #endif
+}
+
+Json::Value HashedObjectStore::getJson()
+{
+	Json::Value ret(Json::objectValue);
 
+	{
+		boost::mutex::scoped_lock sl(mWriteMutex);
+		ret["write_queue"] = static_cast<int>(mWriteSet.size());
+		ret["write_queue_bytes"] = static_cast<Json::UInt>(mWriteBytes);
 	}
+
+	uint64 count, latencyAvg, latencyPeak;
+	bool isOver;
+	mWriteLoad.getCountAndLatency(count, latencyAvg, latencyPeak, isOver);
+	ret["write_per_second"] = static_cast<int>(count);
+	ret["commit_latency_avg"] = static_cast<int>(latencyAvg);
+	ret["commit_latency_peak"] = static_cast<int>(latencyPeak);
+
+	return ret;
 }
 
 HashedObject::pointer HashedObjectStore::retrieve(const uint256& hash)
 {
-
 	HashedObject::pointer obj = mCache.fetch(hash);
 	if (obj)
 		return obj;
@@ -176,15 +281,59 @@ HashedObject::pointer HashedObjectStore::retrieve(const uint256& hash)
 	if (!theApp || !theApp->getHashNodeDB())
 		return obj;
 
+	std::vector<uint256> hashes(1, hash);
+	std::vector<HashedObject::pointer> objects(1);
+
+	LatencyTimer timer(mFetchLatency);
+	fetchStored(hashes, objects);
+	return objects[0];
+}
+
+HashedObject::pointer HashedObjectStore::makeObject(const uint256& hash, const std::string& type, uint32 index,
+	std::vector<unsigned char>& data)
+{
+#ifdef PARANOID
+	assert(Serializer::getSHA512Half(data) == hash);
+#endif
+
+	HashedObjectType htype = hotUNKNOWN;
+	switch (type.empty() ? 0 : type[0])
+	{
+		case 'L': htype = hotLEDGER; break;
+		case 'T': htype = hotTRANSACTION; break;
+		case 'A': htype = hotACCOUNT_NODE; break;
+		case 'N': htype = hotTRANSACTION_NODE; break;
+		default:
+		assert(false);
+			cLog(lsERROR) << "Invalid hashed object";
+			mNegativeCache.add(hash);
+			return HashedObject::pointer();
+	}
+
+	HashedObject::pointer obj = boost::make_shared<HashedObject>(htype, index, data, hash);
+	mCache.canonicalize(hash, obj);
+
+	cLog(lsTRACE) << "HOS: " << hash << " fetch: in db";
+	return obj;
+}
+
+void HashedObjectStore::fetchStored(const std::vector<uint256>& hashes, std::vector<HashedObject::pointer>& objects)
+{ // Read the objects the caches don't have, all under one hold of the database
 	std::vector<unsigned char> data;
 	std::string type;
 	uint32 index;
 
 #ifndef NO_SQLITE3_PREPARE
+	DatabaseReader dbr(theApp->getHashNodeDB());
+	SqliteStatement& pSt = dbr.getStatement(
+		"SELECT ObjType,LedgerIndex,Object FROM CommittedObjects WHERE Hash = ?;");
+
+	for (unsigned i = 0; i < hashes.size(); ++i)
 	{
-		ScopedLock sl(theApp->getHashNodeDB()->getDBLock());
-		static SqliteStatement pSt(theApp->getHashNodeDB()->getDB()->getSqliteDB(),
-			"SELECT ObjType,LedgerIndex,Object FROM CommittedObjects WHERE Hash = ?;");
+		const uint256& hash = hashes[i];
+
+		if ((objects[i] = mCache.fetch(hash)) || mNegativeCache.isPresent(hash))
+			continue;
 
 		pSt.reset();
 		pSt.bind(1, hash.GetHex());
@@ -194,30 +343,36 @@ HashedObject::pointer HashedObjectStore::retrieve(const uint256& hash)
 		{
 			mNegativeCache.add(hash);
 			cLog(lsTRACE) << "HOS: " << hash <<" fetch: not in db";
-			return obj;
+			continue;
 		}
 
 		type = pSt.peekString(0);
 		index = pSt.getUInt32(1);
 		pSt.getBlob(2).swap(data);
+		objects[i] = makeObject(hash, type, index, data);
 	}
+	pSt.reset();
 
 #else
 
-	std::string sql = "SELECT * FROM CommittedObjects WHERE Hash='";
-	sql.append(hash.GetHex());
-	sql.append("';");
-
+	DatabaseReader dbr(theApp->getHashNodeDB());
+	Database* db = dbr.getDB();
 
+	for (unsigned i = 0; i < hashes.size(); ++i)
 	{
-		ScopedLock sl(theApp->getHashNodeDB()->getDBLock());
-		Database* db = theApp->getHashNodeDB()->getDB();
+		const uint256& hash = hashes[i];
+
+		if ((objects[i] = mCache.fetch(hash)) || mNegativeCache.isPresent(hash))
+			continue;
+
+		std::string sql = "SELECT * FROM CommittedObjects WHERE Hash='";
+		sql.append(hash.GetHex());
+		sql.append("';");
 
 		if (!db->executeSQL(sql) || !db->startIterRows())
 		{
-			sl.unlock();
 			mNegativeCache.add(hash);
-			return obj;
+			continue;
 		}
 
 		db->getStr("ObjType", type);
@@ -227,32 +382,63 @@ HashedObject::pointer HashedObjectStore::retrieve(const uint256& hash)
 		data.resize(size);
 		db->getBinary("Object", &(data.front()), size);
 		db->endIterRows();
+
+		objects[i] = makeObject(hash, type, index, data);
 	}
 #endif
+}
 
-#ifdef PARANOID
-	assert(Serializer::getSHA512Half(data) == hash);
-#endif
+bool HashedObjectStore::fetchBatch(const std::vector<uint256>& hashes, const fetchCallback& callback)
+{
+	boost::shared_ptr<FetchBatch> batch = boost::make_shared<FetchBatch>();
+	batch->mObjects.resize(hashes.size());
+	batch->mCallback = callback;
 
-	HashedObjectType htype = hotUNKNOWN;
-	switch (type[0])
+	for (unsigned i = 0; i < hashes.size(); ++i)
 	{
-		case 'L': htype = hotLEDGER; break;
-		case 'T': htype = hotTRANSACTION; break;
-		case 'A': htype = hotACCOUNT_NODE; break;
-		case 'N': htype = hotTRANSACTION_NODE; break;
-		default:
-		assert(false);
-			cLog(lsERROR) << "Invalid hashed object";
-			mNegativeCache.add(hash);
-			return obj;
+		batch->mObjects[i] = mCache.fetch(hashes[i]);
+		if (!batch->mObjects[i] && !mNegativeCache.isPresent(hashes[i]))
+			batch->mMisses.push_back(std::make_pair(hashes[i], static_cast<int>(i)));
 	}
 
-	obj = boost::make_shared<HashedObject>(htype, index, data, hash);
-	mCache.canonicalize(hash, obj);
+	if (batch->mMisses.empty() || !theApp || !theApp->getHashNodeDB())
+	{ // nothing to wait for
+		callback(batch->mObjects);
+		return true;
+	}
 
-	cLog(lsTRACE) << "HOS: " << hash << " fetch: in db";
-	return obj;
+	if (++mFetchJobs > HASHED_FETCH_JOBS_MAX)
+	{
+		--mFetchJobs;
+		return false;
+	}
+
+	// Ask for the misses in key order, which is index order in the database
+	std::sort(batch->mMisses.begin(), batch->mMisses.end());
+	theApp->getJobQueue().addJob(jtOBJECT_FETCH, boost::bind(&HashedObjectStore::fetchMisses, this, _1, batch));
+	return true;
+}
+
+void HashedObjectStore::fetchMisses(Job&, boost::shared_ptr<FetchBatch> batch)
+{
+	std::vector<uint256> hashes;
+	std::vector<HashedObject::pointer> objects(batch->mMisses.size());
+
+	hashes.reserve(batch->mMisses.size());
+	typedef std::pair<uint256, int> u256_int_pair;
+	BOOST_FOREACH(const u256_int_pair& it, batch->mMisses)
+		hashes.push_back(it.first);
+
+	{
+		LatencyTimer timer(mFetchLatency);
+		fetchStored(hashes, objects);
+	}
+
+	for (unsigned i = 0; i < objects.size(); ++i)
+		batch->mObjects[batch->mMisses[i].second] = objects[i];
+
+	--mFetchJobs;
+	batch->mCallback(batch->mObjects);
 }
 
 int HashedObjectStore::import(const std::string& file)
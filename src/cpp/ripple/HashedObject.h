@@ -3,15 +3,21 @@
 
 #include <vector>
 
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 
+#include "../json/value.h"
+
 #include "types.h"
 #include "uint256.h"
 #include "ScopedLock.h"
 #include "TaggedCache.h"
 #include "KeyCache.h"
 #include "InstanceCounter.h"
+#include "LoadMonitor.h"
 
 DEFINE_INSTANCE(HashedObject);
 
@@ -43,31 +49,74 @@ public:
 	uint32 getIndex() const								{ return mLedgerIndex; }
 };
 
+class Job;
+
 class HashedObjectStore
 {
+public:
+	// Called with one object per hash asked for, empty where the object is not known
+	typedef boost::function<void (const std::vector<HashedObject::pointer>&)> fetchCallback;
+
 protected:
+	struct FetchBatch
+	{
+		std::vector<HashedObject::pointer>		mObjects;
+		std::vector< std::pair<uint256, int> >	mMisses;	// hash and position, in hash order
+		fetchCallback							mCallback;
+	};
+
 	TaggedCache<uint256, HashedObject>	mCache;
 	KeyCache<uint256>					mNegativeCache;
 
+	// Objects waiting to be written stay strongly referenced here, so the cache can always find them
 	boost::mutex				mWriteMutex;
-	boost::condition_variable	mWriteCondition;
-	int							mWriteGeneration;
-
+	boost::condition_variable	mWriteCondition;	// wakes the writer
+	boost::condition_variable	mWrittenCondition;	// wakes waiters and throttled producers
 	std::vector< boost::shared_ptr<HashedObject> > mWriteSet;
-	bool mWritePending;
+	uint64						mWriteBytes;		// bytes queued or being written
+	uint64						mWriteQueued;		// objects ever queued
+	uint64						mWriteDone;			// objects ever committed
+	boost::thread				mWriter;
+	bool						mWriteThread;		// the writer thread is running
+	bool						mWriteFlush;		// a waiter wants the queue written now
+	bool						mWriteStop;			// the writer should drain the queue and exit
+
+	unsigned					mWriteBatch;		// most objects per transaction
+	int							mWriteLatency;		// milliseconds to wait for a full batch
+	uint64						mWriteBudget;		// queued bytes before producers block
+
+	LoadMonitor					mWriteLoad;			// commit latency
+	LatencyHistogram&			mFetchLatency;		// lookups that reach the database
+	boost::atomic<int>			mFetchJobs;			// fetch jobs queued or running
+
+	void writeThread();
+	void writeBatch(const std::vector< boost::shared_ptr<HashedObject> >& set);
+
+	HashedObject::pointer makeObject(const uint256& hash, const std::string& type, uint32 index,
+		std::vector<unsigned char>& data);
+	void fetchStored(const std::vector<uint256>& hashes, std::vector<HashedObject::pointer>& objects);
+	void fetchMisses(Job&, boost::shared_ptr<FetchBatch> batch);
 
 public:
 
 	HashedObjectStore(int cacheSize, int cacheAge);
+	~HashedObjectStore();
 
 	bool store(HashedObjectType type, uint32 index, const std::vector<unsigned char>& data,
 		const uint256& hash);
 
 	HashedObject::pointer retrieve(const uint256& hash);
 
-	void bulkWrite();
+	// Cache hits are answered at once, on this thread. Otherwise the misses are read together
+	// on a job and the callback runs there. Returns false, without calling back, if too many
+	// fetch jobs are already waiting.
+	bool fetchBatch(const std::vector<uint256>& hashes, const fetchCallback& callback);
+
 	void waitWrite();
+	void stopWrite();			// write everything queued and join the writer, later stores aren't written
 	void tune(int size, int age);
+	void tuneWrites(int batch, int latencyMS, uint64 budgetBytes);
+	Json::Value getJson();
 	void sweep() { mCache.sweep(); mNegativeCache.sweep(); }
 
 	int import(const std::string&);
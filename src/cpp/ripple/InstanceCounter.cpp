@@ -1,7 +1,26 @@
 #include "InstanceCounter.h"
 
+#ifdef _MSC_VER
+#define INSTANCE_TLS __declspec(thread)
+#else
+#define INSTANCE_TLS __thread
+#endif
+
 InstanceType* InstanceType::sHeadInstance = NULL;
-bool InstanceType::sMultiThreaded = false;
+bool InstanceType::sTelemetry = false;
+boost::mutex InstanceType::sTelemetryLock;
+
+static boost::atomic<int> sNextShard(0);
+
+int InstanceType::getShard()
+{ // Hand out shards round robin as threads first touch a counter
+	static INSTANCE_TLS int iShard = -1;
+
+	if (iShard < 0)
+		iShard = sNextShard.fetch_add(1, boost::memory_order_relaxed) % sShards;
+
+	return iShard;
+}
 
 std::vector<InstanceType::InstanceCount> InstanceType::getInstanceCounts(int min)
 {
@@ -14,3 +33,35 @@ std::vector<InstanceType::InstanceCount> InstanceType::getInstanceCounts(int min
 	}
 	return ret;
 }
+
+std::vector<InstanceType::InstanceTelemetry> InstanceType::getInstanceTelemetry()
+{
+	std::vector<InstanceTelemetry> ret;
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+	boost::mutex::scoped_lock sl(sTelemetryLock);
+	for (InstanceType* i = sHeadInstance; i != NULL; i = i->mNextInstance)
+	{
+		InstanceTelemetry t;
+		t.name		= i->getName();
+		t.count		= i->getCount();
+		t.created	= i->getCreated();
+		t.bytes		= t.created * i->mSize;
+		t.rate		= 0.0;
+
+		if (!i->mLastSample.is_not_a_date_time())
+		{
+			long long ms = (now - i->mLastSample).total_milliseconds();
+			if (ms > 0)
+				t.rate = (t.created - i->mLastCreated) * 1000.0 / ms;
+		}
+		i->mLastCreated	= t.created;
+		i->mLastSample	= now;
+
+		if (t.created != 0)
+			ret.push_back(t);
+	}
+	return ret;
+}
+
+// vim:ts=4
@@ -4,7 +4,12 @@
 #include <string>
 #include <vector>
 
+#include <boost/atomic.hpp>
+#include <boost/static_assert.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "types.h"
 
 #define DEFINE_INSTANCE(x)								\
 	extern InstanceType IT_##x;							\
@@ -21,59 +26,97 @@
 #define DECLARE_INSTANCE(x)								\
 	InstanceType IT_##x(#x);
 
+// Also record the fixed footprint of each object for allocation telemetry.
+#define DECLARE_SIZED_INSTANCE(x, type)					\
+	InstanceType IT_##x(#x, sizeof(type));
+
 #define IS_INSTANCE(x) Instance_##x
 
 class InstanceType
 {
+public:
+	typedef std::pair<std::string, int> InstanceCount;
+
+	struct InstanceTelemetry
+	{
+		std::string		name;
+		int				count;		// Live instances.
+		uint64			created;	// Instances created since telemetry was enabled.
+		uint64			bytes;		// Fixed footprint of those instances, zero if the size isn't known.
+		double			rate;		// Instances created per second since the previous sample.
+	};
+
 protected:
-	int						mInstances;
+	// Counters are spread over shards, each on its own cache line, and every thread sticks to one shard.
+	// A shard's count can go negative when objects die on another thread; only the sum means anything.
+	static const int		sShards = 16;
+
+	struct Counts
+	{
+		boost::atomic<uint64>	mCreated;
+		boost::atomic<int>		mInstances;
+	};
+
+	struct Shard : public Counts
+	{ // padded to a whole line, the counts alone are rounded up to their alignment
+		char					mPad[64 - sizeof(Counts)];
+	};
+	BOOST_STATIC_ASSERT((sizeof(Shard) % 64) == 0);
+
+	Shard					mShards[sShards];
 	std::string				mName;
-	boost::mutex			mLock;
+	int						mSize;
+
+	uint64					mLastCreated;	// Protected by sTelemetryLock.
+	boost::posix_time::ptime mLastSample;
 
 	InstanceType*			mNextInstance;
 	static InstanceType*	sHeadInstance;
-	static bool				sMultiThreaded;
+	static bool				sTelemetry;
+	static boost::mutex		sTelemetryLock;
 
-public:
-	typedef std::pair<std::string, int> InstanceCount;
+	static int getShard();
 
-	InstanceType(const char *n) : mInstances(0), mName(n)
+public:
+	InstanceType(const char *n, int size = 0) : mName(n), mSize(size), mLastCreated(0)
 	{
+		for (int i = 0; i < sShards; ++i)
+		{
+			mShards[i].mInstances.store(0, boost::memory_order_relaxed);
+			mShards[i].mCreated.store(0, boost::memory_order_relaxed);
+		}
 		mNextInstance = sHeadInstance;
 		sHeadInstance = this;
 	}
 
-	static void multiThread()
-	{
-		// We can support global objects and multi-threaded code, but not both
-		// at the same time. Switch to multi-threaded.
-		sMultiThreaded = true;
-	}
+	// Opt in to counting every creation. Costs one more relaxed add per object.
+	static void setTelemetry(bool enable)	{ sTelemetry = enable; }
+	static bool getTelemetry()				{ return sTelemetry; }
 
 	void addInstance()
 	{
-		if (sMultiThreaded)
-		{
-			mLock.lock();
-			++mInstances;
-			mLock.unlock();
-		}
-		else ++mInstances;
+		Shard& shard = mShards[getShard()];
+		shard.mInstances.fetch_add(1, boost::memory_order_relaxed);
+		if (sTelemetry)
+			shard.mCreated.fetch_add(1, boost::memory_order_relaxed);
 	}
 	void decInstance()
 	{
-		if (sMultiThreaded)
-		{
-			mLock.lock();
-			--mInstances;
-			mLock.unlock();
-		}
-		else --mInstances;
+		mShards[getShard()].mInstances.fetch_sub(1, boost::memory_order_relaxed);
+	}
+	int getCount() const
+	{
+		int count = 0;
+		for (int i = 0; i < sShards; ++i)
+			count += mShards[i].mInstances.load(boost::memory_order_relaxed);
+		return count;
 	}
-	int getCount()
+	uint64 getCreated() const
 	{
-		boost::mutex::scoped_lock(mLock);
-		return mInstances;
+		uint64 created = 0;
+		for (int i = 0; i < sShards; ++i)
+			created += mShards[i].mCreated.load(boost::memory_order_relaxed);
+		return created;
 	}
 	const std::string& getName()
 	{
@@ -81,6 +124,7 @@ public:
 	}
 
 	static std::vector<InstanceCount> getInstanceCounts(int min = 1);
+	static std::vector<InstanceTelemetry> getInstanceTelemetry();
 };
 
 class Instance
@@ -28,6 +28,20 @@ JobQueue::JobQueue() : mLastJob(0), mThreadCount(0), mShuttingDown(false)
 	mJobLoads[jtDISK].setTargetLatency(500, 1000);
 	mJobLoads[jtRPC].setTargetLatency(250, 750);
 	mJobLoads[jtACCEPTLEDGER].setTargetLatency(1000, 2500);
+
+	// Queued jobs report from queueing to completion as "job" and the running alone as "job_run"
+	for (int i = 0; i < NUM_JOB_TYPES; ++i)
+		mJobRun[i] = NULL;
+	for (int i = jtPUBOLDLEDGER; i <= jtPATH_FIND; ++i)
+	{
+		if ((i == jtDEATH) || ((i > jtDEATH) && (i < jtPEER)))
+			continue;
+
+		const char* name = Job::toString(static_cast<JobType>(i));
+		mJobLoads[i].setHistogram(Metrics::get("job", "type", name));
+		if (i < jtDEATH)
+			mJobRun[i] = &Metrics::get("job_run", "type", name);
+	}
 }
 
 
@@ -37,6 +51,7 @@ const char* Job::toString(JobType t)
 	{
 		case jtINVALID:			return "invalid";
 		case jtPUBOLDLEDGER:	return "publishAcqLedger";
+		case jtOBJECT_FETCH:	return "objectFetch";
 		case jtVALIDATION_ut:	return "untrustedValidation";
 		case jtPROOFWORK:		return "proofOfWork";
 		case jtPROPOSAL_ut:		return "untrustedProposal";
@@ -265,7 +280,10 @@ void JobQueue::threadEntry()
 
 		sl.unlock();
 		cLog(lsTRACE) << "Doing " << Job::toString(job.getType()) << " job";
-		job.doJob();
+		{
+			LatencyTimer timer(*mJobRun[job.getType()]);
+			job.doJob();
+		}
 		sl.lock();
 	}
 	--mThreadCount;
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <fstream>
 
+#include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/test/unit_test.hpp>
@@ -21,6 +22,7 @@
 #include "LedgerTiming.h"
 #include "HashPrefixes.h"
 #include "Log.h"
+#include "UndoLog.h"
 
 SETUP_LOG();
 DECLARE_INSTANCE(Ledger);
@@ -232,9 +234,17 @@ NicknameState::pointer Ledger::getNicknameState(const uint256& uNickname)
 	return boost::make_shared<NicknameState>(sle);
 }
 
+boost::shared_ptr<UndoLog> Ledger::getUndoLog(bool create)
+{
+	boost::recursive_mutex::scoped_lock sl(mLock);
+	if (!mUndoLog && create)
+		mUndoLog = boost::make_shared<UndoLog>();
+	return mUndoLog;
+}
+
 bool Ledger::addTransaction(const uint256& txID, const Serializer& txn)
 { // low-level - just add to table
-	SHAMapItem::pointer item = boost::make_shared<SHAMapItem>(txID, txn.peekData());
+	SHAMapItem::pointer item = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), txID, txn.peekData());
 	if (!mTransactionMap->addGiveItem(item, true, false))
 	{
 		cLog(lsWARNING) << "Attempt to add transaction to ledger that already had it";
@@ -248,7 +258,7 @@ bool Ledger::addTransaction(const uint256& txID, const Serializer& txn, const Se
 	Serializer s(txn.getDataLength() + md.getDataLength() + 16);
 	s.addVL(txn.peekData());
 	s.addVL(md.peekData());
-	SHAMapItem::pointer item = boost::make_shared<SHAMapItem>(txID, s.peekData());
+	SHAMapItem::pointer item = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), txID, s.peekData());
 	if (!mTransactionMap->addGiveItem(item, true, true))
 	{
 		cLog(lsFATAL) << "Attempt to add transaction+MD to ledger that already had it";
@@ -369,136 +379,168 @@ uint256 Ledger::getHash()
 	return mHash;
 }
 
-void Ledger::saveAcceptedLedger(bool fromConsensus, LoadEvent::pointer event)
-{ // can be called in a different thread
-	cLog(lsTRACE) << "saveAcceptedLedger " << (fromConsensus ? "fromConsensus " : "fromAcquire ") << getLedgerSeq();
-	static boost::format ledgerExists("SELECT LedgerSeq FROM Ledgers where LedgerSeq = %d;");
-	static boost::format deleteLedger("DELETE FROM Ledgers WHERE LedgerSeq = %d;");
-	static boost::format AcctTransExists("SELECT LedgerSeq FROM AccountTransactions WHERE TransId = '%s';");
-	static boost::format transExists("SELECT Status FROM Transactions WHERE TransID = '%s';");
-	static boost::format
-		updateTx("UPDATE Transactions SET LedgerSeq = %d, Status = '%c', TxnMeta = %s WHERE TransID = '%s';");
-	static boost::format addLedger("INSERT INTO Ledgers "
-		"(LedgerHash,LedgerSeq,PrevHash,TotalCoins,ClosingTime,PrevClosingTime,CloseTimeRes,CloseFlags,"
-		"AccountSetHash,TransSetHash) VALUES ('%s','%u','%s','%s','%u','%u','%d','%u','%s','%s');");
-
-	if (!getAccountHash().isNonZero())
-	{
-		cLog(lsFATAL) << "AH is zero: " << getJson(0);
-		assert(false);
-	}
-
-	assert (getAccountHash() == mAccountStateMap->getHash());
+void Ledger::saveTransactions(SqliteDatabase* db)
+{ // caller holds the transaction database lock and has begun a transaction
 	assert (getTransHash() == mTransactionMap->getHash());
 
-	// Save the ledger header in the hashed object store
-	Serializer s(128);
-	s.add32(sHP_Ledger);
-	addRaw(s);
-	theApp->getHashedObjectStore().store(hotLEDGER, mLedgerSeq, s.peekData(), mHash);
+	SqliteStatement& delAcctTx = db->getStatement("DELETE FROM AccountTransactions WHERE LedgerSeq = ?;");
+	delAcctTx.bind(1, mLedgerSeq);
+	delAcctTx.step();
+
+	SqliteStatement& addAcctTx = db->getStatement(
+		"INSERT INTO AccountTransactions (TransID, Account, LedgerSeq) VALUES (?, ?, ?);");
+	SqliteStatement& addTx = db->getStatement("INSERT OR REPLACE INTO Transactions "
+		"(TransID, TransType, FromAcct, FromSeq, LedgerSeq, Status, RawTxn, TxnMeta) "
+		"VALUES (?, ?, ?, ?, ?, ?, ?, ?);");
 
+	std::string txID, status(1, TXN_SQL_VALIDATED);
+	SHAMap& txSet = *peekTransactionMap();
+	SHAMapTreeNode::TNType type;
+	for (SHAMapItem::pointer item = txSet.peekFirstItem(type); !!item;
+		item = txSet.peekNextItem(item->getTag(), type))
 	{
+		assert(type == SHAMapTreeNode::tnTRANSACTION_MD);
+		SerializerIterator sit(item->peekSerializer());
+		Serializer rawTxn(sit.getVL());
+		Serializer rawMeta(sit.getVL());
+
+		SerializerIterator txnIt(rawTxn);
+		SerializedTransaction txn(txnIt);
+		assert(txn.getTransactionID() == item->getTag());
+		TransactionMetaSet meta(item->getTag(), mLedgerSeq, rawMeta.peekData());
+		txID = item->getTag().GetHex();
+
+		const std::vector<RippleAddress> accts = meta.getAffectedAccounts();
+		if (accts.empty())
 		{
-			ScopedLock sl(theApp->getLedgerDB()->getDBLock());
-			if (SQL_EXISTS(theApp->getLedgerDB()->getDB(), boost::str(ledgerExists % mLedgerSeq)))
-				theApp->getLedgerDB()->getDB()->executeSQL(boost::str(deleteLedger % mLedgerSeq));
+			cLog(lsWARNING) << "Transaction in ledger " << mLedgerSeq << " affects no accounts";
 		}
 
-		SHAMap& txSet = *peekTransactionMap();
-		Database *db = theApp->getTxnDB()->getDB();
+		BOOST_FOREACH(const RippleAddress& acct, accts)
 		{
-			ScopedLock dbLock(theApp->getTxnDB()->getDBLock());
-			db->executeSQL("BEGIN TRANSACTION;");
-			SHAMapTreeNode::TNType type;
-			for (SHAMapItem::pointer item = txSet.peekFirstItem(type); !!item;
-				item = txSet.peekNextItem(item->getTag(), type))
+			addAcctTx.reset();
+			addAcctTx.bindStatic(1, txID);
+			addAcctTx.bind(2, acct.humanAccountID());
+			addAcctTx.bind(3, mLedgerSeq);
+			int ret = addAcctTx.step();
+			if (!addAcctTx.isDone(ret))
 			{
-				assert(type == SHAMapTreeNode::tnTRANSACTION_MD);
-				SerializerIterator sit(item->peekSerializer());
-				Serializer rawTxn(sit.getVL());
-				Serializer rawMeta(sit.getVL());
-				std::string escMeta(sqlEscape(rawMeta.peekData()));
+				cLog(lsWARNING) << "Error saving account transaction: " << addAcctTx.getError(ret);
+			}
+		}
 
-				SerializerIterator txnIt(rawTxn);
-				SerializedTransaction txn(txnIt);
-				assert(txn.getTransactionID() == item->getTag());
-				TransactionMetaSet meta(item->getTag(), mLedgerSeq, rawMeta.peekData());
+		addTx.reset();
+		addTx.bindStatic(1, txID);
+		addTx.bind(2, txn.getTransactionType());
+		addTx.bind(3, txn.getSourceAccount().humanAccountID());
+		addTx.bind(4, txn.getSequence());
+		addTx.bind(5, mLedgerSeq);
+		addTx.bindStatic(6, status);
+		addTx.bindStatic(7, rawTxn.peekData());
+		addTx.bindStatic(8, rawMeta.peekData());
+		int ret = addTx.step();
+		if (!addTx.isDone(ret))
+		{
+			cLog(lsWARNING) << "Error saving transaction: " << addTx.getError(ret);
+		}
+	}
+}
 
-				// Make sure transaction is in AccountTransactions.
-				if (!SQL_EXISTS(db, boost::str(AcctTransExists % item->getTag().GetHex())))
-				{
-					// Transaction not in AccountTransactions
-					const std::vector<RippleAddress> accts = meta.getAffectedAccounts();
-					if (!accts.empty())
-					{
-
-						std::string sql = "INSERT INTO AccountTransactions (TransID, Account, LedgerSeq) VALUES ";
-						bool first = true;
-							for (std::vector<RippleAddress>::const_iterator it = accts.begin(), end = accts.end(); it != end; ++it)
-						{
-							if (!first)
-								sql += ", ('";
-							else
-							{
-								sql += "('";
-								first = false;
-							}
-							sql += txn.getTransactionID().GetHex();
-							sql += "','";
-							sql += it->humanAccountID();
-							sql += "',";
-							sql += boost::lexical_cast<std::string>(getLedgerSeq());
-							sql += ")";
-						}
-						sql += ";";
-						Log(lsTRACE) << "ActTx: " << sql;
-						db->executeSQL(sql); // may already be in there
-					}
-					else
-						cLog(lsWARNING) << "Transaction in ledger " << mLedgerSeq << " affects no accounts";
-				}
+void Ledger::saveLedgerHeader(SqliteDatabase* db)
+{ // caller holds the ledger database lock and has begun a transaction
+	SqliteStatement& delLedger = db->getStatement("DELETE FROM Ledgers WHERE LedgerSeq = ?;");
+	delLedger.bind(1, mLedgerSeq);
+	delLedger.step();
 
-				if (SQL_EXISTS(db, boost::str(transExists %	txn.getTransactionID().GetHex())))
-				{
-					// In Transactions, update LedgerSeq, metadata and Status.
-					db->executeSQL(boost::str(updateTx
-						% getLedgerSeq()
-						% TXN_SQL_VALIDATED
-						% escMeta
-						% txn.getTransactionID().GetHex()));
-				}
-				else
-				{
-					// Not in Transactions, insert the whole thing..
-					db->executeSQL(
-						txn.getMetaSQLInsertHeader() + txn.getMetaSQL(getLedgerSeq(), escMeta) + ";");
-				}
-			}
-			db->executeSQL("COMMIT TRANSACTION;");
-		}
+	SqliteStatement& addLedger = db->getStatement("INSERT OR REPLACE INTO Ledgers "
+		"(LedgerHash,LedgerSeq,PrevHash,TotalCoins,ClosingTime,PrevClosingTime,CloseTimeRes,CloseFlags,"
+		"AccountSetHash,TransSetHash) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?);");
+	addLedger.bind(1, getHash().GetHex());
+	addLedger.bind(2, mLedgerSeq);
+	addLedger.bind(3, mParentHash.GetHex());
+	addLedger.bind(4, mTotCoins);
+	addLedger.bind(5, mCloseTime);
+	addLedger.bind(6, mParentCloseTime);
+	addLedger.bind(7, static_cast<uint32>(mCloseResolution));
+	addLedger.bind(8, mCloseFlags);
+	addLedger.bind(9, mAccountHash.GetHex());
+	addLedger.bind(10, mTransHash.GetHex());
+	int ret = addLedger.step();
+	if (!addLedger.isDone(ret))
+	{
+		cLog(lsWARNING) << "Error saving ledger " << mLedgerSeq << ": " << addLedger.getError(ret);
+	}
+}
 
-		theApp->getHashedObjectStore().waitWrite(); // wait until all nodes are written
+void Ledger::saveAcceptedLedgers(const std::vector<PendingSave>& batch)
+{ // Write a batch of accepted ledgers with one transaction per database
+	cLog(lsDEBUG) << "Saving " << batch.size() << " accepted ledgers";
+
+	BOOST_FOREACH(const PendingSave& save, batch)
+	{
+		Ledger& ledger = *save.ledger;
+		cLog(lsTRACE) << "saveAcceptedLedger " << (save.fromConsensus ? "fromConsensus " : "fromAcquire ")
+			<< ledger.getLedgerSeq();
 
+		if (!ledger.getAccountHash().isNonZero())
 		{
-			ScopedLock sl(theApp->getLedgerDB()->getDBLock());
-			theApp->getLedgerDB()->getDB()->executeSQL(boost::str(addLedger %
-				getHash().GetHex() % mLedgerSeq % mParentHash.GetHex() %
-				boost::lexical_cast<std::string>(mTotCoins) % mCloseTime % mParentCloseTime %
-				mCloseResolution % mCloseFlags %
-				mAccountHash.GetHex() % mTransHash.GetHex()));
+			cLog(lsFATAL) << "AH is zero: " << ledger.getJson(0);
+			assert(false);
 		}
+		assert (ledger.getAccountHash() == ledger.mAccountStateMap->getHash());
+
+		// Save the ledger header in the hashed object store
+		Serializer s(128);
+		s.add32(sHP_Ledger);
+		ledger.addRaw(s);
+		theApp->getHashedObjectStore().store(hotLEDGER, ledger.mLedgerSeq, s.peekData(), ledger.getHash());
 	}
 
-	if (!fromConsensus)
 	{
-		decPendingSaves();
-		dropCache();
-		return;
+		ScopedLock sl(theApp->getTxnDB()->getDBLock());
+		Database* db = theApp->getTxnDB()->getDB();
+
+		db->executeSQL("BEGIN TRANSACTION;");
+		try
+		{
+			BOOST_FOREACH(const PendingSave& save, batch)
+				save.ledger->saveTransactions(db->getSqliteDB());
+		}
+		catch (...)
+		{ // leave the database usable for the next batch
+			db->executeSQL("ROLLBACK TRANSACTION;");
+			throw;
+		}
+		db->executeSQL("COMMIT TRANSACTION;");
 	}
 
-	event->stop();
+	theApp->getHashedObjectStore().waitWrite(); // wait until all nodes are written
+
+	{
+		ScopedLock sl(theApp->getLedgerDB()->getDBLock());
+		Database* db = theApp->getLedgerDB()->getDB();
+
+		db->executeSQL("BEGIN TRANSACTION;");
+		try
+		{
+			BOOST_FOREACH(const PendingSave& save, batch)
+				save.ledger->saveLedgerHeader(db->getSqliteDB());
+		}
+		catch (...)
+		{ // leave the database usable for the next batch
+			db->executeSQL("ROLLBACK TRANSACTION;");
+			throw;
+		}
+		db->executeSQL("COMMIT TRANSACTION;");
+	}
 
-	decPendingSaves();
+	BOOST_FOREACH(const PendingSave& save, batch)
+	{
+		if (save.fromConsensus)
+			save.event->stop();
+		else
+			save.ledger->dropCache();
+	}
 }
 
 #ifndef NO_SQLITE3_PREPARE
@@ -507,15 +549,13 @@ Ledger::pointer Ledger::loadByIndex(uint32 ledgerIndex)
 {
 	Ledger::pointer ledger;
 	{
-		Database* db = theApp->getLedgerDB()->getDB();
-		ScopedLock sl(theApp->getLedgerDB()->getDBLock());
+		DatabaseReader dbr(theApp->getLedgerDB());
 
-		static SqliteStatement pSt(db->getSqliteDB(), "SELECT "
+		SqliteStatement& pSt = dbr.getStatement("SELECT "
 			"LedgerHash,PrevHash,AccountSetHash,TransSetHash,TotalCoins,"
 			"ClosingTime,PrevClosingTime,CloseTimeRes,CloseFlags,LedgerSeq"
 			" from Ledgers WHERE LedgerSeq = ?;");
 
-			pSt.reset();
 		pSt.bind(1, ledgerIndex);
 		ledger = getSQL1(&pSt);
 	}
@@ -528,15 +568,13 @@ Ledger::pointer Ledger::loadByHash(const uint256& ledgerHash)
 {
 	Ledger::pointer ledger;
 	{
-		Database* db = theApp->getLedgerDB()->getDB();
-		ScopedLock sl(theApp->getLedgerDB()->getDBLock());
+		DatabaseReader dbr(theApp->getLedgerDB());
 
-		static SqliteStatement pSt(db->getSqliteDB(), "SELECT "
+		SqliteStatement& pSt = dbr.getStatement("SELECT "
 			"LedgerHash,PrevHash,AccountSetHash,TransSetHash,TotalCoins,"
 			"ClosingTime,PrevClosingTime,CloseTimeRes,CloseFlags,LedgerSeq"
 			" from Ledgers WHERE LedgerHash = ?;");
 
-		pSt.reset();
 		pSt.bind(1, ledgerHash.GetHex());
 		ledger = getSQL1(&pSt);
 	}
@@ -578,8 +616,8 @@ Ledger::pointer Ledger::getSQL(const std::string& sql)
 	std::string hash;
 
 	{
-		Database *db = theApp->getLedgerDB()->getDB();
-		ScopedLock sl(theApp->getLedgerDB()->getDBLock());
+		DatabaseReader dbr(theApp->getLedgerDB());
+		Database *db = dbr.getDB();
 
 		if (!db->executeSQL(sql) || !db->startIterRows())
 			return Ledger::pointer();
@@ -670,14 +708,29 @@ uint256 Ledger::getHashByIndex(uint32 ledgerIndex)
 {
 	uint256 ret;
 
+#ifndef NO_SQLITE3_PREPARE
+
+	{
+		DatabaseReader dbr(theApp->getLedgerDB());
+		SqliteStatement& pSt = dbr.getStatement(
+			"SELECT LedgerHash FROM Ledgers INDEXED BY SeqLedger WHERE LedgerSeq = ?;");
+
+		pSt.bind(1, ledgerIndex);
+		if (pSt.isRow(pSt.step()))
+			ret.SetHex(pSt.peekString(0), true);
+	}
+	return ret;
+
+#else
+
 	std::string sql="SELECT LedgerHash FROM Ledgers INDEXED BY SeqLedger WHERE LedgerSeq='";
 	sql.append(boost::lexical_cast<std::string>(ledgerIndex));
 	sql.append("';");
 
 	std::string hash;
 	{
-		Database *db = theApp->getLedgerDB()->getDB();
-		ScopedLock sl(theApp->getLedgerDB()->getDBLock());
+		DatabaseReader dbr(theApp->getLedgerDB());
+		Database *db = dbr.getDB();
 		if (!db->executeSQL(sql) || !db->startIterRows())
 			return ret;
 		db->getStr("LedgerHash", hash);
@@ -686,19 +739,19 @@ uint256 Ledger::getHashByIndex(uint32 ledgerIndex)
 
 	ret.SetHex(hash, true);
 	return ret;
+
+#endif
 }
 
 bool Ledger::getHashesByIndex(uint32 ledgerIndex, uint256& ledgerHash, uint256& parentHash)
 {
 #ifndef NO_SQLITE3_PREPARE
 
-	DatabaseCon *con = theApp->getLedgerDB();
-	ScopedLock sl(con->getDBLock());
+	DatabaseReader dbr(theApp->getLedgerDB());
 
-	static SqliteStatement pSt(con->getDB()->getSqliteDB(),
+	SqliteStatement& pSt = dbr.getStatement(
 		"SELECT LedgerHash,PrevHash FROM Ledgers Where LedgerSeq = ?;");
 
-	pSt.reset();
 	pSt.bind(1, ledgerIndex);
 
 	int ret = pSt.step();
@@ -727,8 +780,8 @@ bool Ledger::getHashesByIndex(uint32 ledgerIndex, uint256& ledgerHash, uint256&
 
 	std::string hash, prevHash;
 	{
-		Database *db = theApp->getLedgerDB()->getDB();
-		ScopedLock sl(theApp->getLedgerDB()->getDBLock());
+		DatabaseReader dbr(theApp->getLedgerDB());
+		Database *db = dbr.getDB();
 		if (!db->executeSQL(sql) || !db->startIterRows())
 			return false;
 		db->getStr("LedgerHash", hash);
@@ -746,6 +799,109 @@ bool Ledger::getHashesByIndex(uint32 ledgerIndex, uint256& ledgerHash, uint256&
 #endif
 }
 
+void Ledger::loadRange(uint32 minSeq, uint32 maxSeq, std::vector<Ledger::pointer>& ledgers)
+{
+	loadRange(theApp->getLedgerDB(), minSeq, maxSeq, ledgers);
+}
+
+void Ledger::loadRange(DatabaseCon* db, uint32 minSeq, uint32 maxSeq, std::vector<Ledger::pointer>& ledgers)
+{ // Ledgers with missing nodes are skipped, so one can't fail the others
+#ifndef NO_SQLITE3_PREPARE
+
+	size_t first = ledgers.size();
+	{
+		DatabaseReader dbr(db);
+
+		SqliteStatement& pSt = dbr.getStatement("SELECT "
+			"LedgerHash,PrevHash,AccountSetHash,TransSetHash,TotalCoins,"
+			"ClosingTime,PrevClosingTime,CloseTimeRes,CloseFlags,LedgerSeq"
+			" from Ledgers WHERE LedgerSeq >= ? AND LedgerSeq <= ? ORDER BY LedgerSeq;");
+
+		pSt.bind(1, minSeq);
+		pSt.bind(2, maxSeq);
+
+		while (true)
+		{
+			try
+			{
+				Ledger::pointer ledger = getSQL1(&pSt);
+				if (!ledger)
+					break;
+				ledgers.push_back(ledger);
+			}
+			catch (SHAMapMissingNode& sn)
+			{
+				cLog(lsDEBUG) << "Ledger in range " << minSeq << "-" << maxSeq << " has missing nodes: " << sn;
+			}
+		}
+	}
+
+	for (size_t i = first; i < ledgers.size(); ++i)
+		getSQL2(ledgers[i]);
+
+#else
+
+	// without prepared statements, this goes through loadByIndex and so the ledger database
+	for (uint32 seq = minSeq; seq <= maxSeq; ++seq)
+	{
+		try
+		{
+			Ledger::pointer ledger = loadByIndex(seq);
+			if (ledger)
+				ledgers.push_back(ledger);
+		}
+		catch (SHAMapMissingNode& sn)
+		{
+			cLog(lsDEBUG) << "Ledger " << seq << " has missing nodes: " << sn;
+		}
+	}
+
+#endif
+}
+
+void Ledger::getHashesByRange(uint32 minSeq, uint32 maxSeq, std::map< uint32, std::pair<uint256, uint256> >& hashes)
+{
+#ifndef NO_SQLITE3_PREPARE
+
+	DatabaseReader dbr(theApp->getLedgerDB());
+
+	SqliteStatement& pSt = dbr.getStatement(
+		"SELECT LedgerSeq,LedgerHash,PrevHash FROM Ledgers WHERE LedgerSeq >= ? AND LedgerSeq <= ?;");
+
+	pSt.bind(1, minSeq);
+	pSt.bind(2, maxSeq);
+
+	while (pSt.isRow(pSt.step()))
+	{
+		std::pair<uint256, uint256>& entry = hashes[pSt.getUInt32(0)];
+		entry.first.SetHex(pSt.peekString(1), true);
+		entry.second.SetHex(pSt.peekString(2), true);
+	}
+
+#else
+
+	std::string sql = "SELECT LedgerSeq,LedgerHash,PrevHash FROM Ledgers WHERE LedgerSeq >= '";
+	sql.append(boost::lexical_cast<std::string>(minSeq));
+	sql.append("' AND LedgerSeq <= '");
+	sql.append(boost::lexical_cast<std::string>(maxSeq));
+	sql.append("';");
+
+	DatabaseReader dbr(theApp->getLedgerDB());
+	Database *db = dbr.getDB();
+
+	std::string hash;
+	SQL_FOREACH(db, sql)
+	{
+		std::pair<uint256, uint256>& entry = hashes[db->getBigInt("LedgerSeq")];
+		db->getStr("LedgerHash", hash);
+		entry.first.SetHex(hash, true);
+		db->getStr("PrevHash", hash);
+		entry.second.SetHex(hash, true);
+	}
+
+#endif
+}
+
 Ledger::pointer Ledger::getLastFullLedger()
 {
 	try
@@ -907,7 +1063,7 @@ LedgerStateParms Ledger::writeBack(LedgerStateParms parms, SLE::ref entry)
 		create = true;
 	}
 
-	SHAMapItem::pointer item = boost::make_shared<SHAMapItem>(entry->getIndex());
+	SHAMapItem::pointer item = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), entry->getIndex());
 	entry->add(item->peekSerializer());
 
 	if (create)
@@ -937,6 +1093,22 @@ SLE::pointer Ledger::getSLE(const uint256& uHash)
 	return boost::make_shared<SLE>(node->peekSerializer(), node->getTag());
 }
 
+SLEView::pointer Ledger::getSLEView(const uint256& uHash, LedgerEntryType letType)
+{
+	SHAMapItem::pointer node = mAccountStateMap->peekItem(uHash);
+	if (!node)
+		return SLEView::pointer();
+
+	SLEView::pointer view = boost::make_shared<SLEView>(node);
+	if ((letType != ltINVALID) && (view->getType() != letType))
+	{ // the index was computed for one type of entry and names another
+		cLog(lsWARNING) << "getSLEView: " << uHash << " is type " << view->getType() << " not " << letType;
+		assert(false);
+		return SLEView::pointer();
+	}
+	return view;
+}
+
 uint256 Ledger::getFirstLedgerIndex()
 {
 	SHAMapItem::pointer node = mAccountStateMap->peekFirstItem();
@@ -1410,13 +1582,30 @@ void Ledger::updateSkipList()
 	}
 }
 
-int Ledger::sPendingSaves = 0;
-boost::recursive_mutex Ledger::sPendingSaveLock;
+std::list<Ledger::PendingSave> Ledger::sSaveQueue;
+int Ledger::sSaving = 0;
+bool Ledger::sSaveThread = false;
+boost::mutex Ledger::sPendingSaveLock;
+boost::condition_variable Ledger::sSaveCondition;
+
+// Most ledgers written in one database transaction
+static const unsigned sMaxSaveBatch = 16;
+
+// Stop acquiring history above this backlog, resume at or below half of it
+static const int sMaxPendingSaves = 4;
+
+// Callers wait for the save thread at this backlog, so the queue can't outgrow the disk
+static const int sMaxQueuedSaves = 64;
 
 int Ledger::getPendingSaves()
 {
-	boost::recursive_mutex::scoped_lock sl(sPendingSaveLock);
-	return sPendingSaves;
+	boost::mutex::scoped_lock sl(sPendingSaveLock);
+	return sSaveQueue.size() + sSaving;
+}
+
+bool Ledger::isSaveBacklogged()
+{
+	return getPendingSaves() > sMaxPendingSaves;
 }
 
 uint32 Ledger::roundCloseTime(uint32 closeTime, uint32 closeResolution)
@@ -1432,25 +1621,66 @@ void Ledger::pendSave(bool fromConsensus)
 		return;
 	assert(isImmutable());
 
-	{
-		boost::recursive_mutex::scoped_lock sl(sPendingSaveLock);
-		++sPendingSaves;
-	}
+	PendingSave save;
+	save.ledger			= shared_from_this();
+	save.fromConsensus	= fromConsensus;
+	save.event			= theApp->getJobQueue().getLoadEvent(jtDISK);
 
-	boost::thread(boost::bind(&Ledger::saveAcceptedLedger, shared_from_this(),
-		fromConsensus, theApp->getJobQueue().getLoadEvent(jtDISK))).detach();
+	boost::mutex::scoped_lock sl(sPendingSaveLock);
+	while (static_cast<int>(sSaveQueue.size()) >= sMaxQueuedSaves)
+		sSaveCondition.wait(sl);		// a full queue means the save thread is running
 
+	sSaveQueue.push_back(save);
+	if (!sSaveThread)
+	{
+		sSaveThread = true;
+		boost::thread(&Ledger::saveThread).detach();
+	}
 }
 
-void Ledger::decPendingSaves()
+void Ledger::saveThread()
 {
+	std::vector<PendingSave> batch;
+	batch.reserve(sMaxSaveBatch);
+
+	while (1)
 	{
-		boost::recursive_mutex::scoped_lock sl(sPendingSaveLock);
-		--sPendingSaves;
-		if (sPendingSaves != 0)
-			return;
+		{
+			boost::mutex::scoped_lock sl(sPendingSaveLock);
+			sSaving = 0;
+			if (sSaveQueue.empty())
+			{
+				sSaveThread = false;
+				break;
+			}
+			while (!sSaveQueue.empty() && (batch.size() < sMaxSaveBatch))
+			{
+				batch.push_back(sSaveQueue.front());
+				sSaveQueue.pop_front();
+			}
+			sSaving = batch.size();
+			sSaveCondition.notify_all();
+		}
+
+		try
+		{
+			saveAcceptedLedgers(batch);
+		}
+		catch (std::exception& e)
+		{ // one bad batch must not stop saving
+			cLog(lsWARNING) << "Saving ledgers " << batch.front().ledger->getLedgerSeq() << "-"
+				<< batch.back().ledger->getLedgerSeq() << " fails: " << e.what();
+		}
+		catch (...)
+		{
+			cLog(lsWARNING) << "Saving ledgers " << batch.front().ledger->getLedgerSeq() << "-"
+				<< batch.back().ledger->getLedgerSeq() << " fails";
+		}
+		batch.clear();
+
+		if (getPendingSaves() <= (sMaxPendingSaves / 2))
+			theApp->getLedgerMaster().resumeAcquiring();
 	}
-	theApp->getLedgerMaster().resumeAcquiring();
 }
 
 void Ledger::ownerDirDescriber(SLE::ref sle, const uint160& owner)
@@ -5,6 +5,8 @@
 #include <list>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
@@ -41,6 +43,9 @@ enum LedgerStateParms
 
 DEFINE_INSTANCE(Ledger);
 
+class SqliteDatabase;
+class DatabaseCon;
+class UndoLog;
 class SqliteStatement;
 
 class Ledger : public boost::enable_shared_from_this<Ledger>, public IS_INSTANCE(Ledger)
@@ -86,10 +91,22 @@ private:
 
 	SHAMap::pointer mTransactionMap, mAccountStateMap;
 
+	boost::shared_ptr<UndoLog> mUndoLog;	// how each transaction was applied, open ledgers only
+
 	mutable boost::recursive_mutex mLock;
 
-	static int sPendingSaves;
-	static boost::recursive_mutex sPendingSaveLock;
+	struct PendingSave
+	{
+		Ledger::pointer		ledger;
+		bool				fromConsensus;
+		LoadEvent::pointer	event;
+	};
+
+	static std::list<PendingSave>	sSaveQueue;		// accepted ledgers waiting to be written
+	static int						sSaving;		// ledgers in the batch being written
+	static bool						sSaveThread;	// the save thread is running
+	static boost::mutex				sPendingSaveLock;
+	static boost::condition_variable	sSaveCondition;	// the save thread took a batch off the queue
 
 	Ledger(const Ledger&);				// no implementation
 	Ledger& operator=(const Ledger&);	// no implementation
@@ -97,9 +114,10 @@ private:
 protected:
 	SLE::pointer getASNode(LedgerStateParms& parms, const uint256& nodeID, LedgerEntryType let);
 
-	static void incPendingSaves();
-	static void decPendingSaves();
-	void saveAcceptedLedger(bool fromConsensus, LoadEvent::pointer);
+	static void saveThread();
+	static void saveAcceptedLedgers(const std::vector<PendingSave>&);
+	void saveTransactions(SqliteDatabase* db);
+	void saveLedgerHeader(SqliteDatabase* db);
 
 	void updateFees();
 	void zeroFees();
@@ -123,6 +141,7 @@ public:
 	static void getSQL2(Ledger::ref);
 	static Ledger::pointer getLastFullLedger();
 	static int getPendingSaves();
+	static bool isSaveBacklogged();
 	static uint32 roundCloseTime(uint32 closeTime, uint32 closeResolution);
 
 	void updateHash();
@@ -158,6 +177,7 @@ public:
 	// low level functions
 	SHAMap::ref peekTransactionMap() { return mTransactionMap; }
 	SHAMap::ref peekAccountStateMap() { return mAccountStateMap; }
+	boost::shared_ptr<UndoLog> getUndoLog(bool create = false);
 	void dropCache()
 	{
 		assert(isImmutable());
@@ -196,10 +216,18 @@ public:
 	static Ledger::pointer loadByHash(const uint256& ledgerHash);
 	static uint256 getHashByIndex(uint32 index);
 	static bool getHashesByIndex(uint32 index, uint256& ledgerHash, uint256& parentHash);
+
+	// range forms, one query each, only ledgers we have are returned
+	static void loadRange(uint32 minSeq, uint32 maxSeq, std::vector<Ledger::pointer>& ledgers);
+	static void loadRange(DatabaseCon* db, uint32 minSeq, uint32 maxSeq, std::vector<Ledger::pointer>& ledgers);
+	static void getHashesByRange(uint32 minSeq, uint32 maxSeq,
+		std::map< uint32, std::pair<uint256, uint256> >& hashes);	// seq -> ledger hash, parent hash
 	void pendSave(bool fromConsensus);
 
 	// next/prev function
 	SLE::pointer getSLE(const uint256& uHash);
+	// read-only, does not copy the entry, asserts it has the type given unless that's ltINVALID
+	SLEView::pointer getSLEView(const uint256& uHash, LedgerEntryType letType = ltINVALID);
 	uint256 getFirstLedgerIndex();
 	uint256 getLastLedgerIndex();
 	uint256 getNextLedgerIndex(const uint256& uHash);							// first node >hash
@@ -1,9 +1,11 @@
 #include "LedgerConsensus.h"
 
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
 #include <boost/bind.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
 
 #include "../json/writer.h"
 
@@ -18,6 +20,7 @@
 
 #define LEDGER_TOTAL_PASSES 8
 #define LEDGER_RETRY_PASSES 5
+#define LEDGER_SPECULATE_MIN 32	// Fewer candidates than this are applied one by one
 
 #define TRUST_NETWORK
 
@@ -26,6 +29,21 @@
 typedef std::map<uint160, LedgerProposal::pointer>::value_type u160_prop_pair;
 typedef std::map<uint256, LCTransaction::pointer>::value_type u256_lct_pair;
 
+static std::string getStateName(int state)
+{
+	switch (state)
+	{
+		case lcsPRE_CLOSE:	return "open";
+		case lcsESTABLISH:	return "consensus";
+		case lcsFINISHED:	return "finished";
+		case lcsACCEPTED:	return "accepted";
+		default:			return "";
+	}
+}
+
+// How long each round spends in each state
+static LatencyFamily sStateLatency("consensus_state", "state", lcsACCEPTED + 1, getStateName);
+
 SETUP_LOG();
 DECLARE_INSTANCE(LedgerConsensus);
 DECLARE_INSTANCE(TransactionAcquire);
@@ -297,7 +315,7 @@ LedgerConsensus::LedgerConsensus(const uint256& prevLCLHash, Ledger::ref previou
 		:  mState(lcsPRE_CLOSE), mCloseTime(closeTime), mPrevLedgerHash(prevLCLHash), mPreviousLedger(previousLedger),
 		mValPublic(theConfig.VALIDATION_PUB), mValPrivate(theConfig.VALIDATION_PRIV), mConsensusFail(false),
 		mCurrentMSeconds(0), mClosePercent(0), mHaveCloseTimeConsensus(false),
-		mConsensusStartTime(boost::posix_time::microsec_clock::universal_time())
+		mConsensusStartTime(boost::posix_time::microsec_clock::universal_time()), mStateStart(LatencyHistogram::now())
 {
 	cLog(lsDEBUG) << "Creating consensus object";
 	cLog(lsTRACE) << "LCL:" << previousLedger->getHash() <<", ct=" << closeTime;
@@ -641,10 +659,19 @@ void LedgerConsensus::statePreClose()
 	}
 }
 
+void LedgerConsensus::setState(LCState state)
+{
+	uint64 now = LatencyHistogram::now();
+
+	sStateLatency.get(mState).add(now - mStateStart);
+	mState = state;
+	mStateStart = now;
+}
+
 void LedgerConsensus::closeLedger()
 {
 	checkOurValidation();
-	mState = lcsESTABLISH;
+	setState(lcsESTABLISH);
 	mConsensusStartTime = boost::posix_time::microsec_clock::universal_time();
 	mCloseTime = theApp->getOPs().getCloseTimeNC();
 	theApp->getOPs().setLastCloseTime(mCloseTime);
@@ -664,7 +691,7 @@ void LedgerConsensus::stateEstablish()
 	else if (haveConsensus(true))
 	{
 		cLog(lsINFO) << "Converge cutoff (" << mPeerPositions.size() << " participants)";
-		mState = lcsFINISHED;
+		setState(lcsFINISHED);
 		beginAccept(false);
 	}
 }
@@ -1131,6 +1158,86 @@ void LedgerConsensus::playbackProposals()
 #define LCAT_FAIL		1
 #define LCAT_RETRY		2
 
+static int applyOutcome(TER result, bool didApply)
+{ // What the apply passes do with a transaction after an attempt
+	if (didApply)
+	{
+		cLog(lsDEBUG) << "Transaction success: " << transHuman(result);
+		return LCAT_SUCCESS;
+	}
+
+	if (isTefFailure(result) || isTemMalformed(result) || isTelLocal(result))
+	{ // failure
+		cLog(lsDEBUG) << "Transaction failure: " << transHuman(result);
+		return LCAT_FAIL;
+	}
+
+	cLog(lsDEBUG) << "Transaction retry: " << transHuman(result);
+	return LCAT_RETRY;
+}
+
+// A candidate transaction run ahead of its turn, against the ledger as it stood before any of the set was applied
+class SpeculativeTxn
+{
+public:
+	typedef boost::shared_ptr<SpeculativeTxn>	pointer;
+
+	SHAMapItem::pointer				mItem;
+	SerializedTransaction::pointer	mTxn;
+	LedgerEntrySet					mNodes;			// what it would write
+	TransactionUndo::ItemMap		mSeen;			// every entry it read or would write, as it was
+	bool							mWholeLedger;	// walked the state map in order, so any write invalidates it
+	bool							mRan;
+	bool							mDidApply;
+	TER								mResult;
+
+	SpeculativeTxn(SHAMapItem::ref item) :
+		mItem(item), mWholeLedger(false), mRan(false), mDidApply(false), mResult(temUNKNOWN) { ; }
+
+	bool isCurrent(Ledger::ref ledger, bool written) const
+	{ // would running it now, in order, see exactly what it saw
+		if (!mRan || (mWholeLedger && written))
+			return false;
+		return TransactionUndo::isCurrent(ledger->peekAccountStateMap(), mSeen);
+	}
+};
+
+static void speculateTransactions(const std::vector<SpeculativeTxn::pointer>& txns, Ledger::ref ledger,
+	TransactionEngineParams params, boost::atomic<int>* next)
+{ // Run candidates into private entry sets until none are left, nothing here writes the ledger
+	TransactionEngine engine(ledger);
+	SHAMap::ref map = ledger->peekAccountStateMap();
+	params = params | tapSPECULATIVE;
+
+	for (int i = next->fetch_add(1); i < static_cast<int>(txns.size()); i = next->fetch_add(1))
+	{
+		SpeculativeTxn& spec = *txns[i];
+		try
+		{
+			SerializerIterator sit(spec.mItem->peekSerializer());
+			spec.mTxn = boost::make_shared<SerializedTransaction>(boost::ref(sit));
+			spec.mResult = engine.executeTransaction(*spec.mTxn, params, spec.mDidApply);
+
+			LedgerEntrySet& nodes = engine.getNodes();
+			const LedgerEntryReads::pointer& reads = nodes.getReads();
+			spec.mWholeLedger = reads->mWholeLedger;
+
+			BOOST_FOREACH(const uint256& index, reads->mIndexes)
+				spec.mSeen[index] = map->peekItem(index);
+			for (LedgerEntrySet::iterator it = nodes.begin(), end = nodes.end(); it != end; ++it)
+				if (spec.mSeen.find(it->first) == spec.mSeen.end())
+					spec.mSeen[it->first] = map->peekItem(it->first);
+
+			nodes.swapWith(spec.mNodes);
+			spec.mRan = true;
+		}
+		catch (...)
+		{ // the in-order pass runs it again and deals with the exception
+			cLog(lsDEBUG) << "Speculative apply throws: " << spec.mItem->getTag();
+		}
+	}
+}
+
 int LedgerConsensus::applyTransaction(TransactionEngine& engine, SerializedTransaction::ref txn, Ledger::ref ledger,
 	bool openLedger, bool retryAssured)
 { // Returns false if the transaction has need not be retried.
@@ -1150,21 +1257,9 @@ int LedgerConsensus::applyTransaction(TransactionEngine& engine, SerializedTrans
 
 		bool didApply;
 		TER result = engine.applyTransaction(*txn, parms, didApply);
-		if (didApply)
-		{
-			cLog(lsDEBUG) << "Transaction success: " << transHuman(result);
-			return LCAT_SUCCESS;
-		}
-
-		if (isTefFailure(result) || isTemMalformed(result) || isTelLocal(result))
-		{ // failure
-			cLog(lsDEBUG) << "Transaction failure: " << transHuman(result);
-			return LCAT_FAIL;
-		}
-
-		cLog(lsDEBUG) << "Transaction retry: " << transHuman(result);
-		assert(!ledger->hasTransaction(txn->getTransactionID()));
-		return LCAT_RETRY;
+		int outcome = applyOutcome(result, didApply);
+		assert((outcome != LCAT_RETRY) || !ledger->hasTransaction(txn->getTransactionID()));
+		return outcome;
 
 #ifndef TRUST_NETWORK
 	}
@@ -1176,21 +1271,95 @@ int LedgerConsensus::applyTransaction(TransactionEngine& engine, SerializedTrans
 #endif
 }
 
+void LedgerConsensus::applySpeculative(TransactionEngine& engine, const std::vector<SHAMapItem::pointer>& candidates,
+	Ledger::ref applyLedger, CanonicalTXSet& failedTransactions, int threads)
+{ // Run every candidate at once against the ledger as it stands, then write them in order. Any that read an entry
+  // an earlier one changed run again in turn, so the ledger comes out exactly as applying them one by one would.
+	std::vector<SpeculativeTxn::pointer> txns;
+	txns.reserve(candidates.size());
+	BOOST_FOREACH(SHAMapItem::ref item, candidates)
+		txns.push_back(boost::make_shared<SpeculativeTxn>(item));
+
+	applyLedger->getReserve(0);	// load the fee settings before the threads share the ledger
+
+	boost::atomic<int> next(0);
+	boost::thread_group workers;
+	for (int i = 0; i < threads; ++i)
+		workers.create_thread(boost::bind(&speculateTransactions, boost::cref(txns), applyLedger, tapRETRY, &next));
+	workers.join_all();
+
+	int written = 0, rerun = 0;
+	BOOST_FOREACH(const SpeculativeTxn::pointer& spec, txns)
+	{
+		cLog(lsINFO) << "Processing candidate transaction: " << spec->mItem->getTag();
+
+		int outcome;
+		if (spec->isCurrent(applyLedger, written != 0))
+		{
+			cLog(lsDEBUG) << "TXN " << spec->mTxn->getTransactionID() << " closed/retry, speculated";
+			TER result = engine.commitTransaction(*spec->mTxn, tapRETRY, spec->mNodes, spec->mResult, spec->mDidApply);
+			outcome = applyOutcome(result, spec->mDidApply);
+		}
+		else
+		{
+			++rerun;
+			if (!spec->mTxn)
+			{
+				SerializerIterator sit(spec->mItem->peekSerializer());
+				spec->mTxn = boost::make_shared<SerializedTransaction>(boost::ref(sit));
+			}
+			outcome = applyTransaction(engine, spec->mTxn, applyLedger, false, true);
+		}
+
+		if (outcome == LCAT_SUCCESS)
+			++written;
+		else if (outcome == LCAT_RETRY)
+			failedTransactions.push_back(spec->mTxn);
+	}
+
+	cLog(lsDEBUG) << "Speculative apply: " << txns.size() << " candidates on " << threads << " threads, "
+		<< written << " applied, " << rerun << " run again";
+}
+
 void LedgerConsensus::applyTransactions(SHAMap::ref set, Ledger::ref applyLedger,
-	Ledger::ref checkLedger, CanonicalTXSet& failedTransactions, bool openLgr)
-{
+	Ledger::ref checkLedger, CanonicalTXSet& failedTransactions, bool openLgr, const UndoLog::pointer& undoLog)
+{ // If we have how each transaction went into the old open ledger, replay those that saw nothing change
 	TransactionEngine engine(applyLedger);
+	int replayed = 0, executed = 0;
 
+	std::vector<SHAMapItem::pointer> candidates;
 	for (SHAMapItem::pointer item = set->peekFirstItem(); !!item; item = set->peekNextItem(item->getTag()))
 		if (!checkLedger->hasTransaction(item->getTag()))
+			candidates.push_back(item);
+
+	int threads = theConfig.LEDGER_APPLY_THREADS;
+	if (threads == 0)
+		threads = boost::thread::hardware_concurrency();
+
+	if (!openLgr && (threads > 1) && (candidates.size() >= LEDGER_SPECULATE_MIN))
+		applySpeculative(engine, candidates, applyLedger, failedTransactions, threads);
+	else
+	{
+		BOOST_FOREACH(SHAMapItem::ref item, candidates)
 		{
 			cLog(lsINFO) << "Processing candidate transaction: " << item->getTag();
 #ifndef TRUST_NETWORK
 			try
 			{
 #endif
+				if (openLgr && undoLog)
+				{
+					TransactionUndo::pointer undo = undoLog->find(item->getTag());
+					if (undo && undo->replay(applyLedger, item->peekSerializer()))
+					{
+						++replayed;
+						continue;
+					}
+				}
+
 				SerializerIterator sit(item->peekSerializer());
 				SerializedTransaction::pointer txn = boost::make_shared<SerializedTransaction>(boost::ref(sit));
+				++executed;
 				if (applyTransaction(engine, txn, applyLedger, openLgr, true) == LCAT_RETRY)
 					failedTransactions.push_back(txn);
 #ifndef TRUST_NETWORK
@@ -1201,6 +1370,12 @@ void LedgerConsensus::applyTransactions(SHAMap::ref set, Ledger::ref applyLedger
 			}
 #endif
 		}
+	}
+
+	if (undoLog)
+	{
+		cLog(lsDEBUG) << "Rebased open ledger: " << replayed << " replayed, " << executed << " executed";
+	}
 
 	int changes;
 	bool certainRetry = true;
@@ -1356,11 +1531,11 @@ void LedgerConsensus::accept(SHAMap::ref set, LoadEvent::pointer)
 	}
 
 	cLog(lsDEBUG) << "Applying transactions from current open ledger";
-	applyTransactions(theApp->getLedgerMaster().getCurrentLedger()->peekTransactionMap(), newOL, newLCL,
-		failedTransactions, true);
+	Ledger::pointer oldOL = theApp->getLedgerMaster().getCurrentLedger();
+	applyTransactions(oldOL->peekTransactionMap(), newOL, newLCL, failedTransactions, true, oldOL->getUndoLog());
 	theApp->getLedgerMaster().pushLedger(newLCL, newOL, !mConsensusFail);
 	mNewLedgerHash = newLCL->getHash();
-	mState = lcsACCEPTED;
+	setState(lcsACCEPTED);
 	sl.unlock();
 
 	if (mValidating)
@@ -1509,4 +1684,97 @@ Json::Value LedgerConsensus::getJson(bool full)
 	return ret;
 }
 
+BOOST_AUTO_TEST_SUITE(LedgerConsensus_suite)
+
+static SerializedTransaction::pointer makePayment(const RippleAddress& srcPublic, const RippleAddress& srcPrivate,
+	uint32 seq, const RippleAddress& dst, uint64 amount)
+{
+	SerializedTransaction::pointer txn = boost::make_shared<SerializedTransaction>(ttPAYMENT);
+	txn->setSourceAccount(srcPublic);
+	txn->setSigningPubKey(srcPublic);
+	txn->setSequence(seq);
+	txn->setTransactionFee(STAmount(1000));
+	txn->setFieldAccount(sfDestination, dst.getAccountID());
+	txn->setFieldAmount(sfAmount, STAmount(amount));
+	txn->sign(srcPrivate);
+	return txn;
+}
+
+static Ledger::pointer applySet(Ledger& base, SHAMap::ref set, int threads)
+{
+	int savedThreads = theConfig.LEDGER_APPLY_THREADS;
+	theConfig.LEDGER_APPLY_THREADS = threads;
+
+	Ledger::pointer ledger = boost::make_shared<Ledger>(boost::ref(base), true);
+	CanonicalTXSet failed(set->getHash());
+	LedgerConsensus::applyTransactions(set, ledger, ledger, failed, false);
+	ledger->updateHash();
+
+	theConfig.LEDGER_APPLY_THREADS = savedThreads;
+	return ledger;
+}
+
+BOOST_AUTO_TEST_CASE( LedgerConsensus_parallelApply_test )
+{ // A set applied one by one and speculatively on several threads must give the same ledger
+	const int iAccounts = 48, iChained = 8;
+	const uint64 uFunding = 10000 * SYSTEM_CURRENCY_PARTS;
+
+	RippleAddress seed;
+	seed.setSeedRandom();
+	RippleAddress generator = RippleAddress::createGeneratorPublic(seed);
+	RippleAddress masterPublic = RippleAddress::createAccountPublic(generator, 0);
+	RippleAddress masterPrivate = RippleAddress::createAccountPrivate(generator, seed, 0);
+
+	Ledger::pointer genesis = boost::make_shared<Ledger>(masterPublic, SYSTEM_CURRENCY_START);
+	genesis->updateHash();
+	genesis->setClosed();
+	genesis->setAccepted();
+	Ledger::pointer base = boost::make_shared<Ledger>(true, boost::ref(*genesis));
+
+	std::vector<RippleAddress> publics, privates;
+	TransactionEngine engine(base);
+	for (int i = 0; i < iAccounts; ++i)
+	{ // fund the senders
+		publics.push_back(RippleAddress::createAccountPublic(generator, i + 1));
+		privates.push_back(RippleAddress::createAccountPrivate(generator, seed, i + 1));
+
+		bool didApply;
+		SerializedTransaction::pointer txn = makePayment(masterPublic, masterPrivate, i + 1, publics[i], uFunding);
+		if ((engine.applyTransaction(*txn, tapNONE, didApply) != tesSUCCESS) || !didApply)
+			BOOST_FAIL("Funding payment failed");
+	}
+
+	// Each sender pays an account of its own, and a few also pay the next sender, so their entries conflict
+	SHAMap::pointer set = boost::make_shared<SHAMap>(smtTRANSACTION);
+	for (int i = 0; i < iAccounts; ++i)
+	{
+		std::vector<SerializedTransaction::pointer> txns;
+		txns.push_back(makePayment(publics[i], privates[i], 1,
+			RippleAddress::createAccountPublic(generator, iAccounts + i + 1), uFunding / 4));
+		if (i < iChained)
+			txns.push_back(makePayment(publics[i], privates[i], 2, publics[i + 1], uFunding / 8));
+
+		BOOST_FOREACH(SerializedTransaction::ref txn, txns)
+		{
+			Serializer s;
+			txn->add(s);
+			if (!set->addItem(SHAMapItem(txn->getTransactionID(), s.peekData()), true, false))
+				BOOST_FAIL("Building transaction set");
+		}
+	}
+
+	Ledger::pointer serial = applySet(*base, set, 1);
+	Ledger::pointer parallel = applySet(*base, set, 4);
+
+	for (SHAMapItem::pointer item = set->peekFirstItem(); !!item; item = set->peekNextItem(item->getTag()))
+		if (!serial->hasTransaction(item->getTag()))
+			BOOST_FAIL("Not every transaction applied");
+	if (serial->getAccountHash() != parallel->getAccountHash())
+		BOOST_FAIL("Parallel apply changed the account state");
+	if (serial->getTransHash() != parallel->getTransHash())
+		BOOST_FAIL("Parallel apply changed the transactions");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
 // vim:ts=4
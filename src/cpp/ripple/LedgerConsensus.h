@@ -19,6 +19,7 @@
 #include "TransactionEngine.h"
 #include "InstanceCounter.h"
 #include "LoadMonitor.h"
+#include "UndoLog.h"
 
 DEFINE_INSTANCE(LedgerConsensus);
 DEFINE_INSTANCE(TransactionAcquire);
@@ -102,6 +103,7 @@ protected:
 	bool mHaveCloseTimeConsensus;
 
 	boost::posix_time::ptime		mConsensusStartTime;
+	uint64							mStateStart;		// LatencyHistogram::now() as mState was entered
 	int								mPreviousProposers;
 	int								mPreviousMSeconds;
 
@@ -139,9 +141,9 @@ protected:
 	void addPosition(LedgerProposal&, bool ours);
 	void removePosition(LedgerProposal&, bool ours);
 	void sendHaveTxSet(const uint256& set, bool direct);
-	void applyTransactions(SHAMap::ref transactionSet, Ledger::ref targetLedger,
-		Ledger::ref checkLedger, CanonicalTXSet& failedTransactions, bool openLgr);
-	int applyTransaction(TransactionEngine& engine, SerializedTransaction::ref txn, Ledger::ref targetLedger,
+	static void applySpeculative(TransactionEngine& engine, const std::vector<SHAMapItem::pointer>& candidates,
+		Ledger::ref targetLedger, CanonicalTXSet& failedTransactions, int threads);
+	static int applyTransaction(TransactionEngine& engine, SerializedTransaction::ref txn, Ledger::ref targetLedger,
 		bool openLgr, bool retryAssured);
 
 	uint32 roundCloseTime(uint32 closeTime);
@@ -155,12 +157,18 @@ protected:
 	void closeLedger();
 	void checkOurValidation();
 
+	void setState(LCState state);
 	void beginAccept(bool synchronous);
 	void endConsensus();
 
 public:
 	LedgerConsensus(const uint256& prevLCLHash, Ledger::ref previousLedger, uint32 closeTime);
 
+	// Apply a transaction set the way a ledger close does, also used to replay stored ledgers
+	static void applyTransactions(SHAMap::ref transactionSet, Ledger::ref targetLedger,
+		Ledger::ref checkLedger, CanonicalTXSet& failedTransactions, bool openLgr,
+		const UndoLog::pointer& undoLog = UndoLog::pointer());
+
 	int startup();
 	Json::Value getJson(bool full);
 
@@ -4,12 +4,14 @@
 #include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include "Log.h"
 
 SETUP_LOG();
 
-DECLARE_INSTANCE(LedgerEntrySetEntry);
+DECLARE_SIZED_INSTANCE(LedgerEntrySetEntry, LedgerEntrySetEntry);
 DECLARE_INSTANCE(LedgerEntrySet)
 
 // #define META_DEBUG
@@ -19,6 +21,8 @@ DECLARE_INSTANCE(LedgerEntrySet)
 void LedgerEntrySet::init(Ledger::ref ledger, const uint256& transactionID, uint32 ledgerID)
 {
 	mEntries.clear();
+	mLayer.reset();
+	mReads.reset();
 	mLedger	= ledger;
 	mSet.init(transactionID, ledgerID);
 	mSeq	= 0;
@@ -27,20 +31,24 @@ void LedgerEntrySet::init(Ledger::ref ledger, const uint256& transactionID, uint
 void LedgerEntrySet::clear()
 {
 	mEntries.clear();
+	mLayer.reset();
 	mSet.clear();
 }
 
-LedgerEntrySet LedgerEntrySet::duplicate() const
+LedgerEntrySet LedgerEntrySet::duplicate()
 {
-	return LedgerEntrySet(mLedger, mEntries, mSet, mSeq + 1);
+	checkpoint();
+	return LedgerEntrySet(mLedger, mLayer, mSet, mSeq + 1, mReads);
 }
 
 void LedgerEntrySet::setTo(const LedgerEntrySet& e)
 {
 	mEntries = e.mEntries;
+	mLayer = e.mLayer;
 	mSet = e.mSet;
 	mSeq = e.mSeq;
 	mLedger = e.mLedger;
+	mReads = e.mReads;
 }
 
 void LedgerEntrySet::swapWith(LedgerEntrySet& e)
@@ -49,14 +57,97 @@ void LedgerEntrySet::swapWith(LedgerEntrySet& e)
 	std::swap(mLedger, e.mLedger);
 	mSet.swap(e.mSet);
 	mEntries.swap(e.mEntries);
+	mLayer.swap(e.mLayer);
+	mReads.swap(e.mReads);
+}
+
+// Move our entries into a frozen layer. Copies of this set then share the layer instead of copying the map,
+// and each copy only records what it changes. Entries read from a layer are copied before they are handed out.
+void LedgerEntrySet::checkpoint()
+{
+	if (mEntries.empty())
+		return;
+
+	boost::shared_ptr<LedgerEntryLayer> layer = boost::make_shared<LedgerEntryLayer>(mLayer);
+	if (layer->mDepth > sMaxLayers)
+	{ // collapse the stack into this one layer
+		mergeLayers(mEntries);
+		layer->mParent.reset();
+		layer->mDepth = 1;
+	}
+	layer->mEntries.swap(mEntries);
+	mLayer = layer;
+}
+
+void LedgerEntrySet::flatten()
+{
+	if (!mLayer)
+		return;
+
+	mergeLayers(mEntries);
+	mLayer.reset();
+
+	for (std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.begin(); it != mEntries.end(); )
+	{ // drop the markers for entries created and then deleted above a layer
+		if (it->second.mAction == taaNONE)
+			mEntries.erase(it++);
+		else
+			++it;
+	}
+}
+
+void LedgerEntrySet::checkFlat() const
+{ // entries in layers would be silently missed
+	if (mLayer)
+		throw std::runtime_error("const iteration over a layered LedgerEntrySet");
+}
+
+void LedgerEntrySet::mergeLayers(std::map<uint256, LedgerEntrySetEntry>& entries) const
+{ // add everything in our layers that entries doesn't already have, the topmost layer wins
+	for (const LedgerEntryLayer* layer = mLayer.get(); layer != NULL; layer = layer->mParent.get())
+	{
+		typedef std::map<uint256, LedgerEntrySetEntry>::value_type u256_LES_pair;
+		BOOST_FOREACH(const u256_LES_pair& it, layer->mEntries)
+		{
+			std::pair<std::map<uint256, LedgerEntrySetEntry>::iterator, bool> ins = entries.insert(it);
+			if (ins.second)
+				ins.first->second.mSeq = -1;	// shared with the layer, force a copy before it is modified
+		}
+	}
+}
+
+const LedgerEntrySetEntry* LedgerEntrySet::findLayered(const uint256& index) const
+{
+	for (const LedgerEntryLayer* layer = mLayer.get(); layer != NULL; layer = layer->mParent.get())
+	{
+		std::map<uint256, LedgerEntrySetEntry>::const_iterator it = layer->mEntries.find(index);
+		if (it != layer->mEntries.end())
+			return &it->second;
+	}
+	return NULL;
+}
+
+// Find an entry among our own, copying it up from a layer if needed.
+std::map<uint256, LedgerEntrySetEntry>::iterator LedgerEntrySet::pullEntry(const uint256& index)
+{
+	std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find(index);
+	if ((it != mEntries.end()) || !mLayer)
+		return it;
+
+	const LedgerEntrySetEntry* entry = findLayered(index);
+	if (entry == NULL)
+		return mEntries.end();
+
+	SLE::pointer sle = (entry->mAction == taaNONE) ? entry->mEntry : boost::make_shared<SLE>(*entry->mEntry);
+	return mEntries.insert(std::make_pair(index, LedgerEntrySetEntry(sle, entry->mAction, mSeq))).first;
 }
 
 // Find an entry in the set.  If it has the wrong sequence number, copy it and update the sequence number.
 // This is basically: copy-on-read.
 SLE::pointer LedgerEntrySet::getEntry(const uint256& index, LedgerEntryAction& action)
 {
-	std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find(index);
-	if (it == mEntries.end())
+	std::map<uint256, LedgerEntrySetEntry>::iterator it = pullEntry(index);
+	if ((it == mEntries.end()) || (it->second.mAction == taaNONE))
 	{
 		action = taaNONE;
 		return SLE::pointer();
@@ -87,6 +178,7 @@ SLE::pointer LedgerEntrySet::entryCache(LedgerEntryType letType, const uint256&
 		sleEntry = getEntry(index, action);
 		if (!sleEntry)
 		{
+			noteRead(index);
 			sleEntry = mLedger->getSLE(index);
 			if (sleEntry)
 				entryCache(sleEntry);
@@ -97,17 +189,69 @@ SLE::pointer LedgerEntrySet::entryCache(LedgerEntryType letType, const uint256&
 	return sleEntry;
 }
 
+// Entries already in the set are seen as they are now. Anything else is viewed in place in the ledger and
+// only becomes a full entry if someone calls entryCache to change it.
+SLEView::pointer LedgerEntrySet::entryView(const uint256& index, LedgerEntryType letType)
+{
+	if (index.isZero())
+		return SLEView::pointer();
+
+	const LedgerEntrySetEntry* entry;
+	std::map<uint256, LedgerEntrySetEntry>::const_iterator it = mEntries.find(index);
+	if (it != mEntries.end())
+		entry = &it->second;
+	else if ((entry = findLayered(index)) == NULL)
+	{
+		noteRead(index);
+		return mLedger->getSLEView(index, letType);
+	}
+
+	if ((entry->mAction == taaDELETE) || (entry->mAction == taaNONE))
+		return SLEView::pointer();
+	assert((letType == ltINVALID) || (entry->mEntry->getType() == letType));
+	return boost::make_shared<SLEView>(entry->mEntry);
+}
+
+uint256 LedgerEntrySet::getNextLedgerIndex(const uint256& uHash, const uint256& uEnd)
+{
+	if (mReads)
+		mReads->mWholeLedger = true;
+	return mLedger->getNextLedgerIndex(uHash, uEnd);
+}
+
+uint32 LedgerEntrySet::getParentCloseTime()
+{
+	if (mReads)
+		mReads->mWholeLedger = true;
+	return mLedger->getParentCloseTimeNC();
+}
+
+bool LedgerEntrySet::hasTransaction(const uint256& txID)
+{
+	if (mReads)
+		mReads->mWholeLedger = true;
+	return mLedger->hasTransaction(txID);
+}
+
+uint64 LedgerEntrySet::getReserve(int increments)
+{
+	noteRead(Ledger::getLedgerFeeIndex());
+	return mLedger->getReserve(increments);
+}
+
 LedgerEntryAction LedgerEntrySet::hasEntry(const uint256& index) const
 {
 	std::map<uint256, LedgerEntrySetEntry>::const_iterator it = mEntries.find(index);
-	if (it == mEntries.end())
-		return taaNONE;
-	return it->second.mAction;
+	if (it != mEntries.end())
+		return it->second.mAction;
+
+	const LedgerEntrySetEntry* entry = findLayered(index);
+	return entry ? entry->mAction : taaNONE;
 }
 
 void LedgerEntrySet::entryCache(SLE::ref sle)
 {
-	std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find(sle->getIndex());
+	std::map<uint256, LedgerEntrySetEntry>::iterator it = pullEntry(sle->getIndex());
 	if (it == mEntries.end())
 	{
 		mEntries.insert(std::make_pair(sle->getIndex(), LedgerEntrySetEntry(sle, taaCACHED, mSeq)));
@@ -116,6 +260,10 @@ void LedgerEntrySet::entryCache(SLE::ref sle)
 
 	switch (it->second.mAction)
 	{
+		case taaNONE:
+			it->second.mAction	= taaCACHED;
+			fallthru();
+
 		case taaCACHED:
 			it->second.mSeq	    = mSeq;
 			it->second.mEntry   = sle;
@@ -128,7 +276,7 @@ void LedgerEntrySet::entryCache(SLE::ref sle)
 
 void LedgerEntrySet::entryCreate(SLE::ref sle)
 {
-	std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find(sle->getIndex());
+	std::map<uint256, LedgerEntrySetEntry>::iterator it = pullEntry(sle->getIndex());
 	if (it == mEntries.end())
 	{
 		mEntries.insert(std::make_pair(sle->getIndex(), LedgerEntrySetEntry(sle, taaCREATE, mSeq)));
@@ -137,6 +285,11 @@ void LedgerEntrySet::entryCreate(SLE::ref sle)
 
 	switch (it->second.mAction)
 	{
+		case taaNONE:
+			it->second.mEntry = sle;
+			it->second.mAction = taaCREATE;
+			it->second.mSeq = mSeq;
+			break;
 
 		case taaDELETE:
 			it->second.mEntry = sle;
@@ -161,12 +314,19 @@ void LedgerEntrySet::entryCreate(SLE::ref sle)
 
 void LedgerEntrySet::entryModify(SLE::ref sle)
 {
-	std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find(sle->getIndex());
+	std::map<uint256, LedgerEntrySetEntry>::iterator it = pullEntry(sle->getIndex());
 	if (it == mEntries.end())
 	{
 		mEntries.insert(std::make_pair(sle->getIndex(), LedgerEntrySetEntry(sle, taaMODIFY, mSeq)));
 		return;
 	}
+	if (it->second.mAction == taaNONE)
+	{
+		it->second.mEntry	= sle;
+		it->second.mAction	= taaMODIFY;
+		it->second.mSeq		= mSeq;
+		return;
+	}
 
 	assert(it->second.mSeq == mSeq);
 	assert(*it->second.mEntry == *sle);
@@ -193,12 +353,19 @@ void LedgerEntrySet::entryModify(SLE::ref sle)
 
 void LedgerEntrySet::entryDelete(SLE::ref sle)
 {
-	std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find(sle->getIndex());
+	std::map<uint256, LedgerEntrySetEntry>::iterator it = pullEntry(sle->getIndex());
 	if (it == mEntries.end())
 	{
 		mEntries.insert(std::make_pair(sle->getIndex(), LedgerEntrySetEntry(sle, taaDELETE, mSeq)));
 		return;
 	}
+	if (it->second.mAction == taaNONE)
+	{
+		it->second.mEntry	= sle;
+		it->second.mAction	= taaDELETE;
+		it->second.mSeq		= mSeq;
+		return;
+	}
 
 	assert(it->second.mSeq == mSeq);
 	assert(*it->second.mEntry == *sle);
@@ -213,7 +380,10 @@ void LedgerEntrySet::entryDelete(SLE::ref sle)
 			break;
 
 		case taaCREATE:
-			mEntries.erase(it);
+			if (mLayer)		// a layer below may still have the create, mask it
+				it->second.mAction = taaNONE;
+			else
+				mEntries.erase(it);
 			break;
 
 		case taaDELETE:
@@ -233,10 +403,22 @@ Json::Value LedgerEntrySet::getJson(int) const
 {
 	Json::Value ret(Json::objectValue);
 
+	std::map<uint256, LedgerEntrySetEntry> merged;
+	const std::map<uint256, LedgerEntrySetEntry>* entries = &mEntries;
+	if (mLayer)
+	{
+		merged = mEntries;
+		mergeLayers(merged);
+		entries = &merged;
+	}
+
 	Json::Value nodes(Json::arrayValue);
-	for (std::map<uint256, LedgerEntrySetEntry>::const_iterator it = mEntries.begin(),
-			end = mEntries.end(); it != end; ++it)
+	for (std::map<uint256, LedgerEntrySetEntry>::const_iterator it = entries->begin(),
+			end = entries->end(); it != end; ++it)
 	{
+		if (it->second.mAction == taaNONE)
+			continue;
+
 		Json::Value entry(Json::objectValue);
 		entry["node"] = it->first.GetHex();
 		switch (it->second.mEntry->getType())
@@ -364,6 +546,8 @@ void LedgerEntrySet::calcRawMeta(Serializer& s, TER result, uint32 index)
 	// Entries modified only as a result of building the transaction metadata
 	boost::unordered_map<uint256, SLE::pointer> newMod;
 
+	flatten();
+
 	typedef std::map<uint256, LedgerEntrySetEntry>::value_type u256_LES_pair;
 	BOOST_FOREACH(u256_LES_pair& it, mEntries)
 	{
@@ -927,8 +1111,8 @@ TER LedgerEntrySet::offerDelete(const uint256& uOfferIndex)
 // <-- $owed/uCurrencyID/uToAccountID: positive: uFromAccountID holds IOUs., negative: uFromAccountID owes IOUs.
 STAmount LedgerEntrySet::rippleOwed(const uint160& uToAccountID, const uint160& uFromAccountID, const uint160& uCurrencyID)
 {
-	STAmount		saBalance;
-	SLE::pointer	sleRippleState	= entryCache(ltRIPPLE_STATE, Ledger::getRippleStateIndex(uToAccountID, uFromAccountID, uCurrencyID));
+	STAmount			saBalance;
+	SLEView::pointer	sleRippleState	= entryView(Ledger::getRippleStateIndex(uToAccountID, uFromAccountID, uCurrencyID), ltRIPPLE_STATE);
 
 	if (sleRippleState)
 	{
@@ -957,8 +1141,8 @@ STAmount LedgerEntrySet::rippleOwed(const uint160& uToAccountID, const uint160&
 // <-- $amount/uCurrencyID/uToAccountID.
 STAmount LedgerEntrySet::rippleLimit(const uint160& uToAccountID, const uint160& uFromAccountID, const uint160& uCurrencyID)
 {
-	STAmount		saLimit;
-	SLE::pointer	sleRippleState	= entryCache(ltRIPPLE_STATE, Ledger::getRippleStateIndex(uToAccountID, uFromAccountID, uCurrencyID));
+	STAmount			saLimit;
+	SLEView::pointer	sleRippleState	= entryView(Ledger::getRippleStateIndex(uToAccountID, uFromAccountID, uCurrencyID), ltRIPPLE_STATE);
 
 	assert(sleRippleState);
 	if (sleRippleState)
@@ -973,7 +1157,7 @@ STAmount LedgerEntrySet::rippleLimit(const uint160& uToAccountID, const uint160&
 
 uint32 LedgerEntrySet::rippleTransferRate(const uint160& uIssuerID)
 {
-	SLE::pointer	sleAccount	= entryCache(ltACCOUNT_ROOT, Ledger::getAccountRootIndex(uIssuerID));
+	SLEView::pointer	sleAccount	= entryView(Ledger::getAccountRootIndex(uIssuerID), ltACCOUNT_ROOT);
 
 	uint32			uQuality	= sleAccount && sleAccount->isFieldPresent(sfTransferRate)
 									? sleAccount->getFieldU32(sfTransferRate)
@@ -997,8 +1181,8 @@ uint32 LedgerEntrySet::rippleTransferRate(const uint160& uSenderID, const uint16
 // XXX Might not need this, might store in nodes on calc reverse.
 uint32 LedgerEntrySet::rippleQualityIn(const uint160& uToAccountID, const uint160& uFromAccountID, const uint160& uCurrencyID, SField::ref sfLow, SField::ref sfHigh)
 {
-	uint32			uQuality		= QUALITY_ONE;
-	SLE::pointer	sleRippleState;
+	uint32				uQuality		= QUALITY_ONE;
+	SLEView::pointer	sleRippleState;
 
 	if (uToAccountID == uFromAccountID)
 	{
@@ -1006,7 +1190,7 @@ uint32 LedgerEntrySet::rippleQualityIn(const uint160& uToAccountID, const uint16
 	}
 	else
 	{
-		sleRippleState	= entryCache(ltRIPPLE_STATE, Ledger::getRippleStateIndex(uToAccountID, uFromAccountID, uCurrencyID));
+		sleRippleState	= entryView(Ledger::getRippleStateIndex(uToAccountID, uFromAccountID, uCurrencyID), ltRIPPLE_STATE);
 
 		if (sleRippleState)
 		{
@@ -1039,7 +1223,7 @@ uint32 LedgerEntrySet::rippleQualityIn(const uint160& uToAccountID, const uint16
 STAmount LedgerEntrySet::rippleHolds(const uint160& uAccountID, const uint160& uCurrencyID, const uint160& uIssuerID)
 {
 	STAmount			saBalance;
-	SLE::pointer		sleRippleState	= entryCache(ltRIPPLE_STATE, Ledger::getRippleStateIndex(uAccountID, uIssuerID, uCurrencyID));
+	SLEView::pointer	sleRippleState	= entryView(Ledger::getRippleStateIndex(uAccountID, uIssuerID, uCurrencyID), ltRIPPLE_STATE);
 
 	if (!sleRippleState)
 	{
@@ -1069,10 +1253,10 @@ STAmount LedgerEntrySet::accountHolds(const uint160& uAccountID, const uint160&
 
 	if (!uCurrencyID)
 	{
-		SLE::pointer	sleAccount	= entryCache(ltACCOUNT_ROOT, Ledger::getAccountRootIndex(uAccountID));
-		uint64			uReserve	= mLedger->getReserve(sleAccount->getFieldU32(sfOwnerCount));
+		SLEView::pointer	sleAccount	= entryView(Ledger::getAccountRootIndex(uAccountID), ltACCOUNT_ROOT);
+		uint64				uReserve	= getReserve(sleAccount->getFieldU32(sfOwnerCount));
 
-		STAmount		saBalance	= sleAccount->getFieldAmount(sfBalance);
+		STAmount			saBalance	= sleAccount->getFieldAmount(sfBalance);
 
 		if (saBalance < uReserve)
 		{
@@ -1402,4 +1586,138 @@ TER LedgerEntrySet::accountSend(const uint160& uSenderID, const uint160& uReceiv
 	return terResult;
 }
 
+BOOST_AUTO_TEST_SUITE(LedgerEntrySet_suite)
+
+// Replay the checkpoint pattern RippleCalc uses for a payment with several paths: every pass each path starts
+// from the pass checkpoint, changes a few entries, and the best path becomes the next pass's state.
+static void runPaths(LedgerEntrySet& lesActive, const std::vector<uint256>& vIndexes, bool bLayered,
+	int iPaths, int iPasses, int iTouched)
+{
+	for (int iPass = 0; iPass != iPasses; ++iPass)
+	{
+		if (bLayered)
+			lesActive.checkpoint();
+
+		const LedgerEntrySet	lesCheckpoint	= lesActive;
+		LedgerEntrySet			lesBest;
+
+		for (int iPath = 0; iPath != iPaths; ++iPath)
+		{
+			LedgerEntrySet	lesPath	= lesCheckpoint;
+			lesPath.bumpSeq();
+
+			for (int i = 0; i != iTouched; ++i)
+			{
+				SLE::pointer sle = lesPath.entryCache(ltACCOUNT_ROOT,
+					vIndexes[(iPass * 37 + iPath * 11 + i * 101) % vIndexes.size()]);
+				sle->setFieldU32(sfSequence, sle->getFieldU32(sfSequence) + iPath + 1);
+				lesPath.entryModify(sle);
+			}
+
+			if (iPath == (iPass % iPaths))
+				lesBest.swapWith(lesPath);
+		}
+
+		lesActive.swapWith(lesBest);
+	}
+
+	lesActive.flatten();
+}
+
+static void makeSets(int iEntries, std::vector<uint256>& vIndexes, LedgerEntrySet& lesDeep, LedgerEntrySet& lesLayered)
+{
+	for (int i = 0; i != iEntries; ++i)
+	{
+		vIndexes.push_back(uint256(i + 1));
+
+		SLE::pointer	sleDeep		= boost::make_shared<SLE>(ltACCOUNT_ROOT, vIndexes.back());
+		SLE::pointer	sleLayered	= boost::make_shared<SLE>(ltACCOUNT_ROOT, vIndexes.back());
+		sleDeep->setFieldU32(sfSequence, i);
+		sleLayered->setFieldU32(sfSequence, i);
+		lesDeep.entryCreate(sleDeep);
+		lesLayered.entryCreate(sleLayered);
+	}
+}
+
+static bool sameSets(const std::vector<uint256>& vIndexes, LedgerEntrySet& lesDeep, LedgerEntrySet& lesLayered)
+{
+	BOOST_FOREACH(const uint256& uIndex, vIndexes)
+	{
+		LedgerEntryAction	aDeep, aLayered;
+		SLE::pointer		sleDeep		= lesDeep.getEntry(uIndex, aDeep);
+		SLE::pointer		sleLayered	= lesLayered.getEntry(uIndex, aLayered);
+
+		if (!sleDeep || !sleLayered || (aDeep != aLayered)
+			|| (sleDeep->getFieldU32(sfSequence) != sleLayered->getFieldU32(sfSequence)))
+			return false;
+	}
+	return true;
+}
+
+BOOST_AUTO_TEST_CASE( LES_checkpoint_test )
+{
+	std::vector<uint256>	vIndexes;
+	LedgerEntrySet			lesDeep, lesLayered;
+
+	makeSets(200, vIndexes, lesDeep, lesLayered);
+	runPaths(lesDeep, vIndexes, false, 6, 5, 8);
+	runPaths(lesLayered, vIndexes, true, 6, 5, 8);
+
+	if (!sameSets(vIndexes, lesDeep, lesLayered)) BOOST_FAIL("Layered LedgerEntrySet diverged from copying one");
+}
+
+#ifdef ENABLE_BENCHMARKS
+
+BOOST_AUTO_TEST_CASE( LES_checkpoint_bench )
+{
+	const int iEntries = 2000, iPaths = 6, iPasses = 20, iTouched = 8;
+
+	std::vector<uint256>	vIndexes;
+	LedgerEntrySet			lesDeep, lesLayered;
+
+	makeSets(iEntries, vIndexes, lesDeep, lesLayered);
+
+	boost::posix_time::ptime	start	= boost::posix_time::microsec_clock::universal_time();
+	runPaths(lesDeep, vIndexes, false, iPaths, iPasses, iTouched);
+	boost::posix_time::ptime	mid		= boost::posix_time::microsec_clock::universal_time();
+	runPaths(lesLayered, vIndexes, true, iPaths, iPasses, iTouched);
+	boost::posix_time::ptime	end		= boost::posix_time::microsec_clock::universal_time();
+
+	Log(lsINFO) << boost::str(boost::format("LedgerEntrySet %d paths x %d passes: copying %dms, layered %dms")
+		% iPaths % iPasses % (mid - start).total_milliseconds() % (end - mid).total_milliseconds());
+
+	if (!sameSets(vIndexes, lesDeep, lesLayered)) BOOST_FAIL("Layered LedgerEntrySet diverged from copying one");
+}
+
+#endif
+
+BOOST_AUTO_TEST_CASE( LES_constIteration_test )
+{
+	LedgerEntrySet			les;
+	const LedgerEntrySet&	lesConst	= les;
+
+	les.entryCreate(boost::make_shared<SLE>(ltACCOUNT_ROOT, uint256(1)));
+	les.checkpoint();
+	les.entryCreate(boost::make_shared<SLE>(ltACCOUNT_ROOT, uint256(2)));
+
+	bool bThrew = false;
+	try
+	{
+		lesConst.begin();
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrew = true;
+	}
+	if (!bThrew) BOOST_FAIL("Const iteration missed layered entries");
+
+	les.flatten();
+	int iCount = 0;
+	for (LedgerEntrySet::const_iterator it = lesConst.begin(), end = lesConst.end(); it != end; ++it)
+		++iCount;
+	if (iCount != 2) BOOST_FAIL("Flattened set lost entries");
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
 // vim:ts=4
@@ -1,6 +1,8 @@
 #ifndef __LEDGERENTRYSET__
 #define __LEDGERENTRYSET__
 
+#include <set>
+
 #include <boost/unordered_map.hpp>
 #include <boost/function.hpp>
 
@@ -32,17 +34,52 @@ public:
 	LedgerEntrySetEntry(SLE::ref e, LedgerEntryAction a, int s) : mEntry(e), mAction(a), mSeq(s) { ; }
 };
 
+class LedgerEntryLayer
+{ // Entries frozen by LedgerEntrySet::checkpoint, shared by every set built on top of them
+public:
+	typedef boost::shared_ptr<const LedgerEntryLayer>	pointer;
+
+	std::map<uint256, LedgerEntrySetEntry>	mEntries;
+	pointer									mParent;
+	int										mDepth;
+
+	LedgerEntryLayer(const pointer& parent) : mParent(parent), mDepth(parent ? (parent->mDepth + 1) : 1) { ; }
+};
+
+class LedgerEntryReads
+{ // What a transaction looked at in the ledger, shared by every set it works through
+public:
+	typedef boost::shared_ptr<LedgerEntryReads>	pointer;
+
+	std::set<uint256>	mIndexes;		// entries fetched from the ledger, whether or not they existed
+	bool				mWholeLedger;	// walked the state map in order or read the close time
+	uint64				mBaseFee;		// fee units charged against the load
+
+	LedgerEntryReads() : mWholeLedger(false), mBaseFee(0) { ; }
+};
 
 class LedgerEntrySet : private IS_INSTANCE(LedgerEntrySet)
 {
 protected:
 	Ledger::pointer mLedger;
 	std::map<uint256, LedgerEntrySetEntry>	mEntries; // cannot be unordered!
+	LedgerEntryLayer::pointer				mLayer;	// frozen entries below ours, mEntries takes precedence
 	TransactionMetaSet mSet;
 	int mSeq;
+	LedgerEntryReads::pointer				mReads;	// if set, record what we fetch from the ledger
+
+	static const int sMaxLayers = 8;	// collapse deeper stacks so lookups stay short
+
+	LedgerEntrySet(Ledger::ref ledger, const LedgerEntryLayer::pointer& l,
+		const TransactionMetaSet& s, int m, const LedgerEntryReads::pointer& r) :
+		mLedger(ledger), mLayer(l), mSet(s), mSeq(m), mReads(r) { ; }
 
-	LedgerEntrySet(Ledger::ref ledger, const std::map<uint256, LedgerEntrySetEntry> &e,
-		const TransactionMetaSet& s, int m) : mLedger(ledger), mEntries(e), mSet(s), mSeq(m) { ; }
+	void noteRead(const uint256& index)		{ if (mReads) mReads->mIndexes.insert(index); }
+
+	const LedgerEntrySetEntry* findLayered(const uint256& index) const;
+	void checkFlat() const;
+	std::map<uint256, LedgerEntrySetEntry>::iterator pullEntry(const uint256& index);
+	void mergeLayers(std::map<uint256, LedgerEntrySetEntry>& entries) const;
 
 	SLE::pointer getForMod(const uint256& node, Ledger::ref ledger,
 		boost::unordered_map<uint256, SLE::pointer>& newMods);
@@ -61,9 +98,11 @@ public:
 	LedgerEntrySet() : mSeq(0) { ; }
 
 	// set functions
-	LedgerEntrySet duplicate() const;	// Make a duplicate of this set
+	LedgerEntrySet duplicate();			// Make a duplicate of this set, shares a checkpoint with it
 	void setTo(const LedgerEntrySet&);	// Set this set to have the same contents as another
 	void swapWith(LedgerEntrySet&);		// Swap the contents of two sets
+	void checkpoint();					// Freeze our entries so copies of this set are O(1)
+	void flatten();						// Pull every frozen layer back into this set
 
 	int getSeq() const			{ return mSeq; }
 	void bumpSeq()				{ ++mSeq; }
@@ -73,6 +112,16 @@ public:
 	Ledger::pointer& getLedger()		{ return mLedger; }
 	Ledger::ref getLedgerRef() const	{ return mLedger; }
 
+	void setReads(const LedgerEntryReads::pointer& reads)	{ mReads = reads; }
+	const LedgerEntryReads::pointer& getReads() const		{ return mReads; }
+
+	// Ledger-wide reads, recorded so the transaction is never replayed from its entries alone
+	uint256 getNextLedgerIndex(const uint256& uHash, const uint256& uEnd);
+	uint32 getParentCloseTime();
+	bool hasTransaction(const uint256& txID);
+
+	uint64 getReserve(int increments);		// reads the fee settings
+
 	// basic entry functions
 	SLE::pointer getEntry(const uint256& index, LedgerEntryAction&);
 	LedgerEntryAction hasEntry(const uint256& index) const;
@@ -84,6 +133,8 @@ public:
 	// higher-level ledger functions
 	SLE::pointer entryCreate(LedgerEntryType letType, const uint256& uIndex);
 	SLE::pointer entryCache(LedgerEntryType letType, const uint256& uIndex);
+	// Read only, does not add the entry to the set. Asserts the entry has the type given unless that's ltINVALID.
+	SLEView::pointer entryView(const uint256& uIndex, LedgerEntryType letType = ltINVALID);
 
 	// Directory functions.
 	TER dirAdd(
@@ -147,11 +198,12 @@ public:
 	// iterator functions
 	typedef std::map<uint256, LedgerEntrySetEntry>::iterator				iterator;
 	typedef std::map<uint256, LedgerEntrySetEntry>::const_iterator			const_iterator;
-	bool isEmpty() const													{ return mEntries.empty(); }
-	std::map<uint256, LedgerEntrySetEntry>::const_iterator begin() const	{ return mEntries.begin(); }
-	std::map<uint256, LedgerEntrySetEntry>::const_iterator end() const		{ return mEntries.end(); }
-	std::map<uint256, LedgerEntrySetEntry>::iterator begin()				{ return mEntries.begin(); }
-	std::map<uint256, LedgerEntrySetEntry>::iterator end()					{ return mEntries.end(); }
+	bool isEmpty() const													{ return mEntries.empty() && !mLayer; }
+	// A const set can't flatten its layers, so iterating over one that has them throws
+	std::map<uint256, LedgerEntrySetEntry>::const_iterator begin() const	{ checkFlat(); return mEntries.begin(); }
+	std::map<uint256, LedgerEntrySetEntry>::const_iterator end() const		{ checkFlat(); return mEntries.end(); }
+	std::map<uint256, LedgerEntrySetEntry>::iterator begin()				{ flatten(); return mEntries.begin(); }
+	std::map<uint256, LedgerEntrySetEntry>::iterator end()					{ flatten(); return mEntries.end(); }
 
 	static bool intersect(const LedgerEntrySet& lesLeft, const LedgerEntrySet& lesRight);
 };
@@ -58,7 +58,7 @@ class LedgerEntryFormat
 public:
 	std::string					t_name;
 	LedgerEntryType				t_type;
-	std::vector<SOElement::ref>	elements;
+	SOTemplate					elements;
 
 	static std::map<int, LedgerEntryFormat*>			byType;
 	static std::map<std::string, LedgerEntryFormat*>	byName;
@@ -4,7 +4,10 @@
 #include <string>
 
 #include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
 #include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
 
 #include "Config.h"
 #include "Application.h"
@@ -17,11 +20,40 @@
 #define CACHED_LEDGER_AGE 120
 #endif
 
-// FIXME: Need to clean up ledgers by index at some point
+// Sequences indexed, a few hours of ledgers
+#ifndef LEDGER_INDEX_SIZE
+#define LEDGER_INDEX_SIZE 8192
+#endif
+
+// Ledgers read at once when lookups by sequence walk through the history
+#ifndef LEDGER_PREFETCH
+#define LEDGER_PREFETCH 32
+#endif
 
-LedgerHistory::LedgerHistory() : mLedgersByHash("LedgerCache", CACHED_LEDGER_NUM, CACHED_LEDGER_AGE)
+LedgerHistory::LedgerHistory() : mLedgersByHash("LedgerCache", CACHED_LEDGER_NUM, CACHED_LEDGER_AGE),
+	mLedgersByIndex(LEDGER_INDEX_SIZE), mLastSeq(0)
 { ; }
 
+uint256 LedgerIndex::getHash(uint32 index)
+{
+	boost::mutex::scoped_lock sl(mLock);
+
+	const Entry& entry = mEntries[index % mEntries.size()];
+	return (entry.mSeq == index) ? entry.mHash : uint256();
+}
+
+void LedgerIndex::setHash(uint32 index, const uint256& hash)
+{
+	boost::mutex::scoped_lock sl(mLock);
+
+	Entry& entry = mEntries[index % mEntries.size()];
+	if (index >= entry.mSeq)
+	{
+		entry.mSeq	= index;
+		entry.mHash	= hash;
+	}
+}
+
 void LedgerHistory::addLedger(Ledger::pointer ledger)
 {
 	assert(ledger->isImmutable());
@@ -32,47 +64,83 @@ void LedgerHistory::addAcceptedLedger(Ledger::pointer ledger, bool fromConsensus
 {
 	assert(ledger && ledger->isAccepted() && ledger->isImmutable());
 	uint256 h(ledger->getHash());
-	boost::recursive_mutex::scoped_lock sl(mLedgersByHash.peekMutex());
 	mLedgersByHash.canonicalize(h, ledger, true);
 	assert(ledger);
 	assert(ledger->isAccepted());
 	assert(ledger->isImmutable());
-	mLedgersByIndex[ledger->getLedgerSeq()] = ledger->getHash();
+	mLedgersByIndex.setHash(ledger->getLedgerSeq(), h);
 
 	ledger->pendSave(fromConsensus);
 }
 
 uint256 LedgerHistory::getLedgerHash(uint32 index)
 {
-	boost::recursive_mutex::scoped_lock sl(mLedgersByHash.peekMutex());
-	std::map<uint32, uint256>::iterator it(mLedgersByIndex.find(index));
-	if (it != mLedgersByIndex.end())
-		return it->second;
-	sl.unlock();
-	return uint256();
+	uint256 hash = mLedgersByIndex.getHash(index);
+	if (hash.isZero())
+		hash = Ledger::getHashByIndex(index);
+	return hash;
 }
 
 Ledger::pointer LedgerHistory::getLedgerBySeq(uint32 index)
 {
-	boost::recursive_mutex::scoped_lock sl(mLedgersByHash.peekMutex());
-	std::map<uint32, uint256>::iterator it(mLedgersByIndex.find(index));
-	if (it != mLedgersByIndex.end())
+	uint32 lastSeq;
 	{
-		uint256 hash = it->second;
-		sl.unlock();
+		boost::mutex::scoped_lock sl(mLastLock);
+
+		lastSeq = mLastSeq;
+		mLastSeq = index;
+	}
+
+	uint256 hash = mLedgersByIndex.getHash(index);
+	if (hash.isNonZero())
 		return getLedgerByHash(hash);
+
+	return loadBySeq(index, lastSeq);
+}
+
+void LedgerHistory::getPrefetchRange(uint32 index, uint32 lastSeq, uint32& minSeq, uint32& maxSeq)
+{
+	minSeq = maxSeq = index;
+
+	if ((lastSeq == (index + 1)) && (index > LEDGER_PREFETCH))
+		minSeq = index - (LEDGER_PREFETCH - 1);
+	else if ((lastSeq + 1) == index)
+		maxSeq = index + (LEDGER_PREFETCH - 1);
+}
+
+Ledger::pointer LedgerHistory::loadBySeq(uint32 index, uint32 lastSeq)
+{ // Not indexed. Walks up or down the history are read ahead with one query, so each step isn't a round trip.
+	uint32 minSeq, maxSeq;
+	getPrefetchRange(index, lastSeq, minSeq, maxSeq);
+
+	Ledger::pointer ret;
+
+	if (minSeq != maxSeq)
+	{
+		std::vector<Ledger::pointer> ledgers;
+		Ledger::loadRange(minSeq, maxSeq, ledgers);
+
+		BOOST_FOREACH(Ledger::pointer& ledger, ledgers)
+		{
+			assert(ledger->isImmutable());
+			mLedgersByHash.canonicalize(ledger->getHash(), ledger);
+			mLedgersByIndex.setHash(ledger->getLedgerSeq(), ledger->getHash());
+			if (ledger->getLedgerSeq() == index)
+				ret = ledger;
+		}
+
+		if (ret)
+			return ret;
 	}
-	sl.unlock();
 
-	Ledger::pointer ret(Ledger::loadByIndex(index));
+	ret = Ledger::loadByIndex(index);
 	if (!ret)
 		return ret;
 	assert(ret->getLedgerSeq() == index);
 
-	sl.lock();
 	assert(ret->isImmutable());
 	mLedgersByHash.canonicalize(ret->getHash(), ret);
-	mLedgersByIndex[ret->getLedgerSeq()] = ret->getHash();
+	mLedgersByIndex.setHash(ret->getLedgerSeq(), ret->getHash());
 	return (ret->getLedgerSeq() == index) ? ret : Ledger::pointer();
 }
 
@@ -111,10 +179,9 @@ Ledger::pointer LedgerHistory::canonicalizeLedger(Ledger::pointer ledger, bool s
 	}
 
 	// save input ledger in map if not in map, otherwise return corresponding map ledger
-	boost::recursive_mutex::scoped_lock sl(mLedgersByHash.peekMutex());
 	mLedgersByHash.canonicalize(h, ledger);
 	if (ledger->isAccepted())
-		mLedgersByIndex[ledger->getLedgerSeq()] = ledger->getHash();
+		mLedgersByIndex.setHash(ledger->getLedgerSeq(), ledger->getHash());
 	return ledger;
 }
 
@@ -124,4 +191,100 @@ void LedgerHistory::tune(int size, int age)
 	mLedgersByHash.setTargetAge(age);
 }
 
+extern const char *LedgerDBInit[];
+extern int LedgerDBCount;
+
+BOOST_AUTO_TEST_SUITE(LedgerHistory_suite)
+
+BOOST_AUTO_TEST_CASE(LedgerIndex_test)
+{
+	LedgerIndex index(16);
+	uint256 a(1), b(2), c(3);
+
+	index.setHash(100, a);
+	if (index.getHash(100) != a)		BOOST_FAIL("LedgerIndex set");
+	if (index.getHash(116).isNonZero())	BOOST_FAIL("LedgerIndex slot shared");
+
+	index.setHash(116, b);
+	if (index.getHash(116) != b)		BOOST_FAIL("LedgerIndex newer");
+	if (index.getHash(100).isNonZero())	BOOST_FAIL("LedgerIndex evicted kept");
+
+	index.setHash(100, a);
+	if (index.getHash(116) != b)		BOOST_FAIL("LedgerIndex older evicted newer");
+	if (index.getHash(100).isNonZero())	BOOST_FAIL("LedgerIndex older stored");
+
+	index.setHash(116, c);
+	if (index.getHash(116) != c)		BOOST_FAIL("LedgerIndex same sequence");
+}
+
+BOOST_AUTO_TEST_CASE(LedgerHistory_Prefetch_test)
+{
+	uint32 minSeq, maxSeq;
+
+	LedgerHistory::getPrefetchRange(1000, 0, minSeq, maxSeq);
+	if ((minSeq != 1000) || (maxSeq != 1000))	BOOST_FAIL("Prefetch first lookup");
+
+	LedgerHistory::getPrefetchRange(1000, 999, minSeq, maxSeq);
+	if ((minSeq != 1000) || (maxSeq != (1000 + LEDGER_PREFETCH - 1)))
+		BOOST_FAIL("Prefetch walking up");
+
+	LedgerHistory::getPrefetchRange(1000, 1001, minSeq, maxSeq);
+	if ((minSeq != (1000 - LEDGER_PREFETCH + 1)) || (maxSeq != 1000))
+		BOOST_FAIL("Prefetch walking down");
+
+	LedgerHistory::getPrefetchRange(LEDGER_PREFETCH, LEDGER_PREFETCH + 1, minSeq, maxSeq);
+	if ((minSeq != LEDGER_PREFETCH) || (maxSeq != LEDGER_PREFETCH))
+		BOOST_FAIL("Prefetch walking down past the first ledger");
+
+	LedgerHistory::getPrefetchRange(1000, 1000, minSeq, maxSeq);
+	if ((minSeq != 1000) || (maxSeq != 1000))	BOOST_FAIL("Prefetch repeated lookup");
+
+	LedgerHistory::getPrefetchRange(1000, 500, minSeq, maxSeq);
+	if ((minSeq != 1000) || (maxSeq != 1000))	BOOST_FAIL("Prefetch jump");
+}
+
+#ifndef NO_SQLITE3_PREPARE
+
+BOOST_AUTO_TEST_CASE(Ledger_loadRange_test)
+{ // Headers with empty maps, so no nodes are needed, in a private database
+	bool standalone = theConfig.RUN_STANDALONE;
+	theConfig.RUN_STANDALONE = true;
+	DatabaseCon db("ledger.db", LedgerDBInit, LedgerDBCount);
+	theConfig.RUN_STANDALONE = standalone;
+
+	std::string zero = uint256().GetHex();
+	for (uint32 seq = 10; seq <= 20; ++seq)
+	{
+		if (seq == 15)
+			continue;
+		db.getDB()->executeSQL(boost::str(boost::format("INSERT INTO Ledgers "
+			"(LedgerHash,LedgerSeq,PrevHash,TotalCoins,ClosingTime,PrevClosingTime,CloseTimeRes,CloseFlags,"
+			"AccountSetHash,TransSetHash) VALUES ('%s',%u,'%s',100,%u,%u,10,0,'%s','%s');")
+			% uint256(seq).GetHex() % seq % uint256(seq - 1).GetHex() % (seq * 10) % ((seq - 1) * 10)
+			% zero % zero));
+	}
+
+	std::vector<Ledger::pointer> ledgers;
+	Ledger::loadRange(&db, 12, 17, ledgers);
+
+	const uint32 expected[] = { 12, 13, 14, 16, 17 };
+	if (ledgers.size() != (sizeof(expected) / sizeof(expected[0])))
+		BOOST_FAIL("loadRange count");
+
+	for (size_t i = 0; i < ledgers.size(); ++i)
+	{
+		if (ledgers[i]->getLedgerSeq() != expected[i])			BOOST_FAIL("loadRange order");
+		if (ledgers[i]->getCloseTimeNC() != (expected[i] * 10))	BOOST_FAIL("loadRange header");
+		if (!ledgers[i]->isClosed())							BOOST_FAIL("loadRange not closed");
+	}
+
+	ledgers.clear();
+	Ledger::loadRange(&db, 21, 30, ledgers);
+	if (!ledgers.empty())	BOOST_FAIL("loadRange beyond the history");
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+
 // vim:ts=4
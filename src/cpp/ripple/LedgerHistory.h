@@ -1,13 +1,46 @@
 #ifndef __LEDGERHISTORY__
 #define __LEDGERHISTORY__
 
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
 #include "TaggedCache.h"
 #include "Ledger.h"
 
+class LedgerIndex
+{ // Hashes of recent ledgers by sequence, in a ring with a slot per sequence
+protected:
+	struct Entry
+	{
+		uint32	mSeq;
+		uint256	mHash;
+
+		Entry() : mSeq(0) { ; }
+	};
+
+	boost::mutex		mLock;
+	std::vector<Entry>	mEntries;
+
+public:
+	LedgerIndex(int size) : mEntries(size) { ; }
+
+	uint256 getHash(uint32 index);
+
+	// A slot only goes to the same or a later sequence. Looking up an old ledger must not evict a recent one,
+	// which may still be waiting in the save queue and so can't be found in the database.
+	void setHash(uint32 index, const uint256& hash);
+};
+
 class LedgerHistory
 {
 	TaggedCache<uint256, Ledger> mLedgersByHash;
-	std::map<uint32, uint256> mLedgersByIndex; // accepted ledgers
+	LedgerIndex mLedgersByIndex;
+
+	boost::mutex	mLastLock;
+	uint32			mLastSeq;		// last looked up, to spot sequential walks
+
+	Ledger::pointer loadBySeq(uint32 index, uint32 lastSeq);
 
 public:
 	LedgerHistory();
@@ -21,6 +54,10 @@ public:
 	Ledger::pointer canonicalizeLedger(Ledger::pointer, bool cache);
 	void tune(int size, int age);
 	void sweep() { mLedgersByHash.sweep(); }
+
+	// The sequences to read for a ledger not indexed: a walk up or down the history, seen from the previous
+	// lookup, reads ahead in its direction
+	static void getPrefetchRange(uint32 index, uint32 lastSeq, uint32& minSeq, uint32& maxSeq);
 };
 
 #endif
@@ -11,6 +11,7 @@ SETUP_LOG();
 
 #define MIN_VALIDATION_RATIO	150		// 150/256ths of validations of previous ledger
 #define MAX_LEDGER_GAP			100		// Don't catch up more than 100 ledgers  (cannot exceed 256)
+#define LEDGER_HASH_BATCH		256		// Ledger hashes read at once when walking back through the chain
 
 uint32 LedgerMaster::getCurrentLedgerIndex()
 {
@@ -144,6 +145,9 @@ void LedgerMaster::asyncAccept(Ledger::pointer ledger)
 	uint32 seq = ledger->getLedgerSeq();
 	uint256 prevHash = ledger->getParentHash();
 
+	// The chain is checked against the hashes in the database a batch at a time
+	std::map< uint32, std::pair<uint256, uint256> > hashes;
+
 	while (seq > 0)
 	{
 		{
@@ -154,10 +158,17 @@ void LedgerMaster::asyncAccept(Ledger::pointer ledger)
 				break;
 		}
 
-		uint256 tHash, pHash;
-		if (!Ledger::getHashesByIndex(seq, tHash, pHash) || (tHash != prevHash))
+		std::map< uint32, std::pair<uint256, uint256> >::iterator it = hashes.find(seq);
+		if (it == hashes.end())
+		{
+			hashes.clear();
+			Ledger::getHashesByRange((seq > LEDGER_HASH_BATCH) ? (seq - LEDGER_HASH_BATCH + 1) : 0, seq, hashes);
+			it = hashes.find(seq);
+		}
+
+		if ((it == hashes.end()) || (it->second.first != prevHash))
 			break;
-		prevHash = pHash;
+		prevHash = it->second.second;
 	}
 
 	resumeAcquiring();
@@ -349,7 +360,7 @@ void LedgerMaster::setFullLedger(Ledger::ref ledger)
 		return;
 	}
 
-	if (Ledger::getPendingSaves() > 2)
+	if (Ledger::isSaveBacklogged())
 	{
 		mTooFast = true;
 		cLog(lsDEBUG) << "Too many pending ledger saves";
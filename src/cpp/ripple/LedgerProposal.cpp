@@ -6,6 +6,8 @@
 #include "key.h"
 #include "Application.h"
 #include "HashPrefixes.h"
+#include "Metrics.h"
+#include "utils.h"
 
 DECLARE_INSTANCE(LedgerProposal);
 
@@ -52,8 +54,20 @@ uint256 LedgerProposal::getSigningHash() const
 }
 
 bool LedgerProposal::checkSign(const std::string& signature, const uint256& signingHash)
-{
-	return mPublicKey.verifyNodePublic(signingHash, signature);
+{ // A proposal relayed to us again, or checked again for another ledger, is only verified once
+	SuppressionTable& suppression = theApp->getSuppression();
+	uint256 key = SuppressionTable::getSignatureKey(signingHash, mPublicKey.getNodePublic(), strCopy(signature));
+
+	int flags = suppression.getSignatureFlags(key);
+	if (flags != 0)
+		return flags == SF_SIGGOOD;
+
+	LatencyTimer timer(Metrics::get("signature_verify", "type", "proposal"));
+	bool good = mPublicKey.verifyNodePublic(signingHash, signature);
+	timer.stop();
+
+	suppression.setFlag(key, good ? SF_SIGGOOD : SF_BAD);
+	return good;
 }
 
 bool LedgerProposal::changePosition(const uint256& newPosition, uint32 closeTime)
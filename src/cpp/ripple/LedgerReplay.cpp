@@ -0,0 +1,209 @@
+#include "LedgerReplay.h"
+
+#include <iostream>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "Config.h"
+#include "LedgerConsensus.h"
+#include "CanonicalTXSet.h"
+#include "TransactionFormats.h"
+#include "Log.h"
+
+SETUP_LOG();
+
+LedgerReplay::LedgerReplay(const std::string& range) : mFirst(0), mLast(0), mValid(false),
+	mWritten(Metrics::get("replay_state_write"))
+{
+	try
+	{
+		size_t dash = range.find('-');
+		if (dash == std::string::npos)
+			mFirst = mLast = boost::lexical_cast<uint32>(range);
+		else
+		{
+			mFirst	= boost::lexical_cast<uint32>(range.substr(0, dash));
+			mLast	= boost::lexical_cast<uint32>(range.substr(dash + 1));
+		}
+		mValid = (mFirst > 1) && (mLast >= mFirst);
+	}
+	catch (boost::bad_lexical_cast&)
+	{
+		mValid = false;
+	}
+}
+
+void LedgerReplay::setup()
+{ // Nothing but the stored ledgers: no peers, no clients
+	theConfig.RUN_STANDALONE		= true;
+	theConfig.START_UP				= Config::LOAD;
+	theConfig.START_LEDGER			= boost::lexical_cast<std::string>(mFirst - 1);
+	theConfig.RPC_PORT				= 0;
+	theConfig.WEBSOCKET_PORT		= 0;
+	theConfig.WEBSOCKET_PUBLIC_PORT	= 0;
+}
+
+std::string LedgerReplay::getTypeName(TransactionType type)
+{
+	TransactionFormat* format = TransactionFormat::getTxnFormat(type);
+	return format ? format->t_name : boost::lexical_cast<std::string>(type);
+}
+
+void LedgerReplay::executed(TransactionType type, int microseconds)
+{
+	LatencyHistogram* histogram;
+	{
+		boost::mutex::scoped_lock sl(mLock);
+		LatencyHistogram*& entry = mExecuted[type];
+		if (!entry)
+			entry = &Metrics::get("replay_apply", "type", getTypeName(type));
+		histogram = entry;
+	}
+	histogram->add(microseconds);
+}
+
+void LedgerReplay::written(int microseconds)
+{
+	mWritten.add(microseconds);
+}
+
+void LedgerReplay::printLatency(const std::string& name, const LatencyHistogram& histogram)
+{
+	LatencyHistogram::Snapshot s = histogram.getSnapshot();
+	if (s.count == 0)
+		return;
+
+	std::cout << boost::str(boost::format("%-20s %8d %8d %8d %8d %8d %8d")
+		% name % s.count % (s.total / s.count) % s.getPercentile(50) % s.getPercentile(90) % s.getPercentile(99)
+		% s.max) << std::endl;
+}
+
+SHAMap::pointer LedgerReplay::getTransactionSet(Ledger::ref ledger)
+{ // Rebuild the set the ledger was closed from, as far as the ledger records it
+	SHAMap::pointer set = boost::make_shared<SHAMap>(smtTRANSACTION);
+	SHAMap::ref txMap = ledger->peekTransactionMap();
+	SHAMapTreeNode::TNType type;
+
+	for (SHAMapItem::pointer item = txMap->peekFirstItem(type); !!item; item = txMap->peekNextItem(item->getTag(), type))
+	{
+		SHAMapItem::pointer txn;
+		if (type == SHAMapTreeNode::tnTRANSACTION_MD)
+		{
+			SerializerIterator sit(item->peekSerializer());
+			txn = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), item->getTag(), sit.getVL());
+		}
+		else
+			txn = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), item->getTag(), item->peekData());
+
+		if (!set->addGiveItem(txn, true, false))
+			assert(false);
+	}
+
+	return set;
+}
+
+bool LedgerReplay::replayLedger(Ledger::pointer& parent, uint32 seq, int& transactions, uint64& applyMicroseconds)
+{
+	if (!parent)
+		parent = Ledger::loadByIndex(seq - 1);
+	Ledger::pointer stored = Ledger::loadByIndex(seq);
+	if (!parent || !stored)
+	{
+		std::cout << "Ledger " << (parent ? seq : (seq - 1)) << " is not stored" << std::endl;
+		parent = stored;
+		return false;
+	}
+
+	SHAMap::pointer set = getTransactionSet(stored);
+	CanonicalTXSet failedTransactions(set->getHash());
+	{ // fetch the nodes the set touches first, so the timed run doesn't wait on the node store
+		TransactionEngine::setTimer(NULL);
+		CanonicalTXSet warmFailed(set->getHash());
+		Ledger::pointer warm = boost::make_shared<Ledger>(false, boost::ref(*parent));
+		LedgerConsensus::applyTransactions(set, warm, warm, warmFailed, false);
+		TransactionEngine::setTimer(this);
+	}
+
+	Ledger::pointer replayed = boost::make_shared<Ledger>(false, boost::ref(*parent));
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	LedgerConsensus::applyTransactions(set, replayed, replayed, failedTransactions, false);
+	replayed->updateSkipList();
+	applyMicroseconds += (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+
+	int count = 0;
+	SHAMap::ref txMap = stored->peekTransactionMap();
+	for (SHAMapItem::pointer item = txMap->peekFirstItem(); !!item; item = txMap->peekNextItem(item->getTag()))
+		++count;
+	transactions += count;
+
+	parent = stored;
+
+	bool stateMatch	= replayed->peekAccountStateMap()->getHash() == stored->getAccountHash();
+	bool txMatch	= replayed->peekTransactionMap()->getHash() == stored->getTransHash();
+	bool coinsMatch	= replayed->getTotalCoins() == stored->getTotalCoins();
+
+	if (!stateMatch || !txMatch || !coinsMatch)
+	{
+		std::cout << "Ledger " << seq << " does not match:"
+			<< (stateMatch ? "" : " state") << (txMatch ? "" : " transactions/metadata")
+			<< (coinsMatch ? "" : " coins") << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int LedgerReplay::run()
+{
+	int transactions = 0, mismatches = 0;
+	uint64 applyMicroseconds = 0;
+
+	Ledger::pointer parent;
+
+	for (uint32 seq = mFirst; seq <= mLast; ++seq)
+	{
+		try
+		{
+			if (!replayLedger(parent, seq, transactions, applyMicroseconds))
+				++mismatches;
+		}
+		catch (SHAMapMissingNode& mn)
+		{
+			std::cout << "Ledger " << seq << " is missing nodes: " << mn << std::endl;
+			parent.reset();
+			++mismatches;
+		}
+		catch (std::exception& e)
+		{
+			std::cout << "Ledger " << seq << " throws: " << e.what() << std::endl;
+			parent.reset();
+			++mismatches;
+		}
+	}
+
+	TransactionEngine::setTimer(NULL);
+
+	double seconds = applyMicroseconds / 1000000.0;
+	std::cout << boost::str(boost::format("Replayed ledgers %d-%d: %d transactions in %.3fs, %.0f tx/s, %d mismatched")
+		% mFirst % mLast % transactions % seconds % ((seconds > 0) ? (transactions / seconds) : 0.0) % mismatches)
+		<< std::endl;
+
+	boost::mutex::scoped_lock sl(mLock);
+	typedef std::map<TransactionType, LatencyHistogram*>::value_type type_hist_pair;
+	std::cout << boost::str(boost::format("%-20s %8s %8s %8s %8s %8s %8s")
+		% "microseconds" % "count" % "mean" % "p50<=" % "p90<=" % "p99<=" % "max") << std::endl;
+	BOOST_FOREACH(const type_hist_pair& it, mExecuted)
+		printLatency(getTypeName(it.first), *it.second);
+	printLatency("state write+hash", mWritten);
+	std::cout << boost::str(boost::format("State write and rehash: %.3fs of %.3fs")
+		% (mWritten.getSnapshot().total / 1000000.0) % seconds) << std::endl;
+
+	return mismatches ? 1 : 0;
+}
+
+// vim:ts=4
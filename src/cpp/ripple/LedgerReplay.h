@@ -0,0 +1,45 @@
+#ifndef __LEDGERREPLAY__
+#define __LEDGERREPLAY__
+
+#include <string>
+#include <map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include "types.h"
+#include "Ledger.h"
+#include "TransactionEngine.h"
+#include "Metrics.h"
+
+// Applies stored ledgers' transaction sets again, the way a ledger close does, against each parent's state.
+// Checks the result against the stored ledger and reports how fast it went.
+class LedgerReplay : public TransactionTimer
+{
+protected:
+	uint32								mFirst, mLast;
+	bool								mValid;
+
+	boost::mutex						mLock;
+	std::map<TransactionType, LatencyHistogram*>	mExecuted;		// the histograms belong to Metrics
+	LatencyHistogram&					mWritten;
+
+	bool replayLedger(Ledger::pointer& parent, uint32 seq, int& transactions, uint64& applyMicroseconds);
+	static SHAMap::pointer getTransactionSet(Ledger::ref ledger);
+	static std::string getTypeName(TransactionType type);
+	static void printLatency(const std::string& name, const LatencyHistogram& histogram);
+
+public:
+	LedgerReplay(const std::string& range);		// first[-last]
+
+	bool isValid() const						{ return mValid; }
+
+	void setup();								// configure the server to load the parent of the first ledger
+	int run();									// returns the process exit code
+
+	virtual void executed(TransactionType type, int microseconds);
+	virtual void written(int microseconds);
+};
+
+#endif
+// vim:ts=4
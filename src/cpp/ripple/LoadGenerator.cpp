@@ -0,0 +1,493 @@
+#include "LoadGenerator.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/function.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+
+#include "CallRPC.h"
+#include "Config.h"
+#include "SerializedTransaction.h"
+#include "Log.h"
+#include "utils.h"
+
+#define LOADGEN_FUND_XRP		100000	// Given to each account, leaves room for many offers.
+#define LOADGEN_TRUST_USD		1000000
+#define LOADGEN_ISSUE_USD		10000
+#define LOADGEN_TICK_MS			10		// How often to catch up with the target rate.
+#define LOADGEN_CLOSE_MS		1000	// How often to close a ledger while under load.
+
+// The mix of load, the rest are trust line changes.
+#define LOADGEN_PAYMENT_PCT		60
+#define LOADGEN_OFFER_PCT		25
+
+SETUP_LOG();
+
+LoadGenerator::LoadGenerator(const std::string& params) :
+	mAccounts(0), mRate(0), mSeconds(0), mValid(false),
+	mSubmitTimer(mIOService), mCloseTimer(mIOService), mStopping(false), mClosing(false), mCurrentLedger(0),
+	mSubmitted(0), mSucceeded(0), mFailed(0), mErrors(0)
+{
+	std::vector<std::string> fields;
+	std::string::size_type start = 0, comma;
+	while ((comma = params.find(',', start)) != std::string::npos)
+	{
+		fields.push_back(params.substr(start, comma - start));
+		start = comma + 1;
+	}
+	fields.push_back(params.substr(start));
+
+	try
+	{
+		if (fields.size() == 3)
+		{
+			mAccounts	= boost::lexical_cast<int>(fields[0]);
+			mRate		= boost::lexical_cast<int>(fields[1]);
+			mSeconds	= boost::lexical_cast<int>(fields[2]);
+			mValid		= (mAccounts >= 2) && (mRate > 0) && (mSeconds > 0);
+		}
+	}
+	catch (boost::bad_lexical_cast&)
+	{
+		mValid = false;
+	}
+}
+
+void LoadGenerator::makeAccount(LoadAccount& account, const std::string& passPhrase)
+{
+	RippleAddress	naSeed		= RippleAddress::createSeedGeneric(passPhrase);
+	RippleAddress	naGenerator	= RippleAddress::createGeneratorPublic(naSeed);
+
+	account.mPublic		= RippleAddress::createAccountPublic(naGenerator, 0);
+	account.mPrivate	= RippleAddress::createAccountPrivate(naGenerator, naSeed, 0);
+	account.mAccountID.setAccountID(account.mPublic.getAccountID());
+	account.mSeq		= 1;
+	account.mBusy		= false;
+	account.mStale		= false;
+}
+
+Json::Value LoadGenerator::getLatencyJson(std::vector<int>& latencies)
+{
+	Json::Value jvResult(Json::objectValue);
+
+	jvResult["count"] = static_cast<int>(latencies.size());
+	if (latencies.empty())
+		return jvResult;
+
+	std::sort(latencies.begin(), latencies.end());
+
+	uint64 total = 0;
+	BOOST_FOREACH(int latency, latencies)
+		total += latency;
+
+	jvResult["mean"]	= static_cast<int>(total / latencies.size());
+	jvResult["p50"]		= latencies[(latencies.size() - 1) * 50 / 100];
+	jvResult["p90"]		= latencies[(latencies.size() - 1) * 90 / 100];
+	jvResult["p99"]		= latencies[(latencies.size() - 1) * 99 / 100];
+	jvResult["max"]		= latencies.back();
+
+	return jvResult;
+}
+
+std::string LoadGenerator::sign(LoadAccount& account, Json::Value txJSON)
+{ // Sign here, so the server only checks
+	txJSON["Account"]	= account.mAccountID.humanAccountID();
+	txJSON["Sequence"]	= account.mSeq++;
+	txJSON["Fee"]		= static_cast<int>(theConfig.FEE_DEFAULT);
+	txJSON["Flags"]		= 0;
+
+	std::auto_ptr<STObject> sopTrans = STObject::parseJson(txJSON);
+	sopTrans->setFieldVL(sfSigningPubKey, account.mPublic.getAccountPublic());
+
+	SerializedTransaction stpTrans(*sopTrans);
+	stpTrans.sign(account.mPrivate);
+
+	return strHex(stpTrans.getSerializer().peekData());
+}
+
+static void storeReply(Json::Value* jvOutput, const Json::Value& jvReply)
+{
+	*jvOutput = jvReply;
+}
+
+Json::Value LoadGenerator::call(const std::string& strMethod, const Json::Value& jvRequest)
+{ // Blocking call, for setting up
+	Json::Value jvParams(Json::arrayValue);
+	Json::Value jvReply;
+
+	jvParams.append(jvRequest);
+
+	boost::asio::io_service isService;
+	callRPC(isService, theConfig.RPC_IP, theConfig.RPC_PORT, theConfig.RPC_USER, theConfig.RPC_PASSWORD,
+		"", strMethod, jvParams, false, boost::bind(storeReply, &jvReply, _1));
+	isService.run();
+
+	return jvReply["result"]["result"];
+}
+
+bool LoadGenerator::submitSync(LoadAccount& account, const Json::Value& txJSON)
+{
+	Json::Value jvRequest(Json::objectValue);
+	jvRequest["tx_blob"] = sign(account, txJSON);
+
+	Json::Value jvResult = call("submit", jvRequest);
+	if (jvResult["engine_result"].asString() != "tesSUCCESS")
+	{
+		std::cerr << "Setup transaction failed: " << jvResult << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool LoadGenerator::closeSync()
+{
+	Json::Value jvRequest(Json::objectValue);
+
+	if (!theConfig.RPC_ADMIN_USER.empty())
+		jvRequest["admin_user"]		= theConfig.RPC_ADMIN_USER;
+	if (!theConfig.RPC_ADMIN_PASSWORD.empty())
+		jvRequest["admin_password"]	= theConfig.RPC_ADMIN_PASSWORD;
+
+	Json::Value jvResult = call("ledger_accept", jvRequest);
+	if (!jvResult.isMember("ledger_current_index"))
+	{
+		std::cerr << "Could not close a ledger, the server must be stand-alone: " << jvResult << std::endl;
+		return false;
+	}
+	mCurrentLedger = jvResult["ledger_current_index"].asUInt();
+	return true;
+}
+
+int LoadGenerator::countTransactions(uint32 firstLedger, uint32 lastLedger)
+{ // Transactions that made it into closed ledgers, what the server actually sustained
+	int count = 0;
+
+	for (uint32 seq = firstLedger; seq <= lastLedger; ++seq)
+	{
+		Json::Value jvRequest(Json::objectValue);
+		jvRequest["ledger"]			= seq;
+		jvRequest["transactions"]	= true;
+
+		Json::Value jvLedger = call("ledger", jvRequest)["ledger"];
+		if (jvLedger.isMember("transactions"))
+			count += jvLedger["transactions"].size();
+		else
+		{
+			cLog(lsDEBUG) << "Ledger " << seq << " not found: " << jvLedger;
+			++mErrors;
+		}
+	}
+
+	return count;
+}
+
+Json::Value LoadGenerator::amountUSD(int value)
+{
+	Json::Value jvAmount(Json::objectValue);
+
+	jvAmount["currency"]	= "USD";
+	jvAmount["issuer"]		= mLoad[0].mAccountID.humanAccountID();
+	jvAmount["value"]		= boost::lexical_cast<std::string>(value);
+
+	return jvAmount;
+}
+
+bool LoadGenerator::setup()
+{ // Fund the accounts, give each a USD trust line to the gateway and some USD
+	makeAccount(mMaster, "masterpassphrase");
+
+	Json::Value jvInfo(Json::objectValue);
+	jvInfo["ident"] = mMaster.mAccountID.humanAccountID();
+	Json::Value jvMaster = call("account_info", jvInfo);
+	if (!jvMaster.isMember("account_data"))
+	{
+		std::cerr << "Master account not found, start the server with --standalone --start: " << jvMaster << std::endl;
+		return false;
+	}
+	mMaster.mSeq = jvMaster["account_data"]["Sequence"].asUInt();
+
+	mLoad.resize(mAccounts);
+	for (int i = 0; i < mAccounts; ++i)
+	{
+		makeAccount(mLoad[i], str(boost::format("loadgen%d") % i));
+
+		Json::Value txJSON(Json::objectValue);
+		txJSON["TransactionType"]	= "Payment";
+		txJSON["Destination"]		= mLoad[i].mAccountID.humanAccountID();
+		txJSON["Amount"]			= boost::lexical_cast<std::string>(uint64(LOADGEN_FUND_XRP) * SYSTEM_CURRENCY_PARTS);
+		if (!submitSync(mMaster, txJSON))
+			return false;
+	}
+	if (!closeSync())
+		return false;
+
+	for (int i = 1; i < mAccounts; ++i)
+	{
+		Json::Value txJSON(Json::objectValue);
+		txJSON["TransactionType"]	= "TrustSet";
+		txJSON["LimitAmount"]		= amountUSD(LOADGEN_TRUST_USD);
+		if (!submitSync(mLoad[i], txJSON))
+			return false;
+	}
+	if (!closeSync())
+		return false;
+
+	for (int i = 1; i < mAccounts; ++i)
+	{
+		Json::Value txJSON(Json::objectValue);
+		txJSON["TransactionType"]	= "Payment";
+		txJSON["Destination"]		= mLoad[i].mAccountID.humanAccountID();
+		txJSON["Amount"]			= amountUSD(LOADGEN_ISSUE_USD);
+		if (!submitSync(mLoad[0], txJSON))
+			return false;
+	}
+	return closeSync();
+}
+
+Json::Value LoadGenerator::makeLoadTransaction(int account)
+{
+	Json::Value txJSON(Json::objectValue);
+	int kind = rand() % 100;
+
+	if ((account == 0) || (kind < LOADGEN_PAYMENT_PCT))
+	{ // XRP to anyone else
+		int destination = (account + 1 + (rand() % (mAccounts - 1))) % mAccounts;
+
+		txJSON["TransactionType"]	= "Payment";
+		txJSON["Destination"]		= mLoad[destination].mAccountID.humanAccountID();
+		txJSON["Amount"]			= boost::lexical_cast<std::string>((1 + (rand() % 10)) * SYSTEM_CURRENCY_PARTS);
+	}
+	else if (kind < (LOADGEN_PAYMENT_PCT + LOADGEN_OFFER_PCT))
+	{ // both sides of one USD/XRP book at one price, so offers cross
+		int usd = 1 + (rand() % 10);
+		Json::Value jvXRP(boost::lexical_cast<std::string>(uint64(usd) * 10 * SYSTEM_CURRENCY_PARTS));
+
+		txJSON["TransactionType"]	= "OfferCreate";
+		if (rand() % 2)
+		{
+			txJSON["TakerPays"]		= amountUSD(usd);
+			txJSON["TakerGets"]		= jvXRP;
+		}
+		else
+		{
+			txJSON["TakerPays"]		= jvXRP;
+			txJSON["TakerGets"]		= amountUSD(usd);
+		}
+	}
+	else
+	{
+		txJSON["TransactionType"]	= "TrustSet";
+		txJSON["LimitAmount"]		= amountUSD(LOADGEN_TRUST_USD + (rand() % LOADGEN_TRUST_USD));
+	}
+
+	return txJSON;
+}
+
+void LoadGenerator::submit(int account)
+{
+	LoadAccount& loadAccount = mLoad[account];
+	Pending::pointer pending = boost::make_shared<Pending>(boost::ref(loadAccount.mBusy), &loadAccount.mStale);
+
+	Json::Value jvRequest(Json::objectValue);
+	Json::Value jvParams(Json::arrayValue);
+
+	jvRequest["tx_blob"] = sign(loadAccount, makeLoadTransaction(account));
+	jvParams.append(jvRequest);
+
+	++mSubmitted;
+
+	callRPC(mIOService, theConfig.RPC_IP, theConfig.RPC_PORT, theConfig.RPC_USER, theConfig.RPC_PASSWORD,
+		"", "submit", jvParams, false,
+		boost::bind(&LoadGenerator::submitted, this, account, pending,
+			boost::posix_time::microsec_clock::universal_time(), _1));
+}
+
+void LoadGenerator::submitted(int account, Pending::pointer pending, boost::posix_time::ptime start,
+	const Json::Value& jvReply)
+{
+	mSubmitLatency.push_back((boost::posix_time::microsec_clock::universal_time() - start).total_microseconds());
+	pending->replied();
+
+	std::string result = jvReply["result"]["result"]["engine_result"].asString();
+
+	if (result == "tesSUCCESS")
+		++mSucceeded;
+	else
+	{
+		++mFailed;
+		if (result.compare(0, 3, "tec") != 0)
+			mLoad[account].mStale = true;	// held or rejected, the server knows whether it took the sequence
+		cLog(lsDEBUG) << "Load transaction: " << result;
+	}
+}
+
+void LoadGenerator::resync(int account)
+{
+	LoadAccount& loadAccount = mLoad[account];
+	Pending::pointer pending = boost::make_shared<Pending>(boost::ref(loadAccount.mBusy), &loadAccount.mStale);
+
+	Json::Value jvRequest(Json::objectValue);
+	Json::Value jvParams(Json::arrayValue);
+
+	jvRequest["ident"] = loadAccount.mAccountID.humanAccountID();
+	jvParams.append(jvRequest);
+
+	callRPC(mIOService, theConfig.RPC_IP, theConfig.RPC_PORT, theConfig.RPC_USER, theConfig.RPC_PASSWORD,
+		"", "account_info", jvParams, false,
+		boost::bind(&LoadGenerator::resynced, this, account, pending, _1));
+}
+
+void LoadGenerator::resynced(int account, Pending::pointer pending, const Json::Value& jvReply)
+{
+	const Json::Value& jvData = jvReply["result"]["result"]["account_data"];
+
+	if (jvData.isMember("Sequence"))
+	{
+		pending->replied();
+		mLoad[account].mSeq		= jvData["Sequence"].asUInt();
+		mLoad[account].mStale	= false;
+	}
+	else
+		++mErrors;
+}
+
+void LoadGenerator::onSubmitTimer(const boost::system::error_code& ecResult)
+{
+	if (ecResult || mStopping)
+		return;
+
+	boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - mStart;
+	if (elapsed.total_seconds() >= mSeconds)
+	{
+		mStopping = true;
+		mCloseTimer.cancel();
+		return;
+	}
+
+	// Catch up with the target rate, as far as there are accounts with nothing in flight
+	int due = static_cast<int>(elapsed.total_milliseconds() * mRate / 1000) - mSubmitted;
+	for (int i = 0, first = rand() % mAccounts; (due > 0) && (i < mAccounts); ++i)
+	{
+		int account = (first + i) % mAccounts;
+		if (mLoad[account].mBusy)
+			continue;
+
+		if (mLoad[account].mStale)
+			resync(account);
+		else
+		{
+			submit(account);
+			--due;
+		}
+	}
+
+	mSubmitTimer.expires_from_now(boost::posix_time::milliseconds(LOADGEN_TICK_MS));
+	mSubmitTimer.async_wait(boost::bind(&LoadGenerator::onSubmitTimer, this, boost::asio::placeholders::error));
+}
+
+void LoadGenerator::onCloseTimer(const boost::system::error_code& ecResult)
+{
+	if (ecResult || mStopping)
+		return;
+
+	if (!mClosing)
+	{
+		Json::Value jvRequest(Json::objectValue);
+		Json::Value jvParams(Json::arrayValue);
+
+		if (!theConfig.RPC_ADMIN_USER.empty())
+			jvRequest["admin_user"]		= theConfig.RPC_ADMIN_USER;
+		if (!theConfig.RPC_ADMIN_PASSWORD.empty())
+			jvRequest["admin_password"]	= theConfig.RPC_ADMIN_PASSWORD;
+		jvParams.append(jvRequest);
+
+		Pending::pointer pending = boost::make_shared<Pending>(boost::ref(mClosing), static_cast<bool*>(NULL));
+		callRPC(mIOService, theConfig.RPC_IP, theConfig.RPC_PORT, theConfig.RPC_USER, theConfig.RPC_PASSWORD,
+			"", "ledger_accept", jvParams, false,
+			boost::bind(&LoadGenerator::closed, this, pending, boost::posix_time::microsec_clock::universal_time(),
+				_1));
+	}
+
+	mCloseTimer.expires_from_now(boost::posix_time::milliseconds(LOADGEN_CLOSE_MS));
+	mCloseTimer.async_wait(boost::bind(&LoadGenerator::onCloseTimer, this, boost::asio::placeholders::error));
+}
+
+void LoadGenerator::closed(Pending::pointer pending, boost::posix_time::ptime start, const Json::Value& jvReply)
+{
+	pending->replied();
+	if (jvReply["result"]["result"].isMember("ledger_current_index"))
+		mCloseLatency.push_back((boost::posix_time::microsec_clock::universal_time() - start).total_microseconds());
+	else
+		++mErrors;
+}
+
+int LoadGenerator::run()
+{
+	theConfig.QUIET = true;		// the RPC client announces every connection otherwise
+
+	boost::posix_time::ptime setupStart = boost::posix_time::microsec_clock::universal_time();
+	try
+	{
+		if (!setup())
+			return 1;
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Setup failed: " << e.what() << std::endl;
+		return 1;
+	}
+	mStart = boost::posix_time::microsec_clock::universal_time();
+	uint32 firstLedger = mCurrentLedger;
+
+	mSubmitTimer.expires_from_now(boost::posix_time::milliseconds(LOADGEN_TICK_MS));
+	mSubmitTimer.async_wait(boost::bind(&LoadGenerator::onSubmitTimer, this, boost::asio::placeholders::error));
+	mCloseTimer.expires_from_now(boost::posix_time::milliseconds(LOADGEN_CLOSE_MS));
+	mCloseTimer.async_wait(boost::bind(&LoadGenerator::onCloseTimer, this, boost::asio::placeholders::error));
+
+	for (;;)
+	{ // a failed request throws out of its handler, count it and carry on
+		try
+		{
+			mIOService.run();
+			break;
+		}
+		catch (std::exception& e)
+		{
+			++mErrors;
+			cLog(lsDEBUG) << "Load request failed: " << e.what();
+		}
+	}
+
+	boost::posix_time::ptime end = boost::posix_time::microsec_clock::universal_time();
+	bool bClosed = closeSync();
+	double seconds = (end - mStart).total_milliseconds() / 1000.0;
+	int committed = bClosed ? countTransactions(firstLedger, mCurrentLedger - 1) : 0;
+
+	Json::Value jvResult(Json::objectValue);
+	jvResult["accounts"]		= mAccounts;
+	jvResult["target_tps"]		= mRate;
+	jvResult["setup_seconds"]	= (mStart - setupStart).total_milliseconds() / 1000.0;
+	jvResult["seconds"]			= seconds;
+	jvResult["submitted"]		= mSubmitted;
+	jvResult["succeeded"]		= mSucceeded;
+	jvResult["committed"]		= committed;
+	jvResult["failed"]			= mFailed;
+	jvResult["errors"]			= mErrors;
+	jvResult["submit_tps"]		= (seconds > 0) ? (mSubmitted / seconds) : 0.0;
+	jvResult["accepted_submit_tps"]	= (seconds > 0) ? (mSucceeded / seconds) : 0.0;
+	jvResult["sustained_tps"]	= (seconds > 0) ? (committed / seconds) : 0.0;
+	jvResult["ledgers_closed"]	= static_cast<int>(mCloseLatency.size());
+	jvResult["submit_latency_us"]	= getLatencyJson(mSubmitLatency);
+	jvResult["close_latency_us"]	= getLatencyJson(mCloseLatency);
+
+	std::cout << jvResult.toStyledString();
+
+	return (bClosed && !mErrors) ? 0 : 1;
+}
+
+// vim:ts=4
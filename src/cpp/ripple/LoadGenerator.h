@@ -0,0 +1,102 @@
+#ifndef __LOADGENERATOR__
+#define __LOADGENERATOR__
+
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "../json/value.h"
+
+#include "types.h"
+#include "RippleAddress.h"
+
+// Drives a stand-alone server over JSON-RPC: funds accounts with trust lines in a fresh ledger, then submits
+// locally signed payments, offers and trust line changes at a target rate while closing ledgers, and reports
+// what it saw as JSON.
+class LoadGenerator
+{
+protected:
+	class LoadAccount
+	{
+	public:
+		RippleAddress	mAccountID, mPublic, mPrivate;
+		uint32			mSeq;
+		bool			mBusy;			// one transaction in flight per account keeps sequences in order
+		bool			mStale;			// the last transaction may or may not have used mSeq, ask the server
+	};
+
+	class Pending
+	{ // Sets a flag while a request is in flight. Bound into the reply handler, so the flag clears however the
+	  // request ends. A request that never got its reply marks what it was for as lost.
+	public:
+		typedef boost::shared_ptr<Pending> pointer;
+
+		Pending(bool& busy, bool* lost) : mBusy(busy), mLost(lost), mReplied(false)	{ mBusy = true; }
+		~Pending()
+		{
+			mBusy = false;
+			if (!mReplied && mLost)
+				*mLost = true;
+		}
+
+		void replied()		{ mReplied = true; }
+
+	protected:
+		bool&	mBusy;
+		bool*	mLost;
+		bool	mReplied;
+	};
+
+	int								mAccounts, mRate, mSeconds;
+	bool							mValid;
+
+	boost::asio::io_service			mIOService;
+	boost::asio::deadline_timer		mSubmitTimer;
+	boost::asio::deadline_timer		mCloseTimer;
+	boost::posix_time::ptime		mStart;
+	bool							mStopping;
+	bool							mClosing;
+
+	LoadAccount						mMaster;
+	std::vector<LoadAccount>		mLoad;		// the first is the gateway that issues USD
+
+	uint32							mCurrentLedger;	// the open ledger after our last close
+
+	int								mSubmitted, mSucceeded, mFailed, mErrors;
+	std::vector<int>				mSubmitLatency, mCloseLatency;	// microseconds
+
+	static void makeAccount(LoadAccount& account, const std::string& passPhrase);
+	static Json::Value getLatencyJson(std::vector<int>& latencies);
+
+	std::string sign(LoadAccount& account, Json::Value txJSON);
+	Json::Value call(const std::string& strMethod, const Json::Value& jvRequest);
+	bool submitSync(LoadAccount& account, const Json::Value& txJSON);
+	bool closeSync();
+	int countTransactions(uint32 firstLedger, uint32 lastLedger);
+	Json::Value amountUSD(int value);
+
+	Json::Value makeLoadTransaction(int account);
+	void submit(int account);
+	void submitted(int account, Pending::pointer pending, boost::posix_time::ptime start,
+		const Json::Value& jvReply);
+	void resync(int account);
+	void resynced(int account, Pending::pointer pending, const Json::Value& jvReply);
+	void onSubmitTimer(const boost::system::error_code& ecResult);
+	void onCloseTimer(const boost::system::error_code& ecResult);
+	void closed(Pending::pointer pending, boost::posix_time::ptime start, const Json::Value& jvReply);
+
+	bool setup();
+
+public:
+	LoadGenerator(const std::string& params);	// accounts,rate,seconds
+
+	bool isValid() const						{ return mValid; }
+
+	int run();									// returns the process exit code
+};
+
+#endif
+// vim:ts=4
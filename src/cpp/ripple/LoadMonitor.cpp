@@ -69,6 +69,13 @@ void LoadMonitor::addCountAndLatency(int counts, int latency)
 		mLatencyMSPeak = lp;
 }
 
+void LoadMonitor::addEvent(int counts, uint64 microseconds)
+{
+	if (mHistogram)
+		mHistogram->add(microseconds);
+	addCountAndLatency(counts, static_cast<int>(microseconds / 1000));
+}
+
 bool LoadMonitor::isOver()
 {
 	boost::mutex::scoped_lock sl(mLock);
@@ -7,6 +7,7 @@
 #include <boost/shared_ptr.hpp>
 
 #include "types.h"
+#include "Metrics.h"
 extern int upTime();
 
 // Monitors load levels and response times
@@ -22,17 +23,21 @@ protected:
 	uint64				mTargetLatencyPk;
 	int					mLastUpdate;
 	boost::mutex		mLock;
+	LatencyHistogram*	mHistogram;
 
 	void update();
 
 public:
 	LoadMonitor() : mCounts(0), mLatencyEvents(0), mLatencyMSAvg(0), mLatencyMSPeak(0),
-		mTargetLatencyAvg(0), mTargetLatencyPk(0)
+		mTargetLatencyAvg(0), mTargetLatencyPk(0), mHistogram(NULL)
 	{ mLastUpdate = upTime(); }
 
 	void addCount(int counts);
 	void addLatency(int latency);
 	void addCountAndLatency(int counts, int latency);
+	void addEvent(int counts, uint64 microseconds);
+
+	void setHistogram(LatencyHistogram& histogram)	{ mHistogram = &histogram; }
 
 	void setTargetLatency(uint64 avg, uint64 pk)
 	{
@@ -60,12 +65,12 @@ protected:
 	LoadMonitor&				mMonitor;
 	bool						mRunning;
 	int							mCount;
-	boost::posix_time::ptime	mStartTime;
+	uint64						mStartTime;
 
 public:
 	LoadEvent(LoadMonitor& monitor, bool shouldStart, int count) : mMonitor(monitor), mRunning(false), mCount(count)
 	{
-		mStartTime = boost::posix_time::microsec_clock::universal_time();
+		mStartTime = LatencyHistogram::now();
 		if (shouldStart)
 			start();
 	}
@@ -79,15 +84,14 @@ public:
 	void start()
 	{ // okay to call if already started
 		mRunning = true;
-		mStartTime = boost::posix_time::microsec_clock::universal_time();
+		mStartTime = LatencyHistogram::now();
 	}
 
 	void stop()
 	{
 		assert(mRunning);
 		mRunning = false;
-		mMonitor.addCountAndLatency(mCount,
-			static_cast<int>((boost::posix_time::microsec_clock::universal_time() - mStartTime).total_milliseconds()));
+		mMonitor.addEvent(mCount, LatencyHistogram::now() - mStartTime);
 	}
 };
 
@@ -0,0 +1,81 @@
+#ifndef LOCKFREEQUEUE__H
+#define LOCKFREEQUEUE__H
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+// A queue any number of threads can push to without a lock. One consumer at a time
+// takes everything pushed so far, in the order it was pushed.
+// Pushes go onto a linked stack with a compare and swap, the consumer swaps out the
+// whole stack and reverses it, so no node is ever reused while another thread holds it.
+
+template <typename T> class LockFreeQueue : private boost::noncopyable
+{
+protected:
+	struct Node
+	{
+		T		value;
+		Node*	next;
+
+		Node(const T& v) : value(v), next(NULL) { ; }
+	};
+
+	boost::atomic<Node*>	mHead;			// most recent push first
+
+public:
+	LockFreeQueue() : mHead(NULL)	{ ; }
+	~LockFreeQueue()				{ clear(); }
+
+	void push(const T& value)
+	{
+		Node* node = new Node(value);
+		Node* head = mHead.load(boost::memory_order_relaxed);
+
+		do
+			node->next = head;
+		while (!mHead.compare_exchange_weak(head, node));
+	}
+
+	bool empty() const
+	{
+		return mHead.load() == NULL;
+	}
+
+	// Append everything pushed so far to a container with push_back, oldest first
+	template <typename C> void popAll(C& out)
+	{
+		Node* node = mHead.exchange(NULL);
+		Node* fifo = NULL;
+
+		while (node != NULL)
+		{
+			Node* next = node->next;
+			node->next = fifo;
+			fifo = node;
+			node = next;
+		}
+
+		while (fifo != NULL)
+		{
+			Node* next = fifo->next;
+			out.push_back(fifo->value);
+			delete fifo;
+			fifo = next;
+		}
+	}
+
+	void clear()
+	{
+		Node* node = mHead.exchange(NULL);
+
+		while (node != NULL)
+		{
+			Node* next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+};
+
+#endif
+// vim:ts=4
@@ -0,0 +1,282 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <map>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/test/unit_test.hpp>
+
+#if defined(WIN32) || defined(__APPLE__)
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#else
+#include <time.h>
+#endif
+
+#define METRICS_PREFIX	"rippled_"
+
+namespace
+{
+	struct MetricsEntry
+	{
+		std::string			name;
+		std::string			label;
+		std::string			value;
+		LatencyHistogram*	histogram;
+	};
+
+	// Keyed by name, label and value, so entries with one name are together
+	typedef std::map<std::string, MetricsEntry> MetricsMap;
+
+	boost::mutex	sMetricsLock;
+	MetricsMap		sMetrics;
+	boost::mutex	sFamilyLock;
+
+	const double	sQuantiles[] = { 50.0, 90.0, 99.0, 99.9, 100.0 };
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+	for (int i = 0; i < sBuckets; ++i)
+		mBuckets[i].store(0, boost::memory_order_relaxed);
+	mTotal.store(0, boost::memory_order_relaxed);
+	mMax.store(0, boost::memory_order_relaxed);
+}
+
+int LatencyHistogram::getBucket(uint64 microseconds)
+{
+	if (microseconds >= (1ull << sMaxBits))
+		microseconds = (1ull << sMaxBits) - 1;
+
+	if (microseconds < sSubBuckets)
+		return static_cast<int>(microseconds);
+
+	int bits = sSubBits;
+	while ((microseconds >> (bits + 1)) != 0)
+		++bits;
+
+	int shift = bits - sSubBits;
+	return (shift + 1) * sSubBuckets + static_cast<int>(microseconds >> shift) - sSubBuckets;
+}
+
+uint64 LatencyHistogram::getBucketTop(int bucket)
+{
+	if (bucket < sSubBuckets)
+		return bucket;
+
+	int shift = (bucket / sSubBuckets) - 1;
+	uint64 mantissa = sSubBuckets + (bucket % sSubBuckets);
+	return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::add(uint64 microseconds)
+{
+	mBuckets[getBucket(microseconds)].fetch_add(1, boost::memory_order_relaxed);
+	mTotal.fetch_add(microseconds, boost::memory_order_relaxed);
+
+	uint64 max = mMax.load(boost::memory_order_relaxed);
+	while ((microseconds > max) && !mMax.compare_exchange_weak(max, microseconds, boost::memory_order_relaxed))
+		;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::getSnapshot() const
+{ // the parts are read one at a time, so a snapshot taken under load can be off by the events in flight
+	Snapshot ret;
+
+	ret.buckets.resize(sBuckets);
+	ret.count = 0;
+	for (int i = 0; i < sBuckets; ++i)
+	{
+		ret.buckets[i] = mBuckets[i].load(boost::memory_order_relaxed);
+		ret.count += ret.buckets[i];
+	}
+	ret.total	= mTotal.load(boost::memory_order_relaxed);
+	ret.max		= mMax.load(boost::memory_order_relaxed);
+
+	return ret;
+}
+
+uint64 LatencyHistogram::Snapshot::getPercentile(double percent) const
+{
+	if (count == 0)
+		return 0;
+
+	uint64 target = static_cast<uint64>(count * percent / 100.0 + 0.5);
+	if (target == 0)
+		target = 1;
+	else if (target >= count)
+		return max;
+
+	uint64 seen = 0;
+	for (int i = 0; i < sBuckets; ++i)
+	{
+		seen += buckets[i];
+		if (seen >= target)
+			return std::min(getBucketTop(i), max);
+	}
+	return max;
+}
+
+uint64 LatencyHistogram::now()
+{
+#if defined(WIN32) || defined(__APPLE__)
+	static const boost::posix_time::ptime epoch(boost::gregorian::date(2000, 1, 1));
+
+	return (boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds();
+#else
+	timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+void LatencyFamily::create()
+{
+	boost::mutex::scoped_lock sl(sFamilyLock);
+
+	if (mReady.load(boost::memory_order_relaxed))
+		return;
+
+	mHistograms.reserve(mSize);
+	for (int i = 0; i < mSize; ++i)
+	{
+		std::string value = mLabelFunc(i);
+		if (value.empty())
+			value = boost::lexical_cast<std::string>(i);
+		mHistograms.push_back(&Metrics::get(mName, mLabel, value));
+	}
+
+	mReady.store(true, boost::memory_order_release);
+}
+
+LatencyHistogram& LatencyFamily::get(int index)
+{
+	if (!mReady.load(boost::memory_order_acquire))
+		create();
+
+	if ((index < 0) || (index >= mSize))
+		index = mSize - 1;
+
+	return *mHistograms[index];
+}
+
+LatencyHistogram& Metrics::get(const std::string& name, const std::string& label, const std::string& value)
+{
+	std::string key = name;
+	key.push_back('\0');
+	key.append(label);
+	key.push_back('\0');
+	key.append(value);
+
+	boost::mutex::scoped_lock sl(sMetricsLock);
+
+	MetricsMap::iterator it = sMetrics.find(key);
+	if (it == sMetrics.end())
+	{
+		MetricsEntry entry;
+		entry.name		= name;
+		entry.label		= label;
+		entry.value		= value;
+		entry.histogram	= new LatencyHistogram();	// never freed, see Metrics.h
+		it = sMetrics.insert(std::make_pair(key, entry)).first;
+	}
+
+	return *it->second.histogram;
+}
+
+Json::Value Metrics::getJson()
+{
+	Json::Value ret(Json::objectValue);
+
+	boost::mutex::scoped_lock sl(sMetricsLock);
+
+	BOOST_FOREACH(const MetricsMap::value_type& it, sMetrics)
+	{
+		const MetricsEntry& entry = it.second;
+		LatencyHistogram::Snapshot snap = entry.histogram->getSnapshot();
+
+		if (snap.count == 0)
+			continue;
+
+		Json::Value jvEntry(Json::objectValue);
+		jvEntry["count"]	= boost::lexical_cast<std::string>(snap.count);
+		jvEntry["mean"]		= static_cast<Json::UInt>(snap.total / snap.count);
+		jvEntry["p50"]		= static_cast<Json::UInt>(snap.getPercentile(50.0));
+		jvEntry["p90"]		= static_cast<Json::UInt>(snap.getPercentile(90.0));
+		jvEntry["p99"]		= static_cast<Json::UInt>(snap.getPercentile(99.0));
+		jvEntry["p999"]		= static_cast<Json::UInt>(snap.getPercentile(99.9));
+		jvEntry["max"]		= static_cast<Json::UInt>(snap.max);
+
+		if (entry.label.empty())
+			ret[entry.name] = jvEntry;
+		else
+			ret[entry.name][entry.value] = jvEntry;
+	}
+
+	return ret;
+}
+
+std::string Metrics::getPrometheus()
+{
+	std::string ret;
+	std::string lastName;
+
+	boost::mutex::scoped_lock sl(sMetricsLock);
+
+	BOOST_FOREACH(const MetricsMap::value_type& it, sMetrics)
+	{
+		const MetricsEntry& entry = it.second;
+		LatencyHistogram::Snapshot snap = entry.histogram->getSnapshot();
+
+		if (snap.count == 0)
+			continue;
+
+		std::string name = METRICS_PREFIX + entry.name + "_microseconds";
+		std::string labels = entry.label.empty() ? "" : (entry.label + "=\"" + entry.value + "\"");
+
+		if (entry.name != lastName)
+		{
+			ret += "# TYPE " + name + " summary\n";
+			lastName = entry.name;
+		}
+
+		BOOST_FOREACH(double quantile, sQuantiles)
+		{
+			ret += boost::str(boost::format("%s{%s%squantile=\"%g\"} %d\n")
+				% name % labels % (labels.empty() ? "" : ",") % (quantile / 100.0) % snap.getPercentile(quantile));
+		}
+
+		std::string suffix = labels.empty() ? "" : ("{" + labels + "}");
+		ret += boost::str(boost::format("%s_sum%s %d\n") % name % suffix % snap.total);
+		ret += boost::str(boost::format("%s_count%s %d\n") % name % suffix % snap.count);
+	}
+
+	return ret;
+}
+
+BOOST_AUTO_TEST_SUITE(Metrics_suite)
+
+BOOST_AUTO_TEST_CASE(LatencyHistogram_test)
+{
+	LatencyHistogram h;
+
+	for (int i = 1; i <= 10000; ++i)
+		h.add(i);
+	h.add(1ull << 40);			// past the last bucket
+
+	LatencyHistogram::Snapshot snap = h.getSnapshot();
+	if (snap.count != 10001)	BOOST_FAIL("LatencyHistogram count");
+	if (snap.max != (1ull << 40))	BOOST_FAIL("LatencyHistogram max");
+
+	uint64 p50 = snap.getPercentile(50.0), p99 = snap.getPercentile(99.0);
+	if ((p50 < 5000) || (p50 > 5000 + 5000 / LatencyHistogram::sSubBuckets))	BOOST_FAIL("LatencyHistogram p50");
+	if ((p99 < 9900) || (p99 > 9900 + 9900 / LatencyHistogram::sSubBuckets))	BOOST_FAIL("LatencyHistogram p99");
+	if (snap.getPercentile(100.0) != snap.max)	BOOST_FAIL("LatencyHistogram p100");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// vim:ts=4
@@ -0,0 +1,106 @@
+#ifndef METRICS__H
+#define METRICS__H
+
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+#include "../json/value.h"
+
+#include "types.h"
+
+// Latency histograms for hot paths, exported by the metrics command and the Prometheus endpoint.
+// Histograms live as long as the process, so callers may keep references to them.
+
+class LatencyHistogram
+{ // HDR style: each power of two of microseconds is split into sSubBuckets linear steps
+public:
+	static const int	sSubBits	= 3;
+	static const int	sSubBuckets	= 1 << sSubBits;			// values are within 1/8 of the bucket they report
+	static const int	sMaxBits	= 36;						// about 19 hours
+	static const int	sBuckets	= (sMaxBits - sSubBits + 1) * sSubBuckets;
+
+	struct Snapshot
+	{
+		uint64					count;
+		uint64					total;
+		uint64					max;
+		std::vector<uint64>		buckets;
+
+		uint64 getPercentile(double percent) const;		// upper bound of the bucket holding it
+	};
+
+protected:
+	boost::atomic<uint64>	mBuckets[sBuckets];
+	boost::atomic<uint64>	mTotal;
+	boost::atomic<uint64>	mMax;
+
+	static int getBucket(uint64 microseconds);
+	static uint64 getBucketTop(int bucket);
+
+public:
+	LatencyHistogram();
+
+	void add(uint64 microseconds);
+	Snapshot getSnapshot() const;
+
+	static uint64 now();					// microseconds from a monotonic clock
+};
+
+class LatencyTimer
+{ // Adds the time from construction to stop or destruction
+protected:
+	LatencyHistogram*	mHistogram;
+	uint64				mStart;
+
+public:
+	LatencyTimer(LatencyHistogram& histogram) : mHistogram(&histogram), mStart(LatencyHistogram::now())	{ ; }
+	~LatencyTimer()							{ stop(); }
+
+	void stop()
+	{
+		if (mHistogram)
+		{
+			mHistogram->add(LatencyHistogram::now() - mStart);
+			mHistogram = NULL;
+		}
+	}
+	void cancel()							{ mHistogram = NULL; }
+};
+
+class LatencyFamily
+{ // One histogram per small integer, such as a message type, found without taking a lock
+public:
+	typedef std::string (*labelFunc)(int);
+
+protected:
+	const char*						mName;
+	const char*						mLabel;
+	int								mSize;
+	labelFunc						mLabelFunc;
+	std::vector<LatencyHistogram*>	mHistograms;
+	boost::atomic<bool>				mReady;
+
+	void create();
+
+public:
+	LatencyFamily(const char* name, const char* label, int size, labelFunc func) :
+		mName(name), mLabel(label), mSize(size), mLabelFunc(func), mReady(false)	{ ; }
+
+	LatencyHistogram& get(int index);		// out of range indexes share the last histogram
+};
+
+class Metrics
+{
+public:
+	// Find or create the histogram for a name and optional label, names are in snake case without units
+	static LatencyHistogram& get(const std::string& name, const std::string& label = "",
+		const std::string& value = "");
+
+	static Json::Value getJson();
+	static std::string getPrometheus();		// text exposition format, one summary per name
+};
+
+#endif
+// vim:ts=4
@@ -0,0 +1,123 @@
+#include "MetricsDoor.h"
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/format.hpp>
+
+#include "Config.h"
+#include "Metrics.h"
+#include "Log.h"
+
+SETUP_LOG();
+
+#define METRICS_MAXIMUM_REQUEST		8192
+#define METRICS_TIMEOUT_SECONDS		10
+
+using namespace boost::asio::ip;
+
+MetricsConnection::MetricsConnection(boost::asio::io_service& io_service) :
+	mSocket(io_service), mTimer(io_service), mRequest(METRICS_MAXIMUM_REQUEST)
+{
+}
+
+void MetricsConnection::connected()
+{
+	mTimer.expires_from_now(boost::posix_time::seconds(METRICS_TIMEOUT_SECONDS));
+	mTimer.async_wait(boost::bind(&MetricsConnection::handleTimeout, shared_from_this(),
+		boost::asio::placeholders::error));
+
+	boost::asio::async_read_until(mSocket, mRequest, "\r\n\r\n",
+		boost::bind(&MetricsConnection::handleRead, shared_from_this(), boost::asio::placeholders::error));
+}
+
+void MetricsConnection::handleRead(const boost::system::error_code& ec)
+{
+	if (ec)
+	{ // including requests too long to be a scrape, and reads cut off by the timeout
+		boost::system::error_code ignore_ec;
+		mTimer.cancel(ignore_ec);
+		mSocket.close(ignore_ec);
+		return;
+	}
+
+	std::string request(boost::asio::buffer_cast<const char*>(mRequest.data()), mRequest.size());
+	std::string body;
+	const char* status;
+
+	if ((request.compare(0, 13, "GET /metrics ") == 0) || (request.compare(0, 6, "GET / ") == 0))
+	{
+		status	= "200 OK";
+		body	= Metrics::getPrometheus();
+	}
+	else
+	{
+		status	= "404 Not Found";
+		body	= "Not found\n";
+	}
+
+	mReply = boost::str(boost::format(
+		"HTTP/1.0 %s\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: %d\r\n"
+		"Connection: close\r\n"
+		"\r\n") % status % body.size());
+	mReply.append(body);
+
+	boost::asio::async_write(mSocket, boost::asio::buffer(mReply),
+		boost::bind(&MetricsConnection::handleWrite, shared_from_this(), boost::asio::placeholders::error));
+}
+
+void MetricsConnection::handleWrite(const boost::system::error_code&)
+{
+	boost::system::error_code ignore_ec;
+	mTimer.cancel(ignore_ec);
+	mSocket.shutdown(tcp::socket::shutdown_both, ignore_ec);
+	mSocket.close(ignore_ec);
+}
+
+void MetricsConnection::handleTimeout(const boost::system::error_code& ec)
+{ // closing the socket fails the pending read or write, which ends the connection
+	if (ec == boost::asio::error::operation_aborted)
+		return;
+
+	cLog(lsDEBUG) << "Metrics connection timed out";
+	boost::system::error_code ignore_ec;
+	mSocket.close(ignore_ec);
+}
+
+MetricsDoor::MetricsDoor(boost::asio::io_service& io_service) :
+	mAcceptor(io_service, tcp::endpoint(address::from_string(theConfig.METRICS_IP), theConfig.METRICS_PORT)),
+	mDelayTimer(io_service)
+{
+	cLog(lsINFO) << "Metrics port: " << theConfig.METRICS_IP << " " << theConfig.METRICS_PORT;
+	startListening();
+}
+
+void MetricsDoor::startListening()
+{
+	MetricsConnection::pointer connection = boost::make_shared<MetricsConnection>(boost::ref(mAcceptor.get_io_service()));
+	mAcceptor.set_option(tcp::acceptor::reuse_address(true));
+
+	mAcceptor.async_accept(connection->getSocket(),
+		boost::bind(&MetricsDoor::handleConnect, this, connection, boost::asio::placeholders::error));
+}
+
+void MetricsDoor::handleConnect(MetricsConnection::pointer connection, const boost::system::error_code& error)
+{
+	if (!error)
+		connection->connected();
+	else
+	{
+		cLog(lsINFO) << "MetricsDoor::handleConnect Error: " << error;
+		if (error == boost::system::errc::too_many_files_open)
+		{
+			mDelayTimer.expires_from_now(boost::posix_time::milliseconds(1000));
+			mDelayTimer.async_wait(boost::bind(&MetricsDoor::startListening, this));
+			return;
+		}
+	}
+
+	startListening();
+}
+
+// vim:ts=4
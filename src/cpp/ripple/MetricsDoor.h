@@ -0,0 +1,49 @@
+#ifndef METRICSDOOR__H
+#define METRICSDOOR__H
+
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+/*
+Serves the latency histograms over plain HTTP for Prometheus to scrape, one request per connection
+*/
+
+class MetricsConnection : public boost::enable_shared_from_this<MetricsConnection>
+{
+public:
+	typedef boost::shared_ptr<MetricsConnection> pointer;
+
+protected:
+	boost::asio::ip::tcp::socket	mSocket;
+	boost::asio::deadline_timer		mTimer;			// for the whole exchange, so idle clients don't hold sockets
+	boost::asio::streambuf			mRequest;
+	std::string						mReply;
+
+	void handleRead(const boost::system::error_code& ec);
+	void handleWrite(const boost::system::error_code& ec);
+	void handleTimeout(const boost::system::error_code& ec);
+
+public:
+	MetricsConnection(boost::asio::io_service& io_service);
+
+	boost::asio::ip::tcp::socket& getSocket()	{ return mSocket; }
+	void connected();
+};
+
+class MetricsDoor
+{
+	boost::asio::ip::tcp::acceptor	mAcceptor;
+	boost::asio::deadline_timer		mDelayTimer;
+
+	void startListening();
+	void handleConnect(MetricsConnection::pointer connection, const boost::system::error_code& error);
+
+public:
+	MetricsDoor(boost::asio::io_service& io_service);
+};
+
+#endif
+// vim:ts=4
@@ -4,6 +4,8 @@
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
+#include "../database/SqliteDatabase.h"
+
 #include "utils.h"
 #include "Application.h"
 #include "Transaction.h"
@@ -931,7 +933,7 @@ void NetworkOPs::processTrustedProposal(LedgerProposal::pointer proposal,
 		std::set<uint64> peers;
 		theApp->getSuppression().swapSet(proposal->getSuppression(), peers, SF_RELAYED);
 		PackedMessage::pointer message = boost::make_shared<PackedMessage>(*set, ripple::mtPROPOSE_LEDGER);
-		theApp->getConnectionPool().relayMessageBut(peers, message);
+		theApp->getConnectionPool().relayValidatorMessage(peers, message, set->nodepubkey());
 	}
 	else
 		cLog(lsINFO) << "Not relaying trusted proposal";
@@ -1050,14 +1052,37 @@ std::vector< std::pair<Transaction::pointer, TransactionMetaSet::pointer> >
 {
 	std::vector< std::pair<Transaction::pointer, TransactionMetaSet::pointer> > ret;
 
+#ifndef NO_SQLITE3_PREPARE
+
+	{
+		DatabaseReader dbr(theApp->getTxnDB());
+		SqliteStatement& pSt = dbr.getStatement("SELECT LedgerSeq,Status,RawTxn,TxnMeta FROM Transactions where TransID in "
+			"(SELECT TransID from AccountTransactions WHERE Account = ? AND LedgerSeq <= ? AND LedgerSeq >= ? LIMIT 1000) "
+			"ORDER BY LedgerSeq;");
+
+		pSt.bind(1, account.humanAccountID());
+		pSt.bind(2, maxLedger);
+		pSt.bind(3, minLedger);
+
+		while (pSt.isRow(pSt.step()))
+		{
+			Transaction::pointer txn = Transaction::transactionFromSQL(pSt, false);
+			TransactionMetaSet::pointer meta =
+				boost::make_shared<TransactionMetaSet>(txn->getID(), txn->getLedger(), pSt.getBlob(3));
+			ret.push_back(std::pair<Transaction::pointer, TransactionMetaSet::pointer>(txn, meta));
+		}
+	}
+
+#else
+
 	std::string sql =
 		str(boost::format("SELECT LedgerSeq,Status,RawTxn,TxnMeta FROM Transactions where TransID in (SELECT TransID from AccountTransactions  "
 			" WHERE Account = '%s' AND LedgerSeq <= '%d' AND LedgerSeq >= '%d' LIMIT 1000) ORDER BY LedgerSeq;")
 			% account.humanAccountID() % maxLedger	% minLedger);
 
 	{
-		Database* db = theApp->getTxnDB()->getDB();
-		ScopedLock sl(theApp->getTxnDB()->getDBLock());
+		DatabaseReader dbr(theApp->getTxnDB());
+		Database* db = dbr.getDB();
 
 		SQL_FOREACH(db, sql)
 		{
@@ -1078,6 +1103,8 @@ std::vector< std::pair<Transaction::pointer, TransactionMetaSet::pointer> >
 		}
 	}
 
+#endif
+
 	return ret;
 }
 
@@ -1090,8 +1117,8 @@ std::vector<RippleAddress>
 			 % ledgerSeq);
 	RippleAddress acct;
 	{
-		Database* db = theApp->getTxnDB()->getDB();
-		ScopedLock sl(theApp->getTxnDB()->getDBLock());
+		DatabaseReader dbr(theApp->getTxnDB());
+		Database* db = dbr.getDB();
 		SQL_FOREACH(db, sql)
 		{
 			if (acct.setAccountID(db->getStrBinary("Account")))
@@ -1,13 +1,13 @@
 #include "Offer.h"
 
-AccountItem::pointer Offer::makeItem(const uint160& ,SerializedLedgerEntry::ref ledgerEntry)
+AccountItem::pointer Offer::makeItem(const uint160& ,SerializedLedgerView::ref ledgerEntry)
 {
 	if (!ledgerEntry || ledgerEntry->getType() != ltOFFER) return(AccountItem::pointer());
 	Offer* offer=new Offer(ledgerEntry);
 	return(AccountItem::pointer(offer));
 }
 
-Offer::Offer(SerializedLedgerEntry::pointer ledgerEntry) : AccountItem(ledgerEntry)
+Offer::Offer(SerializedLedgerView::ref ledgerEntry) : AccountItem(ledgerEntry)
 {
 	mAccount=mLedgerEntry->getFieldAccount(sfAccount);
 	mTakerGets		= mLedgerEntry->getFieldAmount(sfTakerGets);
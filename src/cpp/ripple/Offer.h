@@ -8,10 +8,10 @@ class Offer : public AccountItem
 	int mSeq;
 
 
-	Offer(SerializedLedgerEntry::pointer ledgerEntry);	// For accounts in a ledger
+	Offer(SerializedLedgerView::ref ledgerEntry);	// For accounts in a ledger
 public:
 	Offer(){}
-	AccountItem::pointer makeItem(const uint160&, SerializedLedgerEntry::ref ledgerEntry);
+	AccountItem::pointer makeItem(const uint160&, SerializedLedgerView::ref ledgerEntry);
 	LedgerEntryType getType(){ return(ltOFFER); }
 
 	STAmount getTakerPays(){ return(mTakerPays); }
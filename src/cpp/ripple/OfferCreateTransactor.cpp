@@ -64,7 +64,7 @@ TER OfferCreateTransactor::takeOffers(
 			&& saTakerGot < saTakerGets			// Have less than wanted.
 			&& saTakerPaid < saTakerPays)		// Didn't spend all funds allocated.
 		{
-			sleOfferDir		= mEngine->entryCache(ltDIR_NODE, mEngine->getLedger()->getNextLedgerIndex(uTipIndex, uBookEnd));
+			sleOfferDir		= mEngine->entryCache(ltDIR_NODE, mEngine->getNodes().getNextLedgerIndex(uTipIndex, uBookEnd));
 			if (sleOfferDir)
 			{
 				uTipIndex		= sleOfferDir->getIndex();
@@ -138,7 +138,7 @@ TER OfferCreateTransactor::takeOffers(
 			STAmount		saOfferPays		= sleOffer->getFieldAmount(sfTakerGets);
 			STAmount		saOfferGets		= sleOffer->getFieldAmount(sfTakerPays);
 
-			if (sleOffer->isFieldPresent(sfExpiration) && sleOffer->getFieldU32(sfExpiration) <= mEngine->getLedger()->getParentCloseTimeNC())
+			if (sleOffer->isFieldPresent(sfExpiration) && sleOffer->getFieldU32(sfExpiration) <= mEngine->getNodes().getParentCloseTime())
 			{
 				// Offer is expired. Expired offers are considered unfunded. Delete it.
 				cLog(lsINFO) << "takeOffers: encountered expired offer";
@@ -359,7 +359,7 @@ TER OfferCreateTransactor::doApply()
 
 		terResult	= temBAD_EXPIRATION;
 	}
-	else if (bHaveExpiration && mEngine->getLedger()->getParentCloseTimeNC() >= uExpiration)
+	else if (bHaveExpiration && mEngine->getNodes().getParentCloseTime() >= uExpiration)
 	{
 		cLog(lsWARNING) << "OfferCreate: Expired transaction: offer expired";
 
@@ -466,7 +466,7 @@ TER OfferCreateTransactor::doApply()
 		// Complete as is.
 		nothing();
 	}
-	else if (mTxnAccount->getFieldAmount(sfBalance).getNValue() < mEngine->getLedger()->getReserve(mTxnAccount->getFieldU32(sfOwnerCount)+1))
+	else if (mTxnAccount->getFieldAmount(sfBalance).getNValue() < mEngine->getNodes().getReserve(mTxnAccount->getFieldU32(sfOwnerCount)+1))
 	{
 		if (isSetBit(mParams, tapOPEN_LEDGER)) // Ledger is not final, can vote no.
 		{
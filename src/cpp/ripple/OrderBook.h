@@ -20,14 +20,14 @@ class OrderBook
 	uint160 mIssuerOut;
 
 	//SerializedLedgerEntry::pointer	mLedgerEntry;
-	OrderBook(SerializedLedgerEntry::ref ledgerEntry);	// For accounts in a ledger
+	OrderBook(SerializedLedgerView::ref ledgerEntry);	// For accounts in a ledger
 public:
 	typedef boost::shared_ptr<OrderBook> pointer;
 	typedef const boost::shared_ptr<OrderBook>& ref;
 
 	// returns NULL if ledgerEntry doesn't point to an order
 	// if ledgerEntry is an Order it creates the OrderBook this order would live in
-	static OrderBook::pointer newOrderBook(SerializedLedgerEntry::ref ledgerEntry);
+	static OrderBook::pointer newOrderBook(SerializedLedgerView::ref ledgerEntry);
 
 	uint256& getBookBase(){ return(mBookBase); }
 	uint160& getCurrencyIn(){ return(mCurrencyIn); }
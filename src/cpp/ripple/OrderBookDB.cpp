@@ -27,7 +27,7 @@ void OrderBookDB::setup(Ledger::ref ledger)
 
 	while (currentIndex.isNonZero())
 	{
-		SLE::pointer entry=ledger->getSLE(currentIndex);
+		SLEView::pointer entry=ledger->getSLEView(currentIndex);
 
 		OrderBook::pointer book = OrderBook::newOrderBook(entry);
 		if (book)
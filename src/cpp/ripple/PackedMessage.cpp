@@ -1,23 +1,33 @@
 #include "PackedMessage.h"
 
+#include <zlib.h>
 
-void PackedMessage::encodeHeader(unsigned size, int type) 
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "Metrics.h"
+
+// Sync is usually limited by bandwidth, but a fast level keeps compression off the critical path
+#define PACKED_ZLIB_LEVEL		3
+
+
+void PackedMessage::encodeHeader(std::vector<uint8_t>& buf, unsigned size, int type)
 {
-	assert(mBuffer.size() >= HEADER_SIZE);
-	mBuffer[0] = static_cast<boost::uint8_t>((size >> 24) & 0xFF);
-	mBuffer[1] = static_cast<boost::uint8_t>((size >> 16) & 0xFF);
-	mBuffer[2] = static_cast<boost::uint8_t>((size >> 8) & 0xFF);
-	mBuffer[3] = static_cast<boost::uint8_t>(size & 0xFF);
-	mBuffer[4] = static_cast<boost::uint8_t>((type >> 8) & 0xFF);
-	mBuffer[5] = static_cast<boost::uint8_t>(type & 0xFF);
+	assert(buf.size() >= HEADER_SIZE);
+	buf[0] = static_cast<boost::uint8_t>((size >> 24) & 0xFF);
+	buf[1] = static_cast<boost::uint8_t>((size >> 16) & 0xFF);
+	buf[2] = static_cast<boost::uint8_t>((size >> 8) & 0xFF);
+	buf[3] = static_cast<boost::uint8_t>(size & 0xFF);
+	buf[4] = static_cast<boost::uint8_t>((type >> 8) & 0xFF);
+	buf[5] = static_cast<boost::uint8_t>(type & 0xFF);
 }
 
-PackedMessage::PackedMessage(const ::google::protobuf::Message &message, int type)
+PackedMessage::PackedMessage(const ::google::protobuf::Message &message, int type) : mCompressDone(false)
 {
 	unsigned msg_size = message.ByteSize();
 	assert(msg_size);
 	mBuffer.resize(HEADER_SIZE + msg_size);
-	encodeHeader(msg_size, type);
+	encodeHeader(mBuffer, msg_size, type);
 	if (msg_size)
 	{
 		message.SerializeToArray(&mBuffer[HEADER_SIZE], msg_size);
@@ -49,5 +59,209 @@ int PackedMessage::getType(std::vector<uint8_t>& buf)
 
 	int ret = buf[4];
 	ret <<= 8; ret |= buf[5];
-	return ret;
+	return ret & ~PACKED_COMPRESSED_FLAG;
+}
+
+bool PackedMessage::isCompressed(std::vector<uint8_t>& buf)
+{
+	return (buf.size() >= HEADER_SIZE) && ((buf[4] & (PACKED_COMPRESSED_FLAG >> 8)) != 0);
+}
+
+bool PackedMessage::isCompressible(int type)
+{ // Bulk ledger data and object replies are compressed once their body reaches PACKED_COMPRESS_MIN.
+  // Everything else, proposals and validations above all, is latency critical and always goes as is.
+	return (type == ripple::mtLEDGER_DATA) || (type == ripple::mtGET_OBJECTS);
+}
+
+PackedMessage::pointer PackedMessage::getCompressed(int codecs)
+{
+	if (((codecs & PACKED_CODEC_ZLIB) == 0) || ((mBuffer.size() - HEADER_SIZE) < PACKED_COMPRESS_MIN) ||
+		!isCompressible(getType(mBuffer)))
+		return shared_from_this();
+
+	boost::mutex::scoped_lock sl(mCompressLock);
+
+	if (!mCompressDone)
+	{
+		mCompressDone = true;
+
+		unsigned size = mBuffer.size() - HEADER_SIZE;
+		uLongf outSize = compressBound(size);
+
+		pointer packed(new PackedMessage());
+		std::vector<uint8_t>& out = packed->mBuffer;
+		out.resize(HEADER_SIZE + COMPRESSED_HEADER_SIZE + outSize);
+
+		if (compress2(&out[HEADER_SIZE + COMPRESSED_HEADER_SIZE], &outSize, &mBuffer[HEADER_SIZE], size,
+			PACKED_ZLIB_LEVEL) == Z_OK)
+		{
+			unsigned packedSize = COMPRESSED_HEADER_SIZE + outSize;
+			if (packedSize < (size - size / 8))
+			{ // worth it
+				out.resize(HEADER_SIZE + packedSize);
+				encodeHeader(out, packedSize, getType(mBuffer) | PACKED_COMPRESSED_FLAG);
+				out[HEADER_SIZE] = PACKED_CODEC_ZLIB;
+				out[HEADER_SIZE + 1] = static_cast<boost::uint8_t>((size >> 24) & 0xFF);
+				out[HEADER_SIZE + 2] = static_cast<boost::uint8_t>((size >> 16) & 0xFF);
+				out[HEADER_SIZE + 3] = static_cast<boost::uint8_t>((size >> 8) & 0xFF);
+				out[HEADER_SIZE + 4] = static_cast<boost::uint8_t>(size & 0xFF);
+				mCompressed = packed;
+			}
+		}
+	}
+
+	return mCompressed ? mCompressed : shared_from_this();
+}
+
+bool PackedMessage::decompress(std::vector<uint8_t>& buf, unsigned maxSize)
+{
+	if (!isCompressed(buf))
+		return true;
+
+	if ((buf.size() < (HEADER_SIZE + COMPRESSED_HEADER_SIZE)) || (buf[HEADER_SIZE] != PACKED_CODEC_ZLIB))
+		return false;
+
+	unsigned size = buf[HEADER_SIZE + 1];
+	size <<= 8; size |= buf[HEADER_SIZE + 2]; size <<= 8; size |= buf[HEADER_SIZE + 3]; size <<= 8; size |= buf[HEADER_SIZE + 4];
+	if ((size == 0) || (size > maxSize))
+		return false;
+
+	std::vector<uint8_t> out(HEADER_SIZE + size);
+	uLongf outSize = size;
+
+	if ((uncompress(&out[HEADER_SIZE], &outSize, &buf[HEADER_SIZE + COMPRESSED_HEADER_SIZE],
+			buf.size() - HEADER_SIZE - COMPRESSED_HEADER_SIZE) != Z_OK) || (outSize != size))
+		return false;
+
+	encodeHeader(out, size, getType(buf));
+	buf.swap(out);
+	return true;
+}
+
+BOOST_AUTO_TEST_SUITE(PackedMessage_suite)
+
+static void addRandom(std::string& data, int bytes)
+{
+	for (int i = 0; i < bytes; ++i)
+		data.push_back(static_cast<char>(rand()));
 }
+
+static PackedMessage::pointer makeLedgerData(int inner, int leaves)
+{ // A fat reply, shaped like getNodeFat's: full inner nodes in wire form, then account root leaves
+	ripple::TMLedgerData data;
+	data.set_ledgerhash(std::string(32, 'L'));
+	data.set_ledgerseq(1000000);
+	data.set_type(ripple::liAS_NODE);
+
+	for (int i = 0; i < inner + leaves; ++i)
+	{
+		ripple::TMLedgerNode& node = *data.add_nodes();
+		std::string id(33, '\0'), raw;
+
+		int depth = (i < inner) ? 3 : 4;
+		for (int j = 0; j < (depth + 1) / 2; ++j)
+			id[j] = static_cast<char>(rand());
+		id[32] = static_cast<char>(depth);
+		node.set_nodeid(id);
+
+		if (i < inner)
+		{
+			addRandom(raw, 16 * 32);
+			raw.push_back(2);
+		}
+		else
+		{ // type, flags, sequence, balance, owner count, previous transaction, its ledger, account, then the tag
+			const char fields[] = { 0x11, 0x00, 0x61, 0x22, 0x00, 0x00, 0x00, 0x00, 0x24 };
+			raw.append(fields, sizeof(fields));
+			addRandom(raw, 2);
+			raw.append("\x00\x00\x61\x40\x00\x00\x00", 7);
+			addRandom(raw, 4);
+			raw.append("\x25\x00\x00\x00\x00\x55", 6);
+			addRandom(raw, 32);
+			raw.append("\x26\x00\x0F", 3);
+			addRandom(raw, 2);
+			raw.append("\x81\x14", 2);
+			addRandom(raw, 20 + 32);
+			raw.push_back(1);
+		}
+		node.set_nodedata(raw);
+	}
+
+	return boost::make_shared<PackedMessage>(data, ripple::mtLEDGER_DATA);
+}
+
+BOOST_AUTO_TEST_CASE(PackedMessage_Compression_test)
+{
+	srand(1);
+
+	PackedMessage::pointer packet = makeLedgerData(16, 256);
+	std::vector<uint8_t> original = packet->getBuffer();
+
+	if (packet->getCompressed(0) != packet)		BOOST_FAIL("Compressed for a peer without codecs");
+
+	PackedMessage::pointer compressed = packet->getCompressed(PACKED_CODECS);
+	if (compressed == packet)					BOOST_FAIL("Ledger data not compressed");
+	if (compressed != packet->getCompressed(PACKED_CODECS))	BOOST_FAIL("Compression not shared");
+
+	std::vector<uint8_t> buf = compressed->getBuffer();
+	if (!PackedMessage::isCompressed(buf))		BOOST_FAIL("Compressed flag");
+	if (PackedMessage::getType(buf) != ripple::mtLEDGER_DATA)	BOOST_FAIL("Compressed type");
+	if (PackedMessage::getLength(buf) != (buf.size() - HEADER_SIZE))	BOOST_FAIL("Compressed length");
+
+	if (PackedMessage::decompress(buf, original.size() - HEADER_SIZE - 1))	BOOST_FAIL("Decompress limit");
+	if (!PackedMessage::decompress(buf, 32 * 1024 * 1024) || (buf != original))	BOOST_FAIL("Decompress");
+
+	buf = compressed->getBuffer();
+	buf[buf.size() / 2] ^= 0x55;
+	if (PackedMessage::decompress(buf, 32 * 1024 * 1024) && (buf == original))	BOOST_FAIL("Corrupt decompress");
+
+	ripple::TMProposeSet propose;
+	propose.set_proposeseq(1);
+	propose.set_currenttxhash(std::string(32, '\0'));
+	propose.set_nodepubkey(std::string(2048, '\0'));
+	propose.set_signature(std::string(72, '\0'));
+	propose.set_closetime(1);
+	PackedMessage::pointer proposal = boost::make_shared<PackedMessage>(propose, ripple::mtPROPOSE_LEDGER);
+	if (proposal->getCompressed(PACKED_CODECS) != proposal)	BOOST_FAIL("Proposal compressed");
+}
+
+#ifdef ENABLE_BENCHMARKS
+
+BOOST_AUTO_TEST_CASE(PackedMessage_Compression_bench)
+{ // The bandwidth and time a sync's worth of ledger data replies takes compressed
+	const int iReplies = 200;
+	srand(2);
+
+	std::vector<PackedMessage::pointer> replies;
+	for (int i = 0; i < iReplies; ++i)
+		replies.push_back(makeLedgerData(16, 256));
+
+	uint64 raw = 0, packed = 0, compressTime = 0, decompressTime = 0;
+	for (int i = 0; i < iReplies; ++i)
+	{
+		uint64 start = LatencyHistogram::now();
+		PackedMessage::pointer compressed = replies[i]->getCompressed(PACKED_CODECS);
+		uint64 middle = LatencyHistogram::now();
+
+		std::vector<uint8_t> buf = compressed->getBuffer();
+		uint64 end = LatencyHistogram::now();
+		if (!PackedMessage::decompress(buf, 32 * 1024 * 1024))
+			BOOST_FAIL("Decompress");
+		decompressTime += LatencyHistogram::now() - end;
+		compressTime += middle - start;
+
+		raw += replies[i]->getBuffer().size();
+		packed += compressed->getBuffer().size();
+	}
+
+	BOOST_TEST_MESSAGE("PackedMessage: " << iReplies << " ledger data replies, " << (raw / 1024) << " KB raw, "
+		<< (packed / 1024) << " KB compressed (" << (packed * 100 / raw) << "%), compress "
+		<< (raw * 1000000 / std::max<uint64>(compressTime, 1) / (1024 * 1024)) << " MB/s, decompress "
+		<< (raw * 1000000 / std::max<uint64>(decompressTime, 1) / (1024 * 1024)) << " MB/s");
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// vim:ts=4
@@ -13,6 +13,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "ripple.pb.h"
 
@@ -20,6 +21,16 @@
 // len(4)+type(2)
 const unsigned HEADER_SIZE = 6;
 
+// A compressed message sets this bit in its type. Its body is the codec(1), the
+// uncompressed length(4), and then the compressed body.
+const int PACKED_COMPRESSED_FLAG = 0x8000;
+const unsigned COMPRESSED_HEADER_SIZE = 5;
+
+// Codecs, as bits of TMHello::compression
+#define PACKED_CODEC_ZLIB		0x01
+#define PACKED_CODECS			PACKED_CODEC_ZLIB	// codecs we can read
+
+#define PACKED_COMPRESS_MIN		1024				// smaller bodies are sent as is
 
 // PackedMessage implements simple "packing" of protocol buffers Messages into
 // a string prepended by a header specifying the message length.
@@ -29,22 +40,39 @@ const unsigned HEADER_SIZE = 6;
 class PackedMessage : public boost::enable_shared_from_this<PackedMessage>
 {
 
+public:
+    typedef boost::shared_ptr< ::google::protobuf::Message > MessagePointer;
+	typedef boost::shared_ptr<PackedMessage> pointer;
+
+protected:
 	std::vector<uint8_t> mBuffer;
 
+	boost::mutex	mCompressLock;
+	bool			mCompressDone;
+	pointer			mCompressed;	// the compressed form, if it is worth sending
+
 	// Encodes the size and type into a header at the beginning of buf
 	//
-	void encodeHeader(unsigned size, int type);
+	static void encodeHeader(std::vector<uint8_t>& buf, unsigned size, int type);
 
-public:
-    typedef boost::shared_ptr< ::google::protobuf::Message > MessagePointer;
-	typedef boost::shared_ptr<PackedMessage> pointer;
+	PackedMessage() : mCompressDone(false) { ; }
 
+public:
     PackedMessage(const ::google::protobuf::Message& message, int type);
 
 	std::vector<uint8_t>& getBuffer() { return(mBuffer); }
 
+	// The message to send to a peer that reads the given codecs. Bulk data such as ledger nodes
+	// is compressed once and shared by every peer it goes to, anything else is returned as is.
+	pointer getCompressed(int codecs);
+
 	static unsigned getLength(std::vector<uint8_t>& buf);
-	static int getType(std::vector<uint8_t>& buf);
+	static int getType(std::vector<uint8_t>& buf);		// without the compressed flag
+	static bool isCompressed(std::vector<uint8_t>& buf);
+	static bool isCompressible(int type);
+
+	// Replace a compressed message with the original, false if it's corrupt or would be over maxSize
+	static bool decompress(std::vector<uint8_t>& buf, unsigned maxSize);
 
 	bool operator == (const PackedMessage& other);
 
@@ -206,7 +206,7 @@ bool Pathfinder::findPaths(const unsigned int iMaxSteps, const unsigned int iMax
 
 	LedgerEntrySet		lesActive(mLedger);
 
-	SLE::pointer	sleSrc		= lesActive.entryCache(ltACCOUNT_ROOT, Ledger::getAccountRootIndex(mSrcAccountID));
+	SLEView::pointer	sleSrc	= lesActive.entryView(Ledger::getAccountRootIndex(mSrcAccountID));
 	if (!sleSrc)
 	{
 		cLog(lsDEBUG) << boost::str(boost::format("findPaths< no source"));
@@ -214,7 +214,7 @@ bool Pathfinder::findPaths(const unsigned int iMaxSteps, const unsigned int iMax
 		return false;
 	}
 
-	SLE::pointer	sleDst		= lesActive.entryCache(ltACCOUNT_ROOT, Ledger::getAccountRootIndex(mDstAccountID));
+	SLEView::pointer	sleDst	= lesActive.entryView(Ledger::getAccountRootIndex(mDstAccountID));
 	if (!sleDst)
 	{
 		cLog(lsDEBUG) << boost::str(boost::format("findPaths< no dest"));
@@ -385,7 +385,7 @@ bool Pathfinder::findPaths(const unsigned int iMaxSteps, const unsigned int iMax
 
 			// Create new paths for each outbound account not already in the path.
 			AccountItems	rippleLines(speEnd.mAccountID, mLedger, AccountItem::pointer(new RippleState()));
-			SLE::pointer	sleEnd			= lesActive.entryCache(ltACCOUNT_ROOT, Ledger::getAccountRootIndex(speEnd.mAccountID));
+			SLEView::pointer	sleEnd		= lesActive.entryView(Ledger::getAccountRootIndex(speEnd.mAccountID));
 
 			tLog(sleEnd, lsDEBUG)
 				<< boost::str(boost::format("findPaths: account without root: %s")
@@ -122,7 +122,7 @@ TER PaymentTransactor::doApply()
 			// Another transaction could create the account and then this transaction would succeed.
 			return telNO_DST_PARTIAL;
 		}
-		else if (saDstAmount.getNValue() < mEngine->getLedger()->getReserve(0))	// Reserve is not scaled by load.
+		else if (saDstAmount.getNValue() < mEngine->getNodes().getReserve(0))	// Reserve is not scaled by load.
 		{
 			cLog(lsINFO) << "Payment: Delay transaction: Destination account does not exist. Insufficent payment to create account.";
 
@@ -192,7 +192,7 @@ TER PaymentTransactor::doApply()
 
 		const STAmount	saSrcXRPBalance	= mTxnAccount->getFieldAmount(sfBalance);
 		const uint32	uOwnerCount		= mTxnAccount->getFieldU32(sfOwnerCount);
-		const uint64	uReserve		= mEngine->getLedger()->getReserve(uOwnerCount);
+		const uint64	uReserve		= mEngine->getNodes().getReserve(uOwnerCount);
 		STAmount		saPaid			= mTxn.getTransactionFee();
 
 		// Make sure have enough reserve to send. Allow final spend to use reserve for fee.
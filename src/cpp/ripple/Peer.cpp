@@ -24,15 +24,46 @@ DECLARE_INSTANCE(Peer);
 // Node has this long to verify its identity from connection accepted or connection attempt.
 #define NODE_VERIFY_SECONDS		15
 
+// Queued packets are gathered into writes of up to this many bytes
+#define PEER_WRITE_BYTES		(64 * 1024)
+
+// A peer that falls behind first stops getting relayed transactions, then relayed proposals and validations.
+// Past the last limit the queue is trimmed of those, and if that's not enough the peer is dropped.
+#define PEER_QUEUE_TX_BYTES		(1 * 1024 * 1024)
+#define PEER_QUEUE_RELAY_BYTES	(4 * 1024 * 1024)
+#define PEER_QUEUE_MAX_BYTES	(32 * 1024 * 1024)
+
+// The largest message we'll read, before or after decompression
+#define PEER_MESSAGE_MAX_BYTES	(32 * 1024 * 1024)
+
+// Object queries from one peer that can wait on the node store at once, more are dropped and asked again
+#define PEER_OBJECT_FETCHES		4
+
+static std::string getMessageName(int type)
+{
+	if (!ripple::MessageType_IsValid(type))
+		return (type == 0) ? "unknown" : "";
+	return ripple::MessageType_Name(static_cast<ripple::MessageType>(type));
+}
+
+// Message types past the last one all count as "unknown" with type zero
+static LatencyFamily sMessageLatency("peer_message", "type", 64, getMessageName);
+
 Peer::Peer(boost::asio::io_service& io_service, boost::asio::ssl::context& ctx, uint64 peerID, bool inbound) :
 	mInbound(inbound),
 	mHelloed(false),
 	mDetaching(false),
 	mActive(true),
 	mCluster(false),
+	mCompression(0),
 	mPeerId(peerID),
 	mSocketSsl(io_service, ctx),
-	mActivityTimer(io_service)
+	mActivityTimer(io_service),
+	mSendActive(false),
+	mSendQueueCount(0),
+	mSendQueueBytes(0),
+	mSendDropped(0),
+	mObjectFetches(0)
 {
 	cLog(lsDEBUG) << "CREATING PEER: " << ADDRESS(this);
 }
@@ -47,6 +78,7 @@ void Peer::handleWrite(const boost::system::error_code& error, size_t bytes_tran
 	boost::recursive_mutex::scoped_lock sl(ioMutex);
 
 	mSendingPacket.reset();
+	mWriteBuffer.clear();
 
 	if (mDetaching)
 	{
@@ -59,15 +91,9 @@ void Peer::handleWrite(const boost::system::error_code& error, size_t bytes_tran
 
 		detach("hw");
 	}
-	else if (!mSendQ.empty())
+	else
 	{
-		PackedMessage::pointer packet = mSendQ.front();
-
-		if (packet)
-		{
-			sendPacketForce(packet);
-			mSendQ.pop_front();
-		}
+		startWrite();
 	}
 }
 
@@ -95,6 +121,9 @@ void Peer::detach(const char *rsn)
 			*/
 
 		mSendQ.clear();
+		mSendIncoming.clear();
+		mSendQueueCount.store(0);
+		mSendQueueBytes.store(0);
 
 		(void) mActivityTimer.cancel();
 		mSocketSsl.async_shutdown(boost::bind(&Peer::handleShutdown, shared_from_this(), boost::asio::placeholders::error));
@@ -275,34 +304,151 @@ void Peer::connected(const boost::system::error_code& error)
 	}
 }
 
-void Peer::sendPacketForce(const PackedMessage::pointer& packet)
-{ // must hold I/O mutex
-	if (!mDetaching)
+static int getQueueLimit(int type)
+{ // Queued bytes past which a packet of this type is dropped rather than sent
+	switch (type)
 	{
-		mSendingPacket = packet;
+		case ripple::mtTRANSACTION:
+			return PEER_QUEUE_TX_BYTES;
 
-		boost::asio::async_write(mSocketSsl, boost::asio::buffer(packet->getBuffer()),
-			boost::bind(&Peer::handleWrite, shared_from_this(),
-			boost::asio::placeholders::error,
-			boost::asio::placeholders::bytes_transferred));
+		case ripple::mtPROPOSE_LEDGER:
+		case ripple::mtVALIDATION:
+		case ripple::mtHAVE_SET:
+			return PEER_QUEUE_RELAY_BYTES;
+
+		default:
+			return PEER_QUEUE_MAX_BYTES;
 	}
 }
 
-void Peer::sendPacket(const PackedMessage::pointer& packet)
-{
-	boost::recursive_mutex::scoped_lock sl(ioMutex);
+bool Peer::trimSendQueue()
+{ // must hold I/O mutex, drops queued relays, transactions first, returns false if still too much is queued
+	int limits[] = { PEER_QUEUE_TX_BYTES, PEER_QUEUE_RELAY_BYTES };
 
-	if (packet)
+	BOOST_FOREACH(int limit, limits)
 	{
-		if (mSendingPacket)
+		std::list<PackedMessage::pointer>::iterator it = mSendQ.begin();
+		while ((it != mSendQ.end()) && (mSendQueueBytes.load() > PEER_QUEUE_MAX_BYTES))
 		{
-			mSendQ.push_back(packet);
+			if (getQueueLimit(PackedMessage::getType((*it)->getBuffer())) == limit)
+			{
+				mSendQueueBytes.fetch_sub((*it)->getBuffer().size());
+				mSendQueueCount.fetch_sub(1);
+				mSendDropped.fetch_add(1);
+				it = mSendQ.erase(it);
+			}
+			else
+				++it;
 		}
-		else
+	}
+
+	return mSendQueueBytes.load() <= PEER_QUEUE_MAX_BYTES;
+}
+
+void Peer::startWrite()
+{ // must hold I/O mutex and own the writer, gives the writer up if there is nothing to send
+	while (true)
+	{
+		mSendIncoming.popAll(mSendQ);
+
+		if (mDetaching)
+		{ // keep the writer, so nothing more is started
+			mSendQ.clear();
+			return;
+		}
+
+		if ((mSendQueueBytes.load() > PEER_QUEUE_MAX_BYTES) && !trimSendQueue())
+		{
+			cLog(lsWARNING) << "Peer: Send queue full: " << ADDRESS(this) << ": " << mSendQueueBytes.load() << " bytes";
+			detach("sqf");
+			return;
+		}
+
+		if (!mSendQ.empty())
+		{ // Gather what's queued into one write, so small packets share TLS records and system calls
+			int		count	= 1;
+			size_t	bytes	= mSendQ.front()->getBuffer().size();
+
+			mSendingPacket	= mSendQ.front();
+			mSendQ.pop_front();
+
+			while (!mSendQ.empty() && (bytes + mSendQ.front()->getBuffer().size() <= PEER_WRITE_BYTES))
+			{
+				if (mWriteBuffer.empty())
+					mWriteBuffer.assign(mSendingPacket->getBuffer().begin(), mSendingPacket->getBuffer().end());
+
+				const std::vector<uint8_t>& buffer = mSendQ.front()->getBuffer();
+				mWriteBuffer.insert(mWriteBuffer.end(), buffer.begin(), buffer.end());
+				bytes += buffer.size();
+				++count;
+				mSendQ.pop_front();
+			}
+
+			mSendQueueBytes.fetch_sub(bytes);
+			mSendQueueCount.fetch_sub(count);
+
+			boost::asio::async_write(mSocketSsl,
+				boost::asio::buffer(mWriteBuffer.empty() ? mSendingPacket->getBuffer() : mWriteBuffer),
+				boost::bind(&Peer::handleWrite, shared_from_this(),
+				boost::asio::placeholders::error,
+				boost::asio::placeholders::bytes_transferred));
+			return;
+		}
+
+		mSendActive.store(false);
+
+		// A packet pushed before the store saw a writer and left it to us, so look again
+		if (mSendIncoming.empty() || mSendActive.exchange(true))
+			return;
+	}
+}
+
+void Peer::sendPacket(const PackedMessage::pointer& message)
+{ // Relays call this for every peer, so the I/O mutex is only held briefly unless a write must be started
+	if (!message)
+		return;
+
+	{
+		boost::recursive_mutex::scoped_lock sl(ioMutex);
+
+		if (mDetaching)
+			return;
+	}
+
+	// Compressed here rather than by the writer, so the queue limits count what goes on the wire
+	PackedMessage::pointer packet = (mCompression != 0) ? message->getCompressed(mCompression) : message;
+
+	int size	= packet->getBuffer().size();
+	int limit	= getQueueLimit(PackedMessage::getType(packet->getBuffer()));
+	if ((limit != PEER_QUEUE_MAX_BYTES) && (mSendQueueBytes.load() + size > limit))
+	{ // this peer is behind, and can get the packet from others
+		mSendDropped.fetch_add(1);
+		return;
+	}
+
+	mSendQueueBytes.fetch_add(size);
+	mSendQueueCount.fetch_add(1);
+	mSendIncoming.push(packet);
+
+	if (mSendQueueBytes.load() > PEER_QUEUE_MAX_BYTES)
+	{ // a peer that stopped reading has no write finishing to check the queue, so check it here
+		boost::recursive_mutex::scoped_lock sl(ioMutex);
+
+		mSendIncoming.popAll(mSendQ);
+		if (!mDetaching && (mSendQueueBytes.load() > PEER_QUEUE_MAX_BYTES) && !trimSendQueue())
 		{
-			sendPacketForce(packet);
+			cLog(lsWARNING) << "Peer: Send queue full: " << ADDRESS(this) << ": " << mSendQueueBytes.load() << " bytes";
+			detach("sqf");
+			return;
 		}
 	}
+
+	if (!mSendActive.exchange(true))
+	{
+		boost::recursive_mutex::scoped_lock sl(ioMutex);
+
+		startWrite();
+	}
 }
 
 void Peer::startReadHeader()
@@ -348,8 +494,7 @@ void Peer::handleReadHeader(const boost::system::error_code& error)
 	else if (!error)
 	{
 		unsigned msg_len = PackedMessage::getLength(mReadbuf);
-		// WRITEME: Compare to maximum message length, abort if too large
-		if ((msg_len > (32 * 1024 * 1024)) || (msg_len == 0))
+		if ((msg_len > PEER_MESSAGE_MAX_BYTES) || (msg_len == 0))
 		{
 			detach("hrh");
 			return;
@@ -381,6 +526,15 @@ void Peer::handleReadBody(const boost::system::error_code& error)
 		}
 	}
 
+	if (!PackedMessage::decompress(mReadbuf, PEER_MESSAGE_MAX_BYTES))
+	{
+		cLog(lsWARNING) << "Peer: Body: Bad compressed message: " << ADDRESS(this);
+		boost::recursive_mutex::scoped_lock sl(ioMutex);
+		boost::recursive_mutex::scoped_lock ml(theApp->getMasterLock());
+		detach("hrb3");
+		return;
+	}
+
 	processReadBuffer();
 	startReadHeader();
 }
@@ -395,6 +549,7 @@ void Peer::processReadBuffer()
 //	std::cerr << "Peer::processReadBuffer: " << mIpPort.first << " " << mIpPort.second << std::endl;
 
 	LoadEvent::autoptr event(theApp->getJobQueue().getLoadEventAP(jtPEER));
+	LatencyTimer timer(sMessageLatency.get(((type > 0) && (type < 64)) ? type : 0));
 
 	boost::recursive_mutex::scoped_lock sl(theApp->getMasterLock());
 
@@ -612,6 +767,16 @@ void Peer::processReadBuffer()
 			}
 			break;
 
+		case ripple::mtSQUELCH:
+			{
+				ripple::TMSquelch msg;
+				if (msg.ParseFromArray(&mReadbuf[HEADER_SIZE], mReadbuf.size() - HEADER_SIZE))
+					recvSquelch(msg);
+				else
+					cLog(lsWARNING) << "parse error: " << type;
+			}
+			break;
+
 
 		default:
 			cLog(lsWARNING) << "Unknown Msg: " << type;
@@ -686,6 +851,7 @@ void Peer::recvHello(ripple::TMHello& packet)
 			<< "Peer speaks version " <<
 				(packet.protoversion() >> 16) << "." << (packet.protoversion() & 0xFF);
 		mHello = packet;
+		mCompression = packet.has_compression() ? (packet.compression() & PACKED_CODECS) : 0;
 		if (theApp->getUNL().nodeInCluster(mNodePublic, mNodeName))
 		{
 			mCluster = true;
@@ -843,6 +1009,14 @@ void Peer::recvTransaction(ripple::TMTransaction& packet)
 
 }
 
+static void addSquelchSource(const boost::weak_ptr<Peer>& wp, const RippleAddress& signer)
+{ // Only once the signature has verified, so forged messages can't make a peer a validator's source
+	Peer::pointer peer = wp.lock();
+	if (peer)
+		theApp->getConnectionPool().getSquelch().addMessage(strCopy(signer.getNodePublic()), peer->getPeerId(),
+			true, upTime());
+}
+
 static void checkPropose(Job& job, boost::shared_ptr<ripple::TMProposeSet> packet,
 	LedgerProposal::pointer proposal, uint256 consensusLCL,	RippleAddress nodePublic, boost::weak_ptr<Peer> peer)
 { // Called from our JobQueue
@@ -882,6 +1056,13 @@ static void checkPropose(Job& job, boost::shared_ptr<ripple::TMProposeSet> packe
 		}
 	}
 
+	if (sigGood)
+	{ // duplicates of this exact message can now be credited to the peers that relay them
+		theApp->getSuppression().setFlag(proposal->getSuppression(), SF_SIGGOOD);
+		if (isTrusted)
+			addSquelchSource(peer, proposal->peekPublic());
+	}
+
 	if (isTrusted)
 	{
 		theApp->getIOService().post(boost::bind(&NetworkOPs::processTrustedProposal, &theApp->getOPs(),
@@ -893,7 +1074,7 @@ static void checkPropose(Job& job, boost::shared_ptr<ripple::TMProposeSet> packe
 		std::set<uint64> peers;
 		theApp->getSuppression().swapSet(proposal->getSuppression(), peers, SF_RELAYED);
 		PackedMessage::pointer message = boost::make_shared<PackedMessage>(set, ripple::mtPROPOSE_LEDGER);
-		theApp->getConnectionPool().relayMessageBut(peers, message);
+		theApp->getConnectionPool().relayValidatorMessage(peers, message, set.nodepubkey());
 	}
 	else
 		cLog(lsDEBUG) << "Not relaying untrusted proposal";
@@ -937,6 +1118,8 @@ void Peer::recvPropose(const boost::shared_ptr<ripple::TMProposeSet>& packet)
 	if (!theApp->isNew(suppression, mPeerId))
 	{
 		cLog(lsTRACE) << "Received duplicate proposal from peer " << mPeerId;
+		if (theApp->getSuppression().getFlags(suppression) & SF_SIGGOOD)
+			theApp->getConnectionPool().getSquelch().addMessage(set.nodepubkey(), mPeerId, false, upTime());
 		return;
 	}
 
@@ -975,6 +1158,24 @@ void Peer::recvHaveTxSet(ripple::TMHaveTransactionSet& packet)
 		punishPeer(LT_UnwantedData);
 }
 
+static bool checkValidationSign(SerializedValidation::ref val, const uint256& signingHash)
+{ // Verified once per signing hash, signer and signature, however many times it is relayed
+	SuppressionTable& suppression = theApp->getSuppression();
+	uint256 key = SuppressionTable::getSignatureKey(signingHash,
+		val->getFieldVL(sfSigningPubKey), val->getFieldVL(sfSignature));
+
+	int flags = suppression.getSignatureFlags(key);
+	if (flags != 0)
+		return flags == SF_SIGGOOD;
+
+	LatencyTimer timer(Metrics::get("signature_verify", "type", "validation"));
+	bool good = val->isValid(signingHash);
+	timer.stop();
+
+	suppression.setFlag(key, good ? SF_SIGGOOD : SF_BAD);
+	return good;
+}
+
 static void checkValidation(Job&, SerializedValidation::pointer val, uint256 signingHash,
 	bool isTrusted, boost::shared_ptr<ripple::TMValidation> packet, boost::weak_ptr<Peer> peer)
 {
@@ -982,18 +1183,21 @@ static void checkValidation(Job&, SerializedValidation::pointer val, uint256 sig
 	try
 #endif
 	{
-		if (!val->isValid(signingHash))
+		if (!checkValidationSign(val, signingHash))
 		{
 			cLog(lsWARNING) << "Validation is invalid";
 			Peer::punishPeer(peer, LT_InvalidRequest);
 			return;
 		}
+		if (isTrusted)
+			addSquelchSource(peer, val->getSignerPublic());
 
 		std::set<uint64> peers;
 		if (theApp->getOPs().recvValidation(val) && theApp->getSuppression().swapSet(signingHash, peers, SF_RELAYED))
 		{
 			PackedMessage::pointer message = boost::make_shared<PackedMessage>(*packet, ripple::mtVALIDATION);
-			theApp->getConnectionPool().relayMessageBut(peers, message);
+			theApp->getConnectionPool().relayValidatorMessage(peers, message,
+				strCopy(val->getFieldVL(sfSigningPubKey)));
 		}
 	}
 #ifndef TRUST_NETWORK
@@ -1024,8 +1228,12 @@ void Peer::recvValidation(const boost::shared_ptr<ripple::TMValidation>& packet)
 
 		uint256 signingHash = val->getSigningHash();
 		if (!theApp->isNew(signingHash, mPeerId))
-		{
+		{ // credited only if this copy's signature is one already verified
 			cLog(lsTRACE) << "Validation is duplicate";
+			std::vector<unsigned char> signer = val->getFieldVL(sfSigningPubKey);
+			uint256 key = SuppressionTable::getSignatureKey(signingHash, signer, val->getFieldVL(sfSignature));
+			if (theApp->getSuppression().getSignatureFlags(key) == SF_SIGGOOD)
+				theApp->getConnectionPool().getSquelch().addMessage(strCopy(signer), mPeerId, false, upTime());
 			return;
 		}
 
@@ -1109,43 +1317,83 @@ void Peer::recvPeers(ripple::TMPeers& packet)
 	}
 }
 
+void Peer::sendObjects(const boost::shared_ptr<ripple::TMGetObjectByHash>& query, int asked,
+	const std::vector<HashedObject::pointer>& objects)
+{ // The objects are in the order of the query's
+	ripple::TMGetObjectByHash reply;
+
+	reply.set_query(false);
+	if (query->has_seq())
+		reply.set_seq(query->seq());
+	reply.set_type(query->type());
+	if (query->has_ledgerhash())
+		reply.set_ledgerhash(query->ledgerhash());
+
+	for (int i = 0; i < query->objects_size(); ++i)
+	{
+		const HashedObject::pointer& hObj = objects[i];
+		if (hObj)
+		{
+			const ripple::TMIndexedObject& obj = query->objects(i);
+			ripple::TMIndexedObject& newObj = *reply.add_objects();
+			newObj.set_hash(obj.hash());
+			newObj.set_data(&hObj->getData().front(), hObj->getData().size());
+			if (obj.has_nodeid())
+				newObj.set_index(obj.nodeid());
+			if (!reply.has_seq() && (hObj->getIndex() != 0))
+				reply.set_seq(hObj->getIndex());
+		}
+	}
+	--mObjectFetches;
+	cLog(lsTRACE) << "GetObjByHash had " << reply.objects_size() << " of " << asked << " for " << getIP();
+	sendPacket(boost::make_shared<PackedMessage>(reply, ripple::mtGET_OBJECTS));
+}
+
 void Peer::recvGetObjectByHash(ripple::TMGetObjectByHash& packet)
 {
 	if (packet.query())
-	{ // this is a query
-		ripple::TMGetObjectByHash reply;
+	{ // this is a query, answered when the store has read what it doesn't have cached
+		boost::shared_ptr<ripple::TMGetObjectByHash> query = boost::make_shared<ripple::TMGetObjectByHash>();
+		std::vector<uint256> hashes;
 
-		reply.set_query(false);
+		query->set_query(true);
 		if (packet.has_seq())
-			reply.set_seq(packet.seq());
-		reply.set_type(packet.type());
+			query->set_seq(packet.seq());
+		query->set_type(packet.type());
 		if (packet.has_ledgerhash())
-			reply.set_ledgerhash(packet.ledgerhash());
+			query->set_ledgerhash(packet.ledgerhash());
 
-		// This is a very minimal implementation
+		hashes.reserve(packet.objects_size());
 		for (int i = 0; i < packet.objects_size(); ++i)
 		{
-			uint256 hash;
 			const ripple::TMIndexedObject& obj = packet.objects(i);
 			if (obj.has_hash() && (obj.hash().size() == (256/8)))
 			{
+				uint256 hash;
 				memcpy(hash.begin(), obj.hash().data(), 256 / 8);
-				HashedObject::pointer hObj = theApp->getHashedObjectStore().retrieve(hash);
-				if (hObj)
-				{
-					ripple::TMIndexedObject& newObj = *reply.add_objects();
-					newObj.set_hash(hash.begin(), hash.size());
-					newObj.set_data(&hObj->getData().front(), hObj->getData().size());
-					if (obj.has_nodeid())
-						newObj.set_index(obj.nodeid());
-					if (!reply.has_seq() && (hObj->getIndex() != 0))
-						reply.set_seq(hObj->getIndex());
-				}
+				hashes.push_back(hash);
+
+				ripple::TMIndexedObject& wanted = *query->add_objects();
+				wanted.set_hash(obj.hash());
+				if (obj.has_nodeid())
+					wanted.set_nodeid(obj.nodeid());
 			}
 		}
-		cLog(lsTRACE) << "GetObjByHash had " << reply.objects_size() << " of " << packet.objects_size()
-			<< " for " << getIP();
-		sendPacket(boost::make_shared<PackedMessage>(reply, ripple::mtGET_OBJECTS));
+
+		if (++mObjectFetches > PEER_OBJECT_FETCHES)
+		{
+			--mObjectFetches;
+			cLog(lsDEBUG) << "Dropping object query, too many outstanding for " << getIP();
+			punishPeer(LT_RequestNoReply);
+			return;
+		}
+
+		if (!theApp->getHashedObjectStore().fetchBatch(hashes,
+			boost::bind(&Peer::sendObjects, shared_from_this(), query, packet.objects_size(), _1)))
+		{
+			--mObjectFetches;
+			cLog(lsDEBUG) << "Dropping object query, node store busy";
+		}
 	}
 	else
 	{ // this is a reply
@@ -1327,6 +1575,10 @@ void Peer::recvGetLedger(ripple::TMGetLedger& packet)
 	ripple::TMLedgerData reply;
 	bool fatLeaves = true, fatRoot = false;
 
+	// Relayed replies are forwarded as is, so only use bitmap inner nodes when answering the asker directly
+	SHANodeFormat wireFormat = (!packet.has_requestcookie() && mHello.has_compactnodes() && mHello.compactnodes())
+		? snfCOMPACT : snfWIRE;
+
 	if (packet.has_requestcookie())
 		reply.set_requestcookie(packet.requestcookie());
 
@@ -1464,7 +1716,7 @@ void Peer::recvGetLedger(ripple::TMGetLedger& packet)
 			if (map && map->getHash().isNonZero())
 			{ // return account state root node if possible
 				Serializer rootNode(768);
-				if (map->getRootNode(rootNode, snfWIRE))
+				if (map->getRootNode(rootNode, wireFormat))
 				{
 					reply.add_nodes()->set_nodedata(rootNode.getDataPtr(), rootNode.getLength());
 					if (ledger->getTransHash().isNonZero())
@@ -1473,7 +1725,7 @@ void Peer::recvGetLedger(ripple::TMGetLedger& packet)
 						if (map && map->getHash().isNonZero())
 						{
 							rootNode.erase();
-							if (map->getRootNode(rootNode, snfWIRE))
+							if (map->getRootNode(rootNode, wireFormat))
 								reply.add_nodes()->set_nodedata(rootNode.getDataPtr(), rootNode.getLength());
 						}
 					}
@@ -1518,7 +1770,7 @@ void Peer::recvGetLedger(ripple::TMGetLedger& packet)
 		std::list< std::vector<unsigned char> > rawNodes;
 		try
 		{
-			if(map->getNodeFat(mn, nodeIDs, rawNodes, fatRoot, fatLeaves))
+			if(map->getNodeFat(mn, nodeIDs, rawNodes, fatRoot, fatLeaves, wireFormat))
 			{
 				assert(nodeIDs.size() == rawNodes.size());
 				cLog(lsTRACE) << "getNodeFat got " << rawNodes.size() << " nodes";
@@ -1710,6 +1962,9 @@ void Peer::sendHello()
 	h.set_ipv4port(theConfig.PEER_PORT);
 	h.set_nodeprivate(theConfig.PEER_PRIVATE);
 	h.set_testnet(theConfig.TESTNET);
+	h.set_compactnodes(true);
+	h.set_compression(PACKED_CODECS);
+	h.set_squelch(true);
 
 	Ledger::pointer closedLedger = theApp->getLedgerMaster().getClosedLedger();
 	if (closedLedger && closedLedger->isClosed())
@@ -1736,6 +1991,39 @@ void Peer::sendGetPeers()
 	sendPacket(packet);
 }
 
+void Peer::sendSquelch(const std::string& validator, int duration)
+{
+	if (!mHello.has_squelch() || !mHello.squelch())
+		return;
+
+	ripple::TMSquelch squelch;
+
+	squelch.set_squelch(duration != 0);
+	squelch.set_validatorpubkey(validator);
+	if (duration != 0)
+		squelch.set_squelchduration(duration);
+
+	sendPacket(boost::make_shared<PackedMessage>(squelch, ripple::mtSQUELCH));
+}
+
+void Peer::recvSquelch(ripple::TMSquelch& packet)
+{
+	if ((packet.validatorpubkey().size() < 28) || (packet.validatorpubkey().size() > 128))
+	{
+		punishPeer(LT_InvalidRequest);
+		return;
+	}
+
+	if (!packet.squelch())
+	{
+		mSquelch.unsquelch(packet.validatorpubkey());
+		return;
+	}
+
+	int duration = packet.has_squelchduration() ? packet.squelchduration() : SQUELCH_MIN_SECONDS;
+	mSquelch.squelch(packet.validatorpubkey(), upTime() + std::min(duration, SQUELCH_MAX_SECONDS));
+}
+
 void Peer::punishPeer(LoadType l)
 {
 	if (theApp->getLoadManager().adjust(mLoad, l))
@@ -1800,6 +2088,11 @@ Json::Value Peer::getJson()
 	if (!!mClosedLedgerHash)
 		ret["ledger"] = mClosedLedgerHash.GetHex();
 
+	ret["send_queue"]		= mSendQueueCount.load();
+	ret["send_queue_bytes"]	= mSendQueueBytes.load();
+	if (mSendDropped.load() != 0)
+		ret["send_dropped"]	= mSendDropped.load();
+
 	if (mLastStatus.has_newstatus())
 	{
 		switch (mLastStatus.newstatus())
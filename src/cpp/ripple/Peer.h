@@ -16,6 +16,8 @@
 #include "JobQueue.h"
 #include "ProofOfWork.h"
 #include "LoadManager.h"
+#include "LockFreeQueue.h"
+#include "Squelch.h"
 
 typedef std::pair<std::string,int> ipPort;
 
@@ -39,6 +41,7 @@ private:
 	bool			mDetaching;			// True, if detaching.
 	bool 			mActive;
 	bool			mCluster;			// Node in our cluster
+	int				mCompression;		// Codecs we can compress messages to this peer with.
 	RippleAddress	mNodePublic;		// Node public key of peer.
 	std::string		mNodeName;
 	ipPort			mIpPort;
@@ -63,8 +66,17 @@ protected:
 
 	boost::recursive_mutex ioMutex;
 	std::vector<uint8_t> mReadbuf;
-	std::list<PackedMessage::pointer> mSendQ;
-	PackedMessage::pointer mSendingPacket;
+	std::list<PackedMessage::pointer> mSendQ;				// taken from mSendIncoming, under the I/O mutex
+	PackedMessage::pointer mSendingPacket;					// a packet written on its own
+	std::vector<uint8_t> mWriteBuffer;						// or several packets gathered into one write
+	LockFreeQueue<PackedMessage::pointer> mSendIncoming;	// new packets, pushed without a lock
+	boost::atomic<bool> mSendActive;						// a write is in progress or being started
+	boost::atomic<int> mSendQueueCount;						// packets in mSendIncoming and mSendQ
+	boost::atomic<int> mSendQueueBytes;
+	boost::atomic<int> mSendDropped;						// relayed packets dropped as this peer fell behind
+
+	boost::atomic<int> mObjectFetches;						// object queries being read for this peer
+	PeerSquelch mSquelch;									// validators this peer asked us not to relay
 	ripple::TMStatusChange mLastStatus;
 	ripple::TMHello mHello;
 
@@ -79,7 +91,8 @@ protected:
 	void startReadHeader();
 	void startReadBody(unsigned msg_len);
 
-	void sendPacketForce(const PackedMessage::pointer& packet);
+	void startWrite();
+	bool trimSendQueue();
 
 	void sendHello();
 
@@ -92,6 +105,8 @@ protected:
 	void recvGetPeers(ripple::TMGetPeers& packet);
 	void recvPeers(ripple::TMPeers& packet);
 	void recvGetObjectByHash(ripple::TMGetObjectByHash& packet);
+	void sendObjects(const boost::shared_ptr<ripple::TMGetObjectByHash>& query, int asked,
+		const std::vector<HashedObject::pointer>& objects);
 	void recvPing(ripple::TMPing& packet);
 	void recvErrorMessage(ripple::TMErrorMsg& packet);
 	void recvSearchTransaction(ripple::TMSearchTransaction& packet);
@@ -103,6 +118,7 @@ protected:
 	void recvPropose(const boost::shared_ptr<ripple::TMProposeSet>& packet);
 	void recvHaveTxSet(ripple::TMHaveTransactionSet& packet);
 	void recvProofWork(ripple::TMProofWork& packet);
+	void recvSquelch(ripple::TMSquelch& packet);
 
 	void getSessionCookie(std::string& strDst);
 
@@ -141,6 +157,7 @@ public:
 	void sendFullLedger(Ledger::ref ledger);
 	void sendGetFullLedger(uint256& hash);
 	void sendGetPeers();
+	void sendSquelch(const std::string& validator, int duration);
 
 	void punishPeer(LoadType);
 	static void punishPeer(const boost::weak_ptr<Peer>&, LoadType);
@@ -154,6 +171,7 @@ public:
 	bool hasLedger(const uint256& hash) const;
 	bool hasTxSet(const uint256& hash) const;
 	uint64 getPeerId() const				{ return mPeerId; }
+	bool isSquelched(const std::string& validator)	{ return mSquelch.isSquelched(validator, upTime()); }
 
 	const RippleAddress& getNodePublic() const	{ return mNodePublic; }
 	void cycleStatus() { mPreviousLedgerHash = mClosedLedgerHash; mClosedLedgerHash.zero(); }
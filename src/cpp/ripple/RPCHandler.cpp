@@ -21,6 +21,7 @@
 #include "AccountState.h"
 #include "NicknameState.h"
 #include "InstanceCounter.h"
+#include "Metrics.h"
 #include "Offer.h"
 
 SETUP_LOG();
@@ -1393,8 +1394,8 @@ Json::Value RPCHandler::doTxHistory(Json::Value jvRequest)
 		% startIndex);
 
 	{
-		Database* db = theApp->getTxnDB()->getDB();
-		ScopedLock sl (theApp->getTxnDB()->getDBLock());
+		DatabaseReader dbr(theApp->getTxnDB());
+		Database* db = dbr.getDB();
 
 		SQL_FOREACH(db, sql)
 		{
@@ -1459,6 +1460,7 @@ Json::Value RPCHandler::doLedgerCurrent(Json::Value)
 // {
 //    ledger: 'current' | 'closed' | <uint256> | <number>,	// optional
 //    full: true | false	// optional, defaults to false.
+//    transactions: true | false	// optional, defaults to false. List transaction hashes.
 // }
 Json::Value RPCHandler::doLedger(Json::Value jvRequest)
 {
@@ -1491,10 +1493,11 @@ Json::Value RPCHandler::doLedger(Json::Value jvRequest)
 		return rpcError(rpcLGR_NOT_FOUND);
 
 	bool full = jvRequest.isMember("full") && jvRequest["full"].asBool();
+	bool transactions = jvRequest.isMember("transactions") && jvRequest["transactions"].asBool();
 
 	Json::Value ret(Json::objectValue);
 
-	ledger->addJson(ret, full ? LEDGER_JSON_FULL : 0);
+	ledger->addJson(ret, (full ? LEDGER_JSON_FULL : 0) | (transactions ? LEDGER_JSON_DUMP_TXRP : 0));
 
 	return ret;
 }
@@ -1832,10 +1835,30 @@ Json::Value RPCHandler::doGetCounts(Json::Value jvRequest)
 	BOOST_FOREACH(InstanceType::InstanceCount& it, count)
 		ret[it.first] = it.second;
 
+	if (InstanceType::getTelemetry())
+	{
+		Json::Value allocations(Json::objectValue);
+
+		BOOST_FOREACH(const InstanceType::InstanceTelemetry& it, InstanceType::getInstanceTelemetry())
+		{
+			Json::Value& entry	= allocations[it.name];
+
+			entry["created"]	= boost::lexical_cast<std::string>(it.created);
+			if (it.bytes != 0)
+				entry["bytes"]	= boost::lexical_cast<std::string>(it.bytes);
+			entry["per_second"]	= static_cast<int>(it.rate + 0.5);
+		}
+
+		ret["allocations"] = allocations;
+	}
+
 	int dbKB = theApp->getLedgerDB()->getDB()->getKBUsed();
 	if (dbKB > 0)
 		ret["dbKB"] = dbKB;
 
+	ret["node_writes"] = theApp->getHashedObjectStore().getJson();
+	ret["squelch"] = theApp->getConnectionPool().getSquelchJson();
+
 	std::string uptime;
 	int s = upTime();
 	textTime(uptime, s, "year", 365*24*60*60);
@@ -1848,6 +1871,13 @@ Json::Value RPCHandler::doGetCounts(Json::Value jvRequest)
 	return ret;
 }
 
+// {}
+// Latency histograms in microseconds, by name and then by label
+Json::Value RPCHandler::doMetrics(Json::Value)
+{
+	return Metrics::getJson();
+}
+
 Json::Value RPCHandler::doLogLevel(Json::Value jvRequest)
 {
 	// log_level
@@ -2711,6 +2741,7 @@ Json::Value RPCHandler::doCommand(const Json::Value& jvRequest, int iRole)
 		{	"ledger_header",		&RPCHandler::doLedgerHeader,	    false,	optCurrent	},
 		{	"log_level",			&RPCHandler::doLogLevel,		    true,	optNone		},
 		{	"logrotate",			&RPCHandler::doLogRotate,		    true,	optNone		},
+		{	"metrics",				&RPCHandler::doMetrics,			    true,	optNone		},
 //		{	"nickname_info",		&RPCHandler::doNicknameInfo,	    false,	optCurrent	},
 		{	"owner_info",			&RPCHandler::doOwnerInfo,		    false,	optCurrent	},
 		{	"peers",				&RPCHandler::doPeers,			    true,	optNone		},
@@ -2754,6 +2785,12 @@ Json::Value RPCHandler::doCommand(const Json::Value& jvRequest, int iRole)
 		{	"unsubscribe",			&RPCHandler::doUnsubscribe,			false,	optNone		},
 	};
 
+	struct methodName
+	{ // labels the latency histograms, resolved once rather than looked up on every call
+		static std::string get(int i)	{ return commandsA[i].pCommand; }
+	};
+	static LatencyFamily sMethodLatency("rpc", "method", NUMBER(commandsA), &methodName::get);
+
 	int		i = NUMBER(commandsA);
 
 	while (i-- && strCommand != commandsA[i].pCommand)
@@ -2777,6 +2814,7 @@ Json::Value RPCHandler::doCommand(const Json::Value& jvRequest, int iRole)
 	}
 	// XXX Should verify we have a current ledger.
 
+	LatencyTimer timer(sMethodLatency.get(i));
 	boost::recursive_mutex::scoped_lock sl(theApp->getMasterLock());
 	if ((commandsA[i].iOptions & optCurrent) && false)
 	{
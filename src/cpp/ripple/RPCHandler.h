@@ -61,6 +61,7 @@ class RPCHandler
 	Json::Value doLedger(Json::Value params);
 	Json::Value doLogLevel(Json::Value params);
 	Json::Value doLogRotate(Json::Value params);
+	Json::Value doMetrics(Json::Value params);
 	Json::Value doNicknameInfo(Json::Value params);
 	Json::Value doOwnerInfo(Json::Value params);
 	Json::Value doPeers(Json::Value params);
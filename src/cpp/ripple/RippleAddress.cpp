@@ -6,6 +6,7 @@
 
 #include <boost/format.hpp>
 #include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include <openssl/rand.h>
@@ -19,6 +20,25 @@
 
 SETUP_LOG();
 
+namespace
+{
+	// Account IDs are rendered for every row saved and every transaction shown, and the same
+	// accounts come up again and again. A direct mapped cache, locked in stripes, keeps their human form.
+	struct HumanAccountEntry
+	{
+		const char*		alphabet;	// ALPHABET the human form was made with
+		uint160			account;
+		std::string		human;
+
+		HumanAccountEntry() : alphabet(NULL)	{ ; }
+	};
+
+	const int			sHumanCacheSize		= 4096;
+	const int			sHumanCacheLocks	= 64;
+
+	HumanAccountEntry	sHumanCache[sHumanCacheSize];
+	boost::mutex		sHumanCacheLock[sHumanCacheLocks];
+}
 
 RippleAddress::RippleAddress()
 {
@@ -165,20 +185,7 @@ void RippleAddress::setNodePublic(const std::vector<unsigned char>& vPublic)
 
 bool RippleAddress::verifyNodePublic(const uint256& hash, const std::vector<unsigned char>& vchSig) const
 {
-	CKey	pubkey	= CKey();
-	bool	bVerified;
-
-	if (!pubkey.SetPubKey(getNodePublic()))
-	{
-		// Failed to set public key.
-		bVerified	= false;
-	}
-	else
-	{
-		bVerified	= pubkey.Verify(hash, vchSig);
-	}
-
-	return bVerified;
+	return CKey::VerifyPublic(getNodePublic(), hash, vchSig);
 }
 
 bool RippleAddress::verifyNodePublic(const uint256& hash, const std::string& strSig) const
@@ -300,16 +307,10 @@ std::string RippleAddress::humanAccountID() const
 		throw std::runtime_error("unset source - humanAccountID");
 
     case VER_ACCOUNT_ID:
-		return ToString();
+		return createHumanAccountID(uint160(vchData));
 
     case VER_ACCOUNT_PUBLIC:
-	{
-	    RippleAddress	accountID;
-
-	    (void) accountID.setAccountID(getAccountID());
-
-	    return accountID.ToString();
-	}
+		return createHumanAccountID(getAccountID());
 
     default:
 		throw std::runtime_error(str(boost::format("bad source: %d") % int(nVersion)));
@@ -403,21 +404,7 @@ void RippleAddress::setAccountPublic(const RippleAddress& generator, int seq)
 
 bool RippleAddress::accountPublicVerify(const uint256& uHash, const std::vector<unsigned char>& vucSig) const
 {
-	CKey		ckPublic;
-	bool		bVerified;
-
-	if (!ckPublic.SetPubKey(getAccountPublic()))
-	{
-		// Bad private key.
-		cLog(lsWARNING) << "accountPublicVerify: Bad private key.";
-		bVerified	= false;
-	}
-	else
-	{
-		bVerified	= ckPublic.Verify(uHash, vucSig);
-	}
-
-	return bVerified;
+	return CKey::VerifyPublic(getAccountPublic(), uHash, vucSig);
 }
 
 RippleAddress RippleAddress::createAccountID(const uint160& uiAccountID)
@@ -429,6 +416,36 @@ RippleAddress RippleAddress::createAccountID(const uint160& uiAccountID)
 	return na;
 }
 
+std::string RippleAddress::createHumanAccountID(const uint160& uiAccountID)
+{
+	// Account IDs are hashes, so any of their bytes spread evenly over the cache
+	uint32				uIndex;
+	memcpy(&uIndex, uiAccountID.begin(), sizeof(uIndex));
+	uIndex				%= sHumanCacheSize;
+
+	HumanAccountEntry&	entry	= sHumanCache[uIndex];
+	boost::mutex&		lock	= sHumanCacheLock[uIndex % sHumanCacheLocks];
+
+	{
+		boost::mutex::scoped_lock	sl(lock);
+
+		if (entry.alphabet == ALPHABET && entry.account == uiAccountID)
+			return entry.human;
+	}
+
+	std::string			strHuman	= createAccountID(uiAccountID).ToString();
+
+	{
+		boost::mutex::scoped_lock	sl(lock);
+
+		entry.alphabet	= ALPHABET;
+		entry.account	= uiAccountID;
+		entry.human		= strHuman;
+	}
+
+	return strHuman;
+}
+
 //
 // AccountPrivate
 //
@@ -886,6 +903,164 @@ BOOST_AUTO_TEST_CASE( check_crypto )
 	BOOST_CHECK_MESSAGE(vucTextSrc == vucTextRecovered, "Encrypt-decrypt failed.");
 }
 
+// The big number codec the limb codec replaced, kept to check the new one against.
+static std::string EncodeBase58BN(const std::vector<unsigned char>& vucData)
+{
+	CAutoBN_CTX	pctx;
+	CBigNum		bn58	= 58;
+	CBigNum		bn0		= 0;
+	CBigNum		dv, rem;
+
+	// Little endian with an extra zero, so the bignum is positive
+	std::vector<unsigned char>	vucTmp(vucData.size() + 1, 0);
+	std::reverse_copy(vucData.begin(), vucData.end(), vucTmp.begin());
+
+	CBigNum		bn(vucTmp);
+	std::string	str;
+
+	while (bn > bn0)
+	{
+		if (!BN_div(&dv, &rem, &bn, &bn58, pctx))
+			throw bignum_error("EncodeBase58BN : BN_div failed");
+		bn = dv;
+		str += ALPHABET[rem.getuint()];
+	}
+
+	for (std::vector<unsigned char>::const_iterator it = vucData.begin(); it != vucData.end() && *it == 0; ++it)
+		str += ALPHABET[0];
+
+	std::reverse(str.begin(), str.end());
+	return str;
+}
+
+static bool DecodeBase58BN(const std::string& strText, std::vector<unsigned char>& vucRet)
+{
+	CAutoBN_CTX	pctx;
+	CBigNum		bn58	= 58;
+	CBigNum		bn		= 0;
+	CBigNum		bnChar;
+	const char*	psz		= strText.c_str();
+
+	vucRet.clear();
+	while (isspace(*psz))
+		psz++;
+
+	for (const char* p = psz; *p; p++)
+	{
+		const char* p1 = strchr(ALPHABET, *p);
+		if (p1 == NULL)
+		{
+			while (isspace(*p))
+				p++;
+			if (*p != '\0')
+				return false;
+			break;
+		}
+		bnChar.setuint(p1 - ALPHABET);
+		if (!BN_mul(&bn, &bn, &bn58, pctx))
+			throw bignum_error("DecodeBase58BN : BN_mul failed");
+		bn += bnChar;
+	}
+
+	std::vector<unsigned char>	vucTmp	= bn.getvch();
+
+	// Trim off the sign byte
+	if (vucTmp.size() >= 2 && vucTmp.end()[-1] == 0 && vucTmp.end()[-2] >= 0x80)
+		vucTmp.erase(vucTmp.end() - 1);
+
+	int	iZeros	= 0;
+	for (const char* p = psz; *p == ALPHABET[0]; p++)
+		iZeros++;
+
+	vucRet.assign(iZeros + vucTmp.size(), 0);
+	std::reverse_copy(vucTmp.begin(), vucTmp.end(), vucRet.end() - vucTmp.size());
+	return true;
+}
+
+BOOST_AUTO_TEST_CASE( check_base58 )
+{
+	// Round trip lengths and leading zeros across the limb boundaries of the codec.
+	for (int iLength = 0; iLength <= 40; ++iLength)
+	{
+		for (int iZeros = 0; iZeros <= std::min(iLength, 3); ++iZeros)
+		{
+			std::vector<unsigned char>	vucData(iLength, 0);
+			std::vector<unsigned char>	vucDecoded;
+
+			for (int i = iZeros; i < iLength; ++i)
+				vucData[i]	= static_cast<unsigned char>(i * 37 + iLength * 11 + 1);
+
+			std::string	strEncoded	= EncodeBase58(vucData);
+
+			BOOST_CHECK_MESSAGE(DecodeBase58(strEncoded, vucDecoded) && vucDecoded == vucData, strEncoded);
+			BOOST_CHECK(DecodeBase58Check(EncodeBase58Check(vucData), vucDecoded) && vucDecoded == vucData);
+		}
+	}
+
+	// A bug shared by the encoder and decoder would still round trip, so compare both against the big number
+	// codec over random data with runs of leading zeros, and over random digit strings.
+	for (int i = 0; i != 20000; ++i)
+	{
+		std::vector<unsigned char>	vucData(1 + rand() % 64);
+		std::vector<unsigned char>	vucDecoded, vucExpected;
+
+		int	iZeros	= (rand() % 4 == 0) ? rand() % (vucData.size() + 1) : 0;
+		for (size_t j = 0; j != vucData.size(); ++j)
+			vucData[j]	= (j < static_cast<size_t>(iZeros)) ? 0 : static_cast<unsigned char>(rand());
+
+		std::string	strEncoded	= EncodeBase58(vucData);
+
+		BOOST_CHECK_MESSAGE(strEncoded == EncodeBase58BN(vucData), strHex(vucData));
+		BOOST_CHECK_MESSAGE(DecodeBase58(strEncoded, vucDecoded) && vucDecoded == vucData, strEncoded);
+
+		std::string	strDigits(1 + rand() % 90, ALPHABET[0]);
+		for (size_t j = (rand() % 4 == 0) ? rand() % strDigits.size() : 0; j != strDigits.size(); ++j)
+			strDigits[j]	= ALPHABET[rand() % 58];
+
+		BOOST_CHECK_MESSAGE(DecodeBase58(strDigits, vucDecoded) && DecodeBase58BN(strDigits, vucExpected)
+			&& vucDecoded == vucExpected, strDigits);
+	}
+
+	// Standard vectors, in the Bitcoin alphabet the codec was written for.
+	const char*	vectors[][2]	= {
+		{ "61",					"2g" },
+		{ "626262",				"a3gV" },
+		{ "636363",				"aPEr" },
+		{ "73696d706c792061206c6f6e6720737472696e67",			"2cFupjhnEsSn59qHXstmK2ffpLv2" },
+		{ "00eb15231dfceb60925886b67d065299925915aeb172c06647",	"1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9L" },
+		{ "516b6fcd0f",			"ABnLTmg" },
+		{ "bf4f89001e670274dd",	"3SEo3LWLoPntC" },
+		{ "572e4794",			"3EFU7m" },
+		{ "ecac89cad93923c02321",	"EJDM8drfXA6uyA" },
+		{ "10c8511e",			"Rt5zm" },
+		{ "00000000000000000000",	"1111111111" },
+	};
+	const char*	alphabet	= ALPHABET;
+
+	ALPHABET	= "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+	for (size_t i = 0; i != sizeof(vectors) / sizeof(vectors[0]); ++i)
+	{
+		std::vector<unsigned char>	vucData	= strUnHex(vectors[i][0]);
+		std::vector<unsigned char>	vucDecoded;
+
+		BOOST_CHECK_MESSAGE(EncodeBase58(vucData) == vectors[i][1], vectors[i][1]);
+		BOOST_CHECK_MESSAGE(DecodeBase58(vectors[i][1], vucDecoded) && vucDecoded == vucData, vectors[i][1]);
+	}
+	ALPHABET	= alphabet;
+
+	std::vector<unsigned char>	vucDecoded;
+
+	BOOST_CHECK(DecodeBase58(" rrp ", vucDecoded) && vucDecoded.size() == 3 && vucDecoded[2] == 1);
+	BOOST_CHECK(!DecodeBase58("rp0", vucDecoded));
+	BOOST_CHECK(!DecodeBase58("rp rp", vucDecoded));
+
+	// Cached human account IDs must match a fresh encoding, including on a second lookup.
+	RippleAddress	naAccount	= RippleAddress::createAccountID("rHb9CJAWyB4rj91VRWn96DkukG4bwdtyTh");
+
+	BOOST_CHECK(RippleAddress::createHumanAccountID(naAccount.getAccountID()) == "rHb9CJAWyB4rj91VRWn96DkukG4bwdtyTh");
+	BOOST_CHECK(naAccount.humanAccountID() == "rHb9CJAWyB4rj91VRWn96DkukG4bwdtyTh");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 // vim:ts=4
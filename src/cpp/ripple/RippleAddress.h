@@ -78,8 +78,7 @@ public:
 
 	static RippleAddress createAccountID(const uint160& uiAccountID);
 
-	static std::string createHumanAccountID(const uint160& uiAccountID)
-	{ return createAccountID(uiAccountID).humanAccountID(); }
+	static std::string createHumanAccountID(const uint160& uiAccountID);	// cached
 
 	static std::string createHumanAccountID(const std::vector<unsigned char>& vPrivate)
 	{ return createAccountPrivate(vPrivate).humanAccountID(); }
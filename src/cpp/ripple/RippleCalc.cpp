@@ -289,7 +289,7 @@ TER PathState::pushNode(
 //
 // terStatus = tesSUCCESS, temBAD_PATH, terNO_LINE, or temBAD_PATH_LOOP
 void PathState::setExpanded(
-	const LedgerEntrySet&	lesSource,
+	LedgerEntrySet&			lesSource,
 	const STPath&			spSourcePath,
 	const uint160&			uReceiverID,
 	const uint160&			uSenderID
@@ -304,7 +304,7 @@ void PathState::setExpanded(
 	const uint160	uOutIssuerID	= saOutReq.getIssuer();
 	const uint160	uSenderIssuerID	= !!uMaxCurrencyID ? uSenderID : ACCOUNT_XRP;	// Sender is always issuer for non-XRP.
 
-	lesEntries	= lesSource.duplicate();
+	lesEntries	= lesSource.duplicate();	// Layered over lesSource, only our changes are copied.
 
 	terStatus	= tesSUCCESS;
 
@@ -830,7 +830,7 @@ TER RippleCalc::calcNodeAdvance(
 		if (bDirectAdvance)
 		{
 			// Get next quality.
-			uDirectTip		= lesActive.getLedger()->getNextLedgerIndex(uDirectTip, uDirectEnd);
+			uDirectTip		= lesActive.getNextLedgerIndex(uDirectTip, uDirectEnd);
 			bDirectDirDirty	= true;
 			bDirectAdvance	= false;
 
@@ -914,7 +914,7 @@ TER RippleCalc::calcNodeAdvance(
 
 			cLog(lsINFO) << boost::str(boost::format("calcNodeAdvance: uOfrOwnerID=%s") % RippleAddress::createHumanAccountID(uOfrOwnerID));
 
-			if (sleOffer->isFieldPresent(sfExpiration) && sleOffer->getFieldU32(sfExpiration) <= lesActive.getLedger()->getParentCloseTimeNC())
+			if (sleOffer->isFieldPresent(sfExpiration) && sleOffer->getFieldU32(sfExpiration) <= lesActive.getParentCloseTime())
 			{
 				// Offer is expired.
 				cLog(lsINFO) << "calcNodeAdvance: expired offer";
@@ -2528,6 +2528,7 @@ cLog(lsDEBUG) << boost::str(boost::format("rippleCalc: Build path: %d: status: %
 	saMaxAmountAct	= STAmount(saMaxAmountReq.getCurrency(), saMaxAmountReq.getIssuer());
 	saDstAmountAct	= STAmount(saDstAmountReq.getCurrency(), saDstAmountReq.getIssuer());
 
+	lesActive.checkpoint();
     const LedgerEntrySet	lesBase			= lesActive;							// Checkpoint with just fees paid.
     const uint64			uQualityLimit	= bLimitQuality ? STAmount::getRate(saDstAmountReq, saMaxAmountReq) : 0;
 	// When processing, don't want to complicate directory walking with deletion.
@@ -2537,6 +2538,7 @@ int iPass	= 0;
     while (temUNCERTAIN == terResult)
     {
 	    int						iBest			= -1;
+		lesActive.checkpoint();														// Freeze, so restoring only drops a path's changes.
 	    const LedgerEntrySet	lesCheckpoint	= lesActive;
 		int						iDry			= 0;
 		bool					bMultiQuality	= false;					// True, if ever computed multi-quality.
@@ -2688,6 +2690,8 @@ cLog(lsDEBUG) << boost::str(boost::format("rippleCalc: Summary: %d rate: %s qual
 		}
 	}
 
+	lesActive.flatten();	// Callers iterate the set, give them back a single layer.
+
 	return terResult;
 }
 
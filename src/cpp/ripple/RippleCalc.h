@@ -122,7 +122,7 @@ public:
 	 : mLedger(psSrc.mLedger), saInReq(psSrc.saInReq), saOutReq(psSrc.saOutReq) { ; }
 
 	void setExpanded(
-		const LedgerEntrySet&	lesSource,
+		LedgerEntrySet&			lesSource,
 		const STPath&			spSourcePath,
 		const uint160&			uReceiverID,
 		const uint160&			uSenderID
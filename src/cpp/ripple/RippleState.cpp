@@ -1,7 +1,7 @@
 #include "RippleState.h"
 
 
-AccountItem::pointer RippleState::makeItem(const uint160& accountID, SerializedLedgerEntry::ref ledgerEntry)
+AccountItem::pointer RippleState::makeItem(const uint160& accountID, SerializedLedgerView::ref ledgerEntry)
 {
 	if (!ledgerEntry || ledgerEntry->getType() != ltRIPPLE_STATE) return(AccountItem::pointer());
 	RippleState* rs=new RippleState(ledgerEntry);
@@ -10,7 +10,7 @@ AccountItem::pointer RippleState::makeItem(const uint160& accountID, SerializedL
 	return(AccountItem::pointer(rs));
 }
 
-RippleState::RippleState(SerializedLedgerEntry::ref ledgerEntry) : AccountItem(ledgerEntry),
+RippleState::RippleState(SerializedLedgerView::ref ledgerEntry) : AccountItem(ledgerEntry),
 	mValid(false),
 	mViewLowest(true)
 {
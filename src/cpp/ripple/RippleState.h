@@ -35,11 +35,11 @@ private:
 	bool							mValid;
 	bool							mViewLowest;
 
-	RippleState(SerializedLedgerEntry::ref ledgerEntry);	// For accounts in a ledger
+	RippleState(SerializedLedgerView::ref ledgerEntry);	// For accounts in a ledger
 
 public:
 	RippleState(){ }
-	AccountItem::pointer makeItem(const uint160& accountID, SerializedLedgerEntry::ref ledgerEntry);
+	AccountItem::pointer makeItem(const uint160& accountID, SerializedLedgerView::ref ledgerEntry);
 	LedgerEntryType getType(){ return(ltRIPPLE_STATE); }
 
 	void					setViewAccount(const uint160& accountID);
@@ -58,10 +58,6 @@ public:
 	uint32				getQualityIn() const		{ return((uint32) (mViewLowest ? mLowQualityIn : mHighQualityIn)); }
 	uint32				getQualityOut() const		{ return((uint32) (mViewLowest ? mLowQualityOut : mHighQualityOut)); }
 
-	SerializedLedgerEntry::pointer getSLE() { return mLedgerEntry; }
-	const SerializedLedgerEntry& peekSLE() const { return *mLedgerEntry; }
-	SerializedLedgerEntry& peekSLE() { return *mLedgerEntry; }
-
 	std::vector<unsigned char> getRaw() const;
 };
 #endif
@@ -8,6 +8,11 @@
 #include <boost/smart_ptr/make_shared.hpp>
 #include <boost/test/unit_test.hpp>
 #include <iostream>
+#include <cstdio>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 #include "Serializer.h"
 #include "BitcoinUtil.h"
@@ -18,8 +23,8 @@
 SETUP_LOG();
 
 DECLARE_INSTANCE(SHAMap);
-DECLARE_INSTANCE(SHAMapItem);
-DECLARE_INSTANCE(SHAMapTreeNode);
+DECLARE_SIZED_INSTANCE(SHAMapItem, SHAMapItem);
+DECLARE_SIZED_INSTANCE(SHAMapTreeNode, SHAMapTreeNode);
 
 void SHAMapNode::setHash() const
 {
@@ -49,14 +54,14 @@ std::size_t hash_value(const uint160& u)
 
 SHAMap::SHAMap(SHAMapType t, uint32 seq) : mSeq(seq), mState(smsModifying), mType(t)
 {
-	root = boost::make_shared<SHAMapTreeNode>(mSeq, SHAMapNode(0, uint256()));
+	root = SHAMapTreeNode::pointer(new SHAMapTreeNode(mSeq, SHAMapNode(0, uint256())));
 	root->makeInner();
 	mTNByID[*root] = root;
 }
 
 SHAMap::SHAMap(SHAMapType t, const uint256& hash) : mSeq(1), mState(smsSynching), mType(t)
 { // FIXME: Need to acquire root node
-	root = boost::make_shared<SHAMapTreeNode>(mSeq, SHAMapNode(0, uint256()));
+	root = SHAMapTreeNode::pointer(new SHAMapTreeNode(mSeq, SHAMapNode(0, uint256())));
 	root->makeInner();
 	mTNByID[*root] = root;
 }
@@ -235,7 +240,7 @@ void SHAMap::returnNode(SHAMapTreeNode::pointer& node, bool modify)
 	{ // have a CoW
 		assert(node->getSeq() < mSeq);
 
-		node = boost::make_shared<SHAMapTreeNode>(*node, mSeq); // here's to the new node, same as the old node
+		node = SHAMapTreeNode::pointer(new SHAMapTreeNode(*node, mSeq)); // here's to the new node, same as the old node
 		assert(node->isValid());
 
 		mTNByID[*node] = node;
@@ -596,8 +601,7 @@ bool SHAMap::addGiveItem(SHAMapItem::ref item, bool isTransaction, bool hasMeta)
 #endif
 		int branch = node->selectBranch(tag);
 		assert(node->isEmptyBranch(branch));
-		SHAMapTreeNode::pointer newNode =
-			boost::make_shared<SHAMapTreeNode>(node->getChildNodeID(branch), item, type, mSeq);
+		SHAMapTreeNode::pointer newNode(new SHAMapTreeNode(node->getChildNodeID(branch), item, type, mSeq));
 		if (!mTNByID.insert(std::make_pair(SHAMapNode(*newNode), newNode)).second)
 		{
 			std::cerr << "Node: " << *node << std::endl;
@@ -628,8 +632,7 @@ bool SHAMap::addGiveItem(SHAMapItem::ref item, bool isTransaction, bool hasMeta)
 			std::cerr << "need new inner node at " << node->getDepth() << ", "
 				<< b1 << "==" << b2 << std::endl;
 #endif
-			SHAMapTreeNode::pointer newNode =
-				boost::make_shared<SHAMapTreeNode>(mSeq, node->getChildNodeID(b1));
+			SHAMapTreeNode::pointer newNode(new SHAMapTreeNode(mSeq, node->getChildNodeID(b1)));
 			newNode->makeInner();
 			if (!mTNByID.insert(std::make_pair(SHAMapNode(*newNode), newNode)).second)
 				assert(false);
@@ -640,15 +643,14 @@ bool SHAMap::addGiveItem(SHAMapItem::ref item, bool isTransaction, bool hasMeta)
 
 		// we can add the two leaf nodes here
 		assert(node->isInner());
-		SHAMapTreeNode::pointer newNode =
-			boost::make_shared<SHAMapTreeNode>(node->getChildNodeID(b1), item, type, mSeq);
+		SHAMapTreeNode::pointer newNode(new SHAMapTreeNode(node->getChildNodeID(b1), item, type, mSeq));
 		assert(newNode->isValid() && newNode->isLeaf());
 		if (!mTNByID.insert(std::make_pair(SHAMapNode(*newNode), newNode)).second)
 			assert(false);
 		node->setChildHash(b1, newNode->getNodeHash()); // OPTIMIZEME hash op not needed
 		trackNewNode(newNode);
 
-		newNode = boost::make_shared<SHAMapTreeNode>(node->getChildNodeID(b2), otherItem, type, mSeq);
+		newNode = SHAMapTreeNode::pointer(new SHAMapTreeNode(node->getChildNodeID(b2), otherItem, type, mSeq));
 		assert(newNode->isValid() && newNode->isLeaf());
 		if (!mTNByID.insert(std::make_pair(SHAMapNode(*newNode), newNode)).second)
 			assert(false);
@@ -662,7 +664,7 @@ bool SHAMap::addGiveItem(SHAMapItem::ref item, bool isTransaction, bool hasMeta)
 
 bool SHAMap::addItem(const SHAMapItem& i, bool isTransaction, bool hasMetaData)
 {
-	return addGiveItem(boost::make_shared<SHAMapItem>(i), isTransaction, hasMetaData);
+	return addGiveItem(boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), i), isTransaction, hasMetaData);
 }
 
 bool SHAMap::updateGiveItem(SHAMapItem::ref item, bool isTransaction, bool hasMeta)
@@ -716,8 +718,7 @@ SHAMapTreeNode::pointer SHAMap::fetchNodeExternal(const SHAMapNode& id, const ui
 
 	try
 	{
-		SHAMapTreeNode::pointer ret =
-			boost::make_shared<SHAMapTreeNode>(id, obj->getData(), mSeq, snfPREFIX, hash);
+		SHAMapTreeNode::pointer ret(new SHAMapTreeNode(id, obj->getData(), mSeq, snfPREFIX, hash));
 		if (id != *ret)
 		{
 			cLog(lsFATAL) << "id:" << id << ", got:" << *ret;
@@ -944,6 +945,73 @@ BOOST_AUTO_TEST_CASE( SHAMap_test )
 	if (map2->getHash() != mapHash) BOOST_FAIL("bad snapshot");
 }
 
+static void fillStateMap(SHAMap& sMap, int iItems)
+{ // state-sized items under random looking keys
+	for (int i = 0; i < iItems; ++i)
+	{
+		Serializer s;
+		s.add32(i);
+		s.add256(Serializer::getSHA512Half(s.peekData()));
+		sMap.addGiveItem(boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), s.getSHA512Half(), s.peekData()),
+			false, false);
+	}
+	sMap.getHash();
+}
+
+BOOST_AUTO_TEST_CASE( SHAMap_memory )
+{ // every node and item goes back when the map does
+	int iStartNodes = IT_SHAMapTreeNode.getCount(), iStartItems = IT_SHAMapItem.getCount();
+
+	{
+		SHAMap sMap(smtFREE);
+		fillStateMap(sMap, 10000);
+		if (IT_SHAMapItem.getCount() - iStartItems != 10000) BOOST_FAIL("SHAMap item count");
+	}
+
+	if ((IT_SHAMapTreeNode.getCount() != iStartNodes) || (IT_SHAMapItem.getCount() != iStartItems))
+		BOOST_FAIL("SHAMap leaked nodes or items");
+}
+
+#ifdef ENABLE_BENCHMARKS
+
+static int getResidentKB()
+{ // resident set size, or zero where we can't tell
+	int kb = 0;
+#ifdef __linux__
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm)
+	{
+		long pages, resident;
+		if (fscanf(statm, "%ld %ld", &pages, &resident) == 2)
+			kb = static_cast<int>(resident * (sysconf(_SC_PAGESIZE) / 1024));
+		fclose(statm);
+	}
+#endif
+	return kb;
+}
+
+BOOST_AUTO_TEST_CASE( SHAMap_memory_bench )
+{ // load a large state-sized tree and report what it costs
+	const int iItems = 250000;
+
+	int iStartKB = getResidentKB();
+	int iStartNodes = IT_SHAMapTreeNode.getCount(), iStartItems = IT_SHAMapItem.getCount();
+
+	{
+		SHAMap sMap(smtFREE);
+		fillStateMap(sMap, iItems);
+
+		cLog(lsINFO) << "SHAMap " << iItems << " items: RSS " << iStartKB << "KB -> " << getResidentKB() << "KB, "
+			<< (IT_SHAMapTreeNode.getCount() - iStartNodes) << " nodes, "
+			<< (IT_SHAMapItem.getCount() - iStartItems) << " items";
+	}
+
+	SlabPool::releaseAll();
+	cLog(lsINFO) << "SHAMap released: RSS " << getResidentKB() << "KB";
+}
+
+#endif
+
 BOOST_AUTO_TEST_SUITE_END();
 
 // vim:ts=4
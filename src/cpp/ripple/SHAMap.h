@@ -6,11 +6,14 @@
 #include <stack>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/atomic.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/unordered_map.hpp>
 
 #include "types.h"
 #include "uint256.h"
+#include "SlabPool.h"
 #include "ScopedLock.h"
 #include "Serializer.h"
 #include "HashedObject.h"
@@ -131,11 +134,16 @@ public:
 	virtual void dump();
 };
 
+// Items and their reference counts share one chunk of a sharded slab:
+// boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), ...)
+typedef SlabAllocator<SHAMapItem> SHAMapItemAllocator;
+
 enum SHANodeFormat
 {
 	snfPREFIX	= 1, // Form that hashes to its official hash
 	snfWIRE		= 2, // Compressed form used on the wire
 	snfHASH		= 3, // just the hash
+	snfCOMPACT	= 4, // Wire form with bitmap inner nodes, for peers that accept it
 };
 
 enum SHAMapType
@@ -150,8 +158,9 @@ class SHAMapTreeNode : public SHAMapNode, public IS_INSTANCE(SHAMapTreeNode)
 	friend class SHAMap;
 
 public:
-	typedef boost::shared_ptr<SHAMapTreeNode>			pointer;
-	typedef const boost::shared_ptr<SHAMapTreeNode>&	ref;
+	// Nodes are counted intrusively and carved from a slab, so a node costs a single small allocation
+	typedef boost::intrusive_ptr<SHAMapTreeNode>			pointer;
+	typedef const boost::intrusive_ptr<SHAMapTreeNode>&	ref;
 
 	enum TNType
 	{
@@ -164,13 +173,24 @@ public:
 
 private:
 	uint256	mHash;
-	uint256 mHashes[16];
+	uint256* mHashes;		// Populated child hashes in branch order, inner nodes only
+	uint16 mBranches;		// Bitmap of populated branches
 	SHAMapItem::pointer mItem;
 	uint32 mSeq, mAccessSeq;
 	TNType mType;
 	bool mFullBelow;
+	boost::atomic<int> mRefCount;
 
 	bool updateHash();
+	void setChildHashes(const uint256* hashes);
+	void getChildHashes(uint256* hashes) const;
+	void resizeBranches(uint16 branches);
+	int branchIndex(int m) const		{ return countBranches(mBranches & ((1 << m) - 1)); }
+
+	static const uint256 sZeroHash;
+
+	friend void intrusive_ptr_add_ref(SHAMapTreeNode*);
+	friend void intrusive_ptr_release(SHAMapTreeNode*);
 
 	SHAMapTreeNode(const SHAMapTreeNode&); // no implementation
 	SHAMapTreeNode& operator=(const SHAMapTreeNode&); // no implementation
@@ -185,6 +205,11 @@ public:
 		SHANodeFormat format, const uint256& hash);
 	void addRaw(Serializer &, SHANodeFormat format);
 
+	~SHAMapTreeNode();
+
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+
 	virtual bool isPopulated() const { return true; }
 
 	// node functions
@@ -206,14 +231,25 @@ public:
 	// inner node functions
 	bool isInnerNode() const	{ return !mItem; }
 	bool setChildHash(int m, const uint256& hash);
-	bool isEmptyBranch(int m) const { return mHashes[m].isZero(); }
+	bool isEmptyBranch(int m) const { return (mBranches & (1 << m)) == 0; }
 	bool isEmpty() const;
 	int getBranchCount() const;
 	void makeInner();
 	const uint256& getChildHash(int m) const
 	{
 		assert((m >= 0) && (m < 16) && (mType == tnINNER));
-		return mHashes[m];
+		return isEmptyBranch(m) ? sZeroHash : mHashes[branchIndex(m)];
+	}
+
+	static int countBranches(uint32 branches)
+	{
+#ifdef __GNUC__
+		return __builtin_popcount(branches);
+#else
+		static const int nibbleBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+		return nibbleBits[branches & 0xf] + nibbleBits[(branches >> 4) & 0xf]
+			+ nibbleBits[(branches >> 8) & 0xf] + nibbleBits[(branches >> 12) & 0xf];
+#endif
 	}
 
 	// item node function
@@ -233,6 +269,20 @@ public:
 	virtual std::string getString() const;
 };
 
+inline void intrusive_ptr_add_ref(SHAMapTreeNode* node)
+{
+	node->mRefCount.fetch_add(1, boost::memory_order_relaxed);
+}
+
+inline void intrusive_ptr_release(SHAMapTreeNode* node)
+{
+	if (node->mRefCount.fetch_sub(1, boost::memory_order_release) == 1)
+	{
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		delete node;
+	}
+}
+
 enum SHAMapState
 {
 	smsModifying = 0,		// Objects can be added and removed (like an open ledger)
@@ -420,7 +470,7 @@ public:
 	void getMissingNodes(std::vector<SHAMapNode>& nodeIDs, std::vector<uint256>& hashes, int max,
 		SHAMapSyncFilter* filter);
 	bool getNodeFat(const SHAMapNode& node, std::vector<SHAMapNode>& nodeIDs,
-	 std::list<std::vector<unsigned char> >& rawNode, bool fatRoot, bool fatLeaves);
+	 std::list<std::vector<unsigned char> >& rawNode, bool fatRoot, bool fatLeaves, SHANodeFormat format = snfWIRE);
 	bool getRootNode(Serializer& s, SHANodeFormat format);
 	std::vector<uint256> getNeededHashes(int max);
 	SMAddNode addRootNode(const uint256& hash, const std::vector<unsigned char>& rootNode, SHANodeFormat format,
@@ -451,7 +501,7 @@ public:
 	uint32 getSeq()				{ return mSeq; }
 
 	// overloads for backed maps
-	boost::shared_ptr<SHAMapTreeNode> fetchNodeExternal(const SHAMapNode& id, const uint256& hash);
+	SHAMapTreeNode::pointer fetchNodeExternal(const SHAMapNode& id, const uint256& hash);
 
 	bool operator==(const SHAMap& s) { return getHash() == s.getHash(); }
 
@@ -176,36 +176,53 @@ void SHAMapNode::dump() const
 	cLog(lsDEBUG) << getString();
 }
 
+void* SHAMapTreeNode::operator new(size_t size)
+{ // The slabs are process-wide: nodes are shared between maps of different ledgers
+	assert(size == sizeof(SHAMapTreeNode));
+	return SlabPool::get<sizeof(SHAMapTreeNode)>().malloc();
+}
+
+void SHAMapTreeNode::operator delete(void* ptr)
+{
+	SlabPool::get<sizeof(SHAMapTreeNode)>().free(ptr);
+}
+
+const uint256 SHAMapTreeNode::sZeroHash;
+
 SHAMapTreeNode::SHAMapTreeNode(uint32 seq, const SHAMapNode& nodeID) : SHAMapNode(nodeID), mHash(0),
-	mSeq(seq), mAccessSeq(seq),	mType(tnERROR), mFullBelow(false)
+	mHashes(NULL), mBranches(0), mSeq(seq), mAccessSeq(seq),	mType(tnERROR), mFullBelow(false), mRefCount(0)
 {
 }
 
 SHAMapTreeNode::SHAMapTreeNode(const SHAMapTreeNode& node, uint32 seq) : SHAMapNode(node),
-		mHash(node.mHash), mSeq(seq), mType(node.mType), mFullBelow(false)
+		mHash(node.mHash), mHashes(NULL), mBranches(0), mSeq(seq), mType(node.mType), mFullBelow(false), mRefCount(0)
 {
 	if (node.mItem)
-		mItem = boost::make_shared<SHAMapItem>(*node.mItem);
+		mItem = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), *node.mItem);
 	else
-		memcpy(mHashes, node.mHashes, sizeof(mHashes));
+	{
+		resizeBranches(node.mBranches);
+		std::copy(node.mHashes, node.mHashes + countBranches(mBranches), mHashes);
+	}
 }
 
 SHAMapTreeNode::SHAMapTreeNode(const SHAMapNode& node, SHAMapItem::ref item, TNType type, uint32 seq) :
-	SHAMapNode(node), mItem(item), mSeq(seq), mType(type), mFullBelow(true)
+	SHAMapNode(node), mHashes(NULL), mBranches(0), mItem(item), mSeq(seq), mType(type), mFullBelow(true), mRefCount(0)
 {
 	assert(item->peekData().size() >= 12);
 	updateHash();
 }
 
 SHAMapTreeNode::SHAMapTreeNode(const SHAMapNode& id, const std::vector<unsigned char>& rawNode, uint32 seq,
-	SHANodeFormat format, const uint256& hash) : SHAMapNode(id), mSeq(seq), mType(tnERROR), mFullBelow(false)
+	SHANodeFormat format, const uint256& hash) : SHAMapNode(id), mHashes(NULL), mBranches(0), mSeq(seq),
+	mType(tnERROR), mFullBelow(false), mRefCount(0)
 {
-	if (format == snfWIRE)
+	if ((format == snfWIRE) || (format == snfCOMPACT))
 	{
 		Serializer s(rawNode);
 		int type = s.removeLastByte();
 		int len = s.getLength();
-		if ((type < 0) || (type > 4))
+		if ((type < 0) || (type > 5))
 		{
 #ifdef DEBUG
 			std::cerr << "Invalid wire format node" << std::endl;
@@ -217,7 +234,7 @@ SHAMapTreeNode::SHAMapTreeNode(const SHAMapNode& id, const std::vector<unsigned
 
 		if (type == 0)
 		{ // transaction
-			mItem = boost::make_shared<SHAMapItem>(s.getPrefixHash(sHP_TransactionID), s.peekData());
+			mItem = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), s.getPrefixHash(sHP_TransactionID), s.peekData());
 			mType = tnTRANSACTION_NM;
 		}
 		else if (type == 1)
@@ -228,25 +245,42 @@ SHAMapTreeNode::SHAMapTreeNode(const SHAMapNode& id, const std::vector<unsigned
 			s.get256(u, len - (256 / 8));
 			s.chop(256 / 8);
 			if (u.isZero()) throw std::runtime_error("invalid AS node");
-			mItem = boost::make_shared<SHAMapItem>(u, s.peekData());
+			mItem = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), u, s.peekData());
 			mType = tnACCOUNT_STATE;
 		}
 		else if (type == 2)
 		{ // full inner
 			if (len != 512)
 				throw std::runtime_error("invalid FI node");
+			uint256 hashes[16];
 			for (int i = 0; i < 16; ++i)
-				s.get256(mHashes[i], i * 32);
+				s.get256(hashes[i], i * 32);
+			setChildHashes(hashes);
 			mType = tnINNER;
 		}
 		else if (type == 3)
 		{ // compressed inner
+			uint256 hashes[16];
 			for (int i = 0; i < (len / 33); ++i)
 			{
 				int pos;
 				s.get8(pos, 32 + (i * 33));
 				if ((pos < 0) || (pos >= 16)) throw std::runtime_error("invalid CI node");
-				s.get256(mHashes[pos], i * 33);
+				s.get256(hashes[pos], i * 33);
+			}
+			setChildHashes(hashes);
+			mType = tnINNER;
+		}
+		else if (type == 5)
+		{ // bitmap inner: branch bitmap then the populated hashes in order
+			uint16 branches;
+			if ((len < 2) || !s.get16(branches, 0) || (len != (2 + 32 * countBranches(branches))))
+				throw std::runtime_error("invalid BI node");
+			resizeBranches(branches);
+			for (int i = 0, count = countBranches(branches); i < count; ++i)
+			{
+				s.get256(mHashes[i], 2 + i * 32);
+				if (mHashes[i].isZero()) throw std::runtime_error("invalid BI node");
 			}
 			mType = tnINNER;
 		}
@@ -259,7 +293,7 @@ SHAMapTreeNode::SHAMapTreeNode(const SHAMapNode& id, const std::vector<unsigned
 			s.chop(256 / 8);
 			if (u.isZero())
 				throw std::runtime_error("invalid TM node");
-			mItem = boost::make_shared<SHAMapItem>(u, s.peekData());
+			mItem = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), u, s.peekData());
 			mType = tnTRANSACTION_MD;
 		}
 	}
@@ -278,7 +312,7 @@ SHAMapTreeNode::SHAMapTreeNode(const SHAMapNode& id, const std::vector<unsigned
 
 		if (prefix == sHP_TransactionID)
 		{
-			mItem = boost::make_shared<SHAMapItem>(Serializer::getSHA512Half(rawNode), s.peekData());
+			mItem = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), Serializer::getSHA512Half(rawNode), s.peekData());
 			mType = tnTRANSACTION_NM;
 		}
 		else if (prefix == sHP_LeafNode)
@@ -293,15 +327,17 @@ SHAMapTreeNode::SHAMapTreeNode(const SHAMapNode& id, const std::vector<unsigned
 				cLog(lsINFO) << "invalid PLN node";
 				throw std::runtime_error("invalid PLN node");
 			}
-			mItem = boost::make_shared<SHAMapItem>(u, s.peekData()); 
+			mItem = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), u, s.peekData()); 
 			mType = tnACCOUNT_STATE;
 		}
 		else if (prefix == sHP_InnerNode)
 		{
 			if (s.getLength() != 512)
 				throw std::runtime_error("invalid PIN node");
+			uint256 hashes[16];
 			for (int i = 0; i < 16; ++i)
-				s.get256(mHashes[i] , i * 32);
+				s.get256(hashes[i] , i * 32);
+			setChildHashes(hashes);
 			mType = tnINNER;
 		}
 		else if (prefix == sHP_TransactionNode)
@@ -311,7 +347,7 @@ SHAMapTreeNode::SHAMapTreeNode(const SHAMapNode& id, const std::vector<unsigned
 			uint256 txID;
 			s.get256(txID, s.getLength() - 32);
 			s.chop(32);
-			mItem = boost::make_shared<SHAMapItem>(txID, s.peekData());
+			mItem = boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), txID, s.peekData());
 			mType = tnTRANSACTION_MD;
 		}
 		else
@@ -345,21 +381,16 @@ bool SHAMapTreeNode::updateHash()
 
 	if (mType == tnINNER)
 	{
-		bool empty = true;
-		for (int i = 0; i < 16; ++i)
-			if (mHashes[i].isNonZero())
-			{
-				empty = false;
-				break;
-			}
-		if(!empty)
+		if (mBranches != 0)
 		{
-			nh = Serializer::getPrefixHash(sHP_InnerNode, reinterpret_cast<unsigned char *>(mHashes), sizeof(mHashes));
+			uint256 hashes[16];
+			getChildHashes(hashes);
+			nh = Serializer::getPrefixHash(sHP_InnerNode, reinterpret_cast<unsigned char *>(hashes), sizeof(hashes));
 #ifdef PARANOID
 			Serializer s;
 			s.add32(sHP_InnerNode);
 			for(int i = 0; i < 16; ++i)
-				s.add256(mHashes[i]);
+				s.add256(hashes[i]);
 			assert(nh == s.getSHA512Half());
 #endif
 		}
@@ -395,7 +426,7 @@ bool SHAMapTreeNode::updateHash()
 
 void SHAMapTreeNode::addRaw(Serializer& s, SHANodeFormat format)
 {
-	assert((format == snfPREFIX) || (format == snfWIRE) || (format == snfHASH));
+	assert((format == snfPREFIX) || (format == snfWIRE) || (format == snfHASH) || (format == snfCOMPACT));
 	if (mType == tnERROR)
 		throw std::runtime_error("invalid I node type");
 
@@ -410,16 +441,23 @@ void SHAMapTreeNode::addRaw(Serializer& s, SHANodeFormat format)
 		{
 			s.add32(sHP_InnerNode);
 			for (int i = 0; i < 16; ++i)
+				s.add256(getChildHash(i));
+		}
+		else if (format == snfCOMPACT)
+		{ // bitmap node
+			s.add16(mBranches);
+			for (int i = 0, count = getBranchCount(); i < count; ++i)
 				s.add256(mHashes[i]);
+			s.add8(5);
 		}
 		else
 		{
 			if (getBranchCount() < 12)
 			{ // compressed node
 				for (int i = 0; i < 16; ++i)
-					if (mHashes[i].isNonZero())
+					if (!isEmptyBranch(i))
 					{
-						s.add256(mHashes[i]);
+						s.add256(getChildHash(i));
 						s.add8(i);
 					}
 				s.add8(3);
@@ -427,7 +465,7 @@ void SHAMapTreeNode::addRaw(Serializer& s, SHANodeFormat format)
 			else
 			{
 				for (int i = 0; i < 16; ++i)
-					s.add256(mHashes[i]);
+					s.add256(getChildHash(i));
 				s.add8(2);
 			}
 		}
@@ -482,6 +520,7 @@ void SHAMapTreeNode::addRaw(Serializer& s, SHANodeFormat format)
 bool SHAMapTreeNode::setItem(SHAMapItem::ref i, TNType type)
 {
 	uint256 hash = getNodeHash();
+	resizeBranches(0);
 	mType = type;
 	mItem = i;
 	assert(isLeaf());
@@ -492,34 +531,101 @@ bool SHAMapTreeNode::setItem(SHAMapItem::ref i, TNType type)
 SHAMapItem::pointer SHAMapTreeNode::getItem() const
 {
 	assert(isLeaf());
-	return boost::make_shared<SHAMapItem>(*mItem);
+	return boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), *mItem);
 }
 
 bool SHAMapTreeNode::isEmpty() const
 {
 	assert(isInner());
-	for (int i = 0; i < 16; ++i)
-		if (mHashes[i].isNonZero()) return false;
-	return true;
+	return mBranches == 0;
 }
 
 int SHAMapTreeNode::getBranchCount() const
 {
 	assert(isInner());
-	int ret = 0;
-	for (int i = 0; i < 16; ++i)
-		if (mHashes[i].isNonZero()) ++ret;
-	return ret;
+	return countBranches(mBranches);
 }
 
 void SHAMapTreeNode::makeInner()
 {
 	mItem.reset();
-	memset(mHashes, 0, sizeof(mHashes));
+	resizeBranches(0);
 	mType = tnINNER;
 	mHash.zero();
 }
 
+static int branchCapacity(int count)
+{ // grow and shrink in steps so most hash changes don't reallocate
+	if (count == 0)
+		return 0;
+	if (count <= 2)
+		return 2;
+	if (count <= 4)
+		return 4;
+	if (count <= 8)
+		return 8;
+	return 16;
+}
+
+static SlabPool& hashPool(int capacity)
+{ // Child hash arrays come from slabs too, or every inner node would cost a heap block again
+	switch (capacity)
+	{
+		case 2:		return SlabPool::get<2 * sizeof(uint256)>();
+		case 4:		return SlabPool::get<4 * sizeof(uint256)>();
+		case 8:		return SlabPool::get<8 * sizeof(uint256)>();
+		default:	assert(capacity == 16);
+					return SlabPool::get<16 * sizeof(uint256)>();
+	}
+}
+
+void SHAMapTreeNode::resizeBranches(uint16 branches)
+{ // make room for the hashes of a new set of branches, the caller fills them in
+	int oldCapacity = branchCapacity(countBranches(mBranches)), newCapacity = branchCapacity(countBranches(branches));
+	if (oldCapacity != newCapacity)
+	{
+		if (oldCapacity != 0)
+			hashPool(oldCapacity).free(mHashes);
+		mHashes = NULL;
+		if (newCapacity != 0)
+		{
+			mHashes = static_cast<uint256*>(hashPool(newCapacity).malloc());
+			for (int i = 0; i < newCapacity; ++i)
+				new (mHashes + i) uint256();
+		}
+	}
+	mBranches = branches;
+}
+
+void SHAMapTreeNode::setChildHashes(const uint256* hashes)
+{ // from a full 16 branch array
+	uint16 branches = 0;
+	for (int i = 0; i < 16; ++i)
+		if (hashes[i].isNonZero())
+			branches |= (1 << i);
+
+	resizeBranches(branches);
+
+	for (int i = 0, j = 0; i < 16; ++i)
+		if (hashes[i].isNonZero())
+			mHashes[j++] = hashes[i];
+}
+
+void SHAMapTreeNode::getChildHashes(uint256* hashes) const
+{ // to a full 16 branch array
+	for (int i = 0, j = 0; i < 16; ++i)
+		if (isEmptyBranch(i))
+			hashes[i].zero();
+		else
+			hashes[i] = mHashes[j++];
+}
+
+SHAMapTreeNode::~SHAMapTreeNode()
+{
+	if (mHashes)
+		hashPool(branchCapacity(countBranches(mBranches))).free(mHashes);
+}
+
 void SHAMapTreeNode::dump()
 {
 	cLog(lsDEBUG) << "SHAMapTreeNode(" << getNodeID() << ")";
@@ -540,7 +646,7 @@ std::string SHAMapTreeNode::getString() const
 				ret += "\nb";
 				ret += boost::lexical_cast<std::string>(i);
 				ret += " = ";
-				ret += mHashes[i].GetHex();
+				ret += getChildHash(i).GetHex();
 			}
 	}
 	if (isLeaf())
@@ -568,9 +674,17 @@ bool SHAMapTreeNode::setChildHash(int m, const uint256 &hash)
 {
 	assert((m >= 0) && (m < 16));
 	assert(mType == tnINNER);
-	if(mHashes[m] == hash)
+	if (getChildHash(m) == hash)
 		return false;
-	mHashes[m] = hash;
+	if (!isEmptyBranch(m) && hash.isNonZero())
+		mHashes[branchIndex(m)] = hash;
+	else
+	{ // a branch appears or disappears
+		uint256 hashes[16];
+		getChildHashes(hashes);
+		hashes[m] = hash;
+		setChildHashes(hashes);
+	}
 	return updateHash();
 }
 
@@ -61,8 +61,8 @@ void SHAMap::getMissingNodes(std::vector<SHAMapNode>& nodeIDs, std::vector<uint2
 						std::vector<unsigned char> nodeData;
 						if (filter->haveNode(childID, childHash, nodeData))
 						{
-							SHAMapTreeNode::pointer ptr =
-								boost::make_shared<SHAMapTreeNode>(childID, nodeData, mSeq - 1, snfPREFIX, childHash);
+							SHAMapTreeNode::pointer ptr(
+								new SHAMapTreeNode(childID, nodeData, mSeq - 1, snfPREFIX, childHash));
 							cLog(lsTRACE) << "Got sync node from cache: " << *ptr;
 							mTNByID[*ptr] = ptr;
 							d = ptr.get();
@@ -142,7 +142,7 @@ std::vector<uint256> SHAMap::getNeededHashes(int max)
 }
 
 bool SHAMap::getNodeFat(const SHAMapNode& wanted, std::vector<SHAMapNode>& nodeIDs,
-	std::list<std::vector<unsigned char> >& rawNodes, bool fatRoot, bool fatLeaves)
+	std::list<std::vector<unsigned char> >& rawNodes, bool fatRoot, bool fatLeaves, SHANodeFormat format)
 { // Gets a node and some of its children
 	boost::recursive_mutex::scoped_lock sl(mLock);
 
@@ -155,7 +155,7 @@ bool SHAMap::getNodeFat(const SHAMapNode& wanted, std::vector<SHAMapNode>& nodeI
 
 	nodeIDs.push_back(*node);
 	Serializer s;
-	node->addRaw(s, snfWIRE);
+	node->addRaw(s, format);
 	rawNodes.push_back(s.peekData());
 
 	if ((!fatRoot && node->isRoot()) || node->isLeaf()) // don't get a fat root, can't get a fat leaf
@@ -170,7 +170,7 @@ bool SHAMap::getNodeFat(const SHAMapNode& wanted, std::vector<SHAMapNode>& nodeI
 			{
 				nodeIDs.push_back(*nextNode);
 				Serializer s;
-				nextNode->addRaw(s, snfWIRE);
+				nextNode->addRaw(s, format);
 				rawNodes.push_back(s.peekData());
 		 	}
 		}
@@ -197,9 +197,16 @@ SMAddNode SHAMap::addRootNode(const std::vector<unsigned char>& rootNode, SHANod
 		return SMAddNode::okay();
 	}
 
-	SHAMapTreeNode::pointer node = boost::make_shared<SHAMapTreeNode>(SHAMapNode(), rootNode, mSeq - 1, format, uint256());
-	if (!node)
+	SHAMapTreeNode::pointer node;
+	try
+	{
+		node.reset(new SHAMapTreeNode(SHAMapNode(), rootNode, mSeq - 1, format, uint256()));
+	}
+	catch (std::exception&)
+	{
+		cLog(lsWARNING) << "got malformed root node";
 		return SMAddNode::invalid();
+	}
 
 #ifdef DEBUG
 	node->dump();
@@ -235,8 +242,17 @@ SMAddNode SHAMap::addRootNode(const uint256& hash, const std::vector<unsigned ch
 		return SMAddNode::okay();
 	}
 
-	SHAMapTreeNode::pointer node = boost::make_shared<SHAMapTreeNode>(SHAMapNode(), rootNode, mSeq - 1, format, uint256());
-	if (!node || node->getNodeHash() != hash)
+	SHAMapTreeNode::pointer node;
+	try
+	{
+		node.reset(new SHAMapTreeNode(SHAMapNode(), rootNode, mSeq - 1, format, uint256()));
+	}
+	catch (std::exception&)
+	{
+		cLog(lsWARNING) << "got malformed root node";
+		return SMAddNode::invalid();
+	}
+	if (node->getNodeHash() != hash)
 		return SMAddNode::invalid();
 
 	root = node;
@@ -312,7 +328,16 @@ SMAddNode SHAMap::addKnownNode(const SHAMapNode& node, const std::vector<unsigne
 		return SMAddNode::invalid();
 	}
 
-	SHAMapTreeNode::pointer newNode = boost::make_shared<SHAMapTreeNode>(node, rawNode, mSeq - 1, snfWIRE, uint256());
+	SHAMapTreeNode::pointer newNode;
+	try
+	{
+		newNode.reset(new SHAMapTreeNode(node, rawNode, mSeq - 1, snfWIRE, uint256()));
+	}
+	catch (std::exception&)
+	{
+		cLog(lsWARNING) << "got malformed node " << node;
+		return SMAddNode::invalid();
+	}
 	if (hash != newNode->getNodeHash()) // these aren't the droids we're looking for
 		return SMAddNode::invalid();
 
@@ -426,7 +451,7 @@ static SHAMapItem::pointer makeRandomAS()
 {
 	Serializer s;
 	for (int d = 0; d < 3; ++d) s.add32(rand());
-	return boost::make_shared<SHAMapItem>(s.getRIPEMD160().to256(), s.peekData());
+	return boost::allocate_shared<SHAMapItem>(SHAMapItemAllocator(), s.getRIPEMD160().to256(), s.peekData());
 }
 
 static bool confuseMap(SHAMap &map, int count)
@@ -523,7 +548,10 @@ BOOST_AUTO_TEST_CASE( SHAMapSync_test )
 
 	destination.setSynching();
 
-	if (!source.getNodeFat(SHAMapNode(), nodeIDs, gotNodes, (rand() % 2) == 0, (rand() % 2) == 0))
+	// the destination reads either wire form
+	SHANodeFormat format = ((rand() % 2) == 0) ? snfCOMPACT : snfWIRE;
+
+	if (!source.getNodeFat(SHAMapNode(), nodeIDs, gotNodes, (rand() % 2) == 0, (rand() % 2) == 0, format))
 	{
 		cLog(lsFATAL) << "GetNodeFat(root) fails";
 		BOOST_FAIL("GetNodeFat");
@@ -561,7 +589,8 @@ BOOST_AUTO_TEST_CASE( SHAMapSync_test )
 		// get as many nodes as possible based on this information
 		for (nodeIDIterator = nodeIDs.begin(); nodeIDIterator != nodeIDs.end(); ++nodeIDIterator)
 		{
-			if (!source.getNodeFat(*nodeIDIterator, gotNodeIDs, gotNodes, (rand() % 2) == 0, (rand() % 2) == 0))
+			if (!source.getNodeFat(*nodeIDIterator, gotNodeIDs, gotNodes, (rand() % 2) == 0, (rand() % 2) == 0,
+				format))
 			{
 				cLog(lsFATAL) << "GetNodeFat fails";
 				BOOST_FAIL("GetNodeFat");
@@ -616,6 +645,41 @@ BOOST_AUTO_TEST_CASE( SHAMapSync_test )
 	
 }
 
+BOOST_AUTO_TEST_CASE( SHAMapSync_zeroBranch_test )
+{ // a bitmap node that flags a branch with a zero hash hashes like the real node, but must not be taken
+	SHAMap source(smtFREE);
+	for (int i = 0; i < 6; ++i)
+		source.addItem(*makeRandomAS(), false, false);
+	source.setImmutable();
+
+	Serializer s;
+	if (!source.getRootNode(s, snfCOMPACT)) BOOST_FAIL("GetRootNode");
+	std::vector<unsigned char> rootNode = s.getData();
+
+	int branches = (rootNode[0] << 8) | rootNode[1], empty = 0;
+	while ((branches & (1 << empty)) != 0)
+		++empty;
+	if (empty >= 16) BOOST_FAIL("No empty branch");
+
+	int position = 0;
+	for (int i = 0; i < empty; ++i)
+		if ((branches & (1 << i)) != 0)
+			++position;
+
+	std::vector<unsigned char> crafted(rootNode);
+	branches |= 1 << empty;
+	crafted[0] = static_cast<unsigned char>(branches >> 8);
+	crafted[1] = static_cast<unsigned char>(branches);
+	crafted.insert(crafted.begin() + 2 + position * 32, 32, 0);
+
+	SHAMap destination(smtFREE);
+	destination.setSynching();
+	if (!destination.addRootNode(source.getHash(), crafted, snfCOMPACT, NULL).isInvalid())
+		BOOST_FAIL("Took a bitmap node with a zero hash");
+	if (!destination.addRootNode(source.getHash(), rootNode, snfCOMPACT, NULL))
+		BOOST_FAIL("AddRootNode");
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 // vim:ts=4
@@ -0,0 +1,452 @@
+#include "Secp256k1.h"
+
+#include <openssl/ecdsa.h>
+#include <openssl/obj_mac.h>
+#include <openssl/crypto.h>
+
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "key.h"
+#include "Metrics.h"
+#include "Log.h"
+
+SETUP_LOG();
+
+// The endomorphism (x, y) -> (beta*x, y) multiplies points by lambda.
+// A scalar k splits into k1 + k2*lambda using the short basis (a1, b1), (a2, b2) of
+// the lattice of pairs with x + y*lambda = 0 mod n. See "Guide to Elliptic Curve Cryptography", 3.5.
+#define SECP256K1_BETA		"7AE96A2B657C07106E64479EAC3434E99CF0497512F58995C1396C28719501EE"
+#define SECP256K1_A1		"3086D221A7D46BCDE86C90E49284EB15"
+#define SECP256K1_NEG_B1	"E4437ED6010E88286F547FA90ABFE4C3"
+#define SECP256K1_A2		"114CA50F7A8E2F3F657C1108D9D44CFD8"
+#define SECP256K1_B2		"3086D221A7D46BCDE86C90E49284EB15"
+
+Secp256k1::PublicKey::~PublicKey()
+{
+	EC_POINT_free(mPoint);
+	EC_POINT_free(mNegPoint);
+	EC_POINT_free(mEndoPoint);
+	EC_POINT_free(mNegEndoPoint);
+}
+
+static BIGNUM* hexBN(const char* hex)
+{
+	BIGNUM* bn = NULL;
+	if (!BN_hex2bn(&bn, hex))
+		throw std::runtime_error("Secp256k1: bad constant");
+	return bn;
+}
+
+Secp256k1::Secp256k1()
+{
+	BN_CTX* ctx = BN_CTX_new();
+
+	mGroup = EC_GROUP_new_by_curve_name(NID_secp256k1);
+	if (!ctx || !mGroup)
+		throw std::runtime_error("Secp256k1: unable to create group");
+
+	if (!EC_GROUP_precompute_mult(mGroup, ctx))
+	{ // still correct, just slower
+		cLog(lsWARNING) << "Secp256k1: unable to precompute generator multiples";
+	}
+
+	mOrder		= BN_new();
+	mHalfOrder	= BN_new();
+	mField		= BN_new();
+	EC_GROUP_get_order(mGroup, mOrder, ctx);
+	BN_rshift1(mHalfOrder, mOrder);
+	EC_GROUP_get_curve_GFp(mGroup, mField, NULL, NULL, ctx);
+
+	mBeta	= hexBN(SECP256K1_BETA);
+	mA1		= hexBN(SECP256K1_A1);
+	mNegB1	= hexBN(SECP256K1_NEG_B1);
+	mA2		= hexBN(SECP256K1_A2);
+	mB2		= hexBN(SECP256K1_B2);
+
+	BN_CTX_free(ctx);
+}
+
+Secp256k1::~Secp256k1()
+{
+	mKeys.clear();
+
+	BN_free(mOrder);
+	BN_free(mHalfOrder);
+	BN_free(mField);
+	BN_free(mBeta);
+	BN_free(mA1);
+	BN_free(mNegB1);
+	BN_free(mA2);
+	BN_free(mB2);
+	EC_GROUP_free(mGroup);
+}
+
+Secp256k1& Secp256k1::getInstance()
+{
+	static Secp256k1 instance;
+
+	return instance;
+}
+
+Secp256k1::PublicKey::pointer Secp256k1::parsePublicKey(const unsigned char* key, size_t keyLen, BN_CTX* ctx)
+{
+	PublicKey::pointer ret = boost::make_shared<PublicKey>();
+
+	ret->mPoint			= EC_POINT_new(mGroup);
+	ret->mNegPoint		= EC_POINT_new(mGroup);
+	ret->mEndoPoint		= EC_POINT_new(mGroup);
+	ret->mNegEndoPoint	= EC_POINT_new(mGroup);
+	if (!ret->mPoint || !ret->mNegPoint || !ret->mEndoPoint || !ret->mNegEndoPoint)
+		return PublicKey::pointer();
+
+	// Checks the point is on the curve, decompressing it if needed
+	if (!EC_POINT_oct2point(mGroup, ret->mPoint, key, keyLen, ctx) || EC_POINT_is_at_infinity(mGroup, ret->mPoint))
+		return PublicKey::pointer();
+
+	BN_CTX_start(ctx);
+	BIGNUM* x = BN_CTX_get(ctx);
+	BIGNUM* y = BN_CTX_get(ctx);
+	bool bSuccess = (y != NULL)
+		&& EC_POINT_get_affine_coordinates_GFp(mGroup, ret->mPoint, x, y, ctx)
+		&& BN_mod_mul(x, x, mBeta, mField, ctx)
+		&& EC_POINT_set_affine_coordinates_GFp(mGroup, ret->mEndoPoint, x, y, ctx)
+		&& EC_POINT_copy(ret->mNegPoint, ret->mPoint)
+		&& EC_POINT_invert(mGroup, ret->mNegPoint, ctx)
+		&& EC_POINT_copy(ret->mNegEndoPoint, ret->mEndoPoint)
+		&& EC_POINT_invert(mGroup, ret->mNegEndoPoint, ctx);
+	BN_CTX_end(ctx);
+
+	return bSuccess ? ret : PublicKey::pointer();
+}
+
+Secp256k1::PublicKey::pointer Secp256k1::getPublicKey(const unsigned char* key, size_t keyLen)
+{
+	std::string strKey(reinterpret_cast<const char*>(key), keyLen);
+
+	{
+		boost::mutex::scoped_lock sl(mKeyLock);
+
+		KeyMap::iterator it = mKeys.find(strKey);
+		if (it != mKeys.end())
+			return it->second;
+	}
+
+	BN_CTX* ctx = BN_CTX_new();
+	if (!ctx)
+		return PublicKey::pointer();
+	PublicKey::pointer ret = parsePublicKey(key, keyLen, ctx);
+	BN_CTX_free(ctx);
+
+	if (ret)
+	{ // Keys in use are few, validators and active accounts, so a full cache is simply started over
+		boost::mutex::scoped_lock sl(mKeyLock);
+
+		if (mKeys.size() >= sKeyCacheSize)
+			mKeys.clear();
+		mKeys[strKey] = ret;
+	}
+
+	return ret;
+}
+
+bool Secp256k1::roundDivide(BIGNUM* result, const BIGNUM* num, BN_CTX* ctx)
+{ // result = num / n, rounded to nearest, num must not be negative
+	BN_CTX_start(ctx);
+	BIGNUM* sum = BN_CTX_get(ctx);
+	bool bSuccess = (sum != NULL) && BN_add(sum, num, mHalfOrder) && BN_div(result, NULL, sum, mOrder, ctx);
+	BN_CTX_end(ctx);
+
+	return bSuccess;
+}
+
+bool Secp256k1::splitScalar(const BIGNUM* k, BIGNUM* k1, BIGNUM* k2, BN_CTX* ctx)
+{ // k = k1 + k2*lambda mod n, with k1 and k2 about 128 bits and possibly negative
+	BN_CTX_start(ctx);
+	BIGNUM* c1	= BN_CTX_get(ctx);
+	BIGNUM* c2	= BN_CTX_get(ctx);
+	BIGNUM* t	= BN_CTX_get(ctx);
+
+	bool bSuccess = (t != NULL)
+		// c1 = round(b2*k / n), c2 = round(-b1*k / n)
+		&& BN_mul(t, mB2, k, ctx) && roundDivide(c1, t, ctx)
+		&& BN_mul(t, mNegB1, k, ctx) && roundDivide(c2, t, ctx)
+		// k1 = k - c1*a1 - c2*a2
+		&& BN_mul(t, c1, mA1, ctx) && BN_sub(k1, k, t)
+		&& BN_mul(t, c2, mA2, ctx) && BN_sub(k1, k1, t)
+		// k2 = -c1*b1 - c2*b2
+		&& BN_mul(t, c1, mNegB1, ctx) && BN_mul(k2, c2, mB2, ctx) && BN_sub(k2, t, k2);
+
+	BN_CTX_end(ctx);
+
+	return bSuccess;
+}
+
+static bool parseInteger(const unsigned char*& p, const unsigned char* end, BIGNUM* bn)
+{
+	if (((end - p) < 2) || (p[0] != 0x02))
+		return false;
+
+	int len = p[1];
+	p += 2;
+	if ((len == 0) || (len >= 0x80) || ((end - p) < len))
+		return false;
+
+	if (p[0] & 0x80)
+		return false;									// negative
+	if ((len > 1) && (p[0] == 0) && !(p[1] & 0x80))
+		return false;									// not minimal
+
+	if (!BN_bin2bn(p, len, bn))
+		return false;
+	p += len;
+	return true;
+}
+
+bool Secp256k1::parseSignature(const unsigned char* sig, size_t sigLen, BIGNUM* r, BIGNUM* s)
+{ // Both integers are under 33 bytes for this curve, so only short form lengths are valid
+	if ((sigLen < 8) || (sig[0] != 0x30) || (sig[1] >= 0x80) || (sig[1] != (sigLen - 2)))
+		return false;
+
+	const unsigned char* p = sig + 2;
+	const unsigned char* end = sig + sigLen;
+
+	return parseInteger(p, end, r) && parseInteger(p, end, s) && (p == end);
+}
+
+bool Secp256k1::verify(const unsigned char* key, size_t keyLen, const uint256& hash, const unsigned char* sig, size_t sigLen)
+{
+	PublicKey::pointer pubKey = getPublicKey(key, keyLen);
+	if (!pubKey)
+		return false;
+
+	bool bVerified = false;
+	BN_CTX* ctx = BN_CTX_new();
+	EC_POINT* point = EC_POINT_new(mGroup);
+	BIGNUM* r = BN_new();
+	BIGNUM* s = BN_new();
+
+	// Parsed here rather than by d2i_ECDSA_SIG, so what is accepted doesn't change with the OpenSSL version
+	if (ctx && point && r && s
+		&& parseSignature(sig, sigLen, r, s)
+		&& !BN_is_zero(r) && !BN_is_negative(r) && (BN_ucmp(r, mOrder) < 0)
+		&& !BN_is_zero(s) && !BN_is_negative(s) && (BN_ucmp(s, mOrder) < 0))
+	{
+		BN_CTX_start(ctx);
+		BIGNUM* m	= BN_CTX_get(ctx);
+		BIGNUM* w	= BN_CTX_get(ctx);
+		BIGNUM* u1	= BN_CTX_get(ctx);
+		BIGNUM* u2	= BN_CTX_get(ctx);
+		BIGNUM* k1	= BN_CTX_get(ctx);
+		BIGNUM* k2	= BN_CTX_get(ctx);
+		BIGNUM* x	= BN_CTX_get(ctx);
+
+		// R = u1*G + u2*Q = u1*G + k1*Q + k2*(lambda*Q), where u1 = m/s and u2 = r/s
+		if ((x != NULL)
+			&& BN_bin2bn(hash.begin(), hash.size(), m)
+			&& BN_mod_inverse(w, s, mOrder, ctx)
+			&& BN_mod_mul(u1, m, w, mOrder, ctx)
+			&& BN_mod_mul(u2, r, w, mOrder, ctx)
+			&& splitScalar(u2, k1, k2, ctx))
+		{
+			const EC_POINT* points[2];
+			const BIGNUM* scalars[2];
+
+			points[0] = BN_is_negative(k1) ? pubKey->mNegPoint : pubKey->mPoint;
+			points[1] = BN_is_negative(k2) ? pubKey->mNegEndoPoint : pubKey->mEndoPoint;
+			BN_set_negative(k1, 0);
+			BN_set_negative(k2, 0);
+			scalars[0] = k1;
+			scalars[1] = k2;
+
+			if (EC_POINTs_mul(mGroup, point, u1, 2, points, scalars, ctx)
+				&& !EC_POINT_is_at_infinity(mGroup, point)
+				&& EC_POINT_get_affine_coordinates_GFp(mGroup, point, x, NULL, ctx)
+				&& BN_nnmod(x, x, mOrder, ctx))
+			{
+				bVerified = (BN_cmp(x, r) == 0);
+			}
+		}
+
+		BN_CTX_end(ctx);
+	}
+
+	EC_POINT_free(point);
+	BN_CTX_free(ctx);
+	BN_free(r);
+	BN_free(s);
+
+	return bVerified;
+}
+
+bool CKey::VerifyPublic(const std::vector<unsigned char>& vchPubKey, const uint256& hash, const std::vector<unsigned char>& vchSig)
+{
+	return Secp256k1::getInstance().verify(vchPubKey, hash, vchSig);
+}
+
+BOOST_AUTO_TEST_SUITE(Secp256k1_suite)
+
+BOOST_AUTO_TEST_CASE(Secp256k1_Endomorphism_test)
+{
+	Secp256k1& secp = Secp256k1::getInstance();
+	const EC_GROUP* group = secp.getGroup();
+	BN_CTX* ctx = BN_CTX_new();
+
+	// lambda*G must be (beta*Gx, Gy)
+	unsigned char generator[33];
+	if (EC_POINT_point2oct(group, EC_GROUP_get0_generator(group), POINT_CONVERSION_COMPRESSED, generator, 33, ctx) != 33)
+		BOOST_FAIL("Secp256k1 generator encoding");
+
+	Secp256k1::PublicKey::pointer pk = secp.getPublicKey(generator, 33);
+	if (!pk) BOOST_FAIL("Secp256k1 generator parse");
+
+	BIGNUM* lambda = NULL;
+	BN_hex2bn(&lambda, "5363AD4CC05C30E0A5261C028812645A122E22EA20816678DF02967C1B23BD72");
+	EC_POINT* point = EC_POINT_new(group);
+	EC_POINT_mul(group, point, lambda, NULL, NULL, ctx);
+	if (EC_POINT_cmp(group, point, pk->mEndoPoint, ctx) != 0) BOOST_FAIL("Secp256k1 endomorphism");
+
+	EC_POINT_free(point);
+	BN_free(lambda);
+	BN_CTX_free(ctx);
+}
+
+static bool parsesDER(const char* hex)
+{
+	std::vector<unsigned char> sig;
+	for (const char* p = hex; p[0] && p[1]; p += 2)
+		sig.push_back(static_cast<unsigned char>(strtol(std::string(p, 2).c_str(), NULL, 16)));
+
+	BIGNUM* r = BN_new();
+	BIGNUM* s = BN_new();
+	bool ret = Secp256k1::parseSignature(&sig[0], sig.size(), r, s);
+	BN_free(r);
+	BN_free(s);
+	return ret;
+}
+
+BOOST_AUTO_TEST_CASE(Secp256k1_DER_test)
+{
+	if (!parsesDER("3006020101020101"))			BOOST_FAIL("Secp256k1 DER minimal");
+	if (!parsesDER("300702020080020101"))		BOOST_FAIL("Secp256k1 DER padded positive");
+	if (parsesDER("3007020101020101"))			BOOST_FAIL("Secp256k1 DER sequence length");
+	if (parsesDER("300702020001020101"))		BOOST_FAIL("Secp256k1 DER leading zero");
+	if (parsesDER("3006020181020101"))			BOOST_FAIL("Secp256k1 DER negative");
+	if (!parsesDER("3006020100020101"))			BOOST_FAIL("Secp256k1 DER zero");		// rejected later, by range
+	if (parsesDER("30050200020101"))			BOOST_FAIL("Secp256k1 DER empty integer");
+	if (parsesDER("300702010102010100"))		BOOST_FAIL("Secp256k1 DER trailing");
+	if (parsesDER("30060201010201010000"))		BOOST_FAIL("Secp256k1 DER outer trailing");
+	if (parsesDER("3106020101020101"))			BOOST_FAIL("Secp256k1 DER sequence tag");
+	if (parsesDER("3006030101020101"))			BOOST_FAIL("Secp256k1 DER integer tag");
+	if (parsesDER("308106020101020101"))		BOOST_FAIL("Secp256k1 DER long form");
+	if (parsesDER("3006020101020201"))			BOOST_FAIL("Secp256k1 DER overrun");
+}
+
+static void makeSignatures(int iKeys, int iSigs, std::vector< std::vector<unsigned char> >& pubKeys,
+	std::vector<uint256>& hashes, std::vector< std::vector<unsigned char> >& sigs)
+{ // iSigs signatures by each of iKeys new keys, in key order
+	std::vector<CKey> keys(iKeys);
+	for (int i = 0; i < iKeys; ++i)
+	{
+		keys[i].MakeNewKey();
+		pubKeys.push_back(keys[i].GetPubKey());
+
+		for (int j = 0; j < iSigs; ++j)
+		{
+			uint256 hash;
+			hash.zero();
+			*hash.begin() = j;
+			*(hash.end() - 1) = i;
+			hashes.push_back(hash);
+
+			std::vector<unsigned char> sig;
+			if (!keys[i].Sign(hash, sig)) BOOST_FAIL("Secp256k1 sign");
+			sigs.push_back(sig);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Secp256k1_Verify_test)
+{ // The backend must agree with ECDSA_verify
+	const int iKeys = 8, iSigs = 8;
+
+	Secp256k1& secp = Secp256k1::getInstance();
+	std::vector< std::vector<unsigned char> > pubKeys, sigs;
+	std::vector<uint256> hashes;
+
+	makeSignatures(iKeys, iSigs, pubKeys, hashes, sigs);
+
+	for (int i = 0; i < iKeys * iSigs; ++i)
+	{
+		CKey key;
+		if (!key.SetPubKey(pubKeys[i / iSigs]) || !key.Verify(hashes[i], sigs[i]))
+			BOOST_FAIL("Secp256k1 OpenSSL verify");
+		if (!secp.verify(pubKeys[i / iSigs], hashes[i], sigs[i]))
+			BOOST_FAIL("Secp256k1 verify");
+	}
+
+	for (int i = 0; i < iKeys * iSigs; ++i)
+	{ // wrong key, wrong hash, damaged signature, non-canonical signature
+		const std::vector<unsigned char>& pubKey = pubKeys[i / iSigs];
+		const std::vector<unsigned char>& otherKey = pubKeys[(i / iSigs + 1) % iKeys];
+		std::vector<unsigned char> sig = sigs[i];
+		uint256 hash = hashes[i];
+
+		if (secp.verify(otherKey, hash, sig)) BOOST_FAIL("Secp256k1 anti-verify key");
+		if (secp.verify(pubKey, hashes[(i + 1) % hashes.size()], sig)) BOOST_FAIL("Secp256k1 anti-verify hash");
+
+		sig[sig.size() - 1 - (i % 8)] ^= 0x10;
+		CKey key;
+		key.SetPubKey(pubKey);
+		if (secp.verify(pubKey, hash, sig) != key.Verify(hash, sig)) BOOST_FAIL("Secp256k1 agreement damaged");
+
+		sig = sigs[i];
+		sig.push_back(0);
+		if (secp.verify(pubKey, hash, sig) != key.Verify(hash, sig)) BOOST_FAIL("Secp256k1 agreement padded");
+	}
+
+	std::vector<unsigned char> badKey = pubKeys[0];
+	badKey[0] = 0x05;
+	if (secp.verify(badKey, hashes[0], sigs[0])) BOOST_FAIL("Secp256k1 bad key");
+}
+
+#ifdef ENABLE_BENCHMARKS
+
+BOOST_AUTO_TEST_CASE(Secp256k1_Verify_bench)
+{
+	const int iKeys = 16, iSigs = 16;
+
+	Secp256k1& secp = Secp256k1::getInstance();
+	std::vector< std::vector<unsigned char> > pubKeys, sigs;
+	std::vector<uint256> hashes;
+
+	uint64 start = LatencyHistogram::now();
+	makeSignatures(iKeys, iSigs, pubKeys, hashes, sigs);
+	uint64 signTime = LatencyHistogram::now() - start;
+
+	start = LatencyHistogram::now();
+	for (int i = 0; i < iKeys * iSigs; ++i)
+	{
+		CKey key;
+		if (!key.SetPubKey(pubKeys[i / iSigs]) || !key.Verify(hashes[i], sigs[i]))
+			BOOST_FAIL("Secp256k1 OpenSSL verify");
+	}
+	uint64 opensslTime = LatencyHistogram::now() - start;
+
+	start = LatencyHistogram::now();
+	for (int i = 0; i < iKeys * iSigs; ++i)
+	{
+		if (!secp.verify(pubKeys[i / iSigs], hashes[i], sigs[i]))
+			BOOST_FAIL("Secp256k1 verify");
+	}
+	uint64 secpTime = LatencyHistogram::now() - start;
+
+	BOOST_TEST_MESSAGE("Secp256k1: " << (iKeys * iSigs) << " signatures, sign and key generation " << signTime
+		<< "us, OpenSSL verify " << opensslTime << "us, secp256k1 verify " << secpTime << "us");
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// vim:ts=4
@@ -0,0 +1,90 @@
+#ifndef SECP256K1__H
+#define SECP256K1__H
+
+#include <string>
+#include <vector>
+
+#include <openssl/ec.h>
+#include <openssl/bn.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "uint256.h"
+
+// ECDSA verification specialized for secp256k1, used by CKey::VerifyPublic.
+// Results match ECDSA_verify, including the rejection of non-canonical DER signatures.
+//
+// It is faster than parsing each key into an EC_KEY and calling ECDSA_verify because:
+// 1) The group is created once, with a precomputed table of multiples of the generator.
+// 2) Parsed public keys are cached, so compressed keys are only decompressed once.
+// 3) The public key half of u1*G + u2*Q uses the curve's endomorphism: u2 is split into two
+//    half length scalars, k1 + k2*lambda, and Q*lambda is (beta*x, y), which halves the doublings.
+//
+// Signing is left to OpenSSL, which uses a constant time ladder for secret scalars.
+
+class Secp256k1
+{
+public:
+	class PublicKey
+	{ // A parsed public key and the points the endomorphism needs, read only once built
+	public:
+		typedef boost::shared_ptr<PublicKey> pointer;
+
+		EC_POINT*	mPoint;			// Q
+		EC_POINT*	mNegPoint;		// -Q
+		EC_POINT*	mEndoPoint;		// lambda*Q
+		EC_POINT*	mNegEndoPoint;	// -lambda*Q
+
+		PublicKey() : mPoint(NULL), mNegPoint(NULL), mEndoPoint(NULL), mNegEndoPoint(NULL) { ; }
+		~PublicKey();
+	};
+
+protected:
+	typedef boost::unordered_map<std::string, PublicKey::pointer> KeyMap;
+
+	static const int	sKeyCacheSize = 8192;
+
+	EC_GROUP*			mGroup;
+	BIGNUM*				mOrder;
+	BIGNUM*				mHalfOrder;
+	BIGNUM*				mField;			// p
+	BIGNUM*				mBeta;			// cube root of unity mod p
+	BIGNUM*				mA1;			// basis of the lattice used to split scalars
+	BIGNUM*				mNegB1;			// -b1, as b1 is negative
+	BIGNUM*				mA2;
+	BIGNUM*				mB2;
+
+	boost::mutex		mKeyLock;
+	KeyMap				mKeys;
+
+	Secp256k1();
+
+	PublicKey::pointer parsePublicKey(const unsigned char* key, size_t keyLen, BN_CTX* ctx);
+	bool splitScalar(const BIGNUM* k, BIGNUM* k1, BIGNUM* k2, BN_CTX* ctx);
+	bool roundDivide(BIGNUM* result, const BIGNUM* num, BN_CTX* ctx);
+
+public:
+	~Secp256k1();
+
+	static Secp256k1& getInstance();
+
+	PublicKey::pointer getPublicKey(const unsigned char* key, size_t keyLen);
+
+	// Strict DER: a sequence of two minimally encoded, non-negative integers and nothing else
+	static bool parseSignature(const unsigned char* sig, size_t sigLen, BIGNUM* r, BIGNUM* s);
+
+	bool verify(const unsigned char* key, size_t keyLen, const uint256& hash, const unsigned char* sig, size_t sigLen);
+	bool verify(const std::vector<unsigned char>& key, const uint256& hash, const std::vector<unsigned char>& sig)
+	{
+		if (key.empty() || sig.empty())
+			return false;
+		return verify(&key[0], key.size(), hash, &sig[0], sig.size());
+	}
+
+	const EC_GROUP* getGroup() const	{ return mGroup; }
+};
+
+#endif
+// vim:ts=4
@@ -1,11 +1,15 @@
 #include "SerializedLedger.h"
 
 #include <boost/format.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
 
 #include "Ledger.h"
 #include "Log.h"
 
-DECLARE_INSTANCE(SerializedLedgerEntry)
+DECLARE_SIZED_INSTANCE(SerializedLedgerEntry, SerializedLedgerEntry)
+DECLARE_INSTANCE(SerializedLedgerView)
 SETUP_LOG();
 
 SerializedLedgerEntry::SerializedLedgerEntry(SerializerIterator& sit, const uint256& index)
@@ -167,4 +171,260 @@ std::vector<uint256> SerializedLedgerEntry::getOwners()
 	return owners;
 }
 
+SerializedLedgerView::SerializedLedgerView(const boost::shared_ptr<SHAMapItem>& item) :
+	mItem(item), mScanPos(0), mScanDone(false)
+{
+	mFields.reserve(16);
+}
+
+const uint256& SerializedLedgerView::getIndex() const
+{
+	return mEntry ? mEntry->getIndex() : mItem->getTag();
+}
+
+bool SerializedLedgerView::findField(SField::ref field, int& offset) const
+{ // Fields are stored in field code order, so we only scan as far as the field we want
+	typedef std::pair<int, int> field_offset;
+	BOOST_FOREACH(const field_offset& it, mFields)
+	{
+		if (it.first == field.fieldCode)
+		{
+			offset = it.second;
+			return true;
+		}
+	}
+
+	if (mScanDone || (!mFields.empty() && (mFields.back().first > field.fieldCode)))
+		return false;
+
+	SerializerIterator sit(mItem->peekSerializer());
+	sit.setPos(mScanPos);
+	while (!sit.empty())
+	{
+		int type, name;
+		sit.getFieldID(type, name);
+		int code = FIELD_CODE(type, name);
+		int start = sit.getPos();
+
+		switch (type)
+		{ // skip over the field's data
+			case STI_UINT8:		sit.get8();		break;
+			case STI_UINT16:	sit.get16();	break;
+			case STI_UINT32:	sit.get32();	break;
+			case STI_UINT64:	sit.get64();	break;
+			case STI_HASH128:	sit.get128();	break;
+			case STI_HASH160:	sit.get160();	break;
+			case STI_HASH256:	sit.get256();	break;
+
+			case STI_AMOUNT:
+				if ((sit.get64() & (1ull << 63)) != 0)
+				{ // not native, skip currency and issuer
+					sit.get160();
+					sit.get160();
+				}
+				break;
+
+			case STI_VL:
+			case STI_ACCOUNT:
+			case STI_VECTOR256:
+			{
+				int length;
+				if (!(*sit).getVLLength(length, start))
+					throw std::runtime_error("invalid VL in ledger entry");
+				sit.setPos(start + Serializer::encodeLengthLength(length) + length);
+				break;
+			}
+
+			default: // rare in ledger entries, let the full parser find the end
+				STObject::makeDeserializedObject(static_cast<SerializedTypeID>(type),
+					SField::getField(type, name), sit, 1);
+				break;
+		}
+
+		mFields.push_back(std::make_pair(code, start));
+		mScanPos = sit.getPos();
+
+		if (code == field.fieldCode)
+		{
+			offset = start;
+			return true;
+		}
+		if (code > field.fieldCode)
+			return false;
+	}
+
+	mScanDone = true;
+	return false;
+}
+
+bool SerializedLedgerView::isFieldPresent(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->isFieldPresent(field);
+	int offset;
+	return findField(field, offset);
+}
+
+uint16 SerializedLedgerView::getFieldU16(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->getFieldU16(field);
+	int offset;
+	if (!findField(field, offset))
+		return 0;
+	SerializerIterator sit(mItem->peekSerializer());
+	sit.setPos(offset);
+	return sit.get16();
+}
+
+uint32 SerializedLedgerView::getFieldU32(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->getFieldU32(field);
+	int offset;
+	if (!findField(field, offset))
+		return 0;
+	SerializerIterator sit(mItem->peekSerializer());
+	sit.setPos(offset);
+	return sit.get32();
+}
+
+uint64 SerializedLedgerView::getFieldU64(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->getFieldU64(field);
+	int offset;
+	if (!findField(field, offset))
+		return 0;
+	SerializerIterator sit(mItem->peekSerializer());
+	sit.setPos(offset);
+	return sit.get64();
+}
+
+uint160 SerializedLedgerView::getFieldH160(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->getFieldH160(field);
+	int offset;
+	if (!findField(field, offset))
+		return uint160();
+	SerializerIterator sit(mItem->peekSerializer());
+	sit.setPos(offset);
+	return sit.get160();
+}
+
+uint256 SerializedLedgerView::getFieldH256(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->getFieldH256(field);
+	int offset;
+	if (!findField(field, offset))
+		return uint256();
+	SerializerIterator sit(mItem->peekSerializer());
+	sit.setPos(offset);
+	return sit.get256();
+}
+
+uint160 SerializedLedgerView::getFieldAccount160(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->getFieldAccount160(field);
+	uint160 a;
+	int offset, length;
+	if (!findField(field, offset))
+		return a;
+	const Serializer& s = mItem->peekSerializer();
+	if (s.getVLLength(length, offset) && (length == (160 / 8)))
+		memcpy(a.begin(), &(s.peekData()[offset + Serializer::encodeLengthLength(length)]), 160 / 8);
+	return a;
+}
+
+RippleAddress SerializedLedgerView::getFieldAccount(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->getFieldAccount(field);
+	return RippleAddress::createAccountID(getFieldAccount160(field));
+}
+
+STAmount SerializedLedgerView::getFieldAmount(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->getFieldAmount(field);
+	int offset;
+	if (!findField(field, offset))
+		return STAmount();
+	SerializerIterator sit(mItem->peekSerializer());
+	sit.setPos(offset);
+	return STAmount::deserialize(sit);
+}
+
+STVector256 SerializedLedgerView::getFieldV256(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->getFieldV256(field);
+	int offset, length;
+	STVector256 v;
+	if (!findField(field, offset))
+		return v;
+	const Serializer& s = mItem->peekSerializer();
+	if (!s.getVLLength(length, offset))
+		throw std::runtime_error("invalid VL in ledger entry");
+	std::vector<unsigned char>::const_iterator it =
+		s.peekData().begin() + offset + Serializer::encodeLengthLength(length);
+	v.peekValue().reserve(length / (256 / 8));
+	for (int i = 0, count = length / (256 / 8); i < count; ++i, it += (256 / 8))
+		v.peekValue().push_back(uint256(std::vector<unsigned char>(it, it + (256 / 8))));
+	return v;
+}
+
+std::vector<unsigned char> SerializedLedgerView::getFieldVL(SField::ref field) const
+{
+	if (mEntry)
+		return mEntry->getFieldVL(field);
+	int offset;
+	if (!findField(field, offset))
+		return std::vector<unsigned char>();
+	SerializerIterator sit(mItem->peekSerializer());
+	sit.setPos(offset);
+	return sit.getVL();
+}
+
+SLE::pointer SerializedLedgerView::getSLE() const
+{
+	if (mEntry)
+		return boost::make_shared<SLE>(*mEntry);
+	return boost::make_shared<SLE>(mItem->peekSerializer(), mItem->getTag());
+}
+
+BOOST_AUTO_TEST_SUITE(SerializedLedgerView_suite)
+
+BOOST_AUTO_TEST_CASE( SLEView_test )
+{
+	uint160 low(1), high(2), currency(3);
+	SLE sle(ltRIPPLE_STATE, uint256(4));
+	sle.setFieldAmount(sfBalance, STAmount(currency, ACCOUNT_ONE, 5));
+	sle.setFieldAmount(sfLowLimit, STAmount(currency, low, 100));
+	sle.setFieldAmount(sfHighLimit, STAmount(currency, high, 200));
+	sle.setFieldU32(sfLowQualityIn, 7);
+	sle.setFieldU32(sfFlags, lsfLowReserve);
+
+	Serializer s;
+	sle.add(s);
+	SLEView view(boost::make_shared<SHAMapItem>(sle.getIndex(), s));
+
+	if (view.getIndex() != sle.getIndex()) BOOST_FAIL("SLEView index");
+	if (view.getType() != ltRIPPLE_STATE) BOOST_FAIL("SLEView type");
+	// look fields up out of order so the cached offsets get used
+	if (view.getFieldAmount(sfHighLimit) != sle.getFieldAmount(sfHighLimit)) BOOST_FAIL("SLEView high limit");
+	if (view.getFieldAmount(sfBalance) != sle.getFieldAmount(sfBalance)) BOOST_FAIL("SLEView balance");
+	if (view.getFieldAmount(sfLowLimit).getIssuer() != low) BOOST_FAIL("SLEView low limit");
+	if (view.getFieldU32(sfLowQualityIn) != 7) BOOST_FAIL("SLEView quality in");
+	if (view.isFieldPresent(sfHighQualityIn)) BOOST_FAIL("SLEView absent field present");
+	if (view.getFieldU32(sfHighQualityOut) != 0) BOOST_FAIL("SLEView absent field value");
+	if (view.getFlags() != lsfLowReserve) BOOST_FAIL("SLEView flags");
+	if (view.getSLE()->getSerializer() != s) BOOST_FAIL("SLEView materialize");
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
 // vim:ts=4
@@ -7,6 +7,9 @@
 #include "InstanceCounter.h"
 
 DEFINE_INSTANCE(SerializedLedgerEntry);
+DEFINE_INSTANCE(SerializedLedgerView);
+
+class SHAMapItem;
 
 class SerializedLedgerEntry : public STObject, private IS_INSTANCE(SerializedLedgerEntry)
 {
@@ -53,5 +56,48 @@ public:
 
 typedef SerializedLedgerEntry SLE;
 
+class SerializedLedgerView : private IS_INSTANCE(SerializedLedgerView)
+{ // A read-only view of a ledger entry. Fields are located in the shared item's bytes on first use,
+  // nothing is copied or allocated per field. Call getSLE to get an entry that can be modified.
+public:
+	typedef boost::shared_ptr<SerializedLedgerView>			pointer;
+	typedef const boost::shared_ptr<SerializedLedgerView>&	ref;
+
+protected:
+	boost::shared_ptr<SHAMapItem>		mItem;		// the bytes being viewed, or
+	SLE::pointer						mEntry;		// an entry that is already materialized
+
+	mutable std::vector< std::pair<int, int> >	mFields;	// field code, offset of its data
+	mutable int							mScanPos;
+	mutable bool						mScanDone;
+
+	bool findField(SField::ref field, int& offset) const;
+
+public:
+	SerializedLedgerView(const boost::shared_ptr<SHAMapItem>& item);
+	SerializedLedgerView(SLE::ref entry) : mEntry(entry), mScanPos(0), mScanDone(true) { ; }
+
+	const uint256& getIndex() const;
+	LedgerEntryType getType() const		{ return static_cast<LedgerEntryType>(getFieldU16(sfLedgerEntryType)); }
+	uint32 getFlags() const				{ return getFieldU32(sfFlags); }
+
+	// Absent fields return default values
+	bool isFieldPresent(SField::ref field) const;
+	uint16 getFieldU16(SField::ref field) const;
+	uint32 getFieldU32(SField::ref field) const;
+	uint64 getFieldU64(SField::ref field) const;
+	uint160 getFieldH160(SField::ref field) const;
+	uint256 getFieldH256(SField::ref field) const;
+	uint160 getFieldAccount160(SField::ref field) const;
+	RippleAddress getFieldAccount(SField::ref field) const;
+	STAmount getFieldAmount(SField::ref field) const;
+	STVector256 getFieldV256(SField::ref field) const;
+	std::vector<unsigned char> getFieldVL(SField::ref field) const;
+
+	SLE::pointer getSLE() const;		// a full, independent entry
+};
+
+typedef SerializedLedgerView SLEView;
+
 #endif
 // vim:ts=4
@@ -14,8 +14,8 @@
 #include "SerializedTransaction.h"
 
 SETUP_LOG();
-DECLARE_INSTANCE(SerializedObject);
-DECLARE_INSTANCE(SerializedArray);
+DECLARE_SIZED_INSTANCE(SerializedObject, STObject);
+DECLARE_SIZED_INSTANCE(SerializedArray, STArray);
 
 std::auto_ptr<SerializedType> STObject::makeDefaultObject(SerializedTypeID id, SField::ref name)
 {
@@ -130,14 +130,23 @@ std::auto_ptr<SerializedType> STObject::makeDeserializedObject(SerializedTypeID
 	}
 }
 
-void STObject::set(const std::vector<SOElement::ref>& type)
+void SOTemplate::push_back(SOElement::ref elem)
+{
+	int num = elem->e_field.getNum();
+	if (num >= static_cast<int>(mIndex.size()))
+		mIndex.resize(num + 1, -1);
+	assert(mIndex[num] == -1);				// a field may only appear once in a template
+	mIndex[num] = mTypes.size();
+	mTypes.push_back(elem);
+}
+
+void STObject::set(const SOTemplate& type)
 {
 	mData.clear();
-	mType.clear();
+	mType = &type;
 
 	BOOST_FOREACH(SOElement::ref elem, type)
 	{
-		mType.push_back(elem);
 		if (elem->flags != SOE_REQUIRED)
 			giveObject(makeNonPresentObject(elem->e_field));
 		else
@@ -145,30 +154,35 @@ void STObject::set(const std::vector<SOElement::ref>& type)
 	}
 }
 
-bool STObject::setType(const std::vector<SOElement::ref> &type)
-{
-	boost::ptr_vector<SerializedType> newData;
+bool STObject::setType(const SOTemplate& type)
+{ // move each field straight into its slot in the template's layout
+	std::vector<SerializedType*> slots(type.size(), NULL);
 	bool valid = true;
 
-	mType.clear();
-	BOOST_FOREACH(SOElement::ref elem, type)
-	{
-		bool match = false;
-		for (boost::ptr_vector<SerializedType>::iterator it = mData.begin(); it != mData.end(); ++it)
-			if (it->getFName() == elem->e_field)
+	mType = &type;
+	while (!mData.empty())
+	{ // work from the back so the first copy of a duplicated field wins
+		SerializedType* t = mData.pop_back().release();
+		int index = type.getIndex(t->getFName());
+		if (index != -1)
+			std::swap(t, slots[index]);
+		if (t != NULL)
+		{
+			if (!t->getFName().isDiscardable())
 			{
-				match = true;
-				newData.push_back(mData.release(it).release());
-				if ((elem->flags == SOE_DEFAULT) && it->isDefault())
-				{
-					cLog(lsWARNING) << "setType( " << getFName().getName() << ") invalid default "
-						<< elem->e_field.fieldName;
-					valid = false;
-				}
-				break;
+				cLog(lsWARNING) << "setType( " << getFName().getName() << ") invalid leftover "
+					<< t->getFName().getName();
+				valid = false;
 			}
+			delete t;
+		}
+	}
 
-		if (!match)
+	mData.reserve(type.size());
+	for (int i = 0; i < type.size(); ++i)
+	{
+		SOElement::ref elem = type.peekElements()[i];
+		if (slots[i] == NULL)
 		{
 			if (elem->flags == SOE_REQUIRED)
 			{
@@ -176,31 +190,30 @@ bool STObject::setType(const std::vector<SOElement::ref> &type)
 					<< elem->e_field.fieldName;
 				valid = false;
 			}
-			newData.push_back(makeNonPresentObject(elem->e_field));
+			giveObject(makeNonPresentObject(elem->e_field));
 		}
-
-		mType.push_back(elem);
-	}
-	if (mData.size() != 0)
-	{
-		BOOST_FOREACH(const SerializedType& t, mData)
+		else
 		{
-			if (!t.getFName().isDiscardable())
+			if ((elem->flags == SOE_DEFAULT) && slots[i]->isDefault())
 			{
-				cLog(lsWARNING) << "setType( " << getFName().getName() << ") invalid leftover "
-					<< t.getFName().getName();
+				cLog(lsWARNING) << "setType( " << getFName().getName() << ") invalid default "
+					<< elem->e_field.fieldName;
 				valid = false;
 			}
+			giveObject(slots[i]);
 		}
 	}
-	mData.swap(newData);
+
 	return valid;
 }
 
 bool STObject::isValidForType()
 {
+	if (isFree())
+		return true;
+
 	boost::ptr_vector<SerializedType>::iterator it = mData.begin();
-	BOOST_FOREACH(SOElement::ref elem, mType)
+	BOOST_FOREACH(SOElement::ref elem, *mType)
 	{
 		if (it == mData.end())
 			return false;
@@ -216,17 +229,13 @@ bool STObject::isFieldAllowed(SField::ref field)
 {
 	if (isFree())
 		return true;
-	BOOST_FOREACH(SOElement::ref elem, mType)
-	{ // are any required elemnents missing
-		if (elem->e_field == field)
-			return true;
-	}
-	return false;
+	return mType->getIndex(field) != -1;
 }
 
 bool STObject::set(SerializerIterator& sit, int depth)
 { // return true = terminated with end-of-object
 	mData.clear();
+	mType = NULL;
 	while (!sit.empty())
 	{
 		int type, field;
@@ -360,6 +369,13 @@ uint256 STObject::getSigningHash(uint32 prefix) const
 
 int STObject::getFieldIndex(SField::ref field) const
 {
+	if (mType != NULL)
+	{ // templated objects keep each field at its template position
+		int index = mType->getIndex(field);
+		assert((index == -1) || (mData[index].getFName() == field));
+		return index;
+	}
+
 	int i = 0;
 	BOOST_FOREACH(const SerializedType& elem, mData)
 	{
@@ -499,7 +515,10 @@ bool STObject::delField(SField::ref field)
 
 void STObject::delField(int index)
 {
-	mData.erase(mData.begin() + index);
+	if (mType != NULL)	// keep the template layout, the field just becomes absent
+		mData.replace(index, makeNonPresentObject(mData[index].getFName()));
+	else
+		mData.erase(mData.begin() + index);
 }
 
 std::string STObject::getFieldString(SField::ref field) const
@@ -1242,7 +1261,7 @@ BOOST_AUTO_TEST_CASE( FieldManipulation_test )
 	SField sfTestU32(STI_UINT32, 255, "TestU32");
 	SField sfTestObject(STI_OBJECT, 255, "TestObject");
 
-	std::vector<SOElement::ref> elements;
+	SOTemplate elements;
 	elements.push_back(new SOElement(sfFlags, SOE_REQUIRED));
 	elements.push_back(new SOElement(sfTestVL, SOE_REQUIRED));
 	elements.push_back(new SOElement(sfTestH256, SOE_OPTIONAL));
@@ -26,24 +26,50 @@ public:
 	SOElement(SField::ref fi, SOE_Flags fl) : e_field(fi), flags(fl) { ; }
 };
 
+class SOTemplate
+{ // The description of a serialized object, with a direct map from field to position
+public:
+	typedef std::vector<SOElement::ref>::const_iterator const_iterator;
+
+	SOTemplate()										{ ; }
+
+	void push_back(SOElement::ref elem);
+	int getIndex(SField::ref field) const
+	{
+		int num = field.getNum();
+		return (num < static_cast<int>(mIndex.size())) ? mIndex[num] : -1;
+	}
+
+	const std::vector<SOElement::ref>& peekElements() const	{ return mTypes; }
+	const_iterator begin() const							{ return mTypes.begin(); }
+	const_iterator end() const								{ return mTypes.end(); }
+	int size() const										{ return mTypes.size(); }
+	bool empty() const										{ return mTypes.empty(); }
+
+protected:
+	std::vector<SOElement::ref>	mTypes;
+	std::vector<int>			mIndex;		// field number -> position in mTypes, -1 if absent
+};
+
 class STObject : public SerializedType, private IS_INSTANCE(SerializedObject)
 {
 protected:
 	boost::ptr_vector<SerializedType>	mData;
-	std::vector<SOElement::ref>			mType;
+	const SOTemplate*					mType;		// if set, mData is laid out in template order
 
 	STObject* duplicate() const { return new STObject(*this); }
-	STObject(SField::ref name, boost::ptr_vector<SerializedType>& data) : SerializedType(name) { mData.swap(data); }
+	STObject(SField::ref name, boost::ptr_vector<SerializedType>& data) : SerializedType(name), mType(NULL)
+	{ mData.swap(data); }
 
 public:
-	STObject()											{ ; }
+	STObject() : mType(NULL)							{ ; }
 
-	STObject(SField::ref name) : SerializedType(name)	{ ; }
+	STObject(SField::ref name) : SerializedType(name), mType(NULL)	{ ; }
 
-	STObject(const std::vector<SOElement::ref>& type, SField::ref name) : SerializedType(name)
+	STObject(const SOTemplate& type, SField::ref name) : SerializedType(name)
 	{ set(type); }
 
-	STObject(const std::vector<SOElement::ref>& type, SerializerIterator& sit, SField::ref name) : SerializedType(name)
+	STObject(const SOTemplate& type, SerializerIterator& sit, SField::ref name) : SerializedType(name), mType(NULL)
 	{ set(sit); setType(type); }
 
 	std::auto_ptr<STObject> oClone() const { return std::auto_ptr<STObject>(new STObject(*this)); }
@@ -54,12 +80,12 @@ public:
 
 	static std::auto_ptr<SerializedType> deserialize(SerializerIterator& sit, SField::ref name);
 
-	bool setType(const std::vector<SOElement::ref>& type);
+	bool setType(const SOTemplate& type);
 	bool isValidForType();
 	bool isFieldAllowed(SField::ref);
-	bool isFree() const { return mType.empty(); }
+	bool isFree() const { return mType == NULL; }
 
-	void set(const std::vector<SOElement::ref>&);
+	void set(const SOTemplate&);
 	bool set(SerializerIterator& u, int depth = 0);
 
 	virtual SerializedTypeID getSType() const { return STI_OBJECT; }
@@ -3,13 +3,14 @@
 
 #include <boost/foreach.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include "Application.h"
 #include "Log.h"
 #include "HashPrefixes.h"
 
 SETUP_LOG();
-DECLARE_INSTANCE(SerializedTransaction);
+DECLARE_SIZED_INSTANCE(SerializedTransaction, SerializedTransaction);
 
 SerializedTransaction::SerializedTransaction(TransactionType type) : STObject(sfTransaction), mType(type)
 {
@@ -304,6 +305,96 @@ BOOST_AUTO_TEST_CASE( STrans_test )
 	}
 }
 
+static uint64 readPaymentFields(const STObject& txn)
+{ // the fields a payment transactor reads on its way through apply
+	uint64 sum = txn.getFlags();
+	sum += txn.getFieldU32(sfSequence);
+	sum += txn.getFieldU32(sfSourceTag);
+	sum += txn.getFieldAmount(sfFee).getNValue();
+	sum += txn.getFieldAmount(sfAmount).getNValue();
+	sum += txn.isFieldPresent(sfSendMax) ? 1 : 0;
+	sum += txn.isFieldPresent(sfPaths) ? 1 : 0;
+	sum += txn.getFieldU32(sfDestinationTag);
+	sum += txn.getFieldAccount160(sfAccount).isNonZero() ? 1 : 0;
+	sum += txn.getFieldAccount160(sfDestination).isNonZero() ? 1 : 0;
+	sum += txn.getFieldVL(sfSigningPubKey).size();
+	return sum;
+}
+
+static Serializer makeTestPayment()
+{
+	RippleAddress seed;
+	seed.setSeedRandom();
+	RippleAddress generator = RippleAddress::createGeneratorPublic(seed);
+	RippleAddress publicAcct = RippleAddress::createAccountPublic(generator, 1);
+	RippleAddress destAcct = RippleAddress::createAccountPublic(generator, 2);
+
+	SerializedTransaction j(ttPAYMENT);
+	j.setSourceAccount(publicAcct);
+	j.setSigningPubKey(publicAcct);
+	j.setFieldAccount(sfDestination, destAcct);
+	j.setFieldAmount(sfAmount, STAmount(1000000));
+	j.setFieldAmount(sfFee, STAmount(10));
+	j.setFieldU32(sfSequence, 1);
+	j.setFieldU32(sfSourceTag, 3);
+	j.setFieldU32(sfDestinationTag, 5);
+
+	Serializer rawTxn;
+	j.add(rawTxn);
+	return rawTxn;
+}
+
+BOOST_AUTO_TEST_CASE( STrans_fieldAccess_test )
+{ // a payment read through its template sees the same fields as the free-form linear lookup
+	Serializer rawTxn = makeTestPayment();
+
+	SerializerIterator sitTemplated(rawTxn);
+	SerializedTransaction templated(sitTemplated);
+
+	SerializerIterator sitFreeForm(rawTxn);
+	STObject freeForm(sfTransaction);
+	freeForm.set(sitFreeForm);
+
+	if (readPaymentFields(templated) != readPaymentFields(freeForm))
+		BOOST_FAIL("Templated and free-form field reads disagree");
+}
+
+#ifdef ENABLE_BENCHMARKS
+
+BOOST_AUTO_TEST_CASE( STrans_fieldAccess_bench )
+{ // compare parsing and reading a payment through its template against the free-form linear lookup
+	Serializer rawTxn = makeTestPayment();
+
+	const int iterations = 20000;
+	uint64 templated = 0, freeForm = 0;
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for (int i = 0; i < iterations; ++i)
+	{
+		SerializerIterator sit(rawTxn);
+		SerializedTransaction txn(sit);
+		templated += readPaymentFields(txn);
+	}
+	boost::posix_time::ptime mid = boost::posix_time::microsec_clock::universal_time();
+	for (int i = 0; i < iterations; ++i)
+	{
+		SerializerIterator sit(rawTxn);
+		STObject txn(sfTransaction);
+		txn.set(sit);
+		freeForm += readPaymentFields(txn);
+	}
+	boost::posix_time::ptime end = boost::posix_time::microsec_clock::universal_time();
+
+	if (templated != freeForm) BOOST_FAIL("Templated and free-form field reads disagree");
+
+	int templatedMS = std::max(1, static_cast<int>((mid - start).total_milliseconds()));
+	int freeFormMS = std::max(1, static_cast<int>((end - mid).total_milliseconds()));
+	Log(lsINFO) << "Payment parse+read: templated " << (iterations * 1000 / templatedMS) << "/s, free-form "
+		<< (iterations * 1000 / freeFormMS) << "/s";
+}
+
+#endif
+
 BOOST_AUTO_TEST_SUITE_END();
 
 // vim:ts=4
@@ -6,7 +6,7 @@
 
 DECLARE_INSTANCE(SerializedValidation);
 
-std::vector<SOElement::ref> sValidationFormat;
+SOTemplate sValidationFormat;
 
 static bool SVFInit()
 {
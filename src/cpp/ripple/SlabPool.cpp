@@ -0,0 +1,172 @@
+#include "SlabPool.h"
+
+#include <cstring>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#ifdef _MSC_VER
+#define SLAB_TLS __declspec(thread)
+#else
+#define SLAB_TLS __thread
+#endif
+
+SlabPool* SlabPool::sHeadPool = NULL;
+boost::mutex SlabPool::sPoolsLock;
+
+static boost::atomic<int> sNextShard(0);
+
+int SlabPool::getShard()
+{ // Hand out shards round robin as threads first allocate
+	static SLAB_TLS int iShard = -1;
+
+	if (iShard < 0)
+		iShard = sNextShard.fetch_add(1, boost::memory_order_relaxed) % sShards;
+
+	return iShard;
+}
+
+SlabPool::SlabPool(std::size_t size) : mSize(size)
+{
+	for (int i = 0; i < sShards; ++i)
+		mShards[i] = new Shard(size + sHeader);
+
+	boost::mutex::scoped_lock sl(sPoolsLock);
+	mNextPool = sHeadPool;
+	sHeadPool = this;
+}
+
+void* SlabPool::malloc()
+{
+	int shard = getShard();
+	void* chunk;
+
+	{
+		Shard& s = *mShards[shard];
+		boost::mutex::scoped_lock sl(s.mLock);
+		chunk = s.mPool.malloc();
+		if (!chunk)
+			throw std::bad_alloc();
+		++s.mLive;
+	}
+
+	*static_cast<uint64*>(chunk) = shard;
+	return static_cast<char*>(chunk) + sHeader;
+}
+
+void SlabPool::free(void* ptr)
+{
+	if (!ptr)
+		return;
+
+	void* chunk = static_cast<char*>(ptr) - sHeader;
+	Shard& s = *mShards[*static_cast<uint64*>(chunk)];
+
+	boost::mutex::scoped_lock sl(s.mLock);
+	s.mPool.free(chunk);
+	--s.mLive;
+}
+
+int SlabPool::release()
+{
+	int emptied = 0;
+
+	for (int i = 0; i < sShards; ++i)
+	{
+		Shard& s = *mShards[i];
+		boost::mutex::scoped_lock sl(s.mLock);
+		if ((s.mLive == 0) && s.mPool.purge_memory())
+			++emptied;
+	}
+
+	return emptied;
+}
+
+int SlabPool::releaseAll()
+{
+	int emptied = 0;
+
+	boost::mutex::scoped_lock sl(sPoolsLock);
+	for (SlabPool* pool = sHeadPool; pool != NULL; pool = pool->mNextPool)
+		emptied += pool->release();
+
+	return emptied;
+}
+
+BOOST_AUTO_TEST_SUITE(SlabPool_suite)
+
+namespace
+{
+	struct SlabTestItem { char mData[40]; };
+
+	void slabChurn(std::vector<void*>* kept, int count)
+	{ // allocate on this thread, keep every other chunk for the caller to free
+		SlabPool& pool = SlabPool::get<sizeof(SlabTestItem)>();
+		for (int i = 0; i < count; ++i)
+		{
+			void* ptr = pool.malloc();
+			if (i & 1)
+				kept->push_back(ptr);
+			else
+				pool.free(ptr);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(SlabPool_test)
+{
+	SlabPool& pool = SlabPool::get<sizeof(SlabTestItem)>();
+	if (&pool != &SlabPool::get<sizeof(SlabTestItem)>())	BOOST_FAIL("Pools not shared by size");
+	if (pool.getSize() != sizeof(SlabTestItem))			BOOST_FAIL("Pool size");
+
+	void* a = pool.malloc();
+	void* b = pool.malloc();
+	if (!a || !b || (a == b))							BOOST_FAIL("Chunks overlap");
+	if ((reinterpret_cast<std::size_t>(a) % 8) != 0)	BOOST_FAIL("Chunk misaligned");
+	pool.free(a);
+	pool.free(b);
+	pool.free(NULL);
+
+	// Chunks allocated on other threads are freed here, and go back to the shards they came from
+	std::vector<void*> kept[4];
+	boost::thread_group threads;
+	for (int i = 0; i < 4; ++i)
+		threads.create_thread(boost::bind(&slabChurn, &kept[i], 10000));
+	threads.join_all();
+
+	pool.release();
+	for (int i = 0; i < 4; ++i)
+	{
+		if (kept[i].size() != 5000)						BOOST_FAIL("Churn count");
+		for (std::vector<void*>::iterator it = kept[i].begin(); it != kept[i].end(); ++it)
+			memset(*it, i, sizeof(SlabTestItem));		// still ours after a release
+	}
+	for (int i = 0; i < 4; ++i)
+		for (std::vector<void*>::iterator it = kept[i].begin(); it != kept[i].end(); ++it)
+			pool.free(*it);
+
+	if (pool.release() == 0)							BOOST_FAIL("Empty shards kept their slabs");
+}
+
+BOOST_AUTO_TEST_CASE(SlabAllocator_test)
+{
+	typedef SlabAllocator<SlabTestItem> Allocator;
+	Allocator alloc;
+
+	SlabTestItem* one = alloc.allocate(1);
+	SlabTestItem* many = alloc.allocate(3);
+	if (!one || !many)									BOOST_FAIL("Allocate");
+	alloc.deallocate(one, 1);
+	alloc.deallocate(many, 3);
+
+	boost::shared_ptr<SlabTestItem> shared = boost::allocate_shared<SlabTestItem>(alloc);
+	if (!shared)										BOOST_FAIL("allocate_shared");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// vim:ts=4
@@ -0,0 +1,108 @@
+#ifndef SLAB_POOL__H
+#define SLAB_POOL__H
+
+#include <cstddef>
+#include <new>
+
+#include <boost/pool/pool.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "types.h"
+
+// Fixed-size chunks carved from slabs. A single process-wide pool serializes every allocation on one lock,
+// so the slabs are split into shards and each thread allocates from its own. A chunk remembers its shard
+// and goes back there wherever it's freed. Shards with nothing allocated return their slabs on release().
+
+class SlabPool
+{
+protected:
+	static const int			sShards = 8;
+	static const std::size_t	sHeader = sizeof(uint64);	// shard index, keeps chunks 8-byte aligned
+
+	struct Shard
+	{
+		boost::mutex			mLock;
+		boost::pool<>			mPool;
+		int						mLive;		// chunks handed out and not yet freed
+
+		Shard(std::size_t size) : mPool(size), mLive(0) { ; }
+	};
+
+	static SlabPool*			sHeadPool;
+	static boost::mutex			sPoolsLock;
+
+	std::size_t					mSize;
+	Shard*						mShards[sShards];
+	SlabPool*					mNextPool;
+
+	static int getShard();
+
+	SlabPool(const SlabPool&);				// no implementation
+	SlabPool& operator=(const SlabPool&);	// no implementation
+
+public:
+	SlabPool(std::size_t size);
+
+	void* malloc();
+	void free(void* ptr);
+
+	std::size_t getSize() const	{ return mSize; }
+
+	// Give the slabs of shards with nothing allocated back, returns how many shards were emptied
+	int release();
+
+	// Release every pool, called periodically
+	static int releaseAll();
+
+	// The pool for chunks of a size, never destroyed: chunks can outlive static destruction
+	template<std::size_t size> static SlabPool& get()
+	{
+		static SlabPool* pool = new SlabPool(size);
+		return *pool;
+	}
+};
+
+template<typename T> class SlabAllocator
+{ // Single objects come from the slab for their size, arrays from the heap
+public:
+	typedef T					value_type;
+	typedef T*					pointer;
+	typedef const T*			const_pointer;
+	typedef T&					reference;
+	typedef const T&			const_reference;
+	typedef std::size_t			size_type;
+	typedef std::ptrdiff_t		difference_type;
+
+	template<typename U> struct rebind { typedef SlabAllocator<U> other; };
+
+	SlabAllocator()									{ ; }
+	template<typename U> SlabAllocator(const SlabAllocator<U>&)	{ ; }
+
+	pointer address(reference r) const				{ return &r; }
+	const_pointer address(const_reference r) const	{ return &r; }
+	size_type max_size() const						{ return static_cast<size_type>(-1) / sizeof(T); }
+
+	pointer allocate(size_type n, const void* = NULL)
+	{
+		if (n != 1)
+			return static_cast<pointer>(::operator new(n * sizeof(T)));
+		return static_cast<pointer>(SlabPool::get<sizeof(T)>().malloc());
+	}
+
+	void deallocate(pointer ptr, size_type n)
+	{
+		if (n != 1)
+			::operator delete(ptr);
+		else
+			SlabPool::get<sizeof(T)>().free(ptr);
+	}
+
+	void construct(pointer ptr, const T& value)		{ new (ptr) T(value); }
+	void destroy(pointer ptr)						{ ptr->~T(); }
+
+	template<typename U> bool operator==(const SlabAllocator<U>&) const	{ return true; }
+	template<typename U> bool operator!=(const SlabAllocator<U>&) const	{ return false; }
+};
+
+#endif
+// vim:ts=4
@@ -0,0 +1,350 @@
+#include "Squelch.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <map>
+
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/test/unit_test.hpp>
+
+void PeerSquelch::squelch(const std::string& validator, int until)
+{
+	boost::mutex::scoped_lock sl(mLock);
+
+	mValidators[validator] = until;
+	mCount.store(mValidators.size());
+}
+
+void PeerSquelch::unsquelch(const std::string& validator)
+{
+	boost::mutex::scoped_lock sl(mLock);
+
+	mValidators.erase(validator);
+	mCount.store(mValidators.size());
+}
+
+bool PeerSquelch::isSquelched(const std::string& validator, int now)
+{
+	if (mCount.load() == 0)
+		return false;
+
+	boost::mutex::scoped_lock sl(mLock);
+
+	boost::unordered_map<std::string, int>::iterator it = mValidators.find(validator);
+	if (it == mValidators.end())
+		return false;
+
+	if (it->second > now)
+		return true;
+
+	mValidators.erase(it);
+	mCount.store(mValidators.size());
+	return false;
+}
+
+void SquelchTable::addMessage(const std::string& validator, uint64 peer, bool first, int now)
+{
+	boost::mutex::scoped_lock sl(mLock);
+
+	ValidatorMap::iterator it = mValidators.find(validator);
+	if (it == mValidators.end())
+	{
+		if (!first)
+			return;
+		it = mValidators.insert(std::make_pair(validator, Validator())).first;
+	}
+
+	Validator& entry = it->second;
+	entry.mLastSeen = now;
+
+	Source& source = entry.mSources[peer];
+	++source.mMessages;
+	source.mLastSeen = now;
+
+	if (first)
+	{
+		++entry.mMessages;
+		++source.mFirsts;
+	}
+	else
+		++mDuplicates;
+}
+
+void SquelchTable::select(Validator& validator, const std::string& key, int now, std::vector<Action>& actions)
+{ // must hold lock, keeps the peers that were first most often
+	if ((validator.mMessages < SQUELCH_MESSAGES) || (validator.mSources.size() <= SQUELCH_SOURCES))
+		return;
+
+	std::vector< std::pair< std::pair<int, int>, uint64 > > ranked;
+	ranked.reserve(validator.mSources.size());
+
+	for (boost::unordered_map<uint64, Source>::iterator it = validator.mSources.begin(),
+		end = validator.mSources.end(); it != end; ++it)
+		ranked.push_back(std::make_pair(std::make_pair(-it->second.mFirsts, -it->second.mMessages), it->first));
+
+	std::sort(ranked.begin(), ranked.end());
+
+	for (int i = 0, count = ranked.size(); i < count; ++i)
+	{
+		if (i < SQUELCH_SOURCES)
+			validator.mSelected.insert(ranked[i].second);
+		else
+		{
+			validator.mSquelched.insert(ranked[i].second);
+			actions.push_back(Action(ranked[i].second, key, SQUELCH_MAX_SECONDS));
+			++mSquelches;
+		}
+	}
+
+	// Rounds end at different times, so peers don't all resume at once
+	validator.mRoundEnd = now + SQUELCH_MIN_SECONDS + (rand() % (SQUELCH_MAX_SECONDS - SQUELCH_MIN_SECONDS));
+}
+
+void SquelchTable::reset(Validator& validator, const std::string& key, std::vector<Action>& actions)
+{ // must hold lock, lifts the squelches and starts counting again
+	BOOST_FOREACH(uint64 peer, validator.mSquelched)
+		actions.push_back(Action(peer, key, 0));
+
+	validator.mSources.clear();
+	validator.mSelected.clear();
+	validator.mSquelched.clear();
+	validator.mMessages = 0;
+	validator.mRoundEnd = 0;
+}
+
+void SquelchTable::evaluate(int now, std::vector<Action>& actions)
+{
+	boost::mutex::scoped_lock sl(mLock);
+
+	ValidatorMap::iterator it = mValidators.begin();
+	while (it != mValidators.end())
+	{
+		Validator& validator = it->second;
+
+		if (validator.mLastSeen <= (now - SQUELCH_EXPIRE_SECONDS))
+		{
+			reset(validator, it->first, actions);
+			it = mValidators.erase(it);
+			continue;
+		}
+
+		// Squelched peers are quiet because we asked, anyone else this quiet has stopped relaying or gone
+		bool lostSource = false;
+		boost::unordered_map<uint64, Source>::iterator source = validator.mSources.begin();
+		while (source != validator.mSources.end())
+		{
+			if ((source->second.mLastSeen <= (now - SQUELCH_IDLE_SECONDS)) && !validator.mSquelched.count(source->first))
+			{
+				if (validator.mSelected.count(source->first))
+					lostSource = true;
+				source = validator.mSources.erase(source);
+			}
+			else
+				++source;
+		}
+
+		if (lostSource || (!validator.mSelected.empty() && (now >= validator.mRoundEnd)))
+			reset(validator, it->first, actions);
+
+		if (validator.mSelected.empty())
+			select(validator, it->first, now, actions);
+
+		++it;
+	}
+}
+
+Json::Value SquelchTable::getJson()
+{
+	Json::Value ret(Json::objectValue);
+	int squelched = 0;
+
+	boost::mutex::scoped_lock sl(mLock);
+
+	BOOST_FOREACH(const ValidatorMap::value_type& it, mValidators)
+		squelched += it.second.mSquelched.size();
+
+	ret["validators"]	= static_cast<int>(mValidators.size());
+	ret["squelched"]	= squelched;
+	ret["duplicates"]	= boost::lexical_cast<std::string>(mDuplicates);
+	ret["squelches"]	= boost::lexical_cast<std::string>(mSquelches);
+
+	return ret;
+}
+
+BOOST_AUTO_TEST_SUITE(Squelch_suite)
+
+BOOST_AUTO_TEST_CASE(PeerSquelch_test)
+{
+	PeerSquelch squelch;
+
+	if (squelch.isSquelched("v1", 0))		BOOST_FAIL("Squelched by default");
+	squelch.squelch("v1", 100);
+	if (!squelch.isSquelched("v1", 99))		BOOST_FAIL("Not squelched");
+	if (squelch.isSquelched("v2", 99))		BOOST_FAIL("Other validator squelched");
+	if (squelch.isSquelched("v1", 100))		BOOST_FAIL("Squelch didn't expire");
+	if (squelch.getCount() != 0)			BOOST_FAIL("Expired squelch kept");
+	squelch.squelch("v1", 100);
+	squelch.unsquelch("v1");
+	if (squelch.isSquelched("v1", 0))		BOOST_FAIL("Unsquelch");
+}
+
+namespace
+{
+	struct SquelchNode
+	{
+		std::vector<int>						peers;
+		std::map<int, PeerSquelch*>				squelchedBy;	// what each peer asked this node not to relay
+		SquelchTable							table;
+
+		~SquelchNode()
+		{
+			for (std::map<int, PeerSquelch*>::iterator it = squelchedBy.begin(); it != squelchedBy.end(); ++it)
+				delete it->second;
+		}
+	};
+
+	struct SquelchNetwork
+	{ // Nodes that flood every validator's messages, with equal latency on every link
+		std::vector<SquelchNode*>	nodes;
+		uint64						sent, avoided, missed;
+
+		SquelchNetwork(int size, int degree) : sent(0), avoided(0), missed(0)
+		{
+			for (int i = 0; i < size; ++i)
+				nodes.push_back(new SquelchNode());
+
+			for (int i = 0; i < size; ++i)
+			{ // a ring, so it's connected, then random links
+				link(i, (i + 1) % size);
+				while (static_cast<int>(nodes[i]->peers.size()) < degree)
+					link(i, rand() % size);
+			}
+		}
+
+		~SquelchNetwork()
+		{
+			BOOST_FOREACH(SquelchNode* node, nodes)
+				delete node;
+		}
+
+		void link(int a, int b)
+		{
+			if ((a == b) || nodes[a]->squelchedBy.count(b))
+				return;
+			nodes[a]->peers.push_back(b);
+			nodes[b]->peers.push_back(a);
+			nodes[a]->squelchedBy[b] = new PeerSquelch();
+			nodes[b]->squelchedBy[a] = new PeerSquelch();
+		}
+
+		void flood(int origin, const std::string& validator, int now)
+		{
+			std::vector<bool> seen(nodes.size(), false);
+			std::deque< std::pair<int, int> > inFlight;		// from, to
+
+			seen[origin] = true;
+			BOOST_FOREACH(int peer, nodes[origin]->peers)
+				inFlight.push_back(std::make_pair(origin, peer));
+
+			while (!inFlight.empty())
+			{
+				int from = inFlight.front().first, to = inFlight.front().second;
+				inFlight.pop_front();
+				++sent;
+
+				SquelchNode& node = *nodes[to];
+				node.table.addMessage(validator, from, !seen[to], now);
+				if (seen[to])
+					continue;
+				seen[to] = true;
+
+				std::vector<int> peers = node.peers;
+				std::random_shuffle(peers.begin(), peers.end());
+				BOOST_FOREACH(int peer, peers)
+				{
+					if (peer == from)
+						continue;
+					if (node.squelchedBy[peer]->isSquelched(validator, now))
+						++avoided;
+					else
+						inFlight.push_back(std::make_pair(to, peer));
+				}
+			}
+
+			missed += std::count(seen.begin(), seen.end(), false);
+		}
+
+		void evaluate(int now)
+		{
+			for (int i = 0, size = nodes.size(); i < size; ++i)
+			{
+				std::vector<SquelchTable::Action> actions;
+				nodes[i]->table.evaluate(now, actions);
+
+				BOOST_FOREACH(const SquelchTable::Action& action, actions)
+				{
+					PeerSquelch& squelch = *nodes[action.peer]->squelchedBy[i];
+					if (action.duration == 0)
+						squelch.unsquelch(action.validator);
+					else
+						squelch.squelch(action.validator, now + action.duration);
+				}
+			}
+		}
+	};
+
+	void runSquelchNetwork(bool squelch, int iNodes, int iDegree, int iValidators, int iSeconds,
+		uint64& sent, uint64& avoided, uint64& missed)
+	{
+		srand(3);
+		SquelchNetwork network(iNodes, iDegree);
+
+		for (int now = 1; now <= iSeconds; ++now)
+		{
+			if (now == (iSeconds / 2))
+				network.sent = network.avoided = 0;
+
+			for (int v = 0; v < iValidators; ++v)
+				network.flood(v, boost::lexical_cast<std::string>(v), now);
+
+			if (squelch && ((now % 5) == 0))
+				network.evaluate(now);
+		}
+
+		sent	= network.sent;
+		avoided	= network.avoided;
+		missed	= network.missed;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Squelch_Network_test)
+{ // Messages sent over the second half of a run, once the rounds have settled, with and without squelching
+	uint64 floodSent, floodAvoided, floodMissed, sent, avoided, missed;
+
+	runSquelchNetwork(false, 30, 10, 4, 700, floodSent, floodAvoided, floodMissed);
+	runSquelchNetwork(true, 30, 10, 4, 700, sent, avoided, missed);
+
+	if (floodMissed || missed)		BOOST_FAIL("Squelching cut nodes off from a validator");
+	if (sent >= floodSent / 2)		BOOST_FAIL("Squelching saved too little");
+}
+
+#ifdef ENABLE_BENCHMARKS
+
+BOOST_AUTO_TEST_CASE(Squelch_Network_bench)
+{
+	uint64 floodSent, floodAvoided, floodMissed, sent, avoided, missed;
+
+	runSquelchNetwork(false, 60, 12, 10, 1200, floodSent, floodAvoided, floodMissed);
+	runSquelchNetwork(true, 60, 12, 10, 1200, sent, avoided, missed);
+
+	BOOST_TEST_MESSAGE("Squelch: " << floodSent << " messages flooded, " << sent << " with squelching ("
+		<< (sent * 100 / floodSent) << "%), " << avoided << " relays avoided, " << missed << " missed");
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// vim:ts=4
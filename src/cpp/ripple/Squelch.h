@@ -0,0 +1,101 @@
+#ifndef SQUELCH__H
+#define SQUELCH__H
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "../json/value.h"
+
+#include "types.h"
+
+// Every peer relays each validator's proposals and validations, so in a dense mesh a node gets every one of them
+// from nearly all its peers. A node picks a few peers that deliver a validator's messages first, and asks the
+// others to stop relaying that validator to it for a while. Rounds are re-run, so the choice follows the network.
+
+#define SQUELCH_SOURCES			5		// Peers kept per validator
+#define SQUELCH_MESSAGES		20		// Messages from a validator to see before choosing
+#define SQUELCH_IDLE_SECONDS	16		// A source this quiet is gone, and the choice is redone
+#define SQUELCH_EXPIRE_SECONDS	300		// A validator this quiet is forgotten
+#define SQUELCH_MIN_SECONDS		300		// A round lasts between these two
+#define SQUELCH_MAX_SECONDS		600		// and peers are told to resume by themselves after the longest
+
+class PeerSquelch
+{ // The validators a peer asked us not to relay to it, and until when
+protected:
+	boost::mutex							mLock;
+	boost::unordered_map<std::string, int>	mValidators;
+	boost::atomic<int>						mCount;		// so peers that never squelch cost no lock
+
+public:
+	PeerSquelch() : mCount(0)	{ ; }
+
+	void squelch(const std::string& validator, int until);
+	void unsquelch(const std::string& validator);
+	bool isSquelched(const std::string& validator, int now);
+	int getCount()				{ return mCount.load(); }
+};
+
+class SquelchTable
+{ // The sources of each trusted validator's messages, and which of them we've squelched
+public:
+	struct Action
+	{ // Tell a peer to stop relaying a validator's messages for this many seconds, or to resume if zero
+		uint64		peer;
+		std::string	validator;
+		int			duration;
+
+		Action(uint64 p, const std::string& v, int d) : peer(p), validator(v), duration(d) { ; }
+	};
+
+protected:
+	struct Source
+	{
+		int		mMessages;		// this round
+		int		mFirsts;		// messages this peer was first to deliver
+		int		mLastSeen;
+
+		Source() : mMessages(0), mFirsts(0), mLastSeen(0) { ; }
+	};
+
+	struct Validator
+	{
+		boost::unordered_map<uint64, Source>	mSources;
+		std::set<uint64>						mSelected;		// empty while counting
+		std::set<uint64>						mSquelched;
+		int										mMessages;
+		int										mRoundEnd;
+		int										mLastSeen;
+
+		Validator() : mMessages(0), mRoundEnd(0), mLastSeen(0) { ; }
+	};
+
+	typedef boost::unordered_map<std::string, Validator> ValidatorMap;
+
+	boost::mutex	mLock;
+	ValidatorMap	mValidators;
+	uint64			mDuplicates;
+	uint64			mSquelches;
+
+	void select(Validator& validator, const std::string& key, int now, std::vector<Action>& actions);
+	void reset(Validator& validator, const std::string& key, std::vector<Action>& actions);
+
+public:
+	SquelchTable() : mDuplicates(0), mSquelches(0) { ; }
+
+	// A trusted validator's message, with its signature verified, came from a peer.
+	// Duplicates of validators we aren't tracking are ignored.
+	void addMessage(const std::string& validator, uint64 peer, bool first, int now);
+
+	// Called periodically: chooses sources, and ends rounds, returning the squelches to send
+	void evaluate(int now, std::vector<Action>& actions);
+
+	Json::Value getJson();
+};
+
+#endif
+// vim:ts=4
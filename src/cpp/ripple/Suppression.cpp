@@ -1,70 +1,147 @@
 #include "Suppression.h"
 
+#include <algorithm>
+
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "Serializer.h"
+#include "Metrics.h"
 
 DECLARE_INSTANCE(Suppression);
 
 extern int upTime();
 
-Suppression& SuppressionTable::findCreateEntry(const uint256& index, bool& created)
+void Suppression::addPeer(uint64 peer)
+{
+	if ((peer == 0) || hasPeer(peer))
+		return;
+
+	if (mPeerCount < sInlinePeers)
+		mPeers[mPeerCount++] = peer;
+	else
+		mMorePeers.push_back(peer);
+}
+
+bool Suppression::hasPeer(uint64 peer) const
+{
+	for (int i = 0; i < mPeerCount; ++i)
+		if (mPeers[i] == peer)
+			return true;
+
+	return std::find(mMorePeers.begin(), mMorePeers.end(), peer) != mMorePeers.end();
+}
+
+void Suppression::getPeers(std::set<uint64>& peers) const
+{
+	peers.insert(mPeers, mPeers + mPeerCount);
+	peers.insert(mMorePeers.begin(), mMorePeers.end());
+}
+
+void Suppression::swapSet(std::set<uint64>& s)
+{ // s gets our peers, we get the peers in s
+	std::set<uint64> newPeers;
+	newPeers.swap(s);
+	getPeers(s);
+
+	mPeerCount = 0;
+	mMorePeers.clear();
+	BOOST_FOREACH(uint64 peer, newPeers)
+		addPeer(peer);
+}
+
+SuppressionTable::SuppressionTable(int holdTime) : mHoldTime(holdTime)
+{
+	int now = upTime();
+
+	for (int i = 0; i < sShards; ++i)
+	{
+		mShards[i].mWheel.resize(mHoldTime + 1);
+		mShards[i].mExpired = now - mHoldTime;
+	}
+}
+
+SuppressionTable::Shard& SuppressionTable::getShard(const uint256& index)
+{ // the indexes are hashes, so any byte spreads them evenly
+	return mShards[*index.begin() % sShards];
+}
+
+void SuppressionTable::expire(Shard& shard, int now)
+{ // Clear the slots of every second that has passed the hold time since the last call, at most the whole wheel
+	int expireTo = now - mHoldTime;
+	if (expireTo <= shard.mExpired)
+		return;
+
+	int slots = shard.mWheel.size();
+	for (int second = std::max(shard.mExpired + 1, expireTo - slots + 1); second <= expireTo; ++second)
+	{
+		std::vector<uint256>& slot = shard.mWheel[second % slots];
+
+		BOOST_FOREACH(const uint256& index, slot)
+			shard.mMap.erase(index);
+		slot.clear();		// keeps its capacity for the next time around
+	}
+
+	shard.mExpired = expireTo;
+}
+
+Suppression& SuppressionTable::findCreateEntry(Shard& shard, const uint256& index, bool& created)
 {
-	boost::unordered_map<uint256, Suppression>::iterator fit = mSuppressionMap.find(index);
+	SuppressionMap::iterator fit = shard.mMap.find(index);
 
-	if (fit != mSuppressionMap.end())
+	if (fit != shard.mMap.end())
 	{
 		created = false;
 		return fit->second;
 	}
 	created = true;
 
-	int now = upTime();
-	int expireTime = now - mHoldTime;
-
 	// See if any supressions need to be expired
-	std::map< int, std::list<uint256> >::iterator it = mSuppressionTimes.begin();
-	if ((it != mSuppressionTimes.end()) && (it->first <= expireTime))
-	{
-		BOOST_FOREACH(const uint256& lit, it->second)
-			mSuppressionMap.erase(lit);
-		mSuppressionTimes.erase(it);
-	}
+	int now = upTime();
+	expire(shard, now);
 
-	mSuppressionTimes[now].push_back(index);
-	return mSuppressionMap.insert(std::make_pair(index, Suppression())).first->second;
+	shard.mWheel[now % shard.mWheel.size()].push_back(index);
+	return shard.mMap.insert(std::make_pair(index, Suppression())).first->second;
 }
 
 bool SuppressionTable::addSuppression(const uint256& index)
 {
-	boost::mutex::scoped_lock sl(mSuppressionMutex);
+	Shard& shard = getShard(index);
+	boost::mutex::scoped_lock sl(shard.mLock);
 
 	bool created;
-	findCreateEntry(index, created);
+	findCreateEntry(shard, index, created);
 	return created;
 }
 
 Suppression SuppressionTable::getEntry(const uint256& index)
 {
-	boost::mutex::scoped_lock sl(mSuppressionMutex);
+	Shard& shard = getShard(index);
+	boost::mutex::scoped_lock sl(shard.mLock);
 
 	bool created;
-	return findCreateEntry(index, created);
+	return findCreateEntry(shard, index, created);
 }
 
 bool SuppressionTable::addSuppressionPeer(const uint256& index, uint64 peer)
 {
-	boost::mutex::scoped_lock sl(mSuppressionMutex);
+	Shard& shard = getShard(index);
+	boost::mutex::scoped_lock sl(shard.mLock);
 
 	bool created;
-	findCreateEntry(index, created).addPeer(peer);
+	findCreateEntry(shard, index, created).addPeer(peer);
 	return created;
 }
 
 bool SuppressionTable::addSuppressionPeer(const uint256& index, uint64 peer, int& flags)
 {
-	boost::mutex::scoped_lock sl(mSuppressionMutex);
+	Shard& shard = getShard(index);
+	boost::mutex::scoped_lock sl(shard.mLock);
 
 	bool created;
-	Suppression &s = findCreateEntry(index, created);
+	Suppression &s = findCreateEntry(shard, index, created);
 	s.addPeer(peer);
 	flags = s.getFlags();
 	return created;
@@ -72,18 +149,20 @@ bool SuppressionTable::addSuppressionPeer(const uint256& index, uint64 peer, int
 
 int SuppressionTable::getFlags(const uint256& index)
 {
-	boost::mutex::scoped_lock sl(mSuppressionMutex);
+	Shard& shard = getShard(index);
+	boost::mutex::scoped_lock sl(shard.mLock);
 
 	bool created;
-	return findCreateEntry(index, created).getFlags();
+	return findCreateEntry(shard, index, created).getFlags();
 }
 
 bool SuppressionTable::addSuppressionFlags(const uint256& index, int flag)
 {
-	boost::mutex::scoped_lock sl(mSuppressionMutex);
+	Shard& shard = getShard(index);
+	boost::mutex::scoped_lock sl(shard.mLock);
 
 	bool created;
-	findCreateEntry(index, created).setFlag(flag);
+	findCreateEntry(shard, index, created).setFlag(flag);
 	return created;
 }
 
@@ -91,10 +170,11 @@ bool SuppressionTable::setFlag(const uint256& index, int flag)
 { // return: true = changed, false = unchanged
 	assert(flag != 0);
 
-	boost::mutex::scoped_lock sl(mSuppressionMutex);
+	Shard& shard = getShard(index);
+	boost::mutex::scoped_lock sl(shard.mLock);
 
 	bool created;
-	Suppression &s = findCreateEntry(index, created);
+	Suppression &s = findCreateEntry(shard, index, created);
 
 	if ((s.getFlags() & flag) == flag)
 		return false;
@@ -103,12 +183,25 @@ bool SuppressionTable::setFlag(const uint256& index, int flag)
 	return true;
 }
 
+uint256 SuppressionTable::getSignatureKey(const uint256& signingHash, const std::vector<unsigned char>& publicKey,
+	const std::vector<unsigned char>& signature)
+{
+	Serializer s(32 + publicKey.size() + signature.size() + 4);
+
+	s.add256(signingHash);
+	s.addVL(publicKey);
+	s.addVL(signature);
+
+	return s.getSHA512Half();
+}
+
 bool SuppressionTable::swapSet(const uint256& index, std::set<uint64>& peers, int flag)
 {
-	boost::mutex::scoped_lock sl(mSuppressionMutex);
+	Shard& shard = getShard(index);
+	boost::mutex::scoped_lock sl(shard.mLock);
 
 	bool created;
-	Suppression &s = findCreateEntry(index, created);
+	Suppression &s = findCreateEntry(shard, index, created);
 
 	if ((s.getFlags() & flag) == flag)
 		return false;
@@ -118,3 +211,63 @@ bool SuppressionTable::swapSet(const uint256& index, std::set<uint64>& peers, in
 
 	return true;
 }
+
+BOOST_AUTO_TEST_SUITE(Suppression_suite)
+
+BOOST_AUTO_TEST_CASE(Suppression_Peers_test)
+{
+	SuppressionTable table;
+	uint256 index = Serializer::getSHA512Half(std::string("suppression"));
+
+	if (!table.addSuppressionPeer(index, 1)) BOOST_FAIL("Suppression new");
+	for (uint64 peer = 1; peer <= 3 * Suppression::sInlinePeers; ++peer)
+	{
+		if (table.addSuppressionPeer(index, peer)) BOOST_FAIL("Suppression not new");
+		table.addSuppressionPeer(index, peer);
+	}
+
+	std::set<uint64> peers;
+	peers.insert(100);
+	if (!table.swapSet(index, peers, SF_RELAYED)) BOOST_FAIL("Suppression swap");
+	if (peers.size() != 3 * Suppression::sInlinePeers) BOOST_FAIL("Suppression peer count");
+	if (table.swapSet(index, peers, SF_RELAYED)) BOOST_FAIL("Suppression swap twice");
+
+	Suppression entry = table.getEntry(index);
+	if ((entry.getPeerCount() != 1) || !entry.hasPeer(100) || !entry.hasFlag(SF_RELAYED)) BOOST_FAIL("Suppression entry");
+}
+
+#ifdef ENABLE_BENCHMARKS
+
+static void suppressionWork(SuppressionTable* table, int thread, int count)
+{ // half the calls find an entry made by an earlier call
+	uint256 index;
+	index.zero();
+	for (int i = 0; i < count; ++i)
+	{
+		uint32 key = static_cast<uint32>((i / 2) * 2654435761u) ^ (thread << 24);
+		memcpy(index.begin(), &key, sizeof(key));
+		table->addSuppressionPeer(index, thread + 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Suppression_Throughput_bench)
+{
+	const int iThreads = 8, iCount = 250000;
+	SuppressionTable table;
+
+	uint64 start = LatencyHistogram::now();
+	boost::thread_group threads;
+	for (int i = 0; i < iThreads; ++i)
+		threads.create_thread(boost::bind(&suppressionWork, &table, i, iCount));
+	threads.join_all();
+	uint64 elapsed = std::max<uint64>(LatencyHistogram::now() - start, 1);
+
+	BOOST_TEST_MESSAGE("Suppression: " << (iThreads * iCount) << " operations on " << iThreads << " threads, "
+		<< (static_cast<uint64>(iThreads) * iCount * 1000000 / elapsed) << "/s");
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// vim:ts=4
@@ -2,8 +2,7 @@
 #define __SUPPRESSION__
 
 #include <set>
-#include <map>
-#include <list>
+#include <vector>
 
 #include <boost/unordered_map.hpp>
 #include <boost/thread/mutex.hpp>
@@ -22,42 +21,59 @@ DEFINE_INSTANCE(Suppression);
 
 class Suppression : private IS_INSTANCE(Suppression)
 {
+public:
+	static const int		sInlinePeers = 8;
+
 protected:
 	int						mFlags;
-	std::set<uint64>		mPeers;
+	int						mPeerCount;
+	uint64					mPeers[sInlinePeers];	// the first peers, kept without an allocation
+	std::vector<uint64>		mMorePeers;
 
 public:
-	Suppression()	: mFlags(0)					{ ; }
+	Suppression()	: mFlags(0), mPeerCount(0)	{ ; }
 
-	const std::set<uint64>& peekPeers()			{ return mPeers; }
-	void addPeer(uint64 peer)					{ if (peer != 0) mPeers.insert(peer); }
-	bool hasPeer(uint64 peer)					{ return mPeers.count(peer) > 0; }
+	void addPeer(uint64 peer);
+	bool hasPeer(uint64 peer) const;
+	int getPeerCount() const					{ return mPeerCount + static_cast<int>(mMorePeers.size()); }
+	void getPeers(std::set<uint64>& peers) const;
 
 	int getFlags(void)							{ return mFlags; }
 	bool hasFlag(int f)							{ return (mFlags & f) != 0; }
 	void setFlag(int f)							{ mFlags |= f; }
 	void clearFlag(int f)						{ mFlags &= ~f; }
-	void swapSet(std::set<uint64>& s)			{ mPeers.swap(s); }
+	void swapSet(std::set<uint64>& s);
 };
 
 class SuppressionTable
-{
+{ // Split into shards by hash, each with its own lock, map and expiration wheel
+public:
+	static const int sShards = 32;
+
 protected:
+	typedef boost::unordered_map<uint256, Suppression> SuppressionMap;
 
-	boost::mutex mSuppressionMutex;
+	struct Shard
+	{
+		boost::mutex					mLock;
 
-	// Stores all suppressed hashes and their expiration time
-	boost::unordered_map<uint256, Suppression> mSuppressionMap;
+		// Stores all suppressed hashes
+		SuppressionMap					mMap;
 
-	// Stores all expiration times and the hashes indexed for them
-	std::map< int, std::list<uint256> > mSuppressionTimes;
+		// One slot per second of the hold time, holding the hashes created in that second
+		std::vector< std::vector<uint256> >	mWheel;
+		int								mExpired;	// all slots up to this time have been expired
+	};
 
-	int mHoldTime;
+	Shard		mShards[sShards];
+	int			mHoldTime;
 
-	Suppression& findCreateEntry(const uint256&, bool& created);
+	Shard& getShard(const uint256& index);
+	void expire(Shard& shard, int now);
+	Suppression& findCreateEntry(Shard& shard, const uint256&, bool& created);
 
 public:
-	SuppressionTable(int holdTime = 120) : mHoldTime(holdTime) { ; }
+	SuppressionTable(int holdTime = 120);
 
 	bool addSuppression(const uint256& index);
 
@@ -71,6 +87,12 @@ public:
 
 	bool swapSet(const uint256& index, std::set<uint64>& peers, int flag);
 	bool swapSet(const uint256& index, std::set<uint64>& peers);
+
+	// Proposal and validation signature checks are kept as SF_SIGGOOD or SF_BAD under this key. A signing hash
+	// alone doesn't name the signer or the signature, so both are part of it.
+	static uint256 getSignatureKey(const uint256& signingHash, const std::vector<unsigned char>& publicKey,
+		const std::vector<unsigned char>& signature);
+	int getSignatureFlags(const uint256& key)	{ return getFlags(key) & (SF_SIGGOOD | SF_BAD); }
 };
 
 #endif
@@ -5,6 +5,8 @@
 #include <boost/make_shared.hpp>
 #include <boost/ref.hpp>
 
+#include "../database/SqliteDatabase.h"
+
 #include "Application.h"
 #include "Transaction.h"
 #include "Wallet.h"
@@ -147,6 +149,33 @@ void Transaction::save()
 	db->executeSQL(mTransaction->getSQLInsertReplaceHeader() + mTransaction->getSQL(getLedger(), status) + ";");
 }
 
+TransStatus Transaction::sqlTransactionStatus(char status)
+{
+	switch (status)
+	{
+		case TXN_SQL_NEW:			return NEW;
+		case TXN_SQL_CONFLICT:		return CONFLICTED;
+		case TXN_SQL_HELD:			return HELD;
+		case TXN_SQL_VALIDATED:		return COMMITTED;
+		case TXN_SQL_INCLUDED:		return INCLUDED;
+		case TXN_SQL_UNKNOWN:		return INVALID;
+		default: assert(false);
+	}
+	return INVALID;
+}
+
+Transaction::pointer Transaction::transactionFromSQL(SqliteStatement& stmt, bool bValidate)
+{ // columns: LedgerSeq, Status, RawTxn
+	Serializer rawTxn(stmt.getBlob(2));
+	SerializerIterator it(rawTxn);
+	SerializedTransaction::pointer txn = boost::make_shared<SerializedTransaction>(boost::ref(it));
+	Transaction::pointer tr = boost::make_shared<Transaction>(txn, bValidate);
+
+	tr->setStatus(sqlTransactionStatus(stmt.peekString(1)[0]));
+	tr->setLedger(stmt.getUInt32(0));
+	return tr;
+}
+
 Transaction::pointer Transaction::transactionFromSQL(Database* db, bool bValidate)
 {
 	Serializer rawTxn;
@@ -171,18 +200,7 @@ Transaction::pointer Transaction::transactionFromSQL(Database* db, bool bValidat
 	SerializedTransaction::pointer txn = boost::make_shared<SerializedTransaction>(boost::ref(it));
 	Transaction::pointer tr = boost::make_shared<Transaction>(txn, bValidate);
 
-	TransStatus st(INVALID);
-	switch (status[0])
-	{
-	case TXN_SQL_NEW:			st = NEW;			break;
-	case TXN_SQL_CONFLICT:		st = CONFLICTED;	break;
-	case TXN_SQL_HELD:			st = HELD;			break;
-	case TXN_SQL_VALIDATED:		st = COMMITTED;		break;
-	case TXN_SQL_INCLUDED:		st = INCLUDED;		break;
-	case TXN_SQL_UNKNOWN:							break;
-	default: assert(false);
-	}
-	tr->setStatus(st);
+	tr->setStatus(sqlTransactionStatus(status[0]));
 	tr->setLedger(inLedger);
 	return tr;
 }
@@ -198,8 +216,8 @@ Transaction::pointer Transaction::transactionFromSQL(const std::string& sql)
 	rawTxn.resize(txSize);
 
 	{
-		ScopedLock sl(theApp->getTxnDB()->getDBLock());
-		Database* db = theApp->getTxnDB()->getDB();
+		DatabaseReader dbr(theApp->getTxnDB());
+		Database* db = dbr.getDB();
 
 		if (!db->executeSQL(sql, true) || !db->startIterRows())
 			return Transaction::pointer();
@@ -220,18 +238,7 @@ Transaction::pointer Transaction::transactionFromSQL(const std::string& sql)
 	SerializedTransaction::pointer txn = boost::make_shared<SerializedTransaction>(boost::ref(it));
 	Transaction::pointer tr = boost::make_shared<Transaction>(txn, true);
 
-	TransStatus st(INVALID);
-	switch (status[0])
-	{
-		case TXN_SQL_NEW:			st = NEW;			break;
-		case TXN_SQL_CONFLICT:		st = CONFLICTED;	break;
-		case TXN_SQL_HELD:			st = HELD;			break;
-		case TXN_SQL_VALIDATED:		st = COMMITTED;		break;
-		case TXN_SQL_INCLUDED:		st = INCLUDED;		break;
-		case TXN_SQL_UNKNOWN:							break;
-		default: assert(false);
-	}
-	tr->setStatus(st);
+	tr->setStatus(sqlTransactionStatus(status[0]));
 	tr->setLedger(inLedger);
 	return tr;
 }
@@ -239,10 +246,25 @@ Transaction::pointer Transaction::transactionFromSQL(const std::string& sql)
 
 Transaction::pointer Transaction::load(const uint256& id)
 {
+#ifndef NO_SQLITE3_PREPARE
+
+	DatabaseReader dbr(theApp->getTxnDB());
+	SqliteStatement& pSt = dbr.getStatement("SELECT LedgerSeq,Status,RawTxn FROM Transactions WHERE TransID = ?;");
+
+	pSt.bind(1, id.GetHex());
+	if (!pSt.isRow(pSt.step()))
+		return Transaction::pointer();
+
+	return transactionFromSQL(pSt, true);
+
+#else
+
 	std::string sql = "SELECT LedgerSeq,Status,RawTxn FROM Transactions WHERE TransID='";
 	sql.append(id.GetHex());
 	sql.append("';");
 	return transactionFromSQL(sql);
+
+#endif
 }
 
 Transaction::pointer Transaction::findFrom(const RippleAddress& fromID, uint32 seq)
@@ -23,6 +23,7 @@
 #include "InstanceCounter.h"
 
 class Database;
+class SqliteStatement;
 
 enum TransStatus
 {
@@ -63,6 +64,7 @@ public:
 
 	static Transaction::pointer sharedTransaction(const std::vector<unsigned char>&vucTransaction, bool bValidate);
 	static Transaction::pointer transactionFromSQL(Database* db, bool bValidate);
+	static Transaction::pointer transactionFromSQL(SqliteStatement& stmt, bool bValidate);
 
 	Transaction(
 		TransactionType ttKind,
@@ -119,6 +121,7 @@ public:
 
 protected:
 	static Transaction::pointer transactionFromSQL(const std::string& statement);
+	static TransStatus sqlTransactionStatus(char status);
 };
 
 #endif
@@ -5,9 +5,12 @@
 #include <boost/format.hpp>
 #include <boost/foreach.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include "TransactionEngine.h"
 #include "Transactor.h"
+#include "UndoLog.h"
 
 #include "../json/writer.h"
 
@@ -20,6 +23,8 @@ SETUP_LOG();
 
 DECLARE_INSTANCE(TransactionEngine);
 
+TransactionTimer* TransactionEngine::sTimer = NULL;
+
 void TransactionEngine::txnWrite()
 {
 	// Write back the account states
@@ -71,9 +76,51 @@ TER TransactionEngine::applyTransaction(const SerializedTransaction& txn, Transa
 	bool& didApply)
 {
 	cLog(lsTRACE) << "applyTransaction>";
+
+	TER terResult = executeTransaction(txn, params, didApply);
+
+	if (didApply)
+		writeTransaction(txn, params, terResult);
+
+	mTxnAccount.reset();
+	mNodes.clear();
+
+	if (!isSetBit(params, tapOPEN_LEDGER) && isTemMalformed(terResult))
+	{
+		// XXX Malformed or failed transaction in closed ledger must bow out.
+	}
+
+	return terResult;
+}
+
+TER TransactionEngine::commitTransaction(const SerializedTransaction& txn, TransactionEngineParams params,
+	LedgerEntrySet& nodes, TER terResult, bool didApply)
+{ // Write the entries another engine built against our ledger before any of the transactions ahead of this one
+	mNodes.swapWith(nodes);
+	assert(mNodes.getLedgerRef() == mLedger);
+
+	if (didApply)
+		writeTransaction(txn, params, terResult);
+
+	mTxnAccount.reset();
+	mNodes.clear();
+
+	return terResult;
+}
+
+TER TransactionEngine::executeTransaction(const SerializedTransaction& txn, TransactionEngineParams params,
+	bool& didApply)
+{
 	didApply = false;
 	assert(mLedger);
+
+	boost::posix_time::ptime startTime;
+	if (sTimer)
+		startTime = boost::posix_time::microsec_clock::universal_time();
+
 	mNodes.init(mLedger, txn.getTransactionID(), mLedger->getLedgerSeq());
+	if (isSetBit(params, tapOPEN_LEDGER) || isSetBit(params, tapSPECULATIVE))
+		mNodes.setReads(boost::make_shared<LedgerEntryReads>());
 
 #ifdef DEBUG
 	if (1)
@@ -151,47 +198,63 @@ TER TransactionEngine::applyTransaction(const SerializedTransaction& txn, Transa
 		else
 			cLog(lsDEBUG) << "Not applying transaction";
 
-		if (didApply)
-		{
-			// Transaction succeeded fully or (retries are not allowed and the transaction could claim a fee)
-			Serializer m;
-			mNodes.calcRawMeta(m, terResult, mTxnSeq++);
+		if (sTimer)
+			sTimer->executed(txn.getTxnType(),
+				(boost::posix_time::microsec_clock::universal_time() - startTime).total_microseconds());
 
-			txnWrite();
+		return terResult;
+	}
+	else
+	{
+		cLog(lsWARNING) << "applyTransaction: Invalid transaction: unknown transaction type";
+		return temUNKNOWN;
+	}
+}
 
-			Serializer s;
-			txn.add(s);
+void TransactionEngine::writeTransaction(const SerializedTransaction& txn, TransactionEngineParams params,
+	TER terResult)
+{ // Transaction succeeded fully or (retries are not allowed and the transaction could claim a fee)
+	uint256 txID = txn.getTransactionID();
 
-			if (isSetBit(params, tapOPEN_LEDGER))
-			{
-				if (!mLedger->addTransaction(txID, s))
-					assert(false);
-			}
-			else
-			{
-				if (!mLedger->addTransaction(txID, s, m))
-					assert(false);
+	Serializer m;
+	mNodes.calcRawMeta(m, terResult, mTxnSeq++);
 
-				// Charge whatever fee they specified.
-				STAmount saPaid = txn.getTransactionFee();
-				mLedger->destroyCoins(saPaid.getNValue());
-			}
-		}
+	// Remember what an open ledger transaction did, so the next open ledger can take it without running it
+	TransactionUndo::pointer undo;
+	if (isSetBit(params, tapOPEN_LEDGER) && mNodes.getReads() && !mNodes.getReads()->mWholeLedger)
+		undo = boost::make_shared<TransactionUndo>(boost::cref(txn), boost::ref(mNodes), mLedger);
+
+	if (sTimer)
+	{
+		boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+		txnWrite();
+		sTimer->written((boost::posix_time::microsec_clock::universal_time() - startTime).total_microseconds());
+	}
+	else
+		txnWrite();
 
-		mTxnAccount.reset();
-		mNodes.clear();
+	if (undo)
+	{
+		undo->written(mLedger);
+		mLedger->getUndoLog(true)->add(undo);
+	}
 
-		if (!isSetBit(params, tapOPEN_LEDGER) && isTemMalformed(terResult))
-		{
-			// XXX Malformed or failed transaction in closed ledger must bow out.
-		}
+	Serializer s;
+	txn.add(s);
 
-		return terResult;
+	if (isSetBit(params, tapOPEN_LEDGER))
+	{
+		if (!mLedger->addTransaction(txID, s))
+			assert(false);
 	}
 	else
 	{
-		cLog(lsWARNING) << "applyTransaction: Invalid transaction: unknown transaction type";
-		return temUNKNOWN;
+		if (!mLedger->addTransaction(txID, s, m))
+			assert(false);
+
+		// Charge whatever fee they specified.
+		STAmount saPaid = txn.getTransactionFee();
+		mLedger->destroyCoins(saPaid.getNValue());
 	}
 }
 
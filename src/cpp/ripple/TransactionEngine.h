@@ -32,6 +32,19 @@ enum TransactionEngineParams
 
 	tapRETRY			= 0x20,	// This is not the transaction's last pass
 		// Transaction can be retried, soft failures allowed
+
+	tapSPECULATIVE		= 0x40,	// Transaction runs ahead, against a ledger nothing is writing to
+		// record what it reads so the write can be checked for conflicts, skip the ledger lock
+};
+
+// Told how long each transaction took, for benchmarks. Called from every thread that applies transactions.
+class TransactionTimer
+{
+public:
+	virtual ~TransactionTimer() { ; }
+
+	virtual void executed(TransactionType type, int microseconds) = 0;	// ran the transactor
+	virtual void written(int microseconds) = 0;							// wrote the entries and rehashed the state map
 };
 
 // One instance per ledger.
@@ -61,7 +74,10 @@ protected:
 	uint160				mTxnAccountID;
 	SLE::pointer		mTxnAccount;
 
+	static TransactionTimer*	sTimer;
+
 	void				txnWrite();
+	void				writeTransaction(const SerializedTransaction&, TransactionEngineParams, TER);
 
 public:
 	typedef boost::shared_ptr<TransactionEngine> pointer;
@@ -73,12 +89,20 @@ public:
 	Ledger::ref getLedger()				{ return mLedger; }
 	void setLedger(Ledger::ref ledger)	{ assert(ledger); mLedger = ledger; }
 
+	static void setTimer(TransactionTimer* timer)	{ sTimer = timer; }	// NULL to stop timing
+
 	SLE::pointer		entryCreate(LedgerEntryType type, const uint256& index)		{ return mNodes.entryCreate(type, index); }
 	SLE::pointer		entryCache(LedgerEntryType type, const uint256& index)		{ return mNodes.entryCache(type, index); }
 	void				entryDelete(SLE::ref sleEntry)								{ mNodes.entryDelete(sleEntry); }
 	void				entryModify(SLE::ref sleEntry)								{ mNodes.entryModify(sleEntry); }
 
 	TER applyTransaction(const SerializedTransaction&, TransactionEngineParams, bool& didApply);
+
+	// Applying in two steps: run the transaction into our entry set without touching the ledger, then have
+	// the engine that owns the ledger write that set, if nothing the transaction read has changed since.
+	TER executeTransaction(const SerializedTransaction&, TransactionEngineParams, bool& didApply);
+	TER commitTransaction(const SerializedTransaction&, TransactionEngineParams,
+		LedgerEntrySet& nodes, TER terResult, bool didApply);
 };
 
 inline TransactionEngineParams operator|(const TransactionEngineParams& l1, const TransactionEngineParams& l2)
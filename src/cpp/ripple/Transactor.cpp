@@ -42,7 +42,12 @@ Transactor::Transactor(const SerializedTransaction& txn,TransactionEngineParams
 
 void Transactor::calculateFee()
 {
-	mFeeDue	= STAmount(mEngine->getLedger()->scaleFeeLoad(calculateBaseFee()));
+	uint64 uBaseFee = calculateBaseFee();
+
+	if (mEngine->getNodes().getReads())
+		mEngine->getNodes().getReads()->mBaseFee = uBaseFee;
+
+	mFeeDue	= STAmount(mEngine->getLedger()->scaleFeeLoad(uBaseFee));
 }
 
 uint64 Transactor::calculateBaseFee()
@@ -133,7 +138,7 @@ TER Transactor::checkSeq()
 		else
 		{
 			uint256 txID = mTxn.getTransactionID();
-			if (mEngine->getLedger()->hasTransaction(txID))
+			if (mEngine->getNodes().hasTransaction(txID))
 				return tefALREADY;
 		}
 
@@ -186,7 +191,10 @@ TER Transactor::apply()
 
 	calculateFee();
 
-	boost::recursive_mutex::scoped_lock sl(mEngine->getLedger()->mLock);
+	// Speculative runs share a ledger that is only read until they are all done
+	boost::recursive_mutex::scoped_lock sl(mEngine->getLedger()->mLock, boost::defer_lock);
+	if (!isSetBit(mParams, tapSPECULATIVE))
+		sl.lock();
 
 	mTxnAccount	= mEngine->entryCache(ltACCOUNT_ROOT, Ledger::getAccountRootIndex(mTxnAccountID));
 
@@ -76,7 +76,7 @@ TER TrustSetTransactor::doApply()
 	const STAmount	saSrcXRPBalance	= mTxnAccount->getFieldAmount(sfBalance);
 	const uint32	uOwnerCount		= mTxnAccount->getFieldU32(sfOwnerCount);
 	// The reserve required to create the line.
-	const uint64	uReserveCreate	= mEngine->getLedger()->getReserve(uOwnerCount + 1);
+	const uint64	uReserveCreate	= mEngine->getNodes().getReserve(uOwnerCount + 1);
 
 	STAmount			saLimitAllow	= saLimitAmount;
 	saLimitAllow.setIssuer(mTxnAccountID);
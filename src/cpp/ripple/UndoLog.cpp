@@ -0,0 +1,137 @@
+#include "UndoLog.h"
+
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+
+#include "SerializedLedger.h"
+#include "Log.h"
+
+SETUP_LOG();
+
+TransactionUndo::TransactionUndo(const SerializedTransaction& txn, LedgerEntrySet& nodes, Ledger::ref ledger) :
+	mTxID(txn.getTransactionID()), mBaseFee(0), mFeePaid(txn.getTransactionFee().getNValue())
+{
+	SHAMap::ref map = ledger->peekAccountStateMap();
+	const LedgerEntryReads::pointer& reads = nodes.getReads();
+
+	if (reads)
+	{
+		mBaseFee = reads->mBaseFee;
+		BOOST_FOREACH(const uint256& index, reads->mIndexes)
+			mBefore[index] = map->peekItem(index);
+	}
+
+	typedef std::map<uint256, LedgerEntrySetEntry>::value_type u256_LES_pair;
+	BOOST_FOREACH(u256_LES_pair& it, nodes)
+	{
+		if (mBefore.find(it.first) == mBefore.end())
+			mBefore[it.first] = map->peekItem(it.first);
+		if (it.second.mAction != taaCACHED)
+			mAfter[it.first] = SHAMapItem::pointer();
+	}
+}
+
+void TransactionUndo::written(Ledger::ref ledger)
+{
+	SHAMap::ref map = ledger->peekAccountStateMap();
+
+	for (ItemMap::iterator it = mAfter.begin(), end = mAfter.end(); it != end; ++it)
+		it->second = map->peekItem(it->first);
+}
+
+static void putItem(SHAMap::ref map, const uint256& index, SHAMapItem::ref current, SHAMapItem::ref target)
+{ // Move one entry from its current image to its target image, NULL being absent
+	if (!target)
+	{
+		if (current && !map->delItem(index))
+			assert(false);
+	}
+	else if (current)
+	{
+		if (!map->updateGiveItem(target, false, false))
+			assert(false);
+	}
+	else if (!map->addGiveItem(target, false, false))
+		assert(false);
+}
+
+bool TransactionUndo::isCurrent(SHAMap::ref map, const ItemMap& images)
+{
+	for (ItemMap::const_iterator it = images.begin(), end = images.end(); it != end; ++it)
+	{
+		SHAMapItem::pointer item = map->peekItem(it->first);
+
+		if (!item != !it->second)
+			return false;
+		if (item && (item != it->second) && (item->peekData() != it->second->peekData()))
+			return false;
+	}
+
+	return true;
+}
+
+bool TransactionUndo::canReplay(Ledger::ref ledger) const
+{ // Running the transaction again would see exactly what it saw before and charge the same fee
+	if (ledger->scaleFeeLoad(mBaseFee) > mFeePaid)
+		return false;
+
+	return isCurrent(ledger->peekAccountStateMap(), mBefore);
+}
+
+SHAMapItem::pointer TransactionUndo::rethread(SHAMapItem::ref item, uint32 ledgerSeq) const
+{ // Entries this transaction threaded carry the sequence of the ledger it was applied to
+	if (!item)
+		return item;
+
+	SerializedLedgerEntry sle(item->peekSerializer(), item->getTag());
+	if (!sle.isThreadedType() || (sle.getFieldH256(sfPreviousTxnID) != mTxID)
+		|| (sle.getFieldU32(sfPreviousTxnLgrSeq) == ledgerSeq))
+		return item;
+
+	sle.setFieldU32(sfPreviousTxnLgrSeq, ledgerSeq);
+
+	Serializer s;
+	sle.add(s);
+	return boost::make_shared<SHAMapItem>(item->getTag(), s.peekData());
+}
+
+bool TransactionUndo::replay(Ledger::ref ledger, const Serializer& txn)
+{ // Apply the transaction to another open ledger by writing what it wrote here, threaded to that ledger
+	ScopedLock sl(ledger->peekAccountStateMap()->Lock());
+
+	if (!canReplay(ledger))
+		return false;
+
+	SHAMap::ref map = ledger->peekAccountStateMap();
+	for (ItemMap::const_iterator it = mAfter.begin(), end = mAfter.end(); it != end; ++it)
+		putItem(map, it->first, mBefore.find(it->first)->second, rethread(it->second, ledger->getLedgerSeq()));
+
+	if (!ledger->addTransaction(mTxID, txn))
+		assert(false);
+
+	ledger->getUndoLog(true)->add(shared_from_this());
+	return true;
+}
+
+void UndoLog::add(const TransactionUndo::pointer& undo)
+{
+	boost::mutex::scoped_lock sl(mLock);
+	mRecords[undo->getTxID()] = undo;
+}
+
+TransactionUndo::pointer UndoLog::find(const uint256& txID)
+{
+	boost::mutex::scoped_lock sl(mLock);
+	boost::unordered_map<uint256, TransactionUndo::pointer>::iterator it = mRecords.find(txID);
+	if (it == mRecords.end())
+		return TransactionUndo::pointer();
+	return it->second;
+}
+
+int UndoLog::size()
+{
+	boost::mutex::scoped_lock sl(mLock);
+	return mRecords.size();
+}
+
+// vim:ts=4
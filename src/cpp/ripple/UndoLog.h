@@ -0,0 +1,66 @@
+#ifndef __UNDOLOG__
+#define __UNDOLOG__
+
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "uint256.h"
+#include "SHAMap.h"
+#include "Ledger.h"
+#include "LedgerEntrySet.h"
+#include "SerializedTransaction.h"
+
+// What applying one transaction to an open ledger did: every state entry it saw, as it saw it, and every
+// entry it wrote, as it left it. Together they let the transaction move to the next open ledger without
+// running it again, as long as nothing it saw has changed there.
+class TransactionUndo : public boost::enable_shared_from_this<TransactionUndo>
+{
+public:
+	typedef boost::shared_ptr<TransactionUndo>		pointer;
+	typedef std::map<uint256, SHAMapItem::pointer>	ItemMap;	// A NULL item is an absent entry
+
+protected:
+	uint256		mTxID;
+	ItemMap		mBefore;
+	ItemMap		mAfter;
+	uint64		mBaseFee;
+	uint64		mFeePaid;
+
+public:
+	// Takes the before images, so build it before the entries are written to the ledger
+	TransactionUndo(const SerializedTransaction& txn, LedgerEntrySet& nodes, Ledger::ref ledger);
+
+	void written(Ledger::ref ledger);				// Take the after images once the entries are written
+
+	const uint256& getTxID() const					{ return mTxID; }
+	int getTouched() const							{ return mBefore.size(); }
+
+	bool canReplay(Ledger::ref ledger) const;
+	static bool isCurrent(SHAMap::ref map, const ItemMap& images);	// Does the map still hold these images
+	bool replay(Ledger::ref ledger, const Serializer& txn);
+
+protected:
+	SHAMapItem::pointer rethread(SHAMapItem::ref item, uint32 ledgerSeq) const;
+};
+
+class UndoLog
+{ // How each transaction was applied to one open ledger
+public:
+	typedef boost::shared_ptr<UndoLog>	pointer;
+
+protected:
+	boost::mutex											mLock;
+	boost::unordered_map<uint256, TransactionUndo::pointer>	mRecords;
+
+public:
+	void add(const TransactionUndo::pointer& undo);
+	TransactionUndo::pointer find(const uint256& txID);
+	int size();
+};
+
+#endif
+// vim:ts=4
@@ -43,7 +43,7 @@ TER WalletAddTransactor::doApply()
 	STAmount		saDstAmount		= mTxn.getFieldAmount(sfAmount);
 	const STAmount	saSrcBalance	= mTxnAccount->getFieldAmount(sfBalance);
 	const uint32	uOwnerCount		= mTxnAccount->getFieldU32(sfOwnerCount);
-	const uint64	uReserve		= mEngine->getLedger()->getReserve(uOwnerCount);
+	const uint64	uReserve		= mEngine->getNodes().getReserve(uOwnerCount);
 	STAmount		saPaid			= mTxn.getTransactionFee();
 
 	// Make sure have enough reserve to send. Allow final spend to use reserve for fee.
@@ -22,96 +22,179 @@
 
 #include "bignum.h"
 #include "BitcoinUtil.h"
+#include "types.h"
 
 extern const char* ALPHABET;
 
+// The codec works on limbs rather than bytes and digits, so it needs no big number library.
+// Encoding folds the input in 32 bit words into limbs of five base 58 digits, 58^5 < 2^30.
+// Decoding folds the input in groups of five digits into 32 bit limbs.
+// Either way the inner loop is one multiply and one divide by a constant per limb.
+// Inputs up to BASE58_STACK_BYTES long are converted without touching the heap.
+
+#define BASE58_STACK_BYTES	128
+#define BASE58_LIMB_BASE	656356768u				// 58^5
+#define BASE58_STACK_LIMBS	(BASE58_STACK_BYTES * 8 / 29 + 1)
+
 inline std::string EncodeBase58(const unsigned char* pbegin, const unsigned char* pend)
 {
-    CAutoBN_CTX pctx;
-    CBigNum bn58 = 58;
-    CBigNum bn0 = 0;
+    // Leading zeroes encoded as base58 zeros
+    size_t nZeros = 0;
+    while (pbegin + nZeros < pend && pbegin[nZeros] == 0)
+        nZeros++;
+
+    const unsigned char* p = pbegin + nZeros;
+    size_t nSize = pend - p;
+
+    // A limb holds log2(58^5) = 29.3 bits, limbs are stored least significant first
+    uint32 stackLimbs[BASE58_STACK_LIMBS];
+    std::vector<uint32> heapLimbs;
+    uint32* limbs = stackLimbs;
+    if (nSize * 8 / 29 + 1 > BASE58_STACK_LIMBS)
+    {
+        heapLimbs.resize(nSize * 8 / 29 + 1);
+        limbs = &heapLimbs[0];
+    }
+    size_t nLimbs = 0;
 
-    // Convert big endian data to little endian
-    // Extra zero at the end make sure bignum will interpret as a positive number
-    std::vector<unsigned char> vchTmp(pend-pbegin+1, 0);
-    std::reverse_copy(pbegin, pend, vchTmp.begin());
+    // The first word takes the odd bytes, so the rest are whole words
+    int nBytes = (nSize % 4) ? (nSize % 4) : 4;
+    while (p < pend)
+    {
+        uint64 carry = 0;
+        for (int i = 0; i < nBytes; ++i)
+            carry = (carry << 8) | *p++;
 
-    // Convert little endian data to bignum
-    CBigNum bn(vchTmp);
+        for (size_t i = 0; i < nLimbs; ++i)
+        {
+            uint64 t = (static_cast<uint64>(limbs[i]) << (8 * nBytes)) + carry;
+            limbs[i] = static_cast<uint32>(t % BASE58_LIMB_BASE);
+            carry = t / BASE58_LIMB_BASE;
+        }
+        while (carry != 0)
+        {
+            limbs[nLimbs++] = static_cast<uint32>(carry % BASE58_LIMB_BASE);
+            carry /= BASE58_LIMB_BASE;
+        }
+        nBytes = 4;
+    }
 
-    // Convert bignum to std::string
     std::string str;
-    // Expected size increase from base58 conversion is approximately 137%
-    // use 138% to be safe
-    str.reserve((pend - pbegin) * 138 / 100 + 1);
-    CBigNum dv;
-    CBigNum rem;
-    while (bn > bn0)
-    {
-        if (!BN_div(&dv, &rem, &bn, &bn58, pctx))
-            throw bignum_error("EncodeBase58 : BN_div failed");
-        bn = dv;
-        unsigned int c = rem.getuint();
-        str += ALPHABET[c];
+    str.reserve(nZeros + nLimbs * 5);
+    str.assign(nZeros, ALPHABET[0]);
+
+    if (nLimbs != 0)
+    { // The top limb has no leading zero digits, the others have exactly five digits
+        char digits[5];
+        int nDigits = 0;
+        for (uint32 top = limbs[nLimbs - 1]; top != 0; top /= 58)
+            digits[nDigits++] = ALPHABET[top % 58];
+        while (nDigits != 0)
+            str += digits[--nDigits];
+
+        for (size_t i = nLimbs - 1; i-- != 0;)
+        {
+            uint32 limb = limbs[i];
+            for (int j = 4; j >= 0; --j)
+            {
+                digits[j] = ALPHABET[limb % 58];
+                limb /= 58;
+            }
+            str.append(digits, 5);
+        }
     }
 
-    // Leading zeroes encoded as base58 zeros
-    for (const unsigned char* p = pbegin; p < pend && *p == 0; p++)
-        str += ALPHABET[0];
-
-    // Convert little endian std::string to big endian
-    reverse(str.begin(), str.end());
     return str;
 }
 
 inline std::string EncodeBase58(const std::vector<unsigned char>& vch)
 {
+    if (vch.empty())
+        return std::string();
     return EncodeBase58(&vch[0], &vch[0] + vch.size());
 }
 
 inline bool DecodeBase58(const char* psz, std::vector<unsigned char>& vchRet)
 {
-    CAutoBN_CTX pctx;
+    static const uint32 powers[] = { 1, 58, 58 * 58, 58 * 58 * 58, 58 * 58 * 58 * 58, BASE58_LIMB_BASE };
+
+    // ALPHABET can be changed by the configuration, so the reverse map is built per call
+    signed char map[256];
+    memset(map, -1, sizeof(map));
+    for (int i = 0; i < 58; ++i)
+        map[static_cast<unsigned char>(ALPHABET[i])] = i;
+
     vchRet.clear();
-    CBigNum bn58 = 58;
-    CBigNum bn = 0;
-    CBigNum bnChar;
     while (isspace(*psz))
         psz++;
 
-    // Convert big endian string to bignum
-    for (const char* p = psz; *p; p++)
+    const char* pend = psz;
+    while (map[static_cast<unsigned char>(*pend)] >= 0)
+        pend++;
+    for (const char* p = pend; *p; p++)
+    {
+        if (!isspace(*p))
+            return false;
+    }
+
+    // Restore leading zeros
+    size_t nZeros = 0;
+    while (psz + nZeros < pend && psz[nZeros] == ALPHABET[0])
+        nZeros++;
+
+    const char* p = psz + nZeros;
+    size_t nChars = pend - p;
+
+    // A digit holds log2(58) = 5.86 bits, limbs are 32 bits stored least significant first
+    uint32 stackLimbs[BASE58_STACK_LIMBS];
+    std::vector<uint32> heapLimbs;
+    uint32* limbs = stackLimbs;
+    if (nChars * 3 / 16 + 1 > BASE58_STACK_LIMBS)
     {
-        const char* p1 = strchr(ALPHABET, *p);
-        if (p1 == NULL)
+        heapLimbs.resize(nChars * 3 / 16 + 1);
+        limbs = &heapLimbs[0];
+    }
+    size_t nLimbs = 0;
+
+    int nDigits = (nChars % 5) ? (nChars % 5) : 5;
+    while (p < pend)
+    {
+        uint64 carry = 0;
+        for (int i = 0; i < nDigits; ++i)
+            carry = carry * 58 + map[static_cast<unsigned char>(*p++)];
+
+        uint64 multiplier = powers[nDigits];
+        for (size_t i = 0; i < nLimbs; ++i)
         {
-            while (isspace(*p))
-                p++;
-            if (*p != '\0')
-                return false;
-            break;
+            uint64 t = limbs[i] * multiplier + carry;
+            limbs[i] = static_cast<uint32>(t);
+            carry = t >> 32;
         }
-        bnChar.setuint(p1 - ALPHABET);
-        if (!BN_mul(&bn, &bn, &bn58, pctx))
-            throw bignum_error("DecodeBase58 : BN_mul failed");
-        bn += bnChar;
+        if (carry != 0)
+            limbs[nLimbs++] = static_cast<uint32>(carry);
+        nDigits = 5;
     }
 
-    // Get bignum as little endian data
-    std::vector<unsigned char> vchTmp = bn.getvch();
+    vchRet.reserve(nZeros + nLimbs * 4);
+    vchRet.assign(nZeros, 0);
 
-    // Trim off sign byte if present
-    if (vchTmp.size() >= 2 && vchTmp.end()[-1] == 0 && vchTmp.end()[-2] >= 0x80)
-        vchTmp.erase(vchTmp.end()-1);
+    if (nLimbs != 0)
+    { // Skip the leading zero bytes of the top limb
+        int nShift = 24;
+        while ((limbs[nLimbs - 1] >> nShift) == 0)
+            nShift -= 8;
+        for (; nShift >= 0; nShift -= 8)
+            vchRet.push_back(static_cast<unsigned char>(limbs[nLimbs - 1] >> nShift));
 
-    // Restore leading zeros
-    int nLeadingZeros = 0;
-    for (const char* p = psz; *p == ALPHABET[0]; p++)
-        nLeadingZeros++;
-    vchRet.assign(nLeadingZeros + vchTmp.size(), 0);
+        for (size_t i = nLimbs - 1; i-- != 0;)
+        {
+            vchRet.push_back(static_cast<unsigned char>(limbs[i] >> 24));
+            vchRet.push_back(static_cast<unsigned char>(limbs[i] >> 16));
+            vchRet.push_back(static_cast<unsigned char>(limbs[i] >> 8));
+            vchRet.push_back(static_cast<unsigned char>(limbs[i]));
+        }
+    }
 
-    // Convert little endian data to big endian
-    std::reverse_copy(vchTmp.begin(), vchTmp.end(), vchRet.end() - vchTmp.size());
     return true;
 }
 
@@ -124,13 +207,32 @@ inline bool DecodeBase58(const std::string& str, std::vector<unsigned char>& vch
 
 
 
-inline std::string EncodeBase58Check(const std::vector<unsigned char>& vchIn)
+inline std::string EncodeBase58Check(const unsigned char* pbegin, const unsigned char* pend)
 {
     // add 4-byte hash check to the end
-    std::vector<unsigned char> vch(vchIn);
-    uint256 hash = SHA256Hash(vch.begin(), vch.end());
-    vch.insert(vch.end(), (unsigned char*)&hash, (unsigned char*)&hash + 4);
-    return EncodeBase58(vch);
+    size_t nSize = pend - pbegin;
+    uint256 hash = SHA256Hash(pbegin, pend);
+
+    unsigned char stackBuf[BASE58_STACK_BYTES];
+    std::vector<unsigned char> heapBuf;
+    unsigned char* buf = stackBuf;
+    if (nSize + 4 > BASE58_STACK_BYTES)
+    {
+        heapBuf.resize(nSize + 4);
+        buf = &heapBuf[0];
+    }
+
+    if (nSize != 0)
+        memcpy(buf, pbegin, nSize);
+    memcpy(buf + nSize, hash.begin(), 4);
+    return EncodeBase58(buf, buf + nSize + 4);
+}
+
+inline std::string EncodeBase58Check(const std::vector<unsigned char>& vchIn)
+{
+    if (vchIn.empty())
+        return EncodeBase58Check(NULL, NULL);
+    return EncodeBase58Check(&vchIn[0], &vchIn[0] + vchIn.size());
 }
 
 inline bool DecodeBase58Check(const char* psz, std::vector<unsigned char>& vchRet)
@@ -221,11 +323,21 @@ public:
 
     std::string ToString() const
     {
-        std::vector<unsigned char> vch(1, nVersion);
+        if (vchData.size() + 1 + 4 > BASE58_STACK_BYTES)
+        {
+            std::vector<unsigned char> vch(1, nVersion);
+
+            vch.insert(vch.end(), vchData.begin(), vchData.end());
 
-		vch.insert(vch.end(), vchData.begin(), vchData.end());
+            return EncodeBase58Check(vch);
+        }
+
+        unsigned char buf[BASE58_STACK_BYTES];
+        buf[0] = nVersion;
+        if (!vchData.empty())
+            memcpy(buf + 1, &vchData[0], vchData.size());
 
-        return EncodeBase58Check(vch);
+        return EncodeBase58Check(buf, buf + 1 + vchData.size());
     }
 
     int CompareTo(const CBase58Data& b58) const
@@ -282,6 +282,9 @@ public:
 		return Verify(hash, sig.data(), sig.size());
 	}
 
+	// Verify against a serialized public key with the secp256k1 backend, see Secp256k1.h
+	static bool VerifyPublic(const std::vector<unsigned char>& vchPubKey, const uint256& hash, const std::vector<unsigned char>& vchSig);
+
 	// ECIES functions. These throw on failure
 
 	// returns a 32-byte secret unique to these two keys. At least one private key must be known.
@@ -9,6 +9,8 @@
 #include "Application.h"
 #include "CallRPC.h"
 #include "Config.h"
+#include "LedgerReplay.h"
+#include "LoadGenerator.h"
 #include "Log.h"
 #include "RPCHandler.h"
 #include "utils.h"
@@ -133,6 +135,8 @@ int main(int argc, char* argv[])
 		("ledger", po::value<std::string>(), "Load the specified ledger and start from .")
 		("start", "Start from a fresh Ledger.")
 		("net", "Get the initial ledger from the network.")
+		("replay", po::value<std::string>(), "Apply stored ledgers first[-last] again, check them and report timing.")
+		("loadgen", po::value<std::string>(), "Put accounts,rate,seconds of load on a stand-alone server and report as JSON.")
 	;
 
 	// Interpret positional arguments as --parameters.
@@ -177,8 +181,6 @@ int main(int argc, char* argv[])
 	else
 		Log::setMinSeverity(lsINFO, true);
 
-	InstanceType::multiThread();
-
 	if (vm.count("unittest"))
 	{
 		unit_test_main(init_unit_test, argc, argv);
@@ -220,6 +222,27 @@ int main(int argc, char* argv[])
 	{
 		iResult	= 1;
 	}
+	else if (vm.count("replay"))
+	{
+		LedgerReplay replay(vm["replay"].as<std::string>());
+
+		if (!replay.isValid())
+		{
+			iResult	= 1;
+		}
+		else
+		{
+			replay.setup();
+			setupServer();
+			iResult	= replay.run();
+		}
+	}
+	else if (vm.count("loadgen"))
+	{
+		LoadGenerator load(vm["loadgen"].as<std::string>());
+
+		iResult	= load.isValid() ? load.run() : 1;
+	}
 	else if (!vm.count("parameters"))
 	{
 		// No arguments. Run server.